@@ -177,6 +177,21 @@ tray-icon: The tray icon was clicked
 }
 
 
+tray-button-metrics: Performance counters of the tray button process (periodically, and when it exits)
+{
+    "module": "metrics.app",
+    "event": "tray-button-metrics",
+    "data": {
+        "counters": { "SetWindowPos": 4, "RedrawWindow": 9, "shellMessages": 120, "timerWakeups": 30 },
+        "timers": {
+            // Durations are microseconds. buckets[n] is the number of calls which took less than 2^n microseconds.
+            "paint": { "count": 9, "totalUs": 900, "maxUs": 250, "p50Us": 64, "p99Us": 256, "buckets": [0, 0, 1, ...] },
+            ...
+        }
+    }
+}
+
+
 office-change: When one of the simplification buttons have been clicked.
 {
   "module": "metrics.app",
@@ -309,6 +324,10 @@ fluid.defaults("gpii.app.metrics.qssInWrapper", {
                         func: "{eventLog}.uiMetric",
                         args: [ "tray-icon" ]
                     },
+                    "{gpii.app}.tray.events.onTrayButtonMetrics": {
+                        func: "{eventLog}.uiMetric",
+                        args: [ "tray-button-metrics", "{arguments}.0" ]
+                    },
                     "{gpii.app}.tray.events.onTrayIconMenuShown": {
                         func: "{eventLog}.uiMetric",
                         args: [ "button-activated", {
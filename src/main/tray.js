@@ -17,6 +17,7 @@
 var fluid    = require("infusion");
 var electron = require("electron");
 var child_process = require("child_process");
+var net = require("net");
 
 var Tray           = electron.Tray;
 var gpii           = fluid.registerNamespace("gpii");
@@ -46,7 +47,9 @@ fluid.defaults("gpii.app.tray", {
         onActivePreferenceSetAltered: null, // passed from parent
         onMenuUpdated: null,
         onTrayIconClicked: null,
-        onTrayIconMenuShown: null
+        onTrayIconMenuShown: null,
+        // A snapshot of the tray button's performance metrics (only fired by gpii.app.trayButton).
+        onTrayButtonMetrics: null
     },
     model: {
         isKeyedIn: false,
@@ -219,22 +222,41 @@ fluid.defaults("gpii.app.trayButton", {
             funcName: "gpii.app.trayButton.startProcess",
             args: [ "{that}" ]
         },
+        loadAddon: {
+            funcName: "gpii.app.trayButton.loadAddon",
+            args: [ "{that}.options.trayButtonAddon" ]
+        },
         remove: {
             func: "{that}.updateButton",
             args: [ "{that}.options.buttonItems.destroy" ]
         },
         updateButton: {
-            func: "{that}.sendDataMessage", // command, data
-            args: [ "{that}.trayButtonWindow", "{arguments}.0", "{arguments}.1" ]
+            funcName: "gpii.app.trayButton.updateButton", // command, data
+            args: [ "{that}", "{arguments}.0", "{arguments}.1" ]
         },
         getIconBounds: {
             funcName: "fluid.identity",
             args: [ "{that}.rect" ]
+        },
+        // The timeline of the recent clicks, from both the button and here, as a Chrome trace (chrome://tracing).
+        exportTrace: {
+            funcName: "gpii.app.trayButton.exportTrace",
+            args: [ "{that}" ]
         }
     },
     listeners: {
         "onCreate.init": "{that}.startProcess()",
         "onDestroy.remove": "{that}.remove()",
+        "onDestroy.closePipe": {
+            funcName: "gpii.app.trayButton.closePipe",
+            args: [ "{that}" ],
+            priority: "after:remove"
+        },
+        "onDestroy.stopAddon": {
+            funcName: "gpii.app.trayButton.stopAddon",
+            args: [ "{that}" ],
+            priority: "after:remove"
+        },
         "onMenuUpdated.trayButton": {
             funcName: "gpii.app.trayButton.setMenu",
             args: [ "{that}", "{arguments}.0" ]
@@ -269,8 +291,25 @@ fluid.defaults("gpii.app.trayButton", {
         rect: {},
         menu: null,
         // true if the mouse pointer is currently over the button
-        mouseOver: false
+        mouseOver: false,
+        // The server the button connects to, when usePipe is set; the connection, and the next sequence number.
+        pipeServer: null,
+        pipeName: null,
+        pipe: null,
+        pipeSequence: 0,
+        // The addon, when the button is in this process (inProcess).
+        addon: null,
+        // The spans of the recent clicks (Chrome trace events): recorded here, and logged by the button's process.
+        spans: [],
+        buttonSpans: []
     },
+    // The number of trace events kept, by each side.
+    maxSpans: 200,
+    // Talk to the button over a named pipe, rather than window messages (see gpii.app.trayButton.frames).
+    usePipe: false,
+    // Put the button on the taskbar from this process, with the addon, rather than running tray-button.exe (which is
+    // still used if the addon can't be loaded).
+    inProcess: false,
     buttonItems: {
         // Set the current icon
         icon: 1,
@@ -281,9 +320,18 @@ fluid.defaults("gpii.app.trayButton", {
         // Remove the icon
         destroy: 4,
         // Set whether or not the button should look "on" (for high-contrast)
-        state: 5
+        state: 5,
+        // Write the performance metrics to stdout (in-process, they come back as the metrics notification)
+        metrics: 6,
+        // Several of the above, in one message (see gpii.app.trayButton.encodeBatch)
+        batch: 7,
+        // Play an animation instead of the icon: "<ms per frame>;<loops>;<file>;<file>...", or null to stop it
+        animate: 8,
+        // Set an SVG rendition of the current icon, drawn at the exact size for the DPI (null to use the icon file)
+        svgIcon: 9
     },
-    trayButtonExe: "%gpii-app/bin/tray-button.exe"
+    trayButtonExe: "%gpii-app/bin/tray-button.exe",
+    trayButtonAddon: "%gpii-app/trayButton/addon/build/Release/tray_button.node"
 });
 
 fluid.defaults("gpii.app.trayButton.windows", {
@@ -315,19 +363,437 @@ gpii.app.trayButton.notifications = {
     // Mouse is over the button
     mouseEnter: 3,
     // Mouse is no longer over the button
-    mouseLeave: 4
+    mouseLeave: 4,
+    // The button has moved (only from the addon, which passes the rectangle with it)
+    position: 5,
+    // A snapshot of the metrics (only from the addon, which passes the JSON with it; the process writes it to stdout)
+    metrics: 6
+};
+
+// A batch record's length, when it has no data.
+gpii.app.trayButton.batchNoData = 0xffff;
+
+/**
+ * Encodes several button commands as a single batch command. Each record is made of UTF-16 code units:
+ * [command][length][data], where a length of 0xffff means no data (see trayButton/core/batch.h).
+ *
+ * @param {Array} records Array of [command, data] pairs. Data is converted to a string, unless it's null/undefined.
+ * @return {String} The batch, to be sent as the data of the buttonItems.batch command.
+ */
+gpii.app.trayButton.encodeBatch = function (records) {
+    return fluid.transform(records, function (record) {
+        var command = record[0], data = record[1];
+        if (data === null || data === undefined) {
+            return String.fromCharCode(command, gpii.app.trayButton.batchNoData);
+        } else {
+            data = String(data).substr(0, gpii.app.trayButton.batchNoData - 1);
+            return String.fromCharCode(command, data.length) + data;
+        }
+    }).join("");
+};
+
+/**
+ * Splits a batch into batches of no more than a given length, so each fits in a frame. The records are kept in order,
+ * and not split; one that's too long on its own is left out.
+ *
+ * @param {String} batch The batch (gpii.app.trayButton.encodeBatch).
+ * @param {Number} maxLength The longest batch (UTF-16 code units).
+ * @return {Array} The batches (just the one, if it fits).
+ */
+gpii.app.trayButton.splitBatch = function (batch, maxLength) {
+    if (batch.length <= maxLength) {
+        return [batch];
+    }
+
+    var batches = [], current = "", offset = 0;
+    while (offset < batch.length) {
+        var command = batch.charCodeAt(offset), length = batch.charCodeAt(offset + 1);
+        var end = offset + 2 + (length === gpii.app.trayButton.batchNoData ? 0 : length);
+        var record = batch.substring(offset, end);
+        offset = end;
+        if (record.length > maxLength) {
+            fluid.log("traybutton: command too big to send: ", command);
+        } else {
+            if (current.length + record.length > maxLength) {
+                batches.push(current);
+                current = "";
+            }
+            current += record;
+        }
+    }
+    if (current) {
+        batches.push(current);
+    }
+    return batches;
+};
+
+// Frame types of the pipe protocol (see trayButton/core/frame.h).
+gpii.app.trayButton.frames = {
+    // Button to gpii: uint32 notification (gpii.app.trayButton.notifications)
+    notify: 1,
+    // Button to gpii: int32 left, top, width, height
+    position: 2,
+    // gpii to button: a batch of commands (gpii.app.trayButton.encodeBatch, as UTF-16)
+    command: 3,
+    // Either way: answered with a pong, with the same payload
+    ping: 4,
+    pong: 5
+};
+
+// The size of a frame's header: uint32 length, uint16 type, uint16 flags, uint32 sequence, uint64 timestamp.
+gpii.app.trayButton.frameHeaderSize = 20;
+// The largest frame.
+gpii.app.trayButton.frameMaxSize = 0x10000;
+
+// The environment variable which tells the button the name of the pipe.
+gpii.app.trayButton.pipeVariable = "GPII_TRAY_BUTTON_PIPE";
+
+/**
+ * Gets the time, for the frame timestamps and the spans. On Windows, this is the same clock as the button's.
+ * @return {Number} The high-resolution time, in microseconds.
+ */
+gpii.app.trayButton.now = function () {
+    var now = process.hrtime();
+    return now[0] * 1e6 + Math.floor(now[1] / 1e3);
+};
+
+/**
+ * Encodes a frame of the pipe protocol.
+ * @param {Number} type The frame type (gpii.app.trayButton.frames).
+ * @param {Number} sequence The sequence number.
+ * @param {Buffer} payload [optional] The payload.
+ * @param {Number} timestamp [optional] The time, in microseconds. Defaults to now.
+ * @return {Buffer} The frame, or null if the payload is too big for one (the button would drop the connection).
+ */
+gpii.app.trayButton.encodeFrame = function (type, sequence, payload, timestamp) {
+    payload = payload || Buffer.alloc(0);
+    if (timestamp === undefined) {
+        timestamp = gpii.app.trayButton.now();
+    }
+
+    var headerSize = gpii.app.trayButton.frameHeaderSize;
+    if (headerSize + payload.length > gpii.app.trayButton.frameMaxSize) {
+        return null;
+    }
+    var frame = Buffer.alloc(headerSize + payload.length);
+    frame.writeUInt32LE(frame.length, 0);
+    frame.writeUInt16LE(type, 4);
+    frame.writeUInt16LE(0, 6);
+    frame.writeUInt32LE(sequence >>> 0, 8);
+    frame.writeUInt32LE(timestamp % 0x100000000, 12);
+    frame.writeUInt32LE(Math.floor(timestamp / 0x100000000), 16);
+    payload.copy(frame, headerSize);
+    return frame;
+};
+
+/**
+ * Decodes the complete frames at the start of a buffer.
+ * @param {Buffer} buffer The bytes received.
+ * @return {Object} {frames: [{type, sequence, timestamp, payload}], remaining: the bytes of the incomplete frame at the
+ *  end, error: true if the stream is corrupt}.
+ */
+gpii.app.trayButton.decodeFrames = function (buffer) {
+    var headerSize = gpii.app.trayButton.frameHeaderSize;
+    var result = {
+        frames: [],
+        remaining: buffer,
+        error: false
+    };
+
+    var offset = 0;
+    while (buffer.length - offset >= headerSize) {
+        var length = buffer.readUInt32LE(offset);
+        var type = buffer.readUInt16LE(offset + 4);
+        if (length < headerSize || length > gpii.app.trayButton.frameMaxSize || type === 0) {
+            result.error = true;
+            break;
+        }
+        if (buffer.length - offset < length) {
+            break;
+        }
+        result.frames.push({
+            type: type,
+            sequence: buffer.readUInt32LE(offset + 8),
+            timestamp: buffer.readUInt32LE(offset + 12) + buffer.readUInt32LE(offset + 16) * 0x100000000,
+            payload: buffer.slice(offset + headerSize, offset + length)
+        });
+        offset += length;
+    }
+
+    result.remaining = buffer.slice(offset);
+    return result;
+};
+
+/**
+ * Gets the button's rectangle from a position frame.
+ * @param {Buffer} payload The payload of the frame.
+ * @return {Object} The rectangle {x, y, width, height}, or null if the payload isn't a rectangle.
+ */
+gpii.app.trayButton.decodePosition = function (payload) {
+    return payload.length === 16 ? {
+        x: payload.readInt32LE(0),
+        y: payload.readInt32LE(4),
+        width: payload.readInt32LE(8),
+        height: payload.readInt32LE(12)
+    } : null;
+};
+
+/**
+ * Sends a command to the button: to the addon if it's in this process, over the pipe if it's connected, otherwise as
+ * a window message.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Number} command The command (buttonItems).
+ * @param {Any} data The command's data.
+ */
+gpii.app.trayButton.updateButton = function (that, command, data) {
+    if (that.addon) {
+        that.addon.command(command, data === null || data === undefined ? null : String(data));
+    } else if (that.pipe) {
+        // Everything is a batch, over the pipe; split into frames, if it's too big for one.
+        var batch = command === that.options.buttonItems.batch
+            ? data
+            : gpii.app.trayButton.encodeBatch([[command, data]]);
+        var maxLength = (gpii.app.trayButton.frameMaxSize - gpii.app.trayButton.frameHeaderSize) / 2;
+        fluid.each(gpii.app.trayButton.splitBatch(batch, maxLength), function (part) {
+            gpii.app.trayButton.sendFrame(that, gpii.app.trayButton.frames.command, Buffer.from(part, "utf16le"));
+        });
+    } else {
+        that.sendDataMessage(that.trayButtonWindow, command, data);
+    }
+};
+
+/**
+ * Sends a frame to the button, over the pipe.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Number} type The frame type (gpii.app.trayButton.frames).
+ * @param {Buffer} payload [optional] The payload.
+ */
+gpii.app.trayButton.sendFrame = function (that, type, payload) {
+    var frame = gpii.app.trayButton.encodeFrame(type, that.pipeSequence, payload);
+    if (frame) {
+        that.pipeSequence++;
+        that.pipe.write(frame);
+    } else {
+        fluid.log("traybutton: frame too big to send: ", payload.length);
+    }
+};
+
+/**
+ * Creates the pipe server, which the button connects to.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Function} callback Called when the server is ready, or has failed.
+ */
+gpii.app.trayButton.listen = function (that, callback) {
+    var name = "\\\\.\\pipe\\gpii-tray-button-" + process.pid;
+    var ready = false;
+    that.pipeServer = net.createServer(function (socket) {
+        gpii.app.trayButton.pipeConnected(that, socket);
+    });
+    that.pipeServer.on("error", function (err) {
+        fluid.log("traybutton: pipe server failed: ", err.message);
+        that.pipeServer = null;
+        if (!ready) {
+            // Use window messages instead.
+            ready = true;
+            callback();
+        }
+    });
+    that.pipeServer.listen(name, function () {
+        that.pipeName = name;
+        ready = true;
+        callback();
+    });
+};
+
+/**
+ * Handles the button connecting to the pipe.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {net.Socket} socket The connection.
+ */
+gpii.app.trayButton.pipeConnected = function (that, socket) {
+    fluid.log("traybutton: pipe connected");
+    if (that.pipe) {
+        // The old process has gone.
+        that.pipe.destroy();
+    }
+    that.pipe = socket;
+    that.pipeSequence = 0;
+
+    var pending = Buffer.alloc(0);
+    socket.on("data", function (data) {
+        var result = gpii.app.trayButton.decodeFrames(Buffer.concat([pending, data]));
+        pending = result.remaining;
+        fluid.each(result.frames, function (frame) {
+            if (!fluid.isDestroyed(that)) {
+                gpii.app.trayButton.gotFrame(that, frame);
+            }
+        });
+        if (result.error) {
+            fluid.log("traybutton: corrupt frame from the pipe");
+            socket.destroy();
+        }
+    });
+    var closed = function () {
+        if (that.pipe === socket) {
+            that.pipe = null;
+        }
+    };
+    socket.on("close", closed);
+    socket.on("error", closed);
+};
+
+/**
+ * Handles a frame from the button.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Object} frame The frame, from gpii.app.trayButton.decodeFrames.
+ */
+gpii.app.trayButton.gotFrame = function (that, frame) {
+    var frames = gpii.app.trayButton.frames;
+    switch (frame.type) {
+    case frames.notify:
+        // The event's sequence number follows the notification, from newer buttons.
+        if (frame.payload.length === 4 || frame.payload.length === 8) {
+            gpii.app.trayButton.gotNotification(that, frame.payload.readUInt32LE(0),
+                frame.payload.length === 8 ? frame.payload.readUInt32LE(4) : 0, frame.timestamp);
+        }
+        break;
+    case frames.position:
+        that.rect = gpii.app.trayButton.decodePosition(frame.payload) || that.rect;
+        break;
+    case frames.ping:
+        gpii.app.trayButton.sendFrame(that, frames.pong, frame.payload);
+        break;
+    default:
+        break;
+    }
 };
 
 /**
- * Starts the tray button process, and restarts it if it dies.
+ * Closes the pipe server, and the connection.
+ * @param {Component} that The gpii.app.trayButton instance.
+ */
+gpii.app.trayButton.closePipe = function (that) {
+    if (that.pipe) {
+        // Let the destroy command go first.
+        that.pipe.end();
+        that.pipe = null;
+    }
+    if (that.pipeServer) {
+        that.pipeServer.close();
+        that.pipeServer = null;
+    }
+};
+
+/**
+ * Loads the addon, which puts the button on the taskbar from this process.
+ * @param {String} path The addon.
+ * @return {Object} The addon, or null if it can't be loaded.
+ */
+gpii.app.trayButton.loadAddon = function (path) {
+    try {
+        return require(fluid.module.resolvePath(path));
+    } catch (e) {
+        fluid.log("traybutton: can't load the addon: ", e.message);
+        return null;
+    }
+};
+
+/**
+ * Starts the button in this process, with the addon.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @return {Boolean} true if the button has started.
+ */
+gpii.app.trayButton.startAddon = function (that) {
+    var addon = that.loadAddon();
+    if (addon) {
+        fluid.log("Starting TrayButton in-process.");
+        // The button asks for an update as soon as it's created, which can be before start returns.
+        that.addon = addon;
+        var started = addon.start(function (notification, data, sequence, timestamp) {
+            if (!fluid.isDestroyed(that)) {
+                gpii.app.trayButton.gotAddonEvent(that, notification, data, sequence, timestamp);
+            }
+        });
+        if (!started) {
+            fluid.log("traybutton: the addon didn't start");
+            that.addon = null;
+        }
+    }
+    return !!that.addon;
+};
+
+/**
+ * Handles an event from the addon.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Number} notification The notification (gpii.app.trayButton.notifications).
+ * @param {Object|String} data [optional] The button's rectangle {x, y, width, height}, for the position notification,
+ *  or the JSON of the metrics, for the metrics notification.
+ * @param {Number} sequence [optional] The event's sequence number.
+ * @param {Number} timestamp [optional] When the event happened, in microseconds.
+ */
+gpii.app.trayButton.gotAddonEvent = function (that, notification, data, sequence, timestamp) {
+    if (notification === gpii.app.trayButton.notifications.position) {
+        that.rect = data || that.rect;
+    } else if (notification === gpii.app.trayButton.notifications.metrics) {
+        gpii.app.trayButton.gotMetrics(that, data);
+    } else {
+        gpii.app.trayButton.gotNotification(that, notification, sequence, timestamp);
+    }
+};
+
+/**
+ * Removes the button from this process, after it's been told to go.
+ * @param {Component} that The gpii.app.trayButton instance.
+ */
+gpii.app.trayButton.stopAddon = function (that) {
+    if (that.addon) {
+        that.addon.stop();
+        that.addon = null;
+    }
+};
+
+/**
+ * Starts the tray button process, and restarts it if it dies. With inProcess, the addon is used instead, if it loads.
  * @param {Component} that The gpii.app.trayButton instance.
  */
 gpii.app.trayButton.startProcess = function (that) {
+    if (that.options.inProcess && !that.addon && gpii.app.trayButton.startAddon(that)) {
+        return;
+    }
+
+    if (that.options.usePipe && !that.pipeServer) {
+        gpii.app.trayButton.listen(that, function () {
+            if (!fluid.isDestroyed(that)) {
+                gpii.app.trayButton.startProcess(that);
+            }
+        });
+        return;
+    }
+
     fluid.log("Starting TrayButton process.");
-    var child = child_process.spawn(fluid.module.resolvePath(that.options.trayButtonExe), []);
+    var env = process.env;
+    if (that.pipeName) {
+        env = fluid.extend({}, process.env);
+        env[gpii.app.trayButton.pipeVariable] = that.pipeName;
+    }
+    var child = child_process.spawn(fluid.module.resolvePath(that.options.trayButtonExe), [], { env: env });
+    // Output that doesn't end with a new-line (the rest of the line is in the next chunk).
+    var partialLine = "";
     child.stdout.on("data", function (buffer) {
-        var messages = buffer.toString().trim().split(/[\r\n]+/);
+        var messages = (partialLine + buffer.toString()).split(/\r?\n/);
+        partialLine = messages.pop();
+        messages = messages.filter(function (message) {
+            return message.trim().length > 0;
+        });
         fluid.each(messages, function (message) {
+            if (message.startsWith(gpii.app.trayButton.metricsPrefix)) {
+                gpii.app.trayButton.gotMetrics(that, message.substr(gpii.app.trayButton.metricsPrefix.length));
+                return;
+            }
+            if (message.startsWith(gpii.app.trayButton.spanPrefix)) {
+                gpii.app.trayButton.gotButtonSpan(that, message.substr(gpii.app.trayButton.spanPrefix.length));
+                return;
+            }
             fluid.log("traybutton: ", message);
             if (message.startsWith("fail:")) {
                 try {
@@ -346,6 +812,143 @@ gpii.app.trayButton.startProcess = function (that) {
     });
 };
 
+// The start of a line of output from the button which contains a metrics snapshot.
+gpii.app.trayButton.metricsPrefix = "metrics: ";
+
+/**
+ * Handles a metrics snapshot written by the tray button process, or passed by the addon.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {String} json The snapshot.
+ */
+gpii.app.trayButton.gotMetrics = function (that, json) {
+    var metrics;
+    try {
+        metrics = JSON.parse(json);
+    } catch (e) {
+        fluid.log("traybutton: bad metrics: ", json);
+    }
+    if (metrics && !fluid.isDestroyed(that)) {
+        that.events.onTrayButtonMetrics.fire(metrics);
+    }
+};
+
+// The start of a line of output from the button which contains the trace events of a span (see trayButton/core/span.h).
+gpii.app.trayButton.spanPrefix = "span: ";
+
+/**
+ * Keeps the most recent of some trace events.
+ * @param {Array} events The events kept.
+ * @param {Array} newEvents The events to add.
+ * @param {Number} max The number to keep.
+ */
+gpii.app.trayButton.keepSpans = function (events, newEvents, max) {
+    Array.prototype.push.apply(events, newEvents);
+    if (events.length > max) {
+        events.splice(0, events.length - max);
+    }
+};
+
+/**
+ * Handles a span logged by the tray button process.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {String} json The span's trace events (a complete event, and possibly a flow event, separated by a comma).
+ */
+gpii.app.trayButton.gotButtonSpan = function (that, json) {
+    var events;
+    try {
+        events = JSON.parse("[" + json + "]");
+    } catch (e) {
+        fluid.log("traybutton: bad span: ", json);
+    }
+    if (events) {
+        gpii.app.trayButton.keepSpans(that.buttonSpans, events, that.options.maxSpans);
+    }
+};
+
+/**
+ * Records a span of time taken handling a notification from the button, as Chrome trace events.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {String} name What it was.
+ * @param {Number} sequence The sequence number of the button's event (0 if unknown).
+ * @param {Number} start When it started (gpii.app.trayButton.now).
+ * @param {Number} end [optional] When it ended. Defaults to now.
+ * @param {Boolean} received [optional] true if the notification was received in this span: it ends the flow the
+ *  button started when it sent it, which links the two on the timeline.
+ */
+gpii.app.trayButton.recordSpan = function (that, name, sequence, start, end, received) {
+    if (end === undefined) {
+        end = gpii.app.trayButton.now();
+    }
+    var events = [{
+        name: name,
+        cat: "gpii-app",
+        ph: "X",
+        ts: start,
+        dur: Math.max(0, end - start),
+        pid: process.pid,
+        tid: 0,
+        args: {
+            sequence: sequence
+        }
+    }];
+    if (received && sequence) {
+        // Matches the flow event of the button's span.
+        events.push({
+            name: "notification",
+            cat: "tray-button",
+            ph: "f",
+            bp: "e",
+            id: sequence,
+            ts: start,
+            pid: process.pid,
+            tid: 0
+        });
+    }
+    gpii.app.trayButton.keepSpans(that.spans, events, that.options.maxSpans);
+};
+
+/**
+ * Gets the timeline of the recent clicks, from the button and from here, as a Chrome trace.
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @return {Object} The trace: {traceEvents: [...], displayTimeUnit: "ms"}, to be saved as JSON and loaded into
+ *  chrome://tracing.
+ */
+gpii.app.trayButton.exportTrace = function (that) {
+    var buttonEvents = that.buttonSpans;
+    if (that.addon && that.addon.trace) {
+        try {
+            // The button is in this process; its events are only named by their thread.
+            buttonEvents = JSON.parse(that.addon.trace()).traceEvents.filter(function (event) {
+                return event.ph !== "M";
+            });
+        } catch (e) {
+            fluid.log("traybutton: bad trace from the addon: ", e.message);
+        }
+    }
+
+    var names = {};
+    names[process.pid] = "gpii-app";
+    fluid.each(buttonEvents, function (event) {
+        names[event.pid] = names[event.pid] || "tray-button";
+    });
+    var metadata = fluid.transform(Object.keys(names), function (pid) {
+        return {
+            name: "process_name",
+            ph: "M",
+            pid: Number(pid),
+            tid: 0,
+            args: {
+                name: names[pid]
+            }
+        };
+    });
+
+    return {
+        traceEvents: metadata.concat(buttonEvents, that.spans),
+        displayTimeUnit: "ms"
+    };
+};
+
 /**
  * Sets the context menu.
  * @param {Component} that The gpii.app.trayButton instance.
@@ -365,44 +968,85 @@ gpii.app.trayButton.setMenu = function (that, menu) {
  */
 gpii.app.trayButton.windowMessage = function (that, hwnd, msg, wParam, lParam) {
     if (msg === that.trayButtonMessage) {
-        switch (wParam) {
-        case gpii.app.trayButton.notifications.click:
-            process.nextTick(that.events.onTrayIconClicked.fire);
-            break;
+        // lParam is the event's sequence number.
+        gpii.app.trayButton.gotNotification(that, wParam, lParam.address());
+    } else if (msg === that.trayButtonPositionMessage) {
+        that.rect = gpii.app.trayButton.decodePositionMessage(wParam, lParam.address());
+    }
+};
 
-        case gpii.app.trayButton.notifications.showMenu:
-            if (that.menu) {
-                that.events.onTrayIconMenuShown.fire();
-                that.menu.popup({});
-            }
-            break;
+/**
+ * Decodes the button's rectangle from the parameters of the position message: 4 shorts crammed in both. The position
+ * is signed (a monitor to the left of, or above, the primary one has negative co-ordinates).
+ * @param {Number} wParam The position: x in the low word, y in the high word.
+ * @param {Number} lParam The size: width in the low word, height in the high word.
+ * @return {Object} The rectangle {x, y, width, height}.
+ */
+gpii.app.trayButton.decodePositionMessage = function (wParam, lParam) {
+    return {
+        x: (wParam << 16) >> 16,
+        y: wParam >> 16,
+        width: lParam & 0xffff,
+        height: (lParam >>> 16) & 0xffff
+    };
+};
 
-        case gpii.app.trayButton.notifications.update:
-            that.updateButton(that.options.buttonItems.highContrastIcon,
-                fluid.module.resolvePath(that.options.icons.highContrast));
-            that.updateButton(that.options.buttonItems.state, that.model.isKeyedIn);
-            that.updateButton(that.options.buttonItems.icon, that.model.icon);
-            that.updateButton(that.options.buttonItems.toolTip, that.model.tooltip);
-            break;
+/**
+ * Handles a notification from the tray button, from a window message, the pipe, or the addon.
+ *
+ * The time taken by the clicks is recorded as spans, with the sequence number of the button's event, so they can be
+ * put on the same timeline as the button's spans (see gpii.app.trayButton.exportTrace).
+ * @param {Component} that The gpii.app.trayButton instance.
+ * @param {Number} notification The notification (gpii.app.trayButton.notifications).
+ * @param {Number} sequence [optional] The sequence number of the button's event.
+ * @param {Number} sentAt [optional] When the button sent it, in microseconds (not known for window messages).
+ */
+gpii.app.trayButton.gotNotification = function (that, notification, sequence, sentAt) {
+    var notifications = gpii.app.trayButton.notifications;
+    var received = gpii.app.trayButton.now();
+    sequence = sequence || 0;
 
-        case gpii.app.trayButton.notifications.mouseEnter:
-            that.mouseOver = true;
-            break;
-        case gpii.app.trayButton.notifications.mouseLeave:
-            that.mouseOver = false;
-            break;
+    switch (notification) {
+    case notifications.click:
+        process.nextTick(function () {
+            var start = gpii.app.trayButton.now();
+            that.events.onTrayIconClicked.fire();
+            gpii.app.trayButton.recordSpan(that, "onTrayIconClicked", sequence, start);
+        });
+        break;
 
-        default:
-            break;
+    case notifications.showMenu:
+        if (that.menu) {
+            that.events.onTrayIconMenuShown.fire();
+            that.menu.popup({});
         }
-    } else if (msg === that.trayButtonPositionMessage) {
-        var lParamValue = lParam.address();
-        // The bounding rectangle is 4 shorts crammed in both the message parameters.
-        that.rect = {
-            x: wParam & 0xffff,
-            y: (wParam >> 16) & 0xffff,
-            width: lParamValue & 0xffff,
-            height: (lParamValue >> 16) & 0xffff
-        };
+        break;
+
+    case notifications.update:
+        // Send everything in one message, so the button only loads the icon and redraws once.
+        that.updateButton(that.options.buttonItems.batch, gpii.app.trayButton.encodeBatch([
+            [that.options.buttonItems.highContrastIcon, fluid.module.resolvePath(that.options.icons.highContrast)],
+            [that.options.buttonItems.state, that.model.isKeyedIn],
+            [that.options.buttonItems.icon, that.model.icon],
+            [that.options.buttonItems.toolTip, that.model.tooltip]
+        ]));
+        break;
+
+    case notifications.mouseEnter:
+        that.mouseOver = true;
+        break;
+    case notifications.mouseLeave:
+        that.mouseOver = false;
+        break;
+
+    default:
+        break;
+    }
+
+    if (notification === notifications.click || notification === notifications.showMenu) {
+        if (sentAt) {
+            gpii.app.trayButton.recordSpan(that, "delivery", sequence, sentAt, received);
+        }
+        gpii.app.trayButton.recordSpan(that, "gotNotification", sequence, received, undefined, true);
     }
 };
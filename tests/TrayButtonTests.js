@@ -87,6 +87,299 @@ gpii.tests.app.trayButton.buttonMenuUpdated = function (that, menu) {
     that.menu = menu;
 };
 
+jqUnit.test("Testing tray button batch encoding", function () {
+    var batch = gpii.app.trayButton.encodeBatch([
+        [2, "c:\\hc.ico"],
+        [5, true],
+        [1, null],
+        [3, ""]
+    ]);
+
+    var expected = [2, 9].concat(Array.from("c:\\hc.ico", function (c) {
+        return c.charCodeAt(0);
+    }), [5, 4], Array.from("true", function (c) {
+        return c.charCodeAt(0);
+    }), [1, 0xffff], [3, 0]);
+
+    jqUnit.assertDeepEq("batch should be encoded as [command][length][data] records", expected,
+        Array.from(batch, function (c) {
+            return c.charCodeAt(0);
+        }));
+});
+
+jqUnit.test("Testing tray button position decoding", function () {
+    // A button on a monitor above and to the left of the primary one.
+    var wParam = ((-40 & 0xffff) << 16 | (-1920 & 0xffff)) >>> 0;
+    var lParam = 40 << 16 | 24;
+    jqUnit.assertDeepEq("position message should be signed", {x: -1920, y: -40, width: 24, height: 40},
+        gpii.app.trayButton.decodePositionMessage(wParam, lParam));
+    jqUnit.assertDeepEq("positive position", {x: 1800, y: 1040, width: 24, height: 40},
+        gpii.app.trayButton.decodePositionMessage(1040 << 16 | 1800, lParam));
+});
+
+jqUnit.test("Testing tray button pipe frames", function () {
+    var frames = gpii.app.trayButton.frames;
+    var position = Buffer.alloc(16);
+    position.writeInt32LE(-100000, 0);
+    position.writeInt32LE(70000, 4);
+    position.writeInt32LE(24, 8);
+    position.writeInt32LE(40, 12);
+
+    var stream = Buffer.concat([
+        gpii.app.trayButton.encodeFrame(frames.position, 1, position, 0x123456789a),
+        gpii.app.trayButton.encodeFrame(frames.ping, 2, null, 5),
+        gpii.app.trayButton.encodeFrame(frames.command, 0xffffffff, Buffer.from("abc", "utf16le"), 6)
+    ]);
+    jqUnit.assertEquals("header", "2400000002000000010000009a78563412000000",
+        stream.slice(0, gpii.app.trayButton.frameHeaderSize).toString("hex"));
+
+    // Arriving in pieces.
+    var partial = gpii.app.trayButton.decodeFrames(stream.slice(0, 50));
+    jqUnit.assertEquals("one complete frame", 1, partial.frames.length);
+    jqUnit.assertEquals("rest of the stream kept", 14, partial.remaining.length);
+
+    var result = gpii.app.trayButton.decodeFrames(Buffer.concat([partial.remaining, stream.slice(50)]));
+    jqUnit.assertFalse("no error", result.error);
+    jqUnit.assertEquals("remaining frames", 2, result.frames.length);
+    jqUnit.assertEquals("nothing left", 0, result.remaining.length);
+    jqUnit.assertDeepEq("ping", {type: frames.ping, sequence: 2, timestamp: 5, payload: Buffer.alloc(0)},
+        result.frames[0]);
+    jqUnit.assertEquals("command sequence", 0xffffffff, result.frames[1].sequence);
+    jqUnit.assertEquals("command payload", "abc", result.frames[1].payload.toString("utf16le"));
+
+    var first = partial.frames[0];
+    jqUnit.assertEquals("timestamp", 0x123456789a, first.timestamp);
+    jqUnit.assertDeepEq("position keeps all 32 bits", {x: -100000, y: 70000, width: 24, height: 40},
+        gpii.app.trayButton.decodePosition(first.payload));
+
+    var corrupt = Buffer.alloc(gpii.app.trayButton.frameHeaderSize);
+    corrupt.writeUInt32LE(4, 0);
+    jqUnit.assertTrue("corrupt stream", gpii.app.trayButton.decodeFrames(corrupt).error);
+
+    // The largest payload fits; one more byte would make the button drop the pipe.
+    var maxPayload = gpii.app.trayButton.frameMaxSize - gpii.app.trayButton.frameHeaderSize;
+    jqUnit.assertEquals("largest frame", gpii.app.trayButton.frameMaxSize,
+        gpii.app.trayButton.encodeFrame(frames.command, 3, Buffer.alloc(maxPayload), 0).length);
+    jqUnit.assertNull("too big", gpii.app.trayButton.encodeFrame(frames.command, 3, Buffer.alloc(maxPayload + 1), 0));
+});
+
+jqUnit.test("Testing tray button batch splitting", function () {
+    var items = fluid.defaults("gpii.app.trayButton").buttonItems;
+    var encode = gpii.app.trayButton.encodeBatch;
+    var small = encode([[items.icon, "icon.ico"], [items.state, true]]);
+    jqUnit.assertDeepEq("a batch that fits is kept", [small], gpii.app.trayButton.splitBatch(small, 100));
+
+    var half = fluid.generate(40, "x").join("");
+    var batch = encode([[items.toolTip, half], [items.destroy, null], [items.animate, half], [items.icon, "icon.ico"]]);
+    jqUnit.assertDeepEq("split between the records, in order", [
+        encode([[items.toolTip, half], [items.destroy, null]]),
+        encode([[items.animate, half], [items.icon, "icon.ico"]])
+    ], gpii.app.trayButton.splitBatch(batch, 60));
+
+    var tooLong = encode([[items.icon, "icon.ico"], [items.toolTip, half + half], [items.state, false]]);
+    jqUnit.assertDeepEq("a record too long on its own is left out", [
+        encode([[items.icon, "icon.ico"], [items.state, false]])
+    ], gpii.app.trayButton.splitBatch(tooLong, 60));
+
+    // Sent over the pipe as frames the button accepts.
+    var written = [];
+    var that = {
+        pipe: {
+            write: function (frame) {
+                written.push(frame);
+            }
+        },
+        pipeSequence: 1,
+        options: {buttonItems: items}
+    };
+    var longTip = fluid.generate(30000, "t").join("");
+    gpii.app.trayButton.updateButton(that, items.batch, encode([[items.toolTip, longTip], [items.animate, longTip]]));
+    jqUnit.assertEquals("two frames", 2, written.length);
+    var decoded = gpii.app.trayButton.decodeFrames(Buffer.concat(written));
+    jqUnit.assertFalse("accepted", decoded.error);
+    jqUnit.assertEquals("first command", encode([[items.toolTip, longTip]]),
+        decoded.frames[0].payload.toString("utf16le"));
+});
+
+jqUnit.test("Testing tray button in-process", function () {
+    var items = fluid.defaults("gpii.app.trayButton").buttonItems;
+    var notifications = gpii.app.trayButton.notifications;
+    var fakeAddon = {
+        commands: [],
+        stopped: false,
+        start: function (callback) {
+            fakeAddon.callback = callback;
+            // The button asks for everything as soon as it's created.
+            callback(notifications.update);
+            return true;
+        },
+        command: function (command, data) {
+            fakeAddon.commands.push([command, data]);
+            return true;
+        },
+        stop: function () {
+            fakeAddon.stopped = true;
+        }
+    };
+
+    var trayButton = gpii.app.trayButton({
+        inProcess: true,
+        model: {
+            icon: "icon.ico",
+            tooltip: "hello",
+            isKeyedIn: true
+        },
+        icons: {
+            highContrast: "hc.ico"
+        },
+        events: {
+            onMenuUpdated: null,
+            onTrayIconClicked: null,
+            onTrayIconMenuShown: null,
+            onTrayButtonMetrics: null
+        },
+        invokers: {
+            loadAddon: {
+                funcName: "fluid.identity",
+                args: [ fakeAddon ]
+            }
+        }
+    });
+
+    jqUnit.assertEquals("addon should be used", fakeAddon, trayButton.addon);
+    var batch = fluid.find(fakeAddon.commands, function (command) {
+        return command[0] === items.batch ? command[1] : undefined;
+    });
+    jqUnit.assertEquals("update should be answered with a batch", gpii.app.trayButton.encodeBatch([
+        [items.highContrastIcon, fluid.module.resolvePath("hc.ico")],
+        [items.state, true],
+        [items.icon, "icon.ico"],
+        [items.toolTip, "hello"]
+    ]), batch);
+
+    fakeAddon.commands = [];
+    trayButton.applier.change("isKeyedIn", false);
+    jqUnit.assertDeepEq("data should be sent as a string", [[items.state, "false"]], fakeAddon.commands);
+
+    var rect = {x: -1920, y: 1040, width: 24, height: 40};
+    fakeAddon.callback(notifications.position, rect);
+    jqUnit.assertDeepEq("position should come with the event", rect, trayButton.getIconBounds());
+    fakeAddon.callback(notifications.mouseEnter);
+    jqUnit.assertTrue("other events should be notifications", trayButton.mouseOver);
+
+    var metrics = null;
+    trayButton.events.onTrayButtonMetrics.addListener(function (snapshot) {
+        metrics = snapshot;
+    });
+    fakeAddon.callback(notifications.metrics, "{\"counters\":{\"wakeups\":3},\"timers\":{}}");
+    jqUnit.assertDeepEq("metrics should come with the event", {counters: {wakeups: 3}, timers: {}}, metrics);
+
+    fakeAddon.commands = [];
+    trayButton.destroy();
+    jqUnit.assertDeepEq("button should be told to go", [[items.destroy, null]], fakeAddon.commands);
+    jqUnit.assertTrue("addon should be stopped", fakeAddon.stopped);
+});
+
+jqUnit.test("Testing tray button click tracing", function () {
+    var notifications = gpii.app.trayButton.notifications;
+    var fakeAddon = {
+        start: function (callback) {
+            fakeAddon.callback = callback;
+            return true;
+        },
+        command: fluid.identity,
+        stop: fluid.identity,
+        // The button's side of the click.
+        trace: function () {
+            return JSON.stringify({
+                traceEvents: [
+                    {name: "process_name", ph: "M", pid: process.pid, tid: 9, args: {name: "tray-button"}},
+                    {name: "click", cat: "tray-button", ph: "X", ts: 1000, dur: 50, pid: process.pid, tid: 9,
+                        args: {sequence: 7}},
+                    {name: "notification", cat: "tray-button", ph: "s", id: 7, ts: 1040, pid: process.pid, tid: 9}
+                ],
+                displayTimeUnit: "ms"
+            });
+        }
+    };
+
+    var trayButton = gpii.app.trayButton({
+        inProcess: true,
+        events: {
+            onMenuUpdated: null,
+            onTrayIconClicked: null,
+            onTrayIconMenuShown: null
+        },
+        invokers: {
+            loadAddon: {
+                funcName: "fluid.identity",
+                args: [ fakeAddon ]
+            }
+        }
+    });
+
+    var sentAt = gpii.app.trayButton.now();
+    fakeAddon.callback(notifications.click, null, 7, sentAt);
+    // Only clicks are traced.
+    fakeAddon.callback(notifications.mouseEnter, null, 8, sentAt);
+
+    var trace = trayButton.exportTrace();
+    jqUnit.assertEquals("display unit", "ms", trace.displayTimeUnit);
+    var events = trace.traceEvents;
+    var find = function (name, ph) {
+        return fluid.find(events, function (event) {
+            return event.name === name && event.ph === ph ? event : undefined;
+        });
+    };
+
+    jqUnit.assertEquals("button's span should be in the trace", 1000, find("click", "X").ts);
+    jqUnit.assertEquals("button's metadata should be replaced", 1, events.filter(function (event) {
+        return event.ph === "M";
+    }).length);
+    jqUnit.assertEquals("process should be named", "gpii-app", find("process_name", "M").args.name);
+
+    var delivery = find("delivery", "X");
+    jqUnit.assertEquals("delivery should start when it was sent", sentAt, delivery.ts);
+    jqUnit.assertEquals("delivery should have the sequence", 7, delivery.args.sequence);
+    var received = find("gotNotification", "X");
+    jqUnit.assertEquals("receipt should follow the delivery", delivery.ts + delivery.dur, received.ts);
+    var flowEnd = find("notification", "f");
+    jqUnit.assertDeepEq("flow should end where it was received", {id: 7, ts: received.ts, cat: "tray-button"},
+        {id: flowEnd.id, ts: flowEnd.ts, cat: flowEnd.cat});
+    jqUnit.assertFalse("other notifications should not be traced", fluid.find(events, function (event) {
+        return event.args && event.args.sequence === 8 ? true : undefined;
+    }));
+
+    // From the pipe, the sequence follows the notification, and the frame's timestamp is when it was sent.
+    var payload = Buffer.alloc(8);
+    payload.writeUInt32LE(notifications.showMenu, 0);
+    payload.writeUInt32LE(12, 4);
+    gpii.app.trayButton.gotFrame(trayButton, {type: gpii.app.trayButton.frames.notify, sequence: 1,
+        timestamp: 500, payload: payload});
+    var spans = trayButton.spans.filter(function (event) {
+        return event.args && event.args.sequence === 12;
+    });
+    jqUnit.assertDeepEq("menu should be traced from the pipe", ["delivery", "gotNotification"],
+        fluid.getMembers(spans, "name"));
+    jqUnit.assertEquals("pipe delivery should start at the frame's timestamp", 500, spans[0].ts);
+
+    // When the button is another process, its spans are logged.
+    gpii.app.trayButton.gotButtonSpan(trayButton, JSON.stringify(find("click", "X")) + "," +
+        JSON.stringify(find("notification", "s")));
+    gpii.app.trayButton.gotButtonSpan(trayButton, "{bad");
+    jqUnit.assertDeepEq("logged spans should be kept", ["click", "notification"],
+        fluid.getMembers(trayButton.buttonSpans, "name"));
+
+    trayButton.spans.length = 0;
+    for (var n = 0; n < trayButton.options.maxSpans + 10; n++) {
+        gpii.app.trayButton.recordSpan(trayButton, "span", n + 1, n, n + 1);
+    }
+    jqUnit.assertEquals("spans should be limited", trayButton.options.maxSpans, trayButton.spans.length);
+    jqUnit.assertEquals("oldest spans should go", 11, trayButton.spans[0].args.sequence);
+
+    trayButton.destroy();
+});
+
 // Tests the button by making changes to it, and check that it is still there.
 jqUnit.asyncTest("Testing tray button", function () {
 
@@ -0,0 +1,47 @@
+# Task tray button, as a node addon (Windows only). Build it for gpii-app's Electron with:
+#
+#   node-gyp rebuild --target=3.0.2 --arch=x64 --dist-url=https://electronjs.org/headers
+{
+    "targets": [
+        {
+            "target_name": "tray_button",
+            "conditions": [
+                ["OS=='win'", {
+                    "sources": [
+                        "tray-button-addon.c",
+                        "../tray-button.c",
+                        "../core/animation.c",
+                        "../core/atlas.c",
+                        "../core/batch.c",
+                        "../core/button.c",
+                        "../core/button-set.c",
+                        "../core/frame.c",
+                        "../core/frame-cache.c",
+                        "../core/host.c",
+                        "../core/ico.c",
+                        "../core/icon-cache.c",
+                        "../core/icon-loader.c",
+                        "../core/json.c",
+                        "../core/layout.c",
+                        "../core/log-ring.c",
+                        "../core/metrics.c",
+                        "../core/pixels.c",
+                        "../core/raster.c",
+                        "../core/recolor.c",
+                        "../core/render-set.c",
+                        "../core/scheduler.c",
+                        "../core/solid-pool.c",
+                        "../core/span.c",
+                        "../core/startup.c",
+                        "../core/state-snapshot.c",
+                        "../core/svg.c",
+                        "../core/trace.c",
+                        "../core/visual-key.c",
+                        "../core/window-cache.c"
+                    ],
+                    "defines": [ "TRAY_BUTTON_LIBRARY", "UNICODE", "_UNICODE" ]
+                }]
+            ]
+        }
+    ]
+}
@@ -0,0 +1,196 @@
+/* Task tray button.
+ * Node addon, which puts the button on the taskbar from gpii-app's own process (see tray-button.h).
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <node_api.h>
+#include "../tray-button.h"
+
+/*
+ * start(callback): Starts the button; callback(event, data, sequence, timestamp) gets the HOST_EVENT_* events (data is
+ *   the button's {x, y, width, height} for HOST_EVENT_POSITION, and the JSON of the metrics for HOST_EVENT_METRICS;
+ *   sequence and timestamp are hostEvent's, the timestamp in microseconds). Returns false if it's already started, or
+ *   it couldn't start.
+ * stop(): Removes the button.
+ * command(command, data): Performs a HOST_COMMAND_* command (the same as the window messages); data is a string, or
+ *   null. Returns false if the command failed, or the button isn't started.
+ * trace(): Gets the spans of the recent clicks, as the JSON of a Chrome trace (see core/span.h).
+ *
+ * The button's windows are run by the message loop of the thread that called start (Electron's main thread), so the
+ * callback is made on the JavaScript thread.
+ */
+
+typedef struct {
+	napi_env env;
+	napi_ref callback;
+	napi_async_context async;
+} addonState;
+
+static trayHost *host = null;
+static addonState state = { 0 };
+
+/** Throws, if the last call failed, and returns undefined. */
+#define check(ENV, CALL) \
+	if ((CALL) != napi_ok) { \
+		napi_throw_error(ENV, null, #CALL); \
+		return null; \
+	}
+
+static napi_value makeBoolean(napi_env env, bool value)
+{
+	napi_value result;
+	napi_get_boolean(env, value, &result);
+	return result;
+}
+
+static void setNumber(napi_env env, napi_value object, const char *name, int32_t value)
+{
+	napi_value number;
+	napi_create_int32(env, value, &number);
+	napi_set_named_property(env, object, name, number);
+}
+
+/** Passes an event of the button to the JavaScript callback (hostCallback). */
+static void gotEvent(void *context, const hostEvent *event)
+{
+	addonState *s = context;
+	napi_env env = s->env;
+	napi_handle_scope scope;
+	napi_value callback, global, args[4], result;
+
+	if (napi_open_handle_scope(env, &scope) != napi_ok) {
+		return;
+	}
+
+	if (napi_get_reference_value(env, s->callback, &callback) == napi_ok && callback) {
+		napi_get_global(env, &global);
+		napi_create_uint32(env, event->type, &args[0]);
+		if (event->type == HOST_EVENT_POSITION) {
+			napi_create_object(env, &args[1]);
+			setNumber(env, args[1], "x", event->rect.left);
+			setNumber(env, args[1], "y", event->rect.top);
+			setNumber(env, args[1], "width", rectWidth(event->rect));
+			setNumber(env, args[1], "height", rectHeight(event->rect));
+		} else if (event->type == HOST_EVENT_METRICS) {
+			static char json[METRICS_JSON_LENGTH];
+			size_t length = trayButtonMetrics(json, sizeof(json));
+			napi_create_string_utf8(env, json, length, &args[1]);
+		} else {
+			napi_get_undefined(env, &args[1]);
+		}
+		napi_create_uint32(env, event->sequence, &args[2]);
+		// A double holds microseconds for a few hundred years.
+		napi_create_double(env, (double)event->timestamp, &args[3]);
+		// From the message loop, rather than JavaScript; make_callback also runs the microtasks afterwards.
+		napi_make_callback(env, s->async, global, callback, 4, args, &result);
+	}
+
+	napi_close_handle_scope(env, scope);
+}
+
+static napi_value start(napi_env env, napi_callback_info info)
+{
+	size_t argc = 1;
+	napi_value callback, name;
+	check(env, napi_get_cb_info(env, info, &argc, &callback, null, null));
+
+	if (host) {
+		return makeBoolean(env, false);
+	}
+
+	state.env = env;
+	check(env, napi_create_reference(env, callback, 1, &state.callback));
+	if (napi_create_string_utf8(env, "trayButton", NAPI_AUTO_LENGTH, &name) != napi_ok
+		|| napi_async_init(env, null, name, &state.async) != napi_ok) {
+		napi_delete_reference(env, state.callback);
+		state.callback = null;
+		napi_throw_error(env, null, "napi_async_init");
+		return null;
+	}
+
+	host = trayButtonStart(gotEvent, &state);
+	if (!host) {
+		// Nothing will be called back; the next start makes new ones.
+		napi_async_destroy(env, state.async);
+		napi_delete_reference(env, state.callback);
+		state.callback = null;
+	}
+	return makeBoolean(env, host != null);
+}
+
+static napi_value stop(napi_env env, napi_callback_info info)
+{
+	if (host) {
+		trayButtonStop();
+		host = null;
+		napi_async_destroy(env, state.async);
+		napi_delete_reference(env, state.callback);
+		state.callback = null;
+	}
+	return null;
+}
+
+static napi_value command(napi_env env, napi_callback_info info)
+{
+	size_t argc = 2;
+	napi_value args[2];
+	napi_valuetype type = napi_undefined;
+	hostChar *data = null;
+	size_t length = 0;
+	uint32_t id;
+
+	check(env, napi_get_cb_info(env, info, &argc, args, null, null));
+	check(env, napi_get_value_uint32(env, args[0], &id));
+	if (argc > 1) {
+		check(env, napi_typeof(env, args[1], &type));
+	}
+
+	if (!host) {
+		return makeBoolean(env, false);
+	}
+
+	if (type == napi_string) {
+		// Gets the length, then the string.
+		check(env, napi_get_value_string_utf16(env, args[1], null, 0, &length));
+		data = malloc((length + 1) * sizeof(hostChar));
+		if (!data) {
+			return makeBoolean(env, false);
+		}
+		napi_get_value_string_utf16(env, args[1], (char16_t*)data, length + 1, &length);
+	}
+
+	bool ok = trayHostCommand(host, id, data, length);
+	free(data);
+	return makeBoolean(env, ok);
+}
+
+static napi_value trace(napi_env env, napi_callback_info info)
+{
+	static char json[SPAN_CAPACITY * SPAN_EVENT_LENGTH];
+	napi_value result;
+	size_t length = trayButtonTrace(json, sizeof(json));
+	check(env, napi_create_string_utf8(env, json, length, &result));
+	return result;
+}
+
+static napi_value init(napi_env env, napi_value exports)
+{
+	napi_property_descriptor properties[] = {
+		{ "start", null, start, null, null, null, napi_default, null },
+		{ "stop", null, stop, null, null, null, napi_default, null },
+		{ "command", null, command, null, null, null, napi_default, null },
+		{ "trace", null, trace, null, null, null, napi_default, null }
+	};
+	check(env, napi_define_properties(env, exports, sizeof(properties) / sizeof(properties[0]), properties));
+	return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
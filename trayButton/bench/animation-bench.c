@@ -0,0 +1,129 @@
+/* Task tray button - benchmarks.
+ * Cost of an animation: rendering its frames once for a size, then each frame shown.
+ *
+ * A frame shown is a tick of the frame scheduler and the composition of the frame over the button's background, then
+ * a copy to the "screen" (standing in for the BitBlt). The CPU use is that cost at the frame rate, so the GDI calls and
+ * the timer wake-ups themselves aren't included.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/animation.h"
+#include "../core/ico.h"
+#include "../core/pixels.h"
+#include "../core/recolor.h"
+#include "../core/solid-pool.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+/** Frames in the animation (each one is the same icon file) */
+#define FRAMES 24
+/** Time each frame is shown (ms) */
+#define INTERVAL 40
+
+static uint8_t *readFile(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return null;
+	}
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	*size = fread(data, 1, *size, f);
+	fclose(f);
+	return data;
+}
+
+/** Renders every frame, like the button does for each size: each file is read, decoded, scaled and premultiplied. */
+static bool renderFrames(animationStrip *strip, int32_t size)
+{
+	animationStripPrepare(strip, 1, size, FRAMES);
+	for (uint32_t n = 0; n < FRAMES; n++) {
+		size_t fileSize;
+		uint8_t *file = readFile(ICONS_DIR "/Morphic-tray-icon-white.ico", &fileSize);
+		icoFile ico;
+		if (!file || !icoParse(file, fileSize, &ico)) {
+			free(file);
+			return false;
+		}
+		uint32_t *frame = animationStripFrame(strip, n);
+		icoScale(icoSelect(&ico, size), size, frame);
+		premultiplyPixels(frame, (size_t)size * size);
+		icoFree(&ico);
+		free(file);
+	}
+	return true;
+}
+
+int main()
+{
+	static const int dpis[] = { 96, 120, 144, 192, 288 };
+	const int renders = 50;
+	const int iterations = 200000;
+
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x0000ffff, 0x00800000);
+
+	printf("%d frames, %dms each\n", FRAMES, INTERVAL);
+	printf("%5s %8s %16s %14s %10s\n", "dpi", "mode", "us/render once", "ns/frame", "cpu %");
+
+	for (int d = 0; d < (int)(sizeof(dpis) / sizeof(dpis[0])); d++) {
+		int width = scaleDpi(24, dpis[d]), height = scaleDpi(40, dpis[d]), iconSize = scaleDpi(16, dpis[d]);
+		animationStrip strip = { 0 };
+
+		double start = benchNow();
+		for (int i = 0; i < renders; i++) {
+			strip.animationId = 0;
+			if (!renderFrames(&strip, iconSize)) {
+				printf("Can't read the icon\n");
+				return 1;
+			}
+		}
+		double render = (benchNow() - start) / renders;
+
+		uint32_t *background = calloc((size_t)width * height, sizeof(uint32_t));
+		uint32_t *buffer = malloc((size_t)width * height * sizeof(uint32_t));
+		uint32_t *screen = malloc((size_t)width * height * sizeof(uint32_t));
+		fillPixels(background, width, 0, 0, width, height, premultiplyColor(0xffffff, 25));
+
+		for (int hc = 0; hc < 2; hc++) {
+			frameScheduler scheduler;
+			frameSchedulerInit(&scheduler);
+			uint64_t now = 0;
+			frameSchedulerStart(&scheduler, FRAMES, INTERVAL, 0, now);
+
+			start = benchNow();
+			for (int i = 0; i < iterations; i++) {
+				now += frameSchedulerTick(&scheduler, now);
+				animationCompose(buffer, width, background, width, width, height,
+					animationStripFrame(&strip, (uint32_t)scheduler.frame), iconSize, hc ? &table : null);
+				copyPixels(screen, width, buffer, width, width, height);
+				benchSink += screen[i % (width * height)];
+			}
+			double frame = (benchNow() - start) / iterations;
+
+			printf("%5d %8s %16.1f %14.1f %10.4f\n", dpis[d], hc ? "hc" : "normal", render / 1000, frame,
+				frame / (INTERVAL * 1e6) * 100);
+		}
+
+		animationStripFree(&strip);
+		free(background);
+		free(buffer);
+		free(screen);
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/* Task tray button - benchmarks.
+ * Timing helpers for the benchmarks of the platform-neutral core.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_BENCH_H
+#define TRAY_BUTTON_BENCH_H
+
+#include <stdio.h>
+
+#ifdef _WIN32
+# include <Windows.h>
+#else
+# include <time.h>
+#endif
+
+/**
+ * Gets a monotonic time.
+ * @return The time, in nanoseconds.
+ */
+static double benchNow()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER now;
+	if (!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+/** Prevents the compiler from optimising away a result. */
+static volatile unsigned benchSink;
+
+#endif /* TRAY_BUTTON_BENCH_H */
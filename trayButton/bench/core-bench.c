@@ -0,0 +1,551 @@
+/* Task tray button - benchmarks.
+ * The hot paths of the core, in one place: nanoseconds and allocations per operation, at several DPIs and taskbar
+ * sizes. The results can be written as JSON lines, and compared with those of an earlier build.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/batch.h"
+#include "../core/frame.h"
+#include "../core/host.h"
+#include "../core/ico.h"
+#include "../core/layout.h"
+#include "../core/pixels.h"
+#include "../core/recolor.h"
+#include "../core/solid-pool.h"
+#include "../core/span.h"
+#include "../core/svg.h"
+#include "../core/visual-key.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+/*
+ * Allocations are counted by wrapping malloc, calloc and realloc at link time (-Wl,--wrap, where the linker supports
+ * it; see CMakeLists.txt). Otherwise, they aren't counted.
+ */
+static uint64_t benchAllocs;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	benchAllocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	benchAllocs++;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+	benchAllocs++;
+	return __real_realloc(p, size);
+}
+#endif
+
+/** What a case is run with. */
+typedef struct {
+	/** The DPI, and the taskbar's thickness at 96 DPI (0 for the cases which don't depend on them) */
+	uint32_t dpi;
+	int32_t size;
+	/** The button and icon, at the DPI */
+	int32_t width, height, iconSize;
+	int iterations;
+	/** The result */
+	double start, nsPerOp, allocsPerOp;
+	uint64_t allocs;
+} benchRun;
+
+/** Starts timing the loop of a case. */
+static void benchStart(benchRun *run)
+{
+	run->allocs = benchAllocs;
+	run->start = benchNow();
+}
+
+/** Stops timing the loop of a case. */
+static void benchStop(benchRun *run)
+{
+	run->nsPerOp = (benchNow() - run->start) / run->iterations;
+	run->allocsPerOp = (double)(benchAllocs - run->allocs) / run->iterations;
+}
+
+static uint8_t *readFile(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return null;
+	}
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	*size = fread(data, 1, *size, f);
+	fclose(f);
+	return data;
+}
+
+/** The icons, read once. */
+static icoFile ico;
+static svgImage svg;
+
+/** A layout of a settled taskbar (the common case): computed, and nothing to do. */
+static void layoutCase(benchRun *run)
+{
+	int32_t thickness = scaleDpi(run->size, run->dpi);
+	layoutInput input = { 0 };
+	input.trayRect = (coreRect) { 0, 1080 - thickness, 1920, 1080 };
+	input.trayClient = (coreRect) { 0, 0, 1920, thickness };
+	input.tasksRect = (coreRect) { 100, 1080 - thickness, 1770, 1080 };
+	input.notifyRect = (coreRect) { 1770, 1080 - thickness, 1920, 1080 };
+	input.screenHeight = 1000;
+	input.dpi = run->dpi;
+	input.buttonWidth = 24;
+
+	layoutState state = { 0 };
+	layoutResult result;
+	layoutCompute(&input, &result);
+	layoutDiff(&state, &input, &result, false);
+	input.tasksRect.right = input.tasksRect.left + rectWidth(result.tasksRect);
+
+	unsigned ops = 0;
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		layoutCompute(&input, &result);
+		ops += layoutDiff(&state, &input, &result, false);
+	}
+	benchStop(run);
+	benchSink += ops;
+}
+
+/** Scaling the icon to the size for the DPI. */
+static void icoScaleCase(benchRun *run)
+{
+	uint32_t *pixels = malloc((size_t)run->iconSize * run->iconSize * sizeof(uint32_t));
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		icoScale(icoSelect(&ico, run->iconSize), run->iconSize, pixels);
+		benchSink += pixels[i % (run->iconSize * run->iconSize)];
+	}
+	benchStop(run);
+	free(pixels);
+}
+
+/** Drawing the SVG icon at the size for the DPI. */
+static void svgRenderCase(benchRun *run)
+{
+	uint32_t *pixels = malloc((size_t)run->iconSize * run->iconSize * sizeof(uint32_t));
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		svgRender(&svg, run->iconSize, pixels);
+		benchSink += pixels[i % (run->iconSize * run->iconSize)];
+	}
+	benchStop(run);
+	free(pixels);
+}
+
+/** Rendering a frame: the background, and the icon blended over it. */
+static void blendCase(benchRun *run)
+{
+	size_t count = (size_t)run->width * run->height;
+	uint32_t *buffer = malloc(count * sizeof(uint32_t));
+	uint32_t *icon = malloc((size_t)run->iconSize * run->iconSize * sizeof(uint32_t));
+	icoScale(icoSelect(&ico, run->iconSize), run->iconSize, icon);
+	int x = (run->width - run->iconSize) / 2, y = (run->height - run->iconSize) / 2;
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		fillPixels(buffer, run->width, 0, 0, run->width, run->height, premultiplyColor(0xffffff, 25));
+		blendPixels(buffer + (size_t)y * run->width + x, run->width, icon, run->iconSize, run->iconSize,
+			run->iconSize);
+		benchSink += buffer[i % count];
+	}
+	benchStop(run);
+	free(buffer);
+	free(icon);
+}
+
+/** Recolouring a frame for high-contrast. */
+static void recolorCase(benchRun *run)
+{
+	size_t count = (size_t)run->width * run->height;
+	uint32_t *pixels = malloc(count * sizeof(uint32_t));
+	for (size_t n = 0; n < count; n++) {
+		pixels[n] = 0xff000000 | (uint32_t)(n * 2654435761u >> 8);
+	}
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x0000ffff, 0x00800000);
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		// Recolouring the same pixels again costs the same.
+		recolorPixels(&table, pixels, count);
+		benchSink += pixels[i % count];
+	}
+	benchStop(run);
+	free(pixels);
+}
+
+/** Deciding whether a paint is needed, as the mouse moves between the states. */
+static void visualKeyCase(benchRun *run)
+{
+	static const uint32_t states[] = { STATE_NORMAL, STATE_HOVER, STATE_HOVER, STATE_PRESSED };
+	visualTracker tracker = { 0 };
+	unsigned redraws = 0;
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		visualKey key;
+		visualKeyInit(&key, states[i & 3], false, 1, 16, 24, 40, 0, 0);
+		if (visualRedrawNeeded(&tracker, &key)) {
+			visualPainted(&tracker, &key);
+			redraws++;
+		}
+	}
+	benchStop(run);
+	benchSink += redraws;
+}
+
+/** Writes a batch, like gpii-app's answer to the update notification. */
+static size_t writeBatch(uint16_t *buffer, size_t capacity, int variant)
+{
+	static const uint16_t icons[2][6] = { { 'a', '.', 'i', 'c', 'o', 0 }, { 'b', '.', 'i', 'c', 'o', 0 } };
+	static const uint16_t tip[] = { 'M', 'o', 'r', 'p', 'h', 'i', 'c' };
+	static const uint16_t states[2][5] = { { 't', 'r', 'u', 'e' }, { 'f', 'a', 'l', 's', 'e' } };
+
+	batchWriter writer;
+	batchWriterInit(&writer, buffer, capacity);
+	batchAdd(&writer, HOST_COMMAND_ICON_HC, icons[1], 5);
+	batchAdd(&writer, HOST_COMMAND_STATE, states[variant], variant ? 5 : 4);
+	batchAdd(&writer, HOST_COMMAND_ICON, icons[variant], 5);
+	batchAdd(&writer, HOST_COMMAND_TOOLTIP, tip, sizeof(tip) / sizeof(tip[0]));
+	return writer.length;
+}
+
+/** Encoding and decoding a batch of commands. */
+static void batchCase(benchRun *run)
+{
+	uint16_t buffer[256];
+	unsigned records = 0;
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		size_t length = writeBatch(buffer, sizeof(buffer) / sizeof(buffer[0]), i & 1);
+		batchReader reader;
+		batchRecord record;
+		batchReaderInit(&reader, buffer, length * sizeof(uint16_t));
+		while (batchNext(&reader, &record) == BATCH_RECORD) {
+			records++;
+		}
+	}
+	benchStop(run);
+	benchSink += records;
+}
+
+/** Sending a notification over the pipe: encoding the frame, and reading it on the other side. */
+static void frameCase(benchRun *run)
+{
+	static frameReader reader;
+	uint8_t buffer[FRAME_HEADER_SIZE + 8];
+	uint32_t notification = 0, event = 0;
+	frameReaderInit(&reader);
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		size_t length = frameEncodeNotify(buffer, sizeof(buffer), (uint32_t)i, (uint64_t)i, HOST_EVENT_CLICK,
+			(uint32_t)i);
+		frameReaderAppend(&reader, buffer, length);
+		frame f;
+		if (frameReaderNext(&reader, &f) == FRAME_READ) {
+			frameDecodeNotify(&f, &notification, &event);
+		}
+	}
+	benchStop(run);
+	benchSink += notification + event;
+}
+
+static void hostApply(trayHost *host, uint32_t changes)
+{
+	benchSink += changes;
+}
+
+static void hostCallbackNone(void *context, const hostEvent *event)
+{
+}
+
+/** Applying a batch to the host's state, with the icon and state changing each time. */
+static void hostBatchCase(benchRun *run)
+{
+	hostBackend backend = { hostApply, null, null, null, null };
+	trayHost *host = trayHostCreate(&backend, hostCallbackNone, null);
+	uint16_t batches[2][256];
+	size_t lengths[2];
+	for (int n = 0; n < 2; n++) {
+		lengths[n] = writeBatch(batches[n], sizeof(batches[n]) / sizeof(batches[n][0]), n);
+	}
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		trayHostBatch(host, batches[i & 1], lengths[i & 1] * sizeof(uint16_t));
+	}
+	benchStop(run);
+	trayHostDestroy(host);
+}
+
+/** Recording a span of a click, and formatting it for the log. */
+static void spanCase(benchRun *run)
+{
+	static spanRecorder recorder;
+	char json[SPAN_EVENT_LENGTH];
+	size_t total = 0;
+
+	benchStart(run);
+	for (int i = 0; i < run->iterations; i++) {
+		const span *s = spanRecord(&recorder, "notify", (uint32_t)i + 1, SPAN_FLOW_OUT, (uint64_t)i * 1000,
+			(uint64_t)i * 1000 + 25);
+		total += spanFormatEvent(s, 1234, 5678, json, sizeof(json));
+	}
+	benchStop(run);
+	benchSink += (unsigned)total;
+}
+
+/** What a case depends on: it's run once, at each DPI, or at each DPI and taskbar size. */
+#define SCALE_NONE 0
+#define SCALE_DPI  1
+#define SCALE_SIZE 2
+
+typedef struct {
+	const char *name;
+	void (*run)(benchRun *run);
+	/** SCALE_* */
+	int scale;
+	int iterations;
+} benchCase;
+
+static const benchCase cases[] = {
+	{ "layout", layoutCase, SCALE_SIZE, 2000000 },
+	{ "ico-scale", icoScaleCase, SCALE_DPI, 20000 },
+	{ "svg-render", svgRenderCase, SCALE_DPI, 500 },
+	{ "blend", blendCase, SCALE_SIZE, 50000 },
+	{ "recolor", recolorCase, SCALE_SIZE, 50000 },
+	{ "visual-key", visualKeyCase, SCALE_NONE, 5000000 },
+	{ "batch", batchCase, SCALE_NONE, 2000000 },
+	{ "frame", frameCase, SCALE_NONE, 5000000 },
+	{ "host-batch", hostBatchCase, SCALE_NONE, 500000 },
+	{ "span", spanCase, SCALE_NONE, 1000000 }
+};
+
+static const uint32_t dpis[] = { 96, 120, 144, 192, 288 };
+/** The taskbar's thickness at 96 DPI: with small icons, normal, and two rows */
+static const int32_t sizes[] = { 30, 40, 80 };
+
+/** A result of an earlier run. */
+typedef struct {
+	char name[64];
+	uint32_t dpi;
+	int32_t size;
+	double nsPerOp, allocsPerOp;
+} benchBaseline;
+
+#define MAX_BASELINES 256
+
+static benchBaseline baselines[MAX_BASELINES];
+static int baselineCount;
+
+/**
+ * Reads the results of an earlier run (written with --json).
+ * @return false if the file can't be read.
+ */
+static bool readBaseline(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+	char line[512];
+	while (baselineCount < MAX_BASELINES && fgets(line, sizeof(line), f)) {
+		benchBaseline *b = &baselines[baselineCount];
+		b->allocsPerOp = -1;
+		int fields = sscanf(line, "{\"case\":\"%63[^\"]\",\"dpi\":%u,\"size\":%d,\"iterations\":%*d,"
+			"\"nsPerOp\":%lf,\"allocsPerOp\":%lf", b->name, &b->dpi, &b->size, &b->nsPerOp, &b->allocsPerOp);
+		if (fields >= 4) {
+			baselineCount++;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+static const benchBaseline *findBaseline(const char *name, const benchRun *run)
+{
+	for (int n = 0; n < baselineCount; n++) {
+		if (!strcmp(baselines[n].name, name) && baselines[n].dpi == run->dpi && baselines[n].size == run->size) {
+			return &baselines[n];
+		}
+	}
+	return null;
+}
+
+/** Options from the command line. */
+typedef struct {
+	bool json;
+	int divisor;
+	const char *filter;
+	/** Slowdown (percent) which counts as a regression */
+	double threshold;
+} benchOptions;
+
+/**
+ * Writes a result, and compares it with the baseline.
+ * @return true if it's a regression: slower by more than the threshold, or more allocations.
+ */
+static bool report(const benchOptions *options, const char *name, const benchRun *run)
+{
+#ifdef BENCH_COUNT_ALLOCS
+	bool counted = true;
+#else
+	bool counted = false;
+#endif
+	const benchBaseline *base = findBaseline(name, run);
+	double change = base && base->nsPerOp > 0 ? (run->nsPerOp / base->nsPerOp - 1) * 100 : 0;
+	bool slower = base && change > options->threshold;
+	bool allocs = base && counted && base->allocsPerOp >= 0 && run->allocsPerOp > base->allocsPerOp;
+
+	if (options->json) {
+		char allocText[32] = "null";
+		if (counted) {
+			snprintf(allocText, sizeof(allocText), "%.3f", run->allocsPerOp);
+		}
+		printf("{\"case\":\"%s\",\"dpi\":%u,\"size\":%d,\"iterations\":%d,\"nsPerOp\":%.2f,\"allocsPerOp\":%s}\n",
+			name, run->dpi, run->size, run->iterations, run->nsPerOp, allocText);
+	} else {
+		char allocText[32] = "-";
+		char changeText[32] = "";
+		if (counted) {
+			snprintf(allocText, sizeof(allocText), "%.3f", run->allocsPerOp);
+		}
+		if (base) {
+			snprintf(changeText, sizeof(changeText), "%+.1f%%", change);
+		}
+		printf("%-12s %5u %5d %12.2f %10s %9s%s\n", name, run->dpi, run->size, run->nsPerOp, allocText, changeText,
+			slower || allocs ? "  regression" : "");
+	}
+	fflush(stdout);
+
+	if (slower) {
+		fprintf(stderr, "%s (dpi %u, size %d): %.2f ns/op, was %.2f\n", name, run->dpi, run->size, run->nsPerOp,
+			base->nsPerOp);
+	}
+	if (allocs) {
+		fprintf(stderr, "%s (dpi %u, size %d): %.3f allocations/op, was %.3f\n", name, run->dpi, run->size,
+			run->allocsPerOp, base->allocsPerOp);
+	}
+	return slower || allocs;
+}
+
+static void usage()
+{
+	printf("core-bench [--json] [--quick] [--filter <case>] [--baseline <file> [--threshold <percent>]]\n\n"
+		"  --json       Write each result as a line of JSON.\n"
+		"  --quick      Run 100 times fewer iterations (to check they work).\n"
+		"  --filter     Only run the cases whose names contain this.\n"
+		"  --baseline   Compare with the results of an earlier run (written with --json); exits with 1 if a\n"
+		"               case is slower by more than the threshold (default 20%%), or allocates more.\n");
+}
+
+int main(int argc, char **argv)
+{
+	benchOptions options = { false, 1, null, 20 };
+	for (int a = 1; a < argc; a++) {
+		bool more = a + 1 < argc;
+		if (!strcmp(argv[a], "--json")) {
+			options.json = true;
+		} else if (!strcmp(argv[a], "--quick")) {
+			options.divisor = 100;
+		} else if (!strcmp(argv[a], "--filter") && more) {
+			options.filter = argv[++a];
+		} else if (!strcmp(argv[a], "--baseline") && more) {
+			if (!readBaseline(argv[++a])) {
+				fprintf(stderr, "Can't read %s\n", argv[a]);
+				return 2;
+			}
+		} else if (!strcmp(argv[a], "--threshold") && more) {
+			options.threshold = atof(argv[++a]);
+		} else {
+			usage();
+			return 2;
+		}
+	}
+
+	size_t icoSize, svgSize;
+	uint8_t *icoData = readFile(ICONS_DIR "/Morphic-tray-icon-white.ico", &icoSize);
+	uint8_t *svgData = readFile(ICONS_DIR "/TaskTrayIcon_outline.svg", &svgSize);
+	if (!icoData || !icoParse(icoData, icoSize, &ico) || !svgData || !svgParse(svgData, svgSize, &svg)) {
+		fprintf(stderr, "Can't read the icons\n");
+		return 2;
+	}
+
+	if (!options.json) {
+		printf("%-12s %5s %5s %12s %10s %9s\n", "case", "dpi", "size", "ns/op", "allocs/op", "change");
+	}
+
+	int regressions = 0;
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		const benchCase *bc = &cases[c];
+		if (options.filter && !strstr(bc->name, options.filter)) {
+			continue;
+		}
+
+		size_t dpiCount = bc->scale >= SCALE_DPI ? sizeof(dpis) / sizeof(dpis[0]) : 1;
+		size_t sizeCount = bc->scale >= SCALE_SIZE ? sizeof(sizes) / sizeof(sizes[0]) : 1;
+		for (size_t d = 0; d < dpiCount; d++) {
+			for (size_t s = 0; s < sizeCount; s++) {
+				benchRun run = { 0 };
+				if (bc->scale >= SCALE_DPI) {
+					run.dpi = dpis[d];
+					run.iconSize = scaleDpi(16, run.dpi);
+				}
+				if (bc->scale >= SCALE_SIZE) {
+					run.size = sizes[s];
+					run.width = scaleDpi(24, run.dpi);
+					run.height = scaleDpi(run.size, run.dpi);
+				}
+				run.iterations = bc->iterations / options.divisor;
+				if (run.iterations < 1) {
+					run.iterations = 1;
+				}
+
+				bc->run(&run);
+				regressions += report(&options, bc->name, &run);
+			}
+		}
+	}
+
+	svgFree(&svg);
+	icoFree(&ico);
+	free(svgData);
+	free(icoData);
+
+	if (regressions) {
+		fprintf(stderr, "%d regressions\n", regressions);
+		return 1;
+	}
+	return 0;
+}
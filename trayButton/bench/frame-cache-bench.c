@@ -0,0 +1,224 @@
+/* Task tray button - benchmarks.
+ * Time to the first frame of a new process, with and without the file of rendered frames.
+ *
+ * Without the file, the first paint reads and decodes the icon file, scales it to the size for the DPI, draws it into
+ * the cell, and (in high-contrast) recolours it. With it, the file is memory-mapped and the cell is copied out.
+ * Each iteration starts from nothing, like a new process; run with --cold to also drop both files from the page cache
+ * each time (posix_fadvise), like the first start after a reboot. The file is only mapped once by a process, for every
+ * frame it needs, so the cost of a frame once it's mapped is also shown.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "../core/frame-cache.h"
+#include "../core/ico.h"
+#include "../core/pixels.h"
+#include "../core/recolor.h"
+#include "../core/solid-pool.h"
+#include "../core/visual-key.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+#define ICON_FILE ICONS_DIR "/Morphic-tray-icon-white.ico"
+#define CACHE_FILE "frame-cache-bench.cache"
+
+/** High-contrast colours (COLORREF) */
+#define FOREGROUND 0x0000ffff
+#define BACKGROUND 0x00000000
+
+static bool cold = false;
+
+static void dropFromPageCache(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+static frameCacheKey makeKey(uint32_t dpi, bool highContrast)
+{
+	frameCacheKey key = { 1, 2, dpi, highContrast ? 3 : 0, STATE_NORMAL | (highContrast ? FRAME_CACHE_HIGH_CONTRAST : 0),
+		scaleDpi(24, dpi), scaleDpi(40, dpi) };
+	return key;
+}
+
+/** Renders a frame the way the first paint does without the file: from the icon file. */
+static bool renderFrame(const frameCacheKey *key, uint32_t *cell)
+{
+	FILE *f = fopen(ICON_FILE, "rb");
+	if (!f) {
+		return false;
+	}
+	uint8_t *data = malloc(0x100000);
+	size_t size = fread(data, 1, 0x100000, f);
+	fclose(f);
+
+	icoFile ico;
+	int32_t iconSize = scaleDpi(16, key->dpi);
+	bool ok = icoParse(data, size, &ico) > 0;
+	if (ok) {
+		uint32_t *icon = malloc((size_t)iconSize * iconSize * sizeof(uint32_t));
+		icoScale(icoSelect(&ico, iconSize), iconSize, icon);
+		premultiplyPixels(icon, (size_t)iconSize * iconSize);
+
+		bool hc = key->colors != 0;
+		fillPixels(cell, key->width, 0, 0, key->width, key->height, hc ? premultiplyColor(0, 255) : 0);
+		int x = (key->width - iconSize) / 2, y = (key->height - iconSize) / 2;
+		blendPixels(cell + (size_t)y * key->width + x, key->width, icon, iconSize, iconSize, iconSize);
+		if (hc) {
+			recolorTable table = { 0 };
+			recolorTableInit(&table, FOREGROUND, BACKGROUND);
+			recolorPixels(&table, cell, (size_t)key->width * key->height);
+		}
+		free(icon);
+	}
+
+	icoFree(&ico);
+	free(data);
+	return ok;
+}
+
+/** Gets a frame the way the first paint does with the file: map it, find the frame, and copy it. */
+static bool loadFrame(const frameCacheKey *key, uint32_t *cell)
+{
+	int fd = open(CACHE_FILE, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st)) {
+		return false;
+	}
+	void *data = mmap(null, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	frameCache cache;
+	frameCacheOpen(&cache, data, (size_t)st.st_size);
+	const uint32_t *frame = frameCacheFind(&cache, key);
+	if (frame) {
+		copyPixels(cell, key->width, frame, key->width, key->width, key->height);
+	}
+	frameCacheClose(&cache);
+	munmap(data, (size_t)st.st_size);
+	return frame != null;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t dpis[] = { 96, 120, 144, 192, 288 };
+	const int dpiCount = sizeof(dpis) / sizeof(dpis[0]);
+	const int iterations = 2000;
+
+	for (int n = 1; n < argc; n++) {
+		if (!strcmp(argv[n], "--cold")) {
+			cold = true;
+		}
+	}
+
+	// Write the file, as a previous run would have.
+	frameCacheWriter writer;
+	frameCacheWriterInit(&writer);
+	uint32_t *cell = malloc((size_t)scaleDpi(24, 288) * scaleDpi(40, 288) * sizeof(uint32_t));
+	for (int d = 0; d < dpiCount; d++) {
+		for (int hc = 0; hc < 2; hc++) {
+			frameCacheKey key = makeKey(dpis[d], hc);
+			if (!renderFrame(&key, cell)) {
+				printf("Can't read the icon\n");
+				return 1;
+			}
+			frameCacheWriterAdd(&writer, &key, cell, key.width);
+		}
+	}
+
+	size_t size;
+	uint8_t *data = frameCacheWriterFinish(&writer, &size);
+	frameCacheWriterFree(&writer);
+	FILE *f = fopen(CACHE_FILE, "wb");
+	if (!data || !f || fwrite(data, 1, size, f) != size) {
+		printf("Can't write %s\n", CACHE_FILE);
+		return 1;
+	}
+	fclose(f);
+	free(data);
+
+	printf("%u frames, %u bytes%s\n", dpiCount * 2, (unsigned)size, cold ? " (page cache dropped each time)" : "");
+	printf("%5s %8s %20s %20s %9s %16s\n", "dpi", "mode", "us/first frame: ico", "us/first frame: file", "speed-up",
+		"us/frame: mapped");
+
+	int fd = open(CACHE_FILE, O_RDONLY);
+	void *mapped = mmap(null, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	frameCache cache;
+	if (mapped == MAP_FAILED || !frameCacheOpen(&cache, mapped, size)) {
+		printf("Can't map %s\n", CACHE_FILE);
+		return 1;
+	}
+
+	int count = cold ? iterations / 10 : iterations;
+	for (int d = 0; d < dpiCount; d++) {
+		for (int hc = 0; hc < 2; hc++) {
+			frameCacheKey key = makeKey(dpis[d], hc);
+
+			double total = 0;
+			for (int i = 0; i < count; i++) {
+				if (cold) {
+					dropFromPageCache(ICON_FILE);
+				}
+				double start = benchNow();
+				renderFrame(&key, cell);
+				total += benchNow() - start;
+				benchSink += cell[i % (key.width * key.height)];
+			}
+			double before = total / count;
+
+			total = 0;
+			for (int i = 0; i < count; i++) {
+				if (cold) {
+					dropFromPageCache(CACHE_FILE);
+				}
+				double start = benchNow();
+				if (!loadFrame(&key, cell)) {
+					printf("Frame not found\n");
+					return 1;
+				}
+				total += benchNow() - start;
+				benchSink += cell[i % (key.width * key.height)];
+			}
+			double after = total / count;
+
+			double start = benchNow();
+			for (int i = 0; i < iterations; i++) {
+				const uint32_t *frame = frameCacheFind(&cache, &key);
+				copyPixels(cell, key.width, frame, key.width, key.width, key.height);
+				benchSink += cell[i % (key.width * key.height)];
+			}
+			double mappedFrame = (benchNow() - start) / iterations;
+
+			printf("%5u %8s %20.1f %20.1f %8.1fx %16.2f\n", dpis[d], hc ? "hc" : "normal", before / 1000, after / 1000,
+				before / after, mappedFrame / 1000);
+		}
+	}
+
+	frameCacheClose(&cache);
+	munmap(mapped, size);
+	free(cell);
+	remove(CACHE_FILE);
+	return 0;
+}
@@ -0,0 +1,179 @@
+/* Task tray button - benchmarks.
+ * Framed messages over a socket pair: messages per second one way, and the round-trip latency of a ping.
+ *
+ * The button uses a named pipe on Windows; a socket pair between two threads is the nearest equivalent here, and
+ * measures the framing and codec plus the cost of a system call per message.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "bench.h"
+#include "../core/frame.h"
+
+#define MESSAGES 200000
+#define PINGS 20000
+
+/** The other end (gpii): counts the positions, and answers the pings. */
+typedef struct {
+	int socket;
+	uint32_t positions;
+	uint32_t missed;
+	bool failed;
+} peer;
+
+static bool writeAll(int socket, const uint8_t *data, size_t length)
+{
+	while (length) {
+		ssize_t written = write(socket, data, length);
+		if (written <= 0) {
+			return false;
+		}
+		data += written;
+		length -= (size_t)written;
+	}
+	return true;
+}
+
+/**
+ * Reads until there's a frame.
+ * @return false on end of stream, or a corrupt stream.
+ */
+static bool readFrame(int socket, frameReader *reader, frame *f)
+{
+	uint8_t buffer[4096];
+	for (;;) {
+		int result = frameReaderNext(reader, f);
+		if (result == FRAME_READ) {
+			return true;
+		} else if (result == FRAME_ERROR) {
+			return false;
+		}
+		ssize_t length = read(socket, buffer, sizeof(buffer));
+		if (length <= 0) {
+			return false;
+		}
+		// Never more than a frame is left unread, so it all fits.
+		frameReaderAppend(reader, buffer, (size_t)length);
+	}
+}
+
+static void *peerThread(void *arg)
+{
+	peer *p = (peer*)arg;
+	static frameReader reader;
+	uint32_t sequence = 0;
+	frame f;
+
+	frameReaderInit(&reader);
+	while (readFrame(p->socket, &reader, &f)) {
+		coreRect rect;
+		if (frameDecodePosition(&f, &rect)) {
+			p->positions++;
+		} else if (f.type == FRAME_PING) {
+			uint8_t pong[FRAME_HEADER_SIZE + 64];
+			size_t length = frameEncode(pong, sizeof(pong), FRAME_PONG, sequence++, f.timestamp, f.payload,
+				f.payloadLength);
+			if (!length || !writeAll(p->socket, pong, length)) {
+				break;
+			}
+		}
+	}
+
+	p->missed = reader.missed;
+	p->failed = reader.failed;
+	return null;
+}
+
+/** Microseconds, for the frame timestamps. */
+static uint64_t nowMicro()
+{
+	return (uint64_t)(benchNow() / 1000);
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+/** Sends a ping, and waits for the pong. */
+static bool ping(int socket, frameReader *reader, uint32_t sequence)
+{
+	uint8_t buffer[FRAME_HEADER_SIZE];
+	frame f;
+	size_t length = frameEncode(buffer, sizeof(buffer), FRAME_PING, sequence, nowMicro(), null, 0);
+	return writeAll(socket, buffer, length) && readFrame(socket, reader, &f) && f.type == FRAME_PONG;
+}
+
+int main()
+{
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	peer p = { sockets[1] };
+	pthread_t thread;
+	pthread_create(&thread, null, peerThread, &p);
+
+	static frameReader reader;
+	frameReaderInit(&reader);
+	uint32_t sequence = 0;
+	bool ok = true;
+
+	// One way: a frame per write, as the button sends them. The ping at the end waits for them all to be read.
+	coreRect rect = { -1920, 1040, -1896, 1080 };
+	double start = benchNow();
+	for (int n = 0; ok && n < MESSAGES; n++) {
+		uint8_t buffer[FRAME_HEADER_SIZE + 16];
+		rect.left = -1920 + (n & 0xff);
+		size_t length = frameEncodePosition(buffer, sizeof(buffer), sequence++, nowMicro(), &rect);
+		ok = writeAll(sockets[0], buffer, length);
+	}
+	ok = ok && ping(sockets[0], &reader, sequence++);
+	double oneWay = benchNow() - start;
+
+	// Round trips.
+	static double times[PINGS];
+	for (int n = 0; ok && n < PINGS; n++) {
+		double pingStart = benchNow();
+		ok = ping(sockets[0], &reader, sequence++);
+		times[n] = benchNow() - pingStart;
+	}
+
+	shutdown(sockets[0], SHUT_WR);
+	pthread_join(thread, null);
+	close(sockets[0]);
+	close(sockets[1]);
+
+	if (!ok || p.failed || p.positions != MESSAGES || p.missed || reader.missed) {
+		fprintf(stderr, "ipc-bench: lost messages (received %u of %u, %u missed)\n", p.positions, MESSAGES, p.missed);
+		return 1;
+	}
+
+	double total = 0;
+	for (int n = 0; n < PINGS; n++) {
+		total += times[n];
+	}
+	qsort(times, PINGS, sizeof(times[0]), compareDouble);
+
+	printf("%12s %14s %12s\n", "case", "messages/s", "ns/message");
+	printf("%12s %14.0f %12.1f\n", "position", MESSAGES * 1e9 / oneWay, oneWay / MESSAGES);
+	printf("\n%12s %10s %10s %10s\n", "round trip", "avg us", "p50 us", "p99 us");
+	printf("%12s %10.2f %10.2f %10.2f\n", "ping", total / PINGS / 1000, times[PINGS / 2] / 1000,
+		times[PINGS * 99 / 100] / 1000);
+
+	benchSink += p.positions;
+	return 0;
+}
@@ -0,0 +1,58 @@
+/* Task tray button - benchmarks.
+ * Layouts per second, for a settled taskbar (the common case) and one the shell keeps resetting.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "bench.h"
+#include "../core/layout.h"
+
+int main()
+{
+	static const uint32_t dpis[] = { 96, 144, 192, 288 };
+	const int iterations = 5000000;
+
+	printf("%5s %10s %12s %14s\n", "dpi", "case", "ns/layout", "layouts/s");
+
+	for (int d = 0; d < (int)(sizeof(dpis) / sizeof(dpis[0])); d++) {
+		uint32_t dpi = dpis[d];
+		int32_t thickness = scaleDpi(40, dpi);
+		layoutInput input = { 0 };
+		input.trayRect = (coreRect) { 0, 1080 - thickness, 1920, 1080 };
+		input.trayClient = (coreRect) { 0, 0, 1920, thickness };
+		input.tasksRect = (coreRect) { 100, 1080 - thickness, 1770, 1080 };
+		input.notifyRect = (coreRect) { 1770, 1080 - thickness, 1920, 1080 };
+		input.screenHeight = 1000;
+		input.dpi = dpi;
+		input.buttonWidth = 24;
+
+		for (int reset = 0; reset < 2; reset++) {
+			layoutState state = { 0 };
+			layoutResult result;
+			layoutInput settled = input;
+			layoutCompute(&settled, &result);
+			layoutDiff(&state, &settled, &result, false);
+			settled.tasksRect.right = settled.tasksRect.left + rectWidth(result.tasksRect);
+
+			const layoutInput *in = reset ? &input : &settled;
+			unsigned ops = 0;
+			double start = benchNow();
+			for (int i = 0; i < iterations; i++) {
+				layoutCompute(in, &result);
+				ops += layoutDiff(&state, in, &result, false);
+			}
+			double perLayout = (benchNow() - start) / iterations;
+			benchSink += ops;
+
+			printf("%5u %10s %12.2f %14.0f\n", dpi, reset ? "reset" : "settled", perLayout, 1e9 / perLayout);
+		}
+	}
+
+	return 0;
+}
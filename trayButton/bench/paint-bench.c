@@ -0,0 +1,167 @@
+/* Task tray button - benchmarks.
+ * Pixel work per paint: drawing each frame from scratch, against copying it from the atlas.
+ *
+ * GDI isn't available here, so DrawIconEx and AlphaBlend are modelled by the equivalent premultiplied blending; the
+ * fixed cost of the GDI calls themselves (several per paint before, one BitBlt after) isn't included.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/atlas.h"
+#include "../core/ico.h"
+#include "../core/pixels.h"
+#include "../core/recolor.h"
+#include "../core/solid-pool.h"
+#include "../core/visual-key.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+/** Premultiplied source-over of a straight-alpha image, like DrawIconEx. */
+static void drawImage(uint32_t *dest, int stride, int x, int y, const uint32_t *src, int size)
+{
+	for (int row = 0; row < size; row++) {
+		uint32_t *d = dest + (size_t)(y + row) * stride + x;
+		const uint32_t *s = src + (size_t)row * size;
+		for (int col = 0; col < size; col++) {
+			uint32_t a = s[col] >> 24, inv = 255 - a, out = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				uint32_t sc = shift == 24 ? 255 : (s[col] >> shift) & 0xff;
+				uint32_t v = sc * a + ((d[col] >> shift) & 0xff) * inv + 128;
+				out |= ((v + (v >> 8)) >> 8) << shift;
+			}
+			d[col] = out;
+		}
+	}
+}
+
+/** Premultiplied source-over of a single colour, like AlphaRect. */
+static void blendRect(uint32_t *dest, int stride, int width, int height, uint32_t pixel)
+{
+	uint32_t inv = 255 - (pixel >> 24);
+	for (int row = 0; row < height; row++) {
+		uint32_t *d = dest + (size_t)row * stride;
+		for (int col = 0; col < width; col++) {
+			uint32_t out = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				uint32_t v = ((d[col] >> shift) & 0xff) * inv + 128;
+				out |= (((pixel >> shift) & 0xff) + ((v + (v >> 8)) >> 8)) << shift;
+			}
+			d[col] = out;
+		}
+	}
+}
+
+static uint8_t *readFile(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return null;
+	}
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	*size = fread(data, 1, *size, f);
+	fclose(f);
+	return data;
+}
+
+int main()
+{
+	static const int dpis[] = { 96, 144, 192, 288 };
+	const int iterations = 20000;
+
+	size_t fileSize;
+	uint8_t *file = readFile(ICONS_DIR "/Morphic-tray-icon-white.ico", &fileSize);
+	icoFile ico;
+	if (!file || !icoParse(file, fileSize, &ico)) {
+		printf("Can't read the icon\n");
+		return 1;
+	}
+
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x0000ffff, 0x00800000);
+
+	printf("%5s %8s %16s %16s %9s\n", "dpi", "mode", "ns/paint before", "ns/paint after", "speed-up");
+
+	for (int d = 0; d < (int)(sizeof(dpis) / sizeof(dpis[0])); d++) {
+		int width = scaleDpi(24, dpis[d]), height = scaleDpi(40, dpis[d]), iconSize = scaleDpi(16, dpis[d]);
+		int x = (width - iconSize) / 2, y = (height - iconSize) / 2;
+
+		uint32_t *icon = malloc((size_t)iconSize * iconSize * sizeof(uint32_t));
+		icoScale(icoSelect(&ico, iconSize), iconSize, icon);
+
+		uint32_t *buffer = malloc((size_t)width * height * sizeof(uint32_t));
+		uint32_t *screen = malloc((size_t)width * height * sizeof(uint32_t));
+
+		// The atlas, with every cell rendered.
+		spriteAtlas atlas = { 0 };
+		atlasKey key = { width, height, 1, iconSize, 0 };
+		atlasUpdate(&atlas, &key);
+		int stride = width * ATLAS_COLUMNS;
+		uint32_t *atlasPixels = calloc((size_t)stride * height * ATLAS_ROWS, sizeof(uint32_t));
+		for (int cell = 0; cell < ATLAS_CELLS; cell++) {
+			coreRect rc;
+			atlasCellRect(&atlas, cell, &rc);
+			drawImage(atlasPixels, stride, rc.left + x, rc.top + y, icon, iconSize);
+			atlasRendered(&atlas, cell);
+		}
+
+		for (int hc = 0; hc < 2; hc++) {
+			uint32_t state = STATE_NORMAL | STATE_HOVER;
+
+			// Before: every paint draws the frame.
+			double start = benchNow();
+			for (int i = 0; i < iterations; i++) {
+				if (hc) {
+					fillPixels(buffer, width, 0, 0, width, height, premultiplyColor(0, 255));
+					drawImage(buffer, width, x, y, icon, iconSize);
+					recolorPixels(&table, buffer, (size_t)width * height);
+				} else {
+					fillPixels(buffer, width, 0, 0, width, height, 0);
+					blendRect(buffer, width, width, height, premultiplyColor(0xffffff, 25));
+					drawImage(buffer, width, x, y, icon, iconSize);
+				}
+				copyPixels(screen, width, buffer, width, width, height);
+				benchSink += screen[i % (width * height)];
+			}
+			double before = (benchNow() - start) / iterations;
+
+			// After: every paint is a copy of the cell.
+			start = benchNow();
+			for (int i = 0; i < iterations; i++) {
+				int cell = atlasCell(state, hc);
+				if (atlasNeedsRender(&atlas, cell)) {
+					atlasRendered(&atlas, cell);
+				}
+				coreRect rc;
+				atlasCellRect(&atlas, cell, &rc);
+				copyPixels(screen, width, atlasPixels + (size_t)rc.top * stride + rc.left, stride, width, height);
+				benchSink += screen[i % (width * height)];
+			}
+			double after = (benchNow() - start) / iterations;
+
+			printf("%5d %8s %16.1f %16.1f %8.1fx\n", dpis[d], hc ? "hc" : "normal", before, after, before / after);
+		}
+
+		free(icon);
+		free(buffer);
+		free(screen);
+		free(atlasPixels);
+	}
+
+	icoFree(&ico);
+	free(file);
+	return 0;
+}
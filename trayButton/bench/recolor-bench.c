@@ -0,0 +1,60 @@
+/* Task tray button - benchmarks.
+ * Throughput of the high-contrast recolouring kernel, for the button sizes at common DPIs.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/recolor.h"
+
+static const char *implNames[] = { "scalar", "sse2", "avx2" };
+
+int main()
+{
+	// The buffer is the whole client area of the button: 24 x 40 at 96 DPI.
+	static const int dpis[] = { 96, 120, 144, 192, 288 };
+
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x0000ffff, 0x00800000);
+
+	printf("%-8s %5s %10s %12s %10s\n", "impl", "dpi", "pixels", "ns/image", "Mpix/s");
+
+	for (int d = 0; d < (int)(sizeof(dpis) / sizeof(dpis[0])); d++) {
+		int width = 24 * dpis[d] / 96, height = 40 * dpis[d] / 96;
+		size_t count = (size_t)width * height;
+		uint32_t *source = malloc(count * sizeof(uint32_t));
+		uint32_t *pixels = malloc(count * sizeof(uint32_t));
+		for (size_t n = 0; n < count; n++) {
+			source[n] = 0xff000000 | (uint32_t)(n * 2654435761u >> 8);
+		}
+
+		for (int impl = RECOLOR_SCALAR; impl <= (int)recolorBestImpl(); impl++) {
+			int iterations = (int)(20000000 / count) + 1;
+			double total = 0;
+			for (int i = 0; i < iterations; i++) {
+				memcpy(pixels, source, count * sizeof(uint32_t));
+				double start = benchNow();
+				recolorPixelsWith((recolorImpl)impl, &table, pixels, count);
+				total += benchNow() - start;
+				benchSink += pixels[i % count];
+			}
+
+			double perImage = total / iterations;
+			printf("%-8s %5d %10zu %12.1f %10.1f\n", implNames[impl], dpis[d], count, perImage,
+				count / perImage * 1000);
+		}
+
+		free(source);
+		free(pixels);
+	}
+
+	return 0;
+}
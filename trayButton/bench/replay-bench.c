@@ -0,0 +1,401 @@
+/* Task tray button - benchmarks.
+ * Replays traces of what the button received through the button logic, counting what it does.
+ *
+ *   replay-bench [--check] file.trace...
+ *
+ * With --check, the "expect" lines of each trace are checked, and the exit code is non-zero if any are exceeded.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/button.h"
+#include "../core/trace.h"
+
+// The same as tray-button.c
+#define BUTTON_WIDTH 24
+#define RESIZE_DELAY 100
+#define CHECK_MIN_DELAY 1000
+#define CHECK_MAX_DELAY 60000
+
+/** How long to keep going after the last event, for the timers to settle (ms) */
+#define REPLAY_TAIL 5000
+/** Number of times each trace is replayed, for the timing */
+#define REPLAY_ITERATIONS 1000
+#define REPLAY_TIMERS 2
+
+/** What the button did. */
+typedef struct {
+	uint32_t relayouts, setWindowPos, redraws, notifies, reloads, timers;
+} replayCounts;
+
+static const char *countNames[] = { "relayouts", "setWindowPos", "redraws", "notifies", "reloads", "timers" };
+#define COUNT_NAMES (sizeof(countNames) / sizeof(countNames[0]))
+
+/** A stand-in for Windows, which gives the button what the trace says. */
+typedef struct {
+	/** The platform given to the button (must be first) */
+	buttonPlatform platform;
+	trayButton button;
+
+	layoutInput geometry;
+	bool hasGeometry;
+	uint32_t dpi;
+	bool highContrast;
+
+	uint64_t now;
+	struct {
+		bool active;
+		uint32_t delay;
+		uint64_t due;
+	} timers[REPLAY_TIMERS + 1];
+
+	replayCounts counts;
+} replay;
+
+/** A loaded trace. */
+typedef struct {
+	const char *file;
+	traceEvent *events;
+	size_t count;
+} trace;
+
+#define getReplay(platform) ((replay*)(platform))
+
+static bool replayGetTaskbar(buttonPlatform *platform, layoutInput *input)
+{
+	replay *r = getReplay(platform);
+	*input = r->geometry;
+	return r->hasGeometry;
+}
+
+static uint32_t replayGetDpi(buttonPlatform *platform)
+{
+	return getReplay(platform)->dpi;
+}
+
+static bool replayIsHighContrast(buttonPlatform *platform)
+{
+	return getReplay(platform)->highContrast;
+}
+
+static void replayResizeTasks(buttonPlatform *platform, int32_t width, int32_t height)
+{
+	replay *r = getReplay(platform);
+	coreRect *tasks = &r->geometry.tasksRect;
+	r->counts.setWindowPos++;
+
+	// SWP_NOMOVE keeps the origin, which is on the right when the coordinates are mirrored.
+	if (r->geometry.notifyRect.right <= tasks->left) {
+		tasks->left = tasks->right - width;
+	} else {
+		tasks->right = tasks->left + width;
+	}
+	tasks->bottom = tasks->top + height;
+}
+
+static void replayMoveButton(buttonPlatform *platform, const coreRect *rect)
+{
+	getReplay(platform)->counts.setWindowPos++;
+}
+
+static void replayRedraw(buttonPlatform *platform, bool force)
+{
+	getReplay(platform)->counts.redraws++;
+}
+
+static void replayNotifyPosition(buttonPlatform *platform, const coreRect *rect)
+{
+	getReplay(platform)->counts.notifies++;
+}
+
+static void replayReloadIcon(buttonPlatform *platform)
+{
+	replay *r = getReplay(platform);
+	r->counts.reloads++;
+	// Like setImage.
+	r->button.hasIcon = true;
+	buttonPosition(&r->button, true);
+}
+
+static void replayStartTimer(buttonPlatform *platform, uint32_t id, uint32_t delay)
+{
+	replay *r = getReplay(platform);
+	if (id <= REPLAY_TIMERS) {
+		r->timers[id].active = true;
+		r->timers[id].delay = delay ? delay : 1;
+		r->timers[id].due = r->now + r->timers[id].delay;
+	}
+}
+
+static void replayStopTimer(buttonPlatform *platform, uint32_t id)
+{
+	if (id <= REPLAY_TIMERS) {
+		getReplay(platform)->timers[id].active = false;
+	}
+}
+
+static uint64_t replayNow(buttonPlatform *platform)
+{
+	return getReplay(platform)->now;
+}
+
+static const buttonPlatform replayPlatform = {
+	replayGetTaskbar,
+	replayGetDpi,
+	replayIsHighContrast,
+	replayResizeTasks,
+	replayMoveButton,
+	replayRedraw,
+	replayNotifyPosition,
+	replayReloadIcon,
+	replayStartTimer,
+	replayStopTimer,
+	replayNow
+};
+
+/** Fires the timers which are due before the given time. */
+static void replayAdvance(replay *r, uint64_t time)
+{
+	for (;;) {
+		uint32_t timer = 0;
+		uint64_t next = time + 1;
+		for (uint32_t id = 1; id <= REPLAY_TIMERS; id++) {
+			if (r->timers[id].active && r->timers[id].due < next) {
+				next = r->timers[id].due;
+				timer = id;
+			}
+		}
+		if (!timer) {
+			break;
+		}
+
+		r->now = next;
+		r->counts.timers++;
+		r->timers[timer].due += r->timers[timer].delay;
+		buttonTimer(&r->button, timer);
+	}
+
+	if (time > r->now) {
+		r->now = time;
+	}
+}
+
+/** Passes an event to the button. */
+static void replayEvent(replay *r, const traceEvent *event)
+{
+	trayButton *button = &r->button;
+
+	replayAdvance(r, event->time);
+
+	switch (event->type) {
+	case TRACE_SHELL:
+		buttonShellMessage(button);
+		break;
+	case TRACE_SETTING:
+		buttonSettingChange(button);
+		break;
+	case TRACE_DISPLAY:
+	case TRACE_SIZE:
+		buttonPosition(button, true);
+		break;
+	case TRACE_ERASE:
+		buttonPosition(button, false);
+		break;
+	case TRACE_ICON:
+		replayReloadIcon(&r->platform);
+		break;
+	case TRACE_HIDE:
+		button->hasIcon = false;
+		buttonHidden(button);
+		break;
+	case TRACE_GEOMETRY:
+		r->geometry = event->geometry;
+		r->hasGeometry = true;
+		break;
+	case TRACE_DPI:
+		r->dpi = event->value;
+		break;
+	case TRACE_CONTRAST:
+		r->highContrast = event->value != 0;
+		break;
+	default:
+		break;
+	}
+}
+
+/** Replays a trace, from the start. */
+static void replayTrace(replay *r, const trace *t)
+{
+	memset(r, 0, sizeof(*r));
+	r->platform = replayPlatform;
+	r->dpi = 96;
+	buttonInit(&r->button, &r->platform, BUTTON_WIDTH, RESIZE_DELAY, CHECK_MIN_DELAY, CHECK_MAX_DELAY);
+
+	// Like WinMain, start with the DPI and high-contrast mode of the taskbar.
+	bool gotDpi = false, gotContrast = false;
+	for (size_t n = 0; n < t->count && !(gotDpi && gotContrast); n++) {
+		const traceEvent *event = &t->events[n];
+		if (event->type == TRACE_DPI && !gotDpi) {
+			r->dpi = event->value;
+			gotDpi = true;
+		} else if (event->type == TRACE_CONTRAST && !gotContrast) {
+			r->highContrast = event->value != 0;
+			gotContrast = true;
+		}
+	}
+	r->button.dpi = r->dpi;
+	buttonCheckHighContrast(&r->button);
+
+	uint64_t end = 0;
+	for (size_t n = 0; n < t->count; n++) {
+		replayEvent(r, &t->events[n]);
+		end = t->events[n].time;
+	}
+	replayAdvance(r, end + REPLAY_TAIL);
+
+	r->counts.relayouts = r->button.positions;
+}
+
+/** Loads a trace file. */
+static bool loadTrace(const char *file, trace *t)
+{
+	FILE *fp = fopen(file, "r");
+	if (!fp) {
+		printf("%s: can't open\n", file);
+		return false;
+	}
+
+	// Log lines can be longer than a trace line.
+	char line[4096];
+	size_t capacity = 0;
+	int lineNumber = 0;
+	bool ok = true;
+	memset(t, 0, sizeof(*t));
+	t->file = file;
+
+	while (ok && fgets(line, sizeof(line), fp)) {
+		traceEvent event;
+		lineNumber++;
+		switch (traceParse(line, &event)) {
+		case TRACE_LINE_ERROR:
+			printf("%s:%d: bad line\n", file, lineNumber);
+			ok = false;
+			break;
+		case TRACE_LINE_EVENT:
+			if (t->count == capacity) {
+				capacity = capacity ? capacity * 2 : 256;
+				traceEvent *events = realloc(t->events, capacity * sizeof(traceEvent));
+				if (!events) {
+					ok = false;
+					break;
+				}
+				t->events = events;
+			}
+			t->events[t->count++] = event;
+			break;
+		default:
+			break;
+		}
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+/** Gets a count by name. */
+static bool getCount(const replayCounts *counts, const char *name, uint32_t *value)
+{
+	const uint32_t values[] = { counts->relayouts, counts->setWindowPos, counts->redraws, counts->notifies,
+		counts->reloads, counts->timers };
+	for (size_t n = 0; n < COUNT_NAMES; n++) {
+		if (strcmp(name, countNames[n]) == 0) {
+			*value = values[n];
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Checks the expectations of a trace. */
+static bool checkTrace(const trace *t, const replayCounts *counts)
+{
+	bool ok = true;
+	for (size_t n = 0; n < t->count; n++) {
+		const traceEvent *event = &t->events[n];
+		if (event->type == TRACE_EXPECT) {
+			uint32_t actual;
+			if (!getCount(counts, event->name, &actual)) {
+				printf("%s: unknown counter '%s'\n", t->file, event->name);
+				ok = false;
+			} else if (actual > event->value) {
+				printf("%s: %s is %u, expected at most %u\n", t->file, event->name, actual, event->value);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	bool check = false;
+	bool ok = true;
+	replay *r = malloc(sizeof(replay));
+	if (!r) {
+		return 1;
+	}
+
+	printf("%-24s %7s %9s %12s %8s %8s %8s %8s %10s\n", "trace", "events", "relayouts", "setWindowPos",
+		"redraws", "notifies", "reloads", "timers", "us/replay");
+
+	for (int arg = 1; arg < argc; arg++) {
+		if (strcmp(argv[arg], "--check") == 0) {
+			check = true;
+			continue;
+		}
+
+		trace t;
+		if (!loadTrace(argv[arg], &t)) {
+			free(t.events);
+			ok = false;
+			continue;
+		}
+
+		replayTrace(r, &t);
+		replayCounts counts = r->counts;
+
+		double start = benchNow();
+		for (int i = 0; i < REPLAY_ITERATIONS; i++) {
+			replayTrace(r, &t);
+			benchSink += r->counts.setWindowPos;
+		}
+		double us = (benchNow() - start) / REPLAY_ITERATIONS / 1000;
+
+		uint32_t events = 0;
+		for (size_t n = 0; n < t.count; n++) {
+			events += t.events[n].type != TRACE_EXPECT;
+		}
+
+		const char *name = strrchr(t.file, '/');
+		name = name ? name + 1 : t.file;
+		printf("%-24s %7u %9u %12u %8u %8u %8u %8u %10.2f\n", name, events, counts.relayouts,
+			counts.setWindowPos, counts.redraws, counts.notifies, counts.reloads, counts.timers, us);
+
+		if (check && !checkTrace(&t, &counts)) {
+			ok = false;
+		}
+		free(t.events);
+	}
+
+	free(r);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/* Task tray button - benchmarks.
+ * Cost of drawing the SVG icons at the exact size for each DPI, against reading and scaling the .ico file.
+ *
+ * The .ico figure is what the button did for every size: read the icon file and scale its nearest image. The SVG is
+ * read once, then drawn for each size that's needed (and kept, so a size is only drawn once).
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../core/ico.h"
+#include "../core/svg.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+static uint8_t *readFile(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return null;
+	}
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	*size = fread(data, 1, *size, f);
+	fclose(f);
+	return data;
+}
+
+int main()
+{
+	static const char *icons[] = { "TaskTrayIcon_outline", "Morphic-Logo-White" };
+	static const int dpis[] = { 96, 120, 144, 168, 192, 288 };
+	const int iterations = 500;
+
+	size_t icoSize;
+	uint8_t *icoData = readFile(ICONS_DIR "/Morphic-tray-icon-white.ico", &icoSize);
+	if (!icoData) {
+		printf("Can't read the icon\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < sizeof(icons) / sizeof(icons[0]); i++) {
+		char path[1024];
+		size_t size;
+		snprintf(path, sizeof(path), "%s/%s.svg", ICONS_DIR, icons[i]);
+		uint8_t *data = readFile(path, &size);
+		svgImage image;
+		if (!data || !svgParse(data, size, &image)) {
+			printf("Can't read %s\n", path);
+			return 1;
+		}
+
+		double start = benchNow();
+		for (int n = 0; n < iterations; n++) {
+			svgImage parsed;
+			svgParse(data, size, &parsed);
+			benchSink += parsed.pointCount;
+			svgFree(&parsed);
+		}
+		double parse = (benchNow() - start) / iterations;
+
+		printf("%s: %u shapes, %u points; read in %.1fus\n", icons[i], image.shapeCount, image.pointCount / 2,
+			parse / 1000);
+		printf("%5s %6s %14s %14s\n", "dpi", "size", "us/svg draw", "us/ico scale");
+
+		for (int d = 0; d < (int)(sizeof(dpis) / sizeof(dpis[0])); d++) {
+			int32_t iconSize = scaleDpi(16, dpis[d]);
+			uint32_t *pixels = malloc((size_t)iconSize * iconSize * sizeof(uint32_t));
+
+			start = benchNow();
+			for (int n = 0; n < iterations; n++) {
+				svgRender(&image, iconSize, pixels);
+				benchSink += pixels[n % (iconSize * iconSize)];
+			}
+			double render = (benchNow() - start) / iterations;
+
+			start = benchNow();
+			for (int n = 0; n < iterations; n++) {
+				icoFile ico;
+				icoParse(icoData, icoSize, &ico);
+				icoScale(icoSelect(&ico, iconSize), iconSize, pixels);
+				benchSink += pixels[n % (iconSize * iconSize)];
+				icoFree(&ico);
+			}
+			double scale = (benchNow() - start) / iterations;
+
+			printf("%5d %6d %14.1f %14.1f\n", dpis[d], iconSize, render / 1000, scale / 1000);
+			free(pixels);
+		}
+
+		// Switching between DPIs, with the cache: only the first of each size is drawn.
+		svgIcon icon = { 0 };
+		icon.image = image;
+		start = benchNow();
+		for (int n = 0; n < iterations; n++) {
+			const uint32_t *pixels = svgIconGet(&icon, scaleDpi(16, dpis[n % 4]));
+			benchSink += pixels[0];
+		}
+		double cached = (benchNow() - start) / iterations;
+		printf("cached, 4 sizes: %.3fus per icon (%u drawn, %u hits)\n\n", cached / 1000, icon.renders, icon.hits);
+
+		svgIconFree(&icon);
+		free(data);
+	}
+
+	free(icoData);
+	return 0;
+}
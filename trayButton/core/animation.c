@@ -0,0 +1,222 @@
+/* Task tray button - platform-neutral core.
+ * Animated icons: what to play, and which frame to show when.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "animation.h"
+#include "pixels.h"
+
+/**
+ * Reads a number, up to the next ';'.
+ * @return false if it's not a number.
+ */
+static bool parseNumber(const hostChar *data, size_t length, size_t *pos, uint32_t *value)
+{
+	size_t start = *pos;
+	uint32_t n = 0;
+	while (*pos < length && data[*pos] != ';') {
+		hostChar c = data[*pos];
+		if (c < '0' || c > '9' || n > (UINT32_MAX - 9) / 10) {
+			return false;
+		}
+		n = n * 10 + (c - '0');
+		(*pos)++;
+	}
+	if (*pos == start || *pos >= length) {
+		// Empty, or there's nothing after it.
+		return false;
+	}
+	(*pos)++;
+	*value = n;
+	return true;
+}
+
+bool animationParse(const hostChar *data, size_t length, animationSpec *spec)
+{
+	size_t pos = 0;
+	memset(spec, 0, sizeof(*spec));
+
+	if (!data || !parseNumber(data, length, &pos, &spec->interval) || !parseNumber(data, length, &pos, &spec->loops)) {
+		return false;
+	}
+
+	// The file names, separated by ';' (a trailing one is allowed).
+	while (pos < length) {
+		size_t start = pos;
+		while (pos < length && data[pos] != ';') {
+			pos++;
+		}
+		if (pos == start || spec->frameCount >= ANIMATION_MAX_FRAMES) {
+			return false;
+		}
+		spec->frames[spec->frameCount].offset = (uint32_t)start;
+		spec->frames[spec->frameCount].length = (uint32_t)(pos - start);
+		spec->frameCount++;
+		pos++;
+	}
+
+	return spec->frameCount > 0;
+}
+
+void frameSchedulerInit(frameScheduler *scheduler)
+{
+	memset(scheduler, 0, sizeof(*scheduler));
+	scheduler->frame = -1;
+}
+
+/** Gets the delay until the frame after the current one. */
+static uint32_t nextFrameDelay(frameScheduler *scheduler, uint64_t now)
+{
+	uint64_t due = scheduler->started + (uint64_t)(scheduler->position + 1) * scheduler->interval;
+	return due > now ? (uint32_t)(due - now) : 1;
+}
+
+uint32_t frameSchedulerStart(frameScheduler *scheduler, uint32_t frameCount, uint32_t interval, uint32_t loops,
+	uint64_t now)
+{
+	if (!frameCount) {
+		frameSchedulerStop(scheduler);
+		return 0;
+	}
+
+	scheduler->frameCount = frameCount;
+	scheduler->interval = interval < ANIMATION_MIN_INTERVAL ? ANIMATION_MIN_INTERVAL : interval;
+	scheduler->loops = loops;
+	scheduler->started = now;
+	scheduler->hiddenAt = now;
+	scheduler->running = true;
+	scheduler->frame = 0;
+	scheduler->position = 0;
+	scheduler->shown++;
+
+	return scheduler->hidden ? 0 : nextFrameDelay(scheduler, now);
+}
+
+void frameSchedulerStop(frameScheduler *scheduler)
+{
+	scheduler->running = false;
+	scheduler->frame = -1;
+}
+
+uint32_t frameSchedulerTick(frameScheduler *scheduler, uint64_t now)
+{
+	scheduler->ticks++;
+	if (!scheduler->running || scheduler->hidden) {
+		return 0;
+	}
+
+	uint64_t elapsed = now > scheduler->started ? now - scheduler->started : 0;
+	uint64_t position = elapsed / scheduler->interval;
+
+	if (scheduler->loops && position >= (uint64_t)scheduler->frameCount * scheduler->loops) {
+		// Played to the end.
+		frameSchedulerStop(scheduler);
+		return 0;
+	}
+
+	if (position > scheduler->position) {
+		// Frames whose time has passed while the timer was late aren't shown.
+		scheduler->dropped += (uint32_t)(position - scheduler->position - 1);
+		scheduler->shown++;
+		scheduler->position = (uint32_t)position;
+		scheduler->frame = (int32_t)(position % scheduler->frameCount);
+	}
+
+	// (An early timer gets the rest of the current frame.)
+	return nextFrameDelay(scheduler, now);
+}
+
+uint32_t frameSchedulerSetHidden(frameScheduler *scheduler, bool hidden, uint64_t now)
+{
+	if (hidden != scheduler->hidden) {
+		scheduler->hidden = hidden;
+		if (hidden) {
+			scheduler->hiddenAt = now;
+		} else if (now > scheduler->hiddenAt) {
+			// Carry on from the same frame, as though the time hidden didn't happen.
+			scheduler->started += now - scheduler->hiddenAt;
+		}
+	}
+
+	return scheduler->running && !scheduler->hidden ? nextFrameDelay(scheduler, now) : 0;
+}
+
+bool animationStripPrepare(animationStrip *strip, uint32_t animationId, int32_t size, uint32_t frameCount)
+{
+	if (strip->pixels && strip->animationId == animationId && strip->size == size
+		&& strip->frameCount == frameCount) {
+		return false;
+	}
+
+	size_t count = (size_t)size * size * frameCount;
+	if (!strip->pixels || (size_t)strip->size * strip->size * strip->frameCount != count) {
+		free(strip->pixels);
+		strip->pixels = count ? malloc(count * sizeof(uint32_t)) : null;
+	}
+
+	if (!strip->pixels) {
+		strip->animationId = 0;
+		strip->size = 0;
+		strip->frameCount = 0;
+		return false;
+	}
+
+	memset(strip->pixels, 0, count * sizeof(uint32_t));
+	strip->animationId = animationId;
+	strip->size = size;
+	strip->frameCount = frameCount;
+	strip->renders++;
+	return true;
+}
+
+uint32_t *animationStripFrame(const animationStrip *strip, uint32_t frame)
+{
+	return strip->pixels + (size_t)strip->size * strip->size * frame;
+}
+
+void animationStripFree(animationStrip *strip)
+{
+	free(strip->pixels);
+	memset(strip, 0, sizeof(*strip));
+}
+
+void animationCompose(uint32_t *dest, int destStride, const uint32_t *background, int backgroundStride,
+	int width, int height, const uint32_t *frame, int32_t frameSize, const recolorTable *highContrast)
+{
+	if (highContrast) {
+		// Like the atlas's high-contrast cells: the icon on black, then recoloured.
+		fillPixels(dest, destStride, 0, 0, width, height, 0xff000000);
+	} else {
+		copyPixels(dest, destStride, background, backgroundStride, width, height);
+	}
+
+	// Centred, and clipped to the button.
+	int x = (width - frameSize) / 2, y = (height - frameSize) / 2;
+	int srcX = x < 0 ? -x : 0, srcY = y < 0 ? -y : 0;
+	int w = frameSize - srcX * 2, h = frameSize - srcY * 2;
+	if (w > width) {
+		w = width;
+	}
+	if (h > height) {
+		h = height;
+	}
+	if (w > 0 && h > 0) {
+		blendPixels(dest + (size_t)(y + srcY) * destStride + x + srcX, destStride,
+			frame + (size_t)srcY * frameSize + srcX, frameSize, w, h);
+	}
+
+	if (highContrast) {
+		for (int row = 0; row < height; row++) {
+			recolorPixels(highContrast, dest + (size_t)row * destStride, (size_t)width);
+		}
+	}
+}
@@ -0,0 +1,169 @@
+/* Task tray button - platform-neutral core.
+ * Animated icons: what to play, and which frame to show when.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ANIMATION_H
+#define TRAY_BUTTON_ANIMATION_H
+
+#include "common.h"
+#include "host.h"
+#include "recolor.h"
+
+/*
+ * An animation is a list of icon files, shown in turn instead of the button's icon. Its frames are decoded and
+ * rendered once for each size of button; after that, a frame costs a copy of the button's background from the atlas
+ * and a blend of the icon (plus a recolour of the button, in high-contrast mode).
+ *
+ * One timer drives the animation of every button. It fires at the frame boundaries, and stops when the animation ends
+ * or the button is hidden. The frame is picked from the time since the animation started (rather than counted), so a
+ * late timer drops frames instead of slowing the animation down.
+ *
+ * The animation command's data is "<ms per frame>;<loops>;<file>;<file>...", where 0 loops plays it until it's
+ * stopped (by an empty or null animation command).
+ */
+
+/** Most frames in an animation. */
+#define ANIMATION_MAX_FRAMES 32
+/** Shortest time a frame is shown (ms) */
+#define ANIMATION_MIN_INTERVAL 15
+
+/** A parsed animation command. */
+typedef struct {
+	/** Time each frame is shown (ms) */
+	uint32_t interval;
+	/** Number of times it's played (0 for until it's stopped) */
+	uint32_t loops;
+	uint32_t frameCount;
+	/** Where each frame's file name is, in the data */
+	struct {
+		uint32_t offset, length;
+	} frames[ANIMATION_MAX_FRAMES];
+} animationSpec;
+
+/** Which frame is shown, and when the next one is due. */
+typedef struct {
+	uint32_t frameCount, interval, loops;
+	/** When the first frame was shown (moved forward by the time it was hidden) */
+	uint64_t started;
+	/** When it was hidden */
+	uint64_t hiddenAt;
+	bool running, hidden;
+	/** The frame being shown; -1 when not animating (the button's icon is shown) */
+	int32_t frame;
+	/** Frames since the start (the frame number, if every loop was counted) */
+	uint32_t position;
+
+	/** Statistics: timer ticks, frames shown, and frames skipped because the timer was late */
+	uint32_t ticks, shown, dropped;
+} frameScheduler;
+
+/** The frames of an animation, rendered at one size: premultiplied pixels, each frame a square after the last. */
+typedef struct {
+	/** Identifies the animation (0 if unused) */
+	uint32_t animationId;
+	int32_t size;
+	uint32_t frameCount;
+	uint32_t *pixels;
+	/** Statistics: times the frames were rendered */
+	uint32_t renders;
+} animationStrip;
+
+/**
+ * Parses the data of an animation command.
+ * @param data The data (not null-terminated).
+ * @param length Number of code units in data.
+ * @param spec Receives the animation; the file names are in the data.
+ * @return false if it's malformed (or has no frames).
+ */
+bool animationParse(const hostChar *data, size_t length, animationSpec *spec);
+
+/**
+ * Initialises the scheduler, not animating.
+ * @param scheduler The scheduler.
+ */
+void frameSchedulerInit(frameScheduler *scheduler);
+
+/**
+ * Starts an animation, from its first frame.
+ * @param scheduler The scheduler.
+ * @param frameCount Number of frames.
+ * @param interval Time each frame is shown (ms).
+ * @param loops Number of times it's played (0 for until it's stopped).
+ * @param now The current time (ms).
+ * @return The delay until the next frame, or 0 if nothing needs a timer (hidden, or no frames).
+ */
+uint32_t frameSchedulerStart(frameScheduler *scheduler, uint32_t frameCount, uint32_t interval, uint32_t loops,
+	uint64_t now);
+
+/**
+ * Stops the animation; the button's icon is shown again.
+ * @param scheduler The scheduler.
+ */
+void frameSchedulerStop(frameScheduler *scheduler);
+
+/**
+ * The frame timer has fired: moves on to the frame for the current time.
+ * @param scheduler The scheduler.
+ * @param now The current time (ms).
+ * @return The delay until the next frame, or 0 to stop the timer (the animation has ended, or it's hidden).
+ */
+uint32_t frameSchedulerTick(frameScheduler *scheduler, uint64_t now);
+
+/**
+ * Pauses the animation while the button is hidden, and resumes it (on the same frame) when it's shown.
+ * @param scheduler The scheduler.
+ * @param hidden true if the button is hidden.
+ * @param now The current time (ms).
+ * @return The delay until the next frame, or 0 if the timer isn't needed.
+ */
+uint32_t frameSchedulerSetHidden(frameScheduler *scheduler, bool hidden, uint64_t now);
+
+/**
+ * Makes a strip ready for an animation at a size, allocating the frames if it was for something else.
+ * @param strip The strip.
+ * @param animationId Identifies the animation.
+ * @param size Size of the frames.
+ * @param frameCount Number of frames.
+ * @return true if the frames need rendering (they're cleared); false if they're already rendered, or there's no
+ *  memory (pixels is null).
+ */
+bool animationStripPrepare(animationStrip *strip, uint32_t animationId, int32_t size, uint32_t frameCount);
+
+/**
+ * Gets the pixels of a frame.
+ * @param strip The strip.
+ * @param frame The frame number.
+ * @return size * size pixels.
+ */
+uint32_t *animationStripFrame(const animationStrip *strip, uint32_t frame);
+
+/**
+ * Frees the frames.
+ * @param strip The strip.
+ */
+void animationStripFree(animationStrip *strip);
+
+/**
+ * Composes a frame of the button: the frame, centred over the button's background.
+ * @param dest Receives width * height pixels.
+ * @param destStride Width of a destination row, in pixels.
+ * @param background The background (an atlas cell rendered without an icon); ignored in high-contrast mode.
+ * @param backgroundStride Width of a background row, in pixels.
+ * @param width Size of the button.
+ * @param height
+ * @param frame The frame (animationStripFrame).
+ * @param frameSize Size of the frame.
+ * @param highContrast Blend table of the high-contrast colours, or null if high-contrast mode is off.
+ */
+void animationCompose(uint32_t *dest, int destStride, const uint32_t *background, int backgroundStride,
+	int width, int height, const uint32_t *frame, int32_t frameSize, const recolorTable *highContrast);
+
+#endif /* TRAY_BUTTON_ANIMATION_H */
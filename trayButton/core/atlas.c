@@ -0,0 +1,66 @@
+/* Task tray button - platform-neutral core.
+ * Layout and invalidation of the sprite atlas: every frame of the button, rendered once.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "atlas.h"
+#include "visual-key.h"
+
+int atlasCell(uint32_t state, bool highContrast)
+{
+	uint32_t drawn = visualState(state, highContrast);
+	int column = (drawn & STATE_PRESSED) ? 2 : (drawn & STATE_HOVER) ? 1 : 0;
+	int row = (highContrast ? 2 : 0) + ((drawn & STATE_CHECKED) ? 1 : 0);
+	return row * ATLAS_COLUMNS + column;
+}
+
+void atlasCellRect(const spriteAtlas *atlas, int cell, coreRect *rect)
+{
+	rect->left = (cell % ATLAS_COLUMNS) * atlas->key.width;
+	rect->top = (cell / ATLAS_COLUMNS) * atlas->key.height;
+	rect->right = rect->left + atlas->key.width;
+	rect->bottom = rect->top + atlas->key.height;
+}
+
+bool atlasUpdate(spriteAtlas *atlas, const atlasKey *key)
+{
+	if (memcmp(&atlas->key, key, sizeof(*key)) == 0) {
+		return false;
+	}
+
+	bool resized = atlas->key.width != key->width || atlas->key.height != key->height;
+	atlas->key = *key;
+	atlasInvalidate(atlas);
+	return resized;
+}
+
+bool atlasNeedsRender(spriteAtlas *atlas, int cell)
+{
+	if (atlas->valid & (1u << cell)) {
+		atlas->hits++;
+		return false;
+	}
+	return true;
+}
+
+void atlasRendered(spriteAtlas *atlas, int cell)
+{
+	atlas->valid |= 1u << cell;
+	atlas->renders++;
+}
+
+void atlasInvalidate(spriteAtlas *atlas)
+{
+	if (atlas->valid) {
+		atlas->invalidations++;
+	}
+	atlas->valid = 0;
+}
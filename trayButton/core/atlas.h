@@ -0,0 +1,99 @@
+/* Task tray button - platform-neutral core.
+ * Layout and invalidation of the sprite atlas: every frame of the button, rendered once.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ATLAS_H
+#define TRAY_BUTTON_ATLAS_H
+
+#include "common.h"
+
+/*
+ * The atlas is a grid of cells the size of the button. Columns are the interaction (normal, hover, pressed), rows are
+ * checked/unchecked, then high-contrast/normal:
+ *
+ *           normal   hover    pressed
+ *   normal  [0]      [1]      [2]
+ *   checked [3]      [4]      [5]
+ *   hc      [6]      [7]      [8]
+ *   hc+chk  [9]      [10]     [11]
+ *
+ * Cells are rendered when first used, and kept until something they depend on changes.
+ */
+
+#define ATLAS_COLUMNS 3
+#define ATLAS_ROWS 4
+#define ATLAS_CELLS (ATLAS_COLUMNS * ATLAS_ROWS)
+
+/** What the cells depend on. Every field is 32-bit, so it can be compared with memcmp. */
+typedef struct {
+	/** Size of a cell (the button) */
+	int32_t width, height;
+	/** Identifies the icon, and its size */
+	uint32_t iconId;
+	int32_t iconSize;
+	/** Identifies the system colours used by the high-contrast cells */
+	uint32_t colors;
+} atlasKey;
+
+typedef struct {
+	atlasKey key;
+	/** Bit mask of the cells which have been rendered */
+	uint32_t valid;
+	/** Statistics */
+	uint32_t hits, renders, invalidations;
+} spriteAtlas;
+
+/**
+ * Gets the cell for a button state. States that look the same share a cell (see visualState).
+ * @param state The button state (STATE_*).
+ * @param highContrast true if high-contrast mode is on.
+ * @return The cell number.
+ */
+int atlasCell(uint32_t state, bool highContrast);
+
+/**
+ * Gets the position of a cell in the atlas.
+ * @param atlas The atlas.
+ * @param cell The cell number.
+ * @param rect Receives the cell's rectangle.
+ */
+void atlasCellRect(const spriteAtlas *atlas, int cell, coreRect *rect);
+
+/**
+ * Sets what the cells depend on, discarding them all if it's changed.
+ * @param atlas The atlas.
+ * @param key What the cells depend on.
+ * @return true if the size of the atlas has changed, so the surface needs to be re-created.
+ */
+bool atlasUpdate(spriteAtlas *atlas, const atlasKey *key);
+
+/**
+ * Determines if a cell needs to be rendered.
+ * @param atlas The atlas.
+ * @param cell The cell number.
+ * @return true if the cell needs rendering (then call atlasRendered).
+ */
+bool atlasNeedsRender(spriteAtlas *atlas, int cell);
+
+/**
+ * Marks a cell as rendered.
+ * @param atlas The atlas.
+ * @param cell The cell number.
+ */
+void atlasRendered(spriteAtlas *atlas, int cell);
+
+/**
+ * Discards all cells (they'll be rendered again when next used).
+ * @param atlas The atlas.
+ */
+void atlasInvalidate(spriteAtlas *atlas);
+
+#endif /* TRAY_BUTTON_ATLAS_H */
@@ -0,0 +1,73 @@
+/* Task tray button - platform-neutral core.
+ * The few atomic operations needed by the lock-free queues.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ATOMICS_H
+#define TRAY_BUTTON_ATOMICS_H
+
+#include "common.h"
+
+#ifdef _MSC_VER
+# include <intrin.h>
+
+// On x86, volatile accesses are ordered (/volatile:ms); only the compiler needs to be stopped from re-ordering.
+static inline uint32_t atomicLoad(volatile uint32_t *p)
+{
+	uint32_t value = *p;
+	_ReadWriteBarrier();
+	return value;
+}
+
+static inline void atomicStore(volatile uint32_t *p, uint32_t value)
+{
+	_ReadWriteBarrier();
+	*p = value;
+}
+
+static inline uint32_t atomicIncrement(volatile uint32_t *p)
+{
+	return (uint32_t)_InterlockedIncrement((volatile long*)p);
+}
+
+static inline void atomicFence()
+{
+	_ReadWriteBarrier();
+}
+
+#else
+
+/** Loads a value, with acquire semantics. */
+static inline uint32_t atomicLoad(volatile uint32_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/** Stores a value, with release semantics. */
+static inline void atomicStore(volatile uint32_t *p, uint32_t value)
+{
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/** Increments a value. */
+static inline uint32_t atomicIncrement(volatile uint32_t *p)
+{
+	return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST);
+}
+
+/** Stops loads and stores moving either way past this point. */
+static inline void atomicFence()
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+#endif /* TRAY_BUTTON_ATOMICS_H */
@@ -0,0 +1,80 @@
+/* Task tray button - platform-neutral core.
+ * Several commands in one WM_COPYDATA message.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "batch.h"
+
+void batchReaderInit(batchReader *reader, const void *data, size_t size)
+{
+	reader->next = (const uint16_t*)data;
+	reader->end = data ? reader->next + size / sizeof(uint16_t) : null;
+}
+
+int batchNext(batchReader *reader, batchRecord *record)
+{
+	size_t remaining = reader->end - reader->next;
+	if (remaining == 0 || reader->next[0] == 0) {
+		return BATCH_END;
+	}
+	if (remaining < 2) {
+		return BATCH_ERROR;
+	}
+
+	record->command = reader->next[0];
+	uint16_t length = reader->next[1];
+	reader->next += 2;
+
+	if (length == BATCH_NO_DATA) {
+		record->data = null;
+		record->length = 0;
+	} else if (length > (size_t)(reader->end - reader->next)) {
+		// Stop here, so a caller that ignores the error doesn't keep going.
+		reader->next = reader->end;
+		return BATCH_ERROR;
+	} else {
+		record->data = reader->next;
+		record->length = length;
+		reader->next += length;
+	}
+
+	return BATCH_RECORD;
+}
+
+void batchWriterInit(batchWriter *writer, uint16_t *buffer, size_t capacity)
+{
+	writer->buffer = buffer;
+	writer->capacity = capacity;
+	writer->length = 0;
+	writer->overflow = false;
+}
+
+bool batchAdd(batchWriter *writer, uint32_t command, const uint16_t *data, size_t length)
+{
+	if (command == 0 || command > 0xffff || length > BATCH_MAX_LENGTH) {
+		return false;
+	}
+
+	size_t size = 2 + (data ? length : 0);
+	if (writer->capacity - writer->length < size) {
+		writer->overflow = true;
+		return false;
+	}
+
+	uint16_t *p = writer->buffer + writer->length;
+	p[0] = (uint16_t)command;
+	p[1] = data ? (uint16_t)length : BATCH_NO_DATA;
+	if (data) {
+		memcpy(p + 2, data, length * sizeof(uint16_t));
+	}
+	writer->length += size;
+	return true;
+}
@@ -0,0 +1,95 @@
+/* Task tray button - platform-neutral core.
+ * Several commands in one WM_COPYDATA message.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_BATCH_H
+#define TRAY_BUTTON_BATCH_H
+
+#include "common.h"
+
+/*
+ * A batch is a sequence of records, made of UTF-16 code units (so gpii-app can build it as a string):
+ *
+ *   [command][length][data: length code units]
+ *
+ * A length of BATCH_NO_DATA means the command has no data (a null lpData). The batch ends at the end of the buffer, or
+ * at a command of 0 (the string terminator).
+ */
+
+/** Length of a record without data */
+#define BATCH_NO_DATA 0xffff
+/** Longest data in a record (code units) */
+#define BATCH_MAX_LENGTH (BATCH_NO_DATA - 1)
+
+// batchNext results
+#define BATCH_END    0
+#define BATCH_RECORD 1
+#define BATCH_ERROR  (-1)
+
+/** A record in a batch */
+typedef struct {
+	uint32_t command;
+	/** The data (not null-terminated), or null */
+	const uint16_t *data;
+	/** Number of code units in data */
+	uint32_t length;
+} batchRecord;
+
+typedef struct {
+	const uint16_t *next;
+	const uint16_t *end;
+} batchReader;
+
+typedef struct {
+	uint16_t *buffer;
+	/** Capacity of buffer, in code units */
+	size_t capacity;
+	/** Code units written */
+	size_t length;
+	/** true if a record didn't fit */
+	bool overflow;
+} batchWriter;
+
+/**
+ * Starts reading a batch.
+ * @param reader The reader.
+ * @param data The batch.
+ * @param size Size of the batch, in bytes.
+ */
+void batchReaderInit(batchReader *reader, const void *data, size_t size);
+
+/**
+ * Reads the next record of a batch.
+ * @param reader The reader.
+ * @param record Receives the record.
+ * @return BATCH_RECORD if a record was read, BATCH_END at the end, or BATCH_ERROR if the batch is malformed.
+ */
+int batchNext(batchReader *reader, batchRecord *record);
+
+/**
+ * Starts writing a batch.
+ * @param writer The writer.
+ * @param buffer Where the batch is written.
+ * @param capacity Size of buffer, in code units.
+ */
+void batchWriterInit(batchWriter *writer, uint16_t *buffer, size_t capacity);
+
+/**
+ * Adds a record to a batch.
+ * @param writer The writer.
+ * @param command The command (not 0).
+ * @param data The data, or null.
+ * @param length Number of code units in data (at most BATCH_MAX_LENGTH).
+ * @return false if the record didn't fit (or can't be encoded).
+ */
+bool batchAdd(batchWriter *writer, uint32_t command, const uint16_t *data, size_t length);
+
+#endif /* TRAY_BUTTON_BATCH_H */
@@ -0,0 +1,152 @@
+/* Task tray button - platform-neutral core.
+ * A button on each taskbar (with "show taskbar on all displays", there's one on each monitor).
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "button-set.h"
+
+void buttonSetInit(buttonSet *set, const buttonSetHooks *hooks)
+{
+	memset(set, 0, sizeof(*set));
+	set->hooks = *hooks;
+}
+
+/** Removes an entry, keeping the order of the rest. */
+static void removeEntry(buttonSet *set, uint32_t index)
+{
+	set->count--;
+	memmove(&set->entries[index], &set->entries[index + 1], (set->count - index) * sizeof(set->entries[0]));
+}
+
+/** Determines if a taskbar is in the list (as the primary one, or not). */
+static bool hasTaskbar(const windowHandle *taskbars, uint32_t count, windowHandle taskbar, bool primary)
+{
+	for (uint32_t n = 0; n < count; n++) {
+		if (taskbars[n] == taskbar && (n == 0) == primary) {
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t buttonSetSync(buttonSet *set, const windowHandle *taskbars, uint32_t count)
+{
+	uint32_t changes = 0;
+	set->syncs++;
+
+	// Remove the buttons on taskbars which have gone (or stopped being the primary, or became it).
+	for (uint32_t n = 0; n < set->count;) {
+		buttonSetEntry *entry = &set->entries[n];
+		if (hasTaskbar(taskbars, count, entry->taskbar, entry->primary)) {
+			n++;
+		} else {
+			// Out of the set before it's detached, like buttonSetClear.
+			trayButton *button = entry->button;
+			removeEntry(set, n);
+			set->detached++;
+			set->hooks.detach(set->hooks.context, button);
+			changes++;
+		}
+	}
+
+	// Add buttons to the new ones.
+	for (uint32_t n = 0; n < count; n++) {
+		bool primary = n == 0;
+		if (!taskbars[n] || buttonSetFind(set, taskbars[n])) {
+			continue;
+		}
+		if (set->count >= BUTTON_SET_MAX) {
+			set->failed++;
+			continue;
+		}
+
+		trayButton *button = set->hooks.attach(set->hooks.context, taskbars[n], primary);
+		if (!button) {
+			set->failed++;
+			continue;
+		}
+
+		buttonSetEntry *entry = &set->entries[set->count++];
+		entry->taskbar = taskbars[n];
+		entry->primary = primary;
+		entry->button = button;
+		set->attached++;
+		changes++;
+	}
+
+	return changes;
+}
+
+trayButton *buttonSetFind(const buttonSet *set, windowHandle taskbar)
+{
+	for (uint32_t n = 0; n < set->count; n++) {
+		if (set->entries[n].taskbar == taskbar) {
+			return set->entries[n].button;
+		}
+	}
+	return null;
+}
+
+trayButton *buttonSetPrimary(const buttonSet *set)
+{
+	for (uint32_t n = 0; n < set->count; n++) {
+		if (set->entries[n].primary) {
+			return set->entries[n].button;
+		}
+	}
+	return null;
+}
+
+bool buttonSetRemove(buttonSet *set, trayButton *button)
+{
+	for (uint32_t n = 0; n < set->count; n++) {
+		if (set->entries[n].button == button) {
+			removeEntry(set, n);
+			set->detached++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void buttonSetClear(buttonSet *set)
+{
+	// Detaching may cause a button to be removed (when its window is destroyed), so take it out first.
+	while (set->count) {
+		trayButton *button = set->entries[set->count - 1].button;
+		set->count--;
+		set->detached++;
+		set->hooks.detach(set->hooks.context, button);
+	}
+}
+
+uint32_t buttonSetPosition(buttonSet *set, bool force)
+{
+	uint32_t changed = 0;
+	for (uint32_t n = 0; n < set->count; n++) {
+		changed += buttonPosition(set->entries[n].button, force);
+	}
+	return changed;
+}
+
+void buttonSetShellMessage(buttonSet *set)
+{
+	for (uint32_t n = 0; n < set->count; n++) {
+		buttonShellMessage(set->entries[n].button);
+	}
+}
+
+void buttonSetSettingChange(buttonSet *set)
+{
+	for (uint32_t n = 0; n < set->count; n++) {
+		buttonSettingChange(set->entries[n].button);
+	}
+}
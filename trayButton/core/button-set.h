@@ -0,0 +1,123 @@
+/* Task tray button - platform-neutral core.
+ * A button on each taskbar (with "show taskbar on all displays", there's one on each monitor).
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_BUTTON_SET_H
+#define TRAY_BUTTON_BUTTON_SET_H
+
+#include "common.h"
+#include "button.h"
+#include "window-cache.h"
+
+/** Most taskbars */
+#define BUTTON_SET_MAX 16
+
+/** How the buttons are created and destroyed. */
+typedef struct {
+	/**
+	 * Creates a button on a taskbar.
+	 * @param context The context.
+	 * @param taskbar The taskbar window.
+	 * @param primary true for the main taskbar (the one with the notification icons).
+	 * @return The button, or null if it can't be created yet (it's tried again on the next sync).
+	 */
+	trayButton *(*attach)(void *context, windowHandle taskbar, bool primary);
+	/**
+	 * Destroys a button.
+	 * @param context The context.
+	 * @param button The button.
+	 */
+	void (*detach)(void *context, trayButton *button);
+	void *context;
+} buttonSetHooks;
+
+typedef struct {
+	windowHandle taskbar;
+	bool primary;
+	trayButton *button;
+} buttonSetEntry;
+
+/** The buttons, one for each taskbar. */
+typedef struct {
+	buttonSetHooks hooks;
+	buttonSetEntry entries[BUTTON_SET_MAX];
+	uint32_t count;
+	/** Statistics */
+	uint32_t syncs, attached, detached, failed;
+} buttonSet;
+
+/**
+ * Initialises the set, with no buttons.
+ * @param set The set.
+ * @param hooks How the buttons are created and destroyed.
+ */
+void buttonSetInit(buttonSet *set, const buttonSetHooks *hooks);
+
+/**
+ * Makes the buttons match the taskbars: a button is created for each new taskbar, and destroyed for each one which has
+ * gone. The order of the others is kept.
+ * @param set The set.
+ * @param taskbars The taskbars. The first is the primary one (null if there isn't one).
+ * @param count Number of taskbars.
+ * @return Number of buttons created or destroyed.
+ */
+uint32_t buttonSetSync(buttonSet *set, const windowHandle *taskbars, uint32_t count);
+
+/**
+ * Gets the button on a taskbar.
+ * @param set The set.
+ * @param taskbar The taskbar.
+ * @return The button, or null if it hasn't got one.
+ */
+trayButton *buttonSetFind(const buttonSet *set, windowHandle taskbar);
+
+/**
+ * Gets the button on the primary taskbar.
+ * @param set The set.
+ * @return The button, or null if it hasn't got one.
+ */
+trayButton *buttonSetPrimary(const buttonSet *set);
+
+/**
+ * Removes a button which has already been destroyed (its window has gone), without detaching it.
+ * @param set The set.
+ * @param button The button.
+ * @return false if it's not in the set.
+ */
+bool buttonSetRemove(buttonSet *set, trayButton *button);
+
+/**
+ * Destroys all the buttons.
+ * @param set The set.
+ */
+void buttonSetClear(buttonSet *set);
+
+/**
+ * Positions every button (see buttonPosition).
+ * @param set The set.
+ * @param force true to always resize, even if not required.
+ * @return Number of buttons which needed a resize.
+ */
+uint32_t buttonSetPosition(buttonSet *set, bool force);
+
+/**
+ * Passes a shell hook message to every button; the shell changes all the taskbars.
+ * @param set The set.
+ */
+void buttonSetShellMessage(buttonSet *set);
+
+/**
+ * Passes a setting change to every button.
+ * @param set The set.
+ */
+void buttonSetSettingChange(buttonSet *set);
+
+#endif /* TRAY_BUTTON_BUTTON_SET_H */
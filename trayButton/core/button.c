@@ -0,0 +1,143 @@
+/* Task tray button - platform-neutral core.
+ * The button's logic: keeping it positioned in the taskbar, and deciding when to check.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "button.h"
+
+void buttonInit(trayButton *button, buttonPlatform *platform, int32_t buttonWidth,
+	uint32_t resizeDelay, uint32_t minCheckDelay, uint32_t maxCheckDelay)
+{
+	memset(button, 0, sizeof(*button));
+	button->platform = platform;
+	button->buttonWidth = buttonWidth;
+	schedulerInit(&button->scheduler, resizeDelay, minCheckDelay, maxCheckDelay);
+}
+
+bool buttonPosition(trayButton *button, bool force)
+{
+	buttonPlatform *platform = button->platform;
+
+	if (!button->hasIcon) {
+		return false;
+	}
+
+	// Current DPI
+	uint32_t dpi = platform->getDpi(platform);
+	if (dpi != button->dpi) {
+		button->dpi = dpi;
+		// This comes back here.
+		platform->reloadIcon(platform);
+		return true;
+	}
+
+	// Get the dimensions of the windows.
+	layoutInput input = { 0 };
+	if (!platform->getTaskbar(platform, &input)) {
+		return false;
+	}
+	input.dpi = button->dpi;
+	input.buttonWidth = button->buttonWidth;
+	input.highContrast = button->highContrast;
+	button->positions++;
+
+	// Work out where everything should be, and what needs to be done to get it there.
+	layoutResult result;
+	layoutCompute(&input, &result);
+	uint32_t ops = layoutDiff(&button->layout, &input, &result, force);
+
+	if (ops & LAYOUT_RESIZE_TASKS) {
+		// shrink the task list
+		platform->resizeTasks(platform, rectWidth(result.tasksRect), rectHeight(result.tasksRect));
+	}
+
+	if (ops & LAYOUT_MOVE_BUTTON) {
+		// Move the button between the tasks and notification area
+		platform->moveButton(platform, &result.buttonRect);
+	}
+
+	bool changed = (ops & (LAYOUT_RESIZE_TASKS | LAYOUT_MOVE_BUTTON)) != 0;
+	if (changed) {
+		// The surroundings have changed, even if the button hasn't.
+		platform->redraw(platform, true);
+	}
+
+	if (force || changed) {
+		// Things are moving - keep an eye on them.
+		platform->startTimer(platform, TIMER_RESIZE, button->scheduler.resizeDelay);
+		platform->startTimer(platform, TIMER_CHECK, schedulerActivity(&button->scheduler, platform->now(platform)));
+	}
+
+	if (ops & LAYOUT_NOTIFY_POSITION) {
+		// Inform gpii about the new position.
+		platform->notifyPosition(platform, &result.buttonScreenRect);
+	}
+
+	return changed;
+}
+
+void buttonHidden(trayButton *button)
+{
+	memset(&button->layout, 0, sizeof(button->layout));
+}
+
+void buttonTimer(trayButton *button, uint32_t id)
+{
+	buttonPlatform *platform = button->platform;
+
+	switch (id) {
+	case TIMER_CHECK:
+		// If nothing has changed, check less often. (buttonPosition restarts the timer if something has)
+		if (!buttonPosition(button, false)) {
+			platform->startTimer(platform, TIMER_CHECK, schedulerCheck(&button->scheduler, platform->now(platform)));
+		}
+		break;
+
+	case TIMER_RESIZE:
+		if (!schedulerResize(&button->scheduler, buttonPosition(button, false))) {
+			platform->stopTimer(platform, TIMER_RESIZE);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void buttonShellMessage(trayButton *button)
+{
+	buttonPlatform *platform = button->platform;
+	button->shellMessages++;
+
+	// The taskbar reacts to shell messages, so there's a good chance something will need to be redrawn.
+	if (!buttonPosition(button, false)) {
+		platform->redraw(platform, false);
+		// Check again soon, in case the shell is slow to react.
+		platform->startTimer(platform, TIMER_CHECK, schedulerActivity(&button->scheduler, platform->now(platform)));
+	}
+}
+
+bool buttonCheckHighContrast(trayButton *button)
+{
+	bool last = button->highContrast;
+	button->highContrast = button->platform->isHighContrast(button->platform);
+	return button->highContrast != last;
+}
+
+void buttonSettingChange(trayButton *button)
+{
+	if (buttonCheckHighContrast(button)) {
+		// If high-contrast has changed, the icon will need to be reloaded (which also re-positions).
+		button->platform->reloadIcon(button->platform);
+	} else {
+		buttonPosition(button, true);
+	}
+}
@@ -0,0 +1,128 @@
+/* Task tray button - platform-neutral core.
+ * The button's logic: keeping it positioned in the taskbar, and deciding when to check.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_BUTTON_H
+#define TRAY_BUTTON_BUTTON_H
+
+#include "common.h"
+#include "layout.h"
+#include "scheduler.h"
+
+// The button's timers
+#define TIMER_RESIZE 1
+#define TIMER_CHECK 2
+
+typedef struct buttonPlatform buttonPlatform;
+
+/**
+ * What the button logic needs from the system. On Windows these are the Win32 calls in tray-button.c; the tests use a
+ * simulated taskbar.
+ */
+struct buttonPlatform {
+	/**
+	 * Gets the geometry of the taskbar: the trayRect, trayClient, tasksRect, notifyRect and screenHeight fields.
+	 * @return false if there's no taskbar.
+	 */
+	bool (*getTaskbar)(buttonPlatform *platform, layoutInput *input);
+	/** Gets the DPI of the taskbar. */
+	uint32_t (*getDpi)(buttonPlatform *platform);
+	/** Determines if high-contrast mode is on. */
+	bool (*isHighContrast)(buttonPlatform *platform);
+	/** Resizes the task list (without moving it). */
+	void (*resizeTasks)(buttonPlatform *platform, int32_t width, int32_t height);
+	/** Moves and shows the button (taskbar client coordinates). */
+	void (*moveButton)(buttonPlatform *platform, const coreRect *rect);
+	/** Redraws the button; if force is false, only if it looks different. */
+	void (*redraw)(buttonPlatform *platform, bool force);
+	/** Tells gpii where the button is (screen coordinates). */
+	void (*notifyPosition)(buttonPlatform *platform, const coreRect *rect);
+	/** Reloads the icon, for a new DPI or high-contrast mode. Re-positions the button. */
+	void (*reloadIcon)(buttonPlatform *platform);
+	/** Starts (or restarts) a timer. */
+	void (*startTimer)(buttonPlatform *platform, uint32_t id, uint32_t delay);
+	/** Stops a timer. */
+	void (*stopTimer)(buttonPlatform *platform, uint32_t id);
+	/** Gets the current time (ms). */
+	uint64_t (*now)(buttonPlatform *platform);
+};
+
+/** The state of a button. */
+typedef struct {
+	buttonPlatform *platform;
+	/** What was done to the taskbar last time */
+	layoutState layout;
+	/** Decides when the timers fire */
+	pollScheduler scheduler;
+	/** Width of the button, at 96 DPI */
+	int32_t buttonWidth;
+	/** The current DPI (0 if unknown) */
+	uint32_t dpi;
+	bool highContrast;
+	/** The button is only shown when there's an icon */
+	bool hasIcon;
+	/** Statistics */
+	uint32_t positions, shellMessages;
+} trayButton;
+
+/**
+ * Initialises a button.
+ * @param button The button.
+ * @param platform The platform.
+ * @param buttonWidth Width of the button, at 96 DPI.
+ * @param resizeDelay Delay of the resize timer (ms).
+ * @param minCheckDelay Delay of the first check after activity (ms).
+ * @param maxCheckDelay Longest delay between checks (ms).
+ */
+void buttonInit(trayButton *button, buttonPlatform *platform, int32_t buttonWidth,
+	uint32_t resizeDelay, uint32_t minCheckDelay, uint32_t maxCheckDelay);
+
+/**
+ * Moves the button in between the task list and notification icons, by shrinking the task list.
+ * @param button The button.
+ * @param force true to always resize, even if not required.
+ * @return true if a resize was required.
+ */
+bool buttonPosition(trayButton *button, bool force);
+
+/**
+ * The button has been hidden; it will need putting back when it's shown again.
+ * @param button The button.
+ */
+void buttonHidden(trayButton *button);
+
+/**
+ * A timer has fired.
+ * @param button The button.
+ * @param id The timer (TIMER_*).
+ */
+void buttonTimer(trayButton *button, uint32_t id);
+
+/**
+ * A shell hook message has been received. The taskbar reacts to these, so it's likely to change.
+ * @param button The button.
+ */
+void buttonShellMessage(trayButton *button);
+
+/**
+ * A system setting has changed; high-contrast mode may have been toggled.
+ * @param button The button.
+ */
+void buttonSettingChange(trayButton *button);
+
+/**
+ * Checks the high-contrast mode.
+ * @param button The button.
+ * @return true if it has changed.
+ */
+bool buttonCheckHighContrast(trayButton *button);
+
+#endif /* TRAY_BUTTON_BUTTON_H */
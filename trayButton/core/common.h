@@ -0,0 +1,69 @@
+/* Task tray button - platform-neutral core.
+ * Common definitions shared by the portable parts of the button.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_COMMON_H
+#define TRAY_BUTTON_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef null
+# define null NULL
+#endif
+
+#if defined(_MSC_VER) && !defined(__cplusplus)
+# define inline __inline
+#endif
+
+/** A rectangle, with the same layout as the Win32 RECT. */
+typedef struct {
+	int32_t left, top, right, bottom;
+} coreRect;
+
+#define rectWidth(R) ((R).right - (R).left)
+#define rectHeight(R) ((R).bottom - (R).top)
+
+static inline bool rectEquals(const coreRect *a, const coreRect *b)
+{
+	return a->left == b->left && a->top == b->top && a->right == b->right && a->bottom == b->bottom;
+}
+
+/**
+ * Convert a value based on 96dpi to the given dpi (like MulDiv, rounding to the nearest).
+ * @param value The value at 96dpi.
+ * @param dpi The dpi.
+ * @return The scaled value.
+ */
+static inline int32_t scaleDpi(int32_t value, uint32_t dpi)
+{
+	int64_t n = (int64_t)value * dpi;
+	return (int32_t)(n >= 0 ? (n + 48) / 96 : (n - 48) / 96);
+}
+
+/**
+ * FNV-1a hash of a block of memory.
+ * @param data The data.
+ * @param size Number of bytes.
+ * @return The hash.
+ */
+static inline uint32_t hashBytes(const void *data, size_t size)
+{
+	const uint8_t *p = (const uint8_t*)data;
+	uint32_t hash = 2166136261u;
+	for (size_t n = 0; n < size; n++) {
+		hash = (hash ^ p[n]) * 16777619u;
+	}
+	return hash;
+}
+
+#endif /* TRAY_BUTTON_COMMON_H */
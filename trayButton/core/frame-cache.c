@@ -0,0 +1,237 @@
+/* Task tray button - platform-neutral core.
+ * A file of rendered frames, kept between runs so the first paint doesn't need to decode or recolour the icon.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "frame-cache.h"
+
+static const uint8_t magic[4] = { 'T', 'B', 'F', 'C' };
+
+/** Number of 32-bit fields in the key */
+#define KEY_FIELDS (sizeof(frameCacheKey) / sizeof(uint32_t))
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool isLittleEndian()
+{
+	uint32_t n = 1;
+	return *(uint8_t*)&n == 1;
+}
+
+static void getKey(const uint8_t *entry, frameCacheKey *key)
+{
+	uint32_t *fields = (uint32_t*)key;
+	for (size_t n = 0; n < KEY_FIELDS; n++) {
+		fields[n] = get32(entry + n * 4);
+	}
+}
+
+static size_t frameBytes(const frameCacheKey *key)
+{
+	return (size_t)key->width * key->height * sizeof(uint32_t);
+}
+
+bool frameCacheOpen(frameCache *cache, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	memset(cache, 0, sizeof(*cache));
+
+	if (!p || size < FRAME_CACHE_HEADER_SIZE || ((uintptr_t)p & 3) || !isLittleEndian()
+		|| memcmp(p, magic, sizeof(magic)) || get32(p + 4) != FRAME_CACHE_VERSION || get32(p + 12) != size) {
+		return false;
+	}
+
+	uint32_t count = get32(p + 8);
+	size_t directory = (size_t)count * FRAME_CACHE_ENTRY_SIZE;
+	if (count > FRAME_CACHE_MAX_ENTRIES || directory > size - FRAME_CACHE_HEADER_SIZE
+		|| get32(p + 16) != hashBytes(p + FRAME_CACHE_HEADER_SIZE, directory)) {
+		return false;
+	}
+
+	// Check every frame is within the file, so they can be used without checking.
+	for (uint32_t n = 0; n < count; n++) {
+		const uint8_t *entry = p + FRAME_CACHE_HEADER_SIZE + n * FRAME_CACHE_ENTRY_SIZE;
+		frameCacheKey key;
+		getKey(entry, &key);
+		size_t offset = get32(entry + KEY_FIELDS * 4);
+		if (key.width <= 0 || key.height <= 0 || key.width > FRAME_CACHE_MAX_SIZE
+			|| key.height > FRAME_CACHE_MAX_SIZE || (offset & 15) || offset > size || frameBytes(&key) > size - offset) {
+			return false;
+		}
+	}
+
+	cache->data = p;
+	cache->size = size;
+	cache->count = count;
+	return true;
+}
+
+void frameCacheClose(frameCache *cache)
+{
+	cache->data = null;
+	cache->size = 0;
+	cache->count = 0;
+}
+
+const uint32_t *frameCacheFind(frameCache *cache, const frameCacheKey *key)
+{
+	for (uint32_t n = 0; n < cache->count; n++) {
+		const uint8_t *entry = cache->data + FRAME_CACHE_HEADER_SIZE + n * FRAME_CACHE_ENTRY_SIZE;
+		frameCacheKey found;
+		getKey(entry, &found);
+		if (!memcmp(&found, key, sizeof(found))) {
+			cache->hits++;
+			return (const uint32_t*)(cache->data + get32(entry + KEY_FIELDS * 4));
+		}
+	}
+
+	cache->misses++;
+	return null;
+}
+
+bool frameCacheHasIcon(const frameCache *cache, uint32_t pathHash, uint32_t sourceHash, uint32_t dpi)
+{
+	for (uint32_t n = 0; n < cache->count; n++) {
+		frameCacheKey key;
+		getKey(cache->data + FRAME_CACHE_HEADER_SIZE + n * FRAME_CACHE_ENTRY_SIZE, &key);
+		if (key.pathHash == pathHash && key.sourceHash == sourceHash && key.dpi == dpi) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void frameCacheWriterInit(frameCacheWriter *writer)
+{
+	memset(writer, 0, sizeof(*writer));
+}
+
+/** Removes an item, keeping the order of the rest. */
+static void removeItem(frameCacheWriter *writer, uint32_t index)
+{
+	frameCacheItem *item = &writer->items[index];
+	if (item->owned) {
+		free((void*)item->pixels);
+	}
+	memmove(item, item + 1, (writer->count - index - 1) * sizeof(*item));
+	writer->count--;
+}
+
+void frameCacheWriterKeep(frameCacheWriter *writer, const frameCache *cache)
+{
+	for (uint32_t n = 0; n < cache->count && writer->count < FRAME_CACHE_MAX_ENTRIES; n++) {
+		const uint8_t *entry = cache->data + FRAME_CACHE_HEADER_SIZE + n * FRAME_CACHE_ENTRY_SIZE;
+		frameCacheItem *item = &writer->items[writer->count++];
+		getKey(entry, &item->key);
+		item->pixels = (const uint32_t*)(cache->data + get32(entry + KEY_FIELDS * 4));
+		item->owned = false;
+	}
+}
+
+bool frameCacheWriterAdd(frameCacheWriter *writer, const frameCacheKey *key, const uint32_t *pixels, int stride)
+{
+	if (key->width <= 0 || key->height <= 0 || key->width > FRAME_CACHE_MAX_SIZE || key->height > FRAME_CACHE_MAX_SIZE) {
+		return false;
+	}
+
+	uint32_t *copy = malloc(frameBytes(key));
+	if (!copy) {
+		return false;
+	}
+	for (int32_t row = 0; row < key->height; row++) {
+		memcpy(copy + (size_t)row * key->width, pixels + (size_t)row * stride, key->width * sizeof(uint32_t));
+	}
+
+	// Remove the frame it replaces, and those of an older version of the icon file.
+	for (uint32_t n = writer->count; n-- > 0;) {
+		const frameCacheKey *k = &writer->items[n].key;
+		if (!memcmp(k, key, sizeof(*k))) {
+			removeItem(writer, n);
+		} else if (k->pathHash == key->pathHash && k->sourceHash != key->sourceHash) {
+			removeItem(writer, n);
+			writer->stale++;
+		}
+	}
+
+	if (writer->count == FRAME_CACHE_MAX_ENTRIES) {
+		removeItem(writer, 0);
+		writer->evicted++;
+	}
+
+	frameCacheItem *item = &writer->items[writer->count++];
+	item->key = *key;
+	item->pixels = copy;
+	item->owned = true;
+	return true;
+}
+
+uint8_t *frameCacheWriterFinish(const frameCacheWriter *writer, size_t *size)
+{
+	// The most recent frames first, so they're found sooner.
+	size_t total = FRAME_CACHE_HEADER_SIZE + (size_t)writer->count * FRAME_CACHE_ENTRY_SIZE;
+	for (uint32_t n = 0; n < writer->count; n++) {
+		total = ((total + 15) & ~(size_t)15) + frameBytes(&writer->items[n].key);
+	}
+
+	uint8_t *data = calloc(1, total);
+	if (!data) {
+		return null;
+	}
+
+	size_t offset = FRAME_CACHE_HEADER_SIZE + (size_t)writer->count * FRAME_CACHE_ENTRY_SIZE;
+	for (uint32_t n = 0; n < writer->count; n++) {
+		const frameCacheItem *item = &writer->items[writer->count - n - 1];
+		uint8_t *entry = data + FRAME_CACHE_HEADER_SIZE + n * FRAME_CACHE_ENTRY_SIZE;
+		const uint32_t *fields = (const uint32_t*)&item->key;
+		for (size_t f = 0; f < KEY_FIELDS; f++) {
+			put32(entry + f * 4, fields[f]);
+		}
+
+		offset = (offset + 15) & ~(size_t)15;
+		put32(entry + KEY_FIELDS * 4, (uint32_t)offset);
+		size_t count = (size_t)item->key.width * item->key.height;
+		for (size_t p = 0; p < count; p++) {
+			put32(data + offset + p * 4, item->pixels[p]);
+		}
+		offset += count * 4;
+	}
+
+	memcpy(data, magic, sizeof(magic));
+	put32(data + 4, FRAME_CACHE_VERSION);
+	put32(data + 8, writer->count);
+	put32(data + 12, (uint32_t)total);
+	put32(data + 16, hashBytes(data + FRAME_CACHE_HEADER_SIZE, (size_t)writer->count * FRAME_CACHE_ENTRY_SIZE));
+
+	*size = total;
+	return data;
+}
+
+void frameCacheWriterFree(frameCacheWriter *writer)
+{
+	for (uint32_t n = 0; n < writer->count; n++) {
+		if (writer->items[n].owned) {
+			free((void*)writer->items[n].pixels);
+		}
+	}
+	writer->count = 0;
+}
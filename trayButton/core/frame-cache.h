@@ -0,0 +1,169 @@
+/* Task tray button - platform-neutral core.
+ * A file of rendered frames, kept between runs so the first paint doesn't need to decode or recolour the icon.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_FRAME_CACHE_H
+#define TRAY_BUTTON_FRAME_CACHE_H
+
+#include "common.h"
+
+/*
+ * The file is memory-mapped, and the frames are copied straight out of it into the atlas. It's little-endian:
+ *
+ *   Header (FRAME_CACHE_HEADER_SIZE bytes)
+ *     uint8  magic[4]    "TBFC"
+ *     uint32 version     FRAME_CACHE_VERSION
+ *     uint32 count       Number of entries
+ *     uint32 size        Size of the file
+ *     uint32 checksum    hashBytes of the entries
+ *     uint32 reserved[3] 0
+ *
+ *   Entries (count * FRAME_CACHE_ENTRY_SIZE bytes)
+ *     uint32 pathHash, sourceHash, dpi, colors, state, width, height   The key (frameCacheKey)
+ *     uint32 offset      Where the frame's pixels are, from the start of the file (16-byte aligned)
+ *
+ *   Pixels
+ *     width * height 32-bit premultiplied BGRA pixels for each entry, top-down (like the atlas).
+ *
+ * A file from a different version, or that's been cut short, is ignored (and replaced when the cache is next saved).
+ * The pixels are used in place, so the file is also ignored by a big-endian machine.
+ */
+
+#define FRAME_CACHE_VERSION 1
+#define FRAME_CACHE_HEADER_SIZE 32
+#define FRAME_CACHE_ENTRY_SIZE 32
+
+/** Most frames in the file. There are 12 cells for each size of button (see atlas.h). */
+#define FRAME_CACHE_MAX_ENTRIES 64
+/** Largest frame (pixels, either way). */
+#define FRAME_CACHE_MAX_SIZE 512
+
+/** Identifies a frame. Every field is 32-bit, so it can be compared with memcmp. */
+typedef struct {
+	/** Identifies the icon file (a hash of its path) */
+	uint32_t pathHash;
+	/**
+	 * Identifies the version of the icon file. The platform hashes the file's size and modification time, so the
+	 * file doesn't need to be read to find its frames. Frames of an older version are stale.
+	 */
+	uint32_t sourceHash;
+	uint32_t dpi;
+	/** Identifies the high-contrast colours (0 when not in high-contrast; see atlasKey.colors) */
+	uint32_t colors;
+	/** The state bits which are drawn (see visualState), plus FRAME_CACHE_HIGH_CONTRAST */
+	uint32_t state;
+	/** Size of the frame (the button) */
+	int32_t width, height;
+} frameCacheKey;
+
+/** Set in frameCacheKey.state for the high-contrast frames. */
+#define FRAME_CACHE_HIGH_CONTRAST 0x100
+
+/** A file of frames, opened for reading. */
+typedef struct {
+	/** The file contents (mapped by the platform); null if there's no usable file */
+	const uint8_t *data;
+	size_t size;
+	uint32_t count;
+	/** Statistics */
+	uint32_t hits, misses;
+} frameCache;
+
+/** A frame to be written to the file. */
+typedef struct {
+	frameCacheKey key;
+	/** The pixels: either the writer's own copy, or in the file being replaced */
+	const uint32_t *pixels;
+	bool owned;
+} frameCacheItem;
+
+/** Collects the frames for the next version of the file. The oldest are first. */
+typedef struct {
+	frameCacheItem items[FRAME_CACHE_MAX_ENTRIES];
+	uint32_t count;
+	/** Statistics: frames removed because their icon file changed, or because there were too many */
+	uint32_t stale, evicted;
+} frameCacheWriter;
+
+/**
+ * Opens a frame file.
+ * @param cache The cache.
+ * @param data The file contents, which must stay readable (and 4-byte aligned) until the cache is closed.
+ * @param size Size of the data.
+ * @return false if the file isn't usable (the cache is then empty).
+ */
+bool frameCacheOpen(frameCache *cache, const void *data, size_t size);
+
+/**
+ * Forgets the file, so its contents can be unmapped. Frames found in it can no longer be used.
+ * @param cache The cache.
+ */
+void frameCacheClose(frameCache *cache);
+
+/**
+ * Finds a frame.
+ * @param cache The cache.
+ * @param key The frame.
+ * @return The frame's key->width * key->height pixels, in the file; or null if it's not there.
+ */
+const uint32_t *frameCacheFind(frameCache *cache, const frameCacheKey *key);
+
+/**
+ * Determines if there are any frames of an icon at a DPI, so decoding the icon can wait until a frame that isn't there
+ * is needed.
+ * @param cache The cache.
+ * @param pathHash Identifies the icon file.
+ * @param sourceHash Identifies the version of the icon file.
+ * @param dpi The DPI.
+ * @return true if there are frames.
+ */
+bool frameCacheHasIcon(const frameCache *cache, uint32_t pathHash, uint32_t sourceHash, uint32_t dpi);
+
+/**
+ * Initialises a writer.
+ * @param writer The writer.
+ */
+void frameCacheWriterInit(frameCacheWriter *writer);
+
+/**
+ * Keeps the frames of an opened file, for the next version. They're referenced, not copied, so the file needs to stay
+ * mapped until frameCacheWriterFinish. Call before adding the new frames, so they're treated as older.
+ * @param writer The writer.
+ * @param cache The opened file.
+ */
+void frameCacheWriterKeep(frameCacheWriter *writer, const frameCache *cache);
+
+/**
+ * Adds a frame, replacing one with the same key. Frames from another version of the same icon file are removed, and
+ * the oldest frame is removed if there are too many.
+ * @param writer The writer.
+ * @param key The frame.
+ * @param pixels The frame's pixels (copied).
+ * @param stride Width of a row of the pixels.
+ * @return false if there's no memory, or the frame is too big.
+ */
+bool frameCacheWriterAdd(frameCacheWriter *writer, const frameCacheKey *key, const uint32_t *pixels, int stride);
+
+/**
+ * Makes the new version of the file.
+ * @param writer The writer.
+ * @param size Receives the size of the file.
+ * @return The file contents (free with free), or null if there's no memory.
+ */
+uint8_t *frameCacheWriterFinish(const frameCacheWriter *writer, size_t *size);
+
+/**
+ * Frees the frames held by a writer, and empties it.
+ * @param writer The writer.
+ */
+void frameCacheWriterFree(frameCacheWriter *writer);
+
+#endif /* TRAY_BUTTON_FRAME_CACHE_H */
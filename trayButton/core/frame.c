@@ -0,0 +1,170 @@
+/* Task tray button - platform-neutral core.
+ * Framing of the messages between the button and gpii, over a pipe.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "frame.h"
+
+static void put16(uint8_t *p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	put16(p, value);
+	put16(p + 2, value >> 16);
+}
+
+static uint32_t get16(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return get16(p) | (get16(p + 2) << 16);
+}
+
+size_t frameEncode(uint8_t *buffer, size_t capacity, uint32_t type, uint32_t sequence, uint64_t timestamp,
+	const void *payload, size_t payloadLength)
+{
+	size_t length = FRAME_HEADER_SIZE + payloadLength;
+	if (payloadLength > FRAME_MAX_PAYLOAD || length > capacity || type == 0 || type > 0xffff) {
+		return 0;
+	}
+
+	put32(buffer, (uint32_t)length);
+	put16(buffer + 4, type);
+	put16(buffer + 6, 0);
+	put32(buffer + 8, sequence);
+	put32(buffer + 12, (uint32_t)timestamp);
+	put32(buffer + 16, (uint32_t)(timestamp >> 32));
+	if (payloadLength) {
+		memcpy(buffer + FRAME_HEADER_SIZE, payload, payloadLength);
+	}
+	return length;
+}
+
+size_t frameEncodeNotify(uint8_t *buffer, size_t capacity, uint32_t sequence, uint64_t timestamp,
+	uint32_t notification, uint32_t event)
+{
+	uint8_t payload[8];
+	put32(payload, notification);
+	put32(payload + 4, event);
+	return frameEncode(buffer, capacity, FRAME_NOTIFY, sequence, timestamp, payload, sizeof(payload));
+}
+
+size_t frameEncodePosition(uint8_t *buffer, size_t capacity, uint32_t sequence, uint64_t timestamp,
+	const coreRect *rect)
+{
+	uint8_t payload[16];
+	put32(payload, (uint32_t)rect->left);
+	put32(payload + 4, (uint32_t)rect->top);
+	put32(payload + 8, (uint32_t)rectWidth(*rect));
+	put32(payload + 12, (uint32_t)rectHeight(*rect));
+	return frameEncode(buffer, capacity, FRAME_POSITION, sequence, timestamp, payload, sizeof(payload));
+}
+
+bool frameDecodeNotify(const frame *f, uint32_t *notification, uint32_t *event)
+{
+	if (f->type != FRAME_NOTIFY || (f->payloadLength != 4 && f->payloadLength != 8)) {
+		return false;
+	}
+	*notification = get32(f->payload);
+	*event = f->payloadLength == 8 ? get32(f->payload + 4) : 0;
+	return true;
+}
+
+bool frameDecodePosition(const frame *f, coreRect *rect)
+{
+	if (f->type != FRAME_POSITION || f->payloadLength != 16) {
+		return false;
+	}
+	rect->left = (int32_t)get32(f->payload);
+	rect->top = (int32_t)get32(f->payload + 4);
+	rect->right = (int32_t)((uint32_t)rect->left + get32(f->payload + 8));
+	rect->bottom = (int32_t)((uint32_t)rect->top + get32(f->payload + 12));
+	return true;
+}
+
+void frameReaderInit(frameReader *reader)
+{
+	reader->length = 0;
+	reader->consumed = 0;
+	reader->nextSequence = 0;
+	reader->frames = 0;
+	reader->missed = 0;
+	reader->failed = false;
+}
+
+/** Discards the last frame that was read. */
+static void compact(frameReader *reader)
+{
+	if (reader->consumed) {
+		reader->length -= reader->consumed;
+		memmove(reader->buffer, reader->buffer + reader->consumed, reader->length);
+		reader->consumed = 0;
+	}
+}
+
+size_t frameReaderAppend(frameReader *reader, const void *data, size_t length)
+{
+	compact(reader);
+	size_t room = sizeof(reader->buffer) - reader->length;
+	if (length > room) {
+		length = room;
+	}
+	memcpy(reader->buffer + reader->length, data, length);
+	reader->length += (uint32_t)length;
+	return length;
+}
+
+int frameReaderNext(frameReader *reader, frame *f)
+{
+	if (reader->failed) {
+		return FRAME_ERROR;
+	}
+
+	compact(reader);
+	if (reader->length < FRAME_HEADER_SIZE) {
+		return FRAME_NONE;
+	}
+
+	const uint8_t *p = reader->buffer;
+	uint32_t length = get32(p);
+	if (length < FRAME_HEADER_SIZE || length > FRAME_MAX_SIZE || get16(p + 4) == 0) {
+		// Nothing after this can be trusted.
+		reader->failed = true;
+		return FRAME_ERROR;
+	}
+
+	if (reader->length < length) {
+		return FRAME_NONE;
+	}
+
+	f->type = get16(p + 4);
+	f->sequence = get32(p + 8);
+	f->timestamp = (uint64_t)get32(p + 12) | ((uint64_t)get32(p + 16) << 32);
+	f->payload = p + FRAME_HEADER_SIZE;
+	f->payloadLength = length - FRAME_HEADER_SIZE;
+
+	// Count the gap, unless it's gone backwards (a repeat).
+	int32_t gap = (int32_t)(f->sequence - reader->nextSequence);
+	if (reader->frames && gap > 0) {
+		reader->missed += (uint32_t)gap;
+	}
+	reader->nextSequence = f->sequence + 1;
+	reader->frames++;
+	reader->consumed = length;
+	return FRAME_READ;
+}
@@ -0,0 +1,142 @@
+/* Task tray button - platform-neutral core.
+ * Framing of the messages between the button and gpii, over a pipe.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_FRAME_H
+#define TRAY_BUTTON_FRAME_H
+
+#include "common.h"
+
+/*
+ * Each message is a frame, with a little-endian header:
+ *
+ *   uint32 length      Length of the frame, including the header
+ *   uint16 type        FRAME_*
+ *   uint16 flags       0
+ *   uint32 sequence    Incremented for each frame sent, by each side
+ *   uint64 timestamp   When the frame was sent (microseconds, on the sender's monotonic clock)
+ *   payload            length - FRAME_HEADER_SIZE bytes
+ *
+ * The payloads:
+ *   FRAME_NOTIFY    uint32 notification (button to gpii: the GPII_MSG_* values)
+ *                   uint32 event        The event's sequence number (hostEvent.sequence), for tracing; 0 if unknown
+ *                                       (older buttons only send the notification)
+ *   FRAME_POSITION  int32 left, top, width, height (button to gpii: the button's screen rectangle)
+ *   FRAME_COMMAND   A batch of commands (gpii to button: see batch.h)
+ *   FRAME_PING      Anything; the other side replies with a FRAME_PONG with the same payload
+ *   FRAME_PONG
+ */
+
+#define FRAME_NOTIFY   1
+#define FRAME_POSITION 2
+#define FRAME_COMMAND  3
+#define FRAME_PING     4
+#define FRAME_PONG     5
+
+#define FRAME_HEADER_SIZE 20
+/** Largest frame */
+#define FRAME_MAX_SIZE 0x10000
+#define FRAME_MAX_PAYLOAD (FRAME_MAX_SIZE - FRAME_HEADER_SIZE)
+
+// frameReaderNext results
+#define FRAME_NONE  0
+#define FRAME_READ  1
+#define FRAME_ERROR (-1)
+
+/** A decoded frame. */
+typedef struct {
+	uint32_t type;
+	uint32_t sequence;
+	uint64_t timestamp;
+	/** The payload (points into the reader's buffer, until the next read) */
+	const uint8_t *payload;
+	uint32_t payloadLength;
+} frame;
+
+/** Collects frames from a stream of bytes. */
+typedef struct {
+	uint8_t buffer[FRAME_MAX_SIZE];
+	/** Number of bytes in the buffer */
+	uint32_t length;
+	/** Bytes at the start of the buffer which belong to the last frame read */
+	uint32_t consumed;
+	/** The sequence number of the next frame expected */
+	uint32_t nextSequence;
+	/** Statistics: frames read, and frames which were missing (gaps in the sequence) */
+	uint32_t frames, missed;
+	/** Set when the stream is corrupt; everything after is ignored */
+	bool failed;
+} frameReader;
+
+/**
+ * Encodes a frame.
+ * @param buffer Receives the frame.
+ * @param capacity Size of buffer.
+ * @param type The type (FRAME_*).
+ * @param sequence The sequence number.
+ * @param timestamp The time (microseconds).
+ * @param payload The payload.
+ * @param payloadLength Length of the payload.
+ * @return The length of the frame, or 0 if it doesn't fit.
+ */
+size_t frameEncode(uint8_t *buffer, size_t capacity, uint32_t type, uint32_t sequence, uint64_t timestamp,
+	const void *payload, size_t payloadLength);
+
+/**
+ * Encodes a FRAME_NOTIFY frame.
+ * @return The length of the frame, or 0 if it doesn't fit.
+ */
+size_t frameEncodeNotify(uint8_t *buffer, size_t capacity, uint32_t sequence, uint64_t timestamp,
+	uint32_t notification, uint32_t event);
+
+/**
+ * Encodes a FRAME_POSITION frame, from a rectangle.
+ * @return The length of the frame, or 0 if it doesn't fit.
+ */
+size_t frameEncodePosition(uint8_t *buffer, size_t capacity, uint32_t sequence, uint64_t timestamp,
+	const coreRect *rect);
+
+/**
+ * Gets the notification, and its event's sequence number, from a FRAME_NOTIFY frame.
+ * @return false if the frame isn't a valid notification.
+ */
+bool frameDecodeNotify(const frame *f, uint32_t *notification, uint32_t *event);
+
+/**
+ * Gets the rectangle from a FRAME_POSITION frame.
+ * @return false if the frame isn't a valid position.
+ */
+bool frameDecodePosition(const frame *f, coreRect *rect);
+
+/**
+ * Initialises a reader.
+ * @param reader The reader.
+ */
+void frameReaderInit(frameReader *reader);
+
+/**
+ * Adds bytes from the stream. Only as many bytes as there's room for are taken; call frameReaderNext to make room.
+ * @param reader The reader.
+ * @param data The bytes.
+ * @param length Number of bytes.
+ * @return Number of bytes taken.
+ */
+size_t frameReaderAppend(frameReader *reader, const void *data, size_t length);
+
+/**
+ * Gets the next complete frame.
+ * @param reader The reader.
+ * @param f Receives the frame, which is valid until the next call.
+ * @return FRAME_READ, FRAME_NONE if more bytes are needed, or FRAME_ERROR if the stream is corrupt.
+ */
+int frameReaderNext(frameReader *reader, frame *f);
+
+#endif /* TRAY_BUTTON_FRAME_H */
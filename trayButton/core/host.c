@@ -0,0 +1,270 @@
+/* Task tray button - platform-neutral core.
+ * The button's settings and events, for whatever hosts it: gpii-app in another process, or in-process as a library.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "batch.h"
+
+trayHost *trayHostCreate(const hostBackend *backend, hostCallback callback, void *context)
+{
+	trayHost *host = calloc(1, sizeof(trayHost));
+	if (host) {
+		host->backend = *backend;
+		host->callback = callback;
+		host->callbackContext = context;
+	}
+	return host;
+}
+
+void trayHostDestroy(trayHost *host)
+{
+	if (host) {
+		free(host->iconFile);
+		free(host->iconFileHC);
+		free(host->toolTip);
+		free(host->iconSvg);
+		free(host->animation);
+		free(host);
+	}
+}
+
+void trayHostReset(trayHost *host)
+{
+	free(host->iconFile);
+	free(host->iconFileHC);
+	free(host->toolTip);
+	free(host->iconSvg);
+	free(host->animation);
+	host->iconFile = host->iconFileHC = host->toolTip = host->iconSvg = host->animation = null;
+	host->checked = false;
+}
+
+bool trayHostReachable(bool hosted, bool pipeConnected, bool windowExists)
+{
+	return hosted || pipeConnected || windowExists;
+}
+
+size_t hostStringLength(const hostChar *text)
+{
+	size_t length = 0;
+	if (text) {
+		while (text[length]) {
+			length++;
+		}
+	}
+	return length;
+}
+
+/** Tells the backend about a change, or remembers it until the end of the batch. */
+static void changed(trayHost *host, uint32_t changes)
+{
+	if (host->batching) {
+		host->pending |= changes;
+	} else {
+		host->applies++;
+		host->backend.apply(host, changes);
+	}
+}
+
+/**
+ * Sets one of the strings, if it's different.
+ * @return false if there's no memory.
+ */
+static bool setString(trayHost *host, hostChar **field, const hostChar *data, size_t length, uint32_t change)
+{
+	hostChar *current = *field;
+	if (data ? current && hostStringLength(current) == length && memcmp(current, data, length * sizeof(hostChar)) == 0
+		: !current) {
+		host->unchanged++;
+		return true;
+	}
+
+	hostChar *copy = null;
+	if (data) {
+		copy = malloc((length + 1) * sizeof(hostChar));
+		if (!copy) {
+			return false;
+		}
+		memcpy(copy, data, length * sizeof(hostChar));
+		copy[length] = 0;
+	}
+
+	free(current);
+	*field = copy;
+	changed(host, change);
+	return true;
+}
+
+bool trayHostSetIcon(trayHost *host, const hostChar *file)
+{
+	return setString(host, &host->iconFile, file, hostStringLength(file), HOST_CHANGED_ICON);
+}
+
+bool trayHostSetHighContrastIcon(trayHost *host, const hostChar *file)
+{
+	return setString(host, &host->iconFileHC, file, hostStringLength(file), HOST_CHANGED_ICON);
+}
+
+bool trayHostSetSvgIcon(trayHost *host, const hostChar *file)
+{
+	size_t length = hostStringLength(file);
+	return setString(host, &host->iconSvg, length ? file : null, length, HOST_CHANGED_ICON);
+}
+
+bool trayHostSetToolTip(trayHost *host, const hostChar *text)
+{
+	return setString(host, &host->toolTip, text, hostStringLength(text), HOST_CHANGED_TOOLTIP);
+}
+
+bool trayHostSetAnimation(trayHost *host, const hostChar *animation)
+{
+	size_t length = hostStringLength(animation);
+	// Empty stops it, like null.
+	return setString(host, &host->animation, length ? animation : null, length, HOST_CHANGED_ANIMATION);
+}
+
+void trayHostSetState(trayHost *host, bool checked)
+{
+	if (host->checked == checked) {
+		host->unchanged++;
+	} else {
+		host->checked = checked;
+		changed(host, HOST_CHANGED_STATE);
+	}
+}
+
+/** Determines if the data of a state command is "true" (ignoring the case, like gpii-app's String(true)). */
+static bool isTrue(const hostChar *data, size_t length)
+{
+	static const char word[] = "true";
+	if (!data || length != sizeof(word) - 1) {
+		return false;
+	}
+	for (size_t n = 0; n < length; n++) {
+		hostChar c = data[n];
+		if ((c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c) != word[n]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool trayHostCommand(trayHost *host, uint32_t command, const hostChar *data, size_t length)
+{
+	host->commands++;
+
+	switch (command) {
+	case HOST_COMMAND_ICON:
+		return setString(host, &host->iconFile, data, length, HOST_CHANGED_ICON);
+	case HOST_COMMAND_ICON_HC:
+		return setString(host, &host->iconFileHC, data, length, HOST_CHANGED_ICON);
+	case HOST_COMMAND_ICON_SVG:
+		return setString(host, &host->iconSvg, length ? data : null, length, HOST_CHANGED_ICON);
+	case HOST_COMMAND_TOOLTIP:
+		return setString(host, &host->toolTip, data, length, HOST_CHANGED_TOOLTIP);
+	case HOST_COMMAND_ANIMATE:
+		// Empty stops it, like null.
+		return setString(host, &host->animation, length ? data : null, length, HOST_CHANGED_ANIMATION);
+	case HOST_COMMAND_STATE:
+		trayHostSetState(host, isTrue(data, length));
+		return true;
+	case HOST_COMMAND_DESTROY:
+		host->backend.destroy(host);
+		return true;
+	case HOST_COMMAND_METRICS:
+		host->backend.metrics(host);
+		return true;
+	case HOST_COMMAND_BATCH:
+		// Batches don't nest.
+		return !host->batching && trayHostBatch(host, data, length * sizeof(hostChar));
+	default:
+		return false;
+	}
+}
+
+bool trayHostBatch(trayHost *host, const void *data, size_t size)
+{
+	batchReader reader;
+	batchRecord record;
+	int result;
+
+	host->batching = true;
+	host->pending = 0;
+
+	batchReaderInit(&reader, data, size);
+	while ((result = batchNext(&reader, &record)) == BATCH_RECORD) {
+		trayHostCommand(host, record.command, record.data, record.length);
+		if (record.command == HOST_COMMAND_DESTROY) {
+			// The button has gone.
+			host->pending = 0;
+			break;
+		}
+	}
+
+	host->batching = false;
+	if (host->pending) {
+		changed(host, host->pending);
+		host->pending = 0;
+	}
+	return result != BATCH_ERROR;
+}
+
+/** Adds a setting to a batch, if it's set. */
+static void saveString(batchWriter *writer, uint32_t command, const hostChar *value)
+{
+	if (value) {
+		batchAdd(writer, command, value, hostStringLength(value));
+	}
+}
+
+size_t trayHostSaveBatch(const trayHost *host, uint16_t *buffer, size_t capacity)
+{
+	static const hostChar checked[] = { 't', 'r', 'u', 'e' };
+	static const hostChar unchecked[] = { 'f', 'a', 'l', 's', 'e' };
+
+	batchWriter writer;
+	batchWriterInit(&writer, buffer, capacity);
+	// (Applied in one go, so the order doesn't matter.)
+	saveString(&writer, HOST_COMMAND_ICON_HC, host->iconFileHC);
+	saveString(&writer, HOST_COMMAND_ICON_SVG, host->iconSvg);
+	saveString(&writer, HOST_COMMAND_TOOLTIP, host->toolTip);
+	batchAdd(&writer, HOST_COMMAND_STATE, host->checked ? checked : unchecked, host->checked ? 4 : 5);
+	saveString(&writer, HOST_COMMAND_ICON, host->iconFile);
+	return writer.overflow ? 0 : writer.length;
+}
+
+/** Numbers an event, and sends it to the callback. */
+static void sendEvent(trayHost *host, hostEvent *event)
+{
+	event->sequence = ++host->events;
+	event->timestamp = host->backend.now ? host->backend.now(host) : 0;
+	if (host->callback) {
+		host->callback(host->callbackContext, event);
+	}
+}
+
+uint32_t trayHostEvent(trayHost *host, uint32_t type)
+{
+	hostEvent event = { 0 };
+	event.type = type;
+	sendEvent(host, &event);
+	return event.sequence;
+}
+
+void trayHostPosition(trayHost *host, const coreRect *rect)
+{
+	hostEvent event = { 0 };
+	event.type = HOST_EVENT_POSITION;
+	event.rect = *rect;
+	sendEvent(host, &event);
+}
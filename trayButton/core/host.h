@@ -0,0 +1,253 @@
+/* Task tray button - platform-neutral core.
+ * The button's settings and events, for whatever hosts it: gpii-app in another process, or in-process as a library.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_HOST_H
+#define TRAY_BUTTON_HOST_H
+
+#include "common.h"
+
+/*
+ * The host gives the button its icon, tool-tip and state, and is told when the button is clicked or moves. Each
+ * trayHost is an instance of this; the platform (the backend) is told what has changed, and applies it to its buttons.
+ *
+ * Strings are UTF-16 (WCHAR on Windows, and what gpii-app's batches are made of), null-terminated.
+ */
+
+/** A UTF-16 code unit */
+typedef uint16_t hostChar;
+
+// Commands from the host (the same as the WM_COPYDATA dwData values)
+#define HOST_COMMAND_ICON    1
+#define HOST_COMMAND_ICON_HC 2
+#define HOST_COMMAND_TOOLTIP 3
+#define HOST_COMMAND_DESTROY 4
+#define HOST_COMMAND_STATE   5
+#define HOST_COMMAND_METRICS 6
+#define HOST_COMMAND_BATCH   7
+/** Plays an animation instead of the icon (see animation.h); empty or null data stops it */
+#define HOST_COMMAND_ANIMATE 8
+/** An SVG rendition of the icon, drawn at the exact size needed (see svg.h); empty or null data uses the .ico file */
+#define HOST_COMMAND_ICON_SVG 9
+
+// Events sent to the host (the same as the notifications sent to gpii)
+#define HOST_EVENT_UPDATE     0
+#define HOST_EVENT_CLICK      1
+#define HOST_EVENT_MENU       2
+#define HOST_EVENT_ENTER      3
+#define HOST_EVENT_LEAVE      4
+/** The button has moved (gpii gets this as its own message) */
+#define HOST_EVENT_POSITION   5
+/** A snapshot of the metrics is ready (HOST_COMMAND_METRICS, in-process only; see trayButtonMetrics) */
+#define HOST_EVENT_METRICS    6
+
+// What has changed, for hostBackend.apply
+#define HOST_CHANGED_ICON    1
+#define HOST_CHANGED_TOOLTIP 2
+#define HOST_CHANGED_STATE   4
+#define HOST_CHANGED_ANIMATION 8
+
+typedef struct trayHost trayHost;
+
+/** Something that happened to the button. */
+typedef struct {
+	/** HOST_EVENT_* */
+	uint32_t type;
+	/** Where the button is, in screen co-ordinates (HOST_EVENT_POSITION) */
+	coreRect rect;
+	/** Identifies the event (starting at 1), so both sides can put it on the same timeline (see span.h) */
+	uint32_t sequence;
+	/** When it happened (microseconds, from hostBackend.now; 0 if there's no clock) */
+	uint64_t timestamp;
+} hostEvent;
+
+/**
+ * Receives the events of the button.
+ * @param context The context given to trayHostCreate.
+ * @param event The event.
+ */
+typedef void (*hostCallback)(void *context, const hostEvent *event);
+
+/** What the platform does with the settings. */
+typedef struct {
+	/**
+	 * The settings have changed; a batch of them is applied once, at the end.
+	 * @param host The host (the current settings are in it).
+	 * @param changes HOST_CHANGED_* bits.
+	 */
+	void (*apply)(trayHost *host, uint32_t changes);
+	/** Writes the metrics (HOST_COMMAND_METRICS). */
+	void (*metrics)(trayHost *host);
+	/** Removes the button (HOST_COMMAND_DESTROY). */
+	void (*destroy)(trayHost *host);
+	/** Gets the time, in microseconds, for the events' timestamps (null for none). */
+	uint64_t (*now)(trayHost *host);
+	void *context;
+} hostBackend;
+
+struct trayHost {
+	hostBackend backend;
+	hostCallback callback;
+	void *callbackContext;
+
+	/** The icon file, the one used in high-contrast mode, and the tool-tip (null if not set) */
+	hostChar *iconFile;
+	hostChar *iconFileHC;
+	hostChar *toolTip;
+	/** The SVG rendition of the icon (null if none) */
+	hostChar *iconSvg;
+	/** The animation being played (null if none) */
+	hostChar *animation;
+	/** The button looks "on" */
+	bool checked;
+
+	/** A batch is being applied; the changes so far */
+	bool batching;
+	uint32_t pending;
+
+	/** Statistics: commands received, and ignored because nothing changed; backend applies; events sent */
+	uint32_t commands, unchanged, applies, events;
+};
+
+/**
+ * Creates an instance of the button's settings.
+ * @param backend What the platform does with them.
+ * @param callback Receives the events (or null).
+ * @param context Passed to the callback.
+ * @return The host, or null if there's no memory.
+ */
+trayHost *trayHostCreate(const hostBackend *backend, hostCallback callback, void *context);
+
+/**
+ * Frees the host. The backend isn't told; remove the buttons first.
+ * @param host The host (or null).
+ */
+void trayHostDestroy(trayHost *host);
+
+/**
+ * Forgets the settings, without telling the backend. For when the host application has gone; it sends them all
+ * again when it comes back.
+ * @param host The host.
+ */
+void trayHostReset(trayHost *host);
+
+/**
+ * Checks that the host application is still there, to show the button for. In-process, it always is. Otherwise, it's
+ * there while the pipe to it is connected, or its message window exists; the button is hidden (and the host reset)
+ * when it's neither.
+ * @param hosted The button is in the host application's process.
+ * @param pipeConnected The pipe to the host application is connected.
+ * @param windowExists The host application's message window exists.
+ * @return true if the host application is there.
+ */
+bool trayHostReachable(bool hosted, bool pipeConnected, bool windowExists);
+
+/**
+ * Sets the icon.
+ * @param host The host.
+ * @param file The icon file, or null to hide the button.
+ * @return false if there's no memory.
+ */
+bool trayHostSetIcon(trayHost *host, const hostChar *file);
+
+/**
+ * Sets the icon used when high-contrast is on.
+ * @param host The host.
+ * @param file The icon file, or null to use the normal one.
+ * @return false if there's no memory.
+ */
+bool trayHostSetHighContrastIcon(trayHost *host, const hostChar *file);
+
+/**
+ * Sets an SVG rendition of the icon, which is drawn at the exact size for the DPI rather than scaled. The icon file
+ * (trayHostSetIcon) is still needed: the button is hidden without one, and it's used if the SVG can't be read.
+ * @param host The host.
+ * @param file The SVG file, or null (or empty) to use the icon file.
+ * @return false if there's no memory.
+ */
+bool trayHostSetSvgIcon(trayHost *host, const hostChar *file);
+
+/**
+ * Sets the tool-tip.
+ * @param host The host.
+ * @param text The text (or null).
+ * @return false if there's no memory.
+ */
+bool trayHostSetToolTip(trayHost *host, const hostChar *text);
+
+/**
+ * Plays an animation instead of the icon.
+ * @param host The host.
+ * @param animation The animation ("<ms per frame>;<loops>;<file>;<file>..."), or null (or empty) to stop it.
+ * @return false if there's no memory.
+ */
+bool trayHostSetAnimation(trayHost *host, const hostChar *animation);
+
+/**
+ * Sets whether the button looks "on".
+ * @param host The host.
+ * @param checked true for on.
+ */
+void trayHostSetState(trayHost *host, bool checked);
+
+/**
+ * Performs a command.
+ * @param host The host.
+ * @param command The command (HOST_COMMAND_*).
+ * @param data The data (not null-terminated), or null.
+ * @param length Number of code units in data.
+ * @return false if the command is unknown or malformed, or there's no memory.
+ */
+bool trayHostCommand(trayHost *host, uint32_t command, const hostChar *data, size_t length);
+
+/**
+ * Performs a batch of commands (see batch.h), applying the changes once at the end. Nothing after a
+ * HOST_COMMAND_DESTROY is performed.
+ * @param host The host.
+ * @param data The batch.
+ * @param size Size of the batch, in bytes.
+ * @return false if the batch is malformed (the commands before the error are performed).
+ */
+bool trayHostBatch(trayHost *host, const void *data, size_t size);
+
+/**
+ * Writes the settings as a batch of commands, which sets them again when given to trayHostBatch. The animation isn't
+ * included: it only plays for a while.
+ * @param host The host.
+ * @param buffer Receives the batch.
+ * @param capacity Size of the buffer, in code units.
+ * @return The length of the batch (code units), or 0 if it doesn't fit.
+ */
+size_t trayHostSaveBatch(const trayHost *host, uint16_t *buffer, size_t capacity);
+
+/**
+ * Tells the host about something that happened to the button.
+ * @param host The host.
+ * @param type The event (HOST_EVENT_*, but not HOST_EVENT_POSITION).
+ * @return The event's sequence number.
+ */
+uint32_t trayHostEvent(trayHost *host, uint32_t type);
+
+/**
+ * Tells the host where the button is.
+ * @param host The host.
+ * @param rect The button, in screen co-ordinates.
+ */
+void trayHostPosition(trayHost *host, const coreRect *rect);
+
+/**
+ * Gets the length of a string.
+ * @param text The string (or null).
+ * @return Number of code units, excluding the terminator.
+ */
+size_t hostStringLength(const hostChar *text);
+
+#endif /* TRAY_BUTTON_HOST_H */
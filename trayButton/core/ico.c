@@ -0,0 +1,212 @@
+/* Task tray button - platform-neutral core.
+ * Reads .ico files, and picks or scales the image for a given size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ico.h"
+
+// Little-endian readers, so the structures don't depend on the compiler's packing.
+static uint16_t read16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#define ICONDIR_SIZE 6
+#define ICONDIRENTRY_SIZE 16
+#define BITMAPINFOHEADER_SIZE 40
+
+/**
+ * Reads an image from a BITMAPINFOHEADER, followed by the colour and mask bits.
+ * @return true if the image was read.
+ */
+static bool readBitmap(const uint8_t *data, size_t size, icoImage *image)
+{
+	if (size < BITMAPINFOHEADER_SIZE || read32(data) < BITMAPINFOHEADER_SIZE) {
+		// Also rejects PNG
+		return false;
+	}
+
+	int32_t width = (int32_t)read32(data + 4);
+	// The height includes the mask
+	int32_t height = (int32_t)read32(data + 8) / 2;
+	uint16_t bits = read16(data + 14);
+	uint32_t compression = read32(data + 16);
+	uint32_t colors = read32(data + 32);
+
+	if (width <= 0 || width > ICO_MAX_SIZE || height <= 0 || height > ICO_MAX_SIZE || compression != 0
+		|| (bits != 32 && bits != 24) || colors != 0) {
+		return false;
+	}
+
+	// Rows are 4-byte aligned.
+	size_t colorStride = ((width * bits + 31) / 32) * 4;
+	size_t maskStride = ((width + 31) / 32) * 4;
+	size_t colorOffset = read32(data);
+	if (colorOffset > size) {
+		return false;
+	}
+	size_t maskOffset = colorOffset + colorStride * height;
+	bool hasMask = maskOffset <= size && maskStride * height <= size - maskOffset;
+	if (maskOffset > size || (bits == 24 && !hasMask)) {
+		return false;
+	}
+	const uint8_t *colorBits = data + colorOffset;
+	const uint8_t *maskBits = data + maskOffset;
+
+	image->pixels = malloc((size_t)width * height * sizeof(uint32_t));
+	if (!image->pixels) {
+		return false;
+	}
+	image->width = width;
+	image->height = height;
+
+	bool anyAlpha = false;
+	for (int32_t y = 0; y < height; y++) {
+		// Bottom-up
+		const uint8_t *src = colorBits + colorStride * (height - 1 - y);
+		uint32_t *dest = image->pixels + (size_t)width * y;
+		for (int32_t x = 0; x < width; x++) {
+			if (bits == 32) {
+				dest[x] = read32(src + x * 4);
+				anyAlpha |= (dest[x] >> 24) != 0;
+			} else {
+				dest[x] = 0xff000000 | src[x * 3] | (src[x * 3 + 1] << 8) | (src[x * 3 + 2] << 16);
+			}
+		}
+	}
+
+	// Old-style icons use the mask for transparency, instead of the alpha channel.
+	if (hasMask && (bits == 24 || !anyAlpha)) {
+		for (int32_t y = 0; y < height; y++) {
+			const uint8_t *mask = maskBits + maskStride * (height - 1 - y);
+			uint32_t *dest = image->pixels + (size_t)width * y;
+			for (int32_t x = 0; x < width; x++) {
+				bool transparent = (mask[x / 8] >> (7 - x % 8)) & 1;
+				dest[x] = transparent ? 0 : (dest[x] | 0xff000000);
+			}
+		}
+	}
+
+	return true;
+}
+
+uint32_t icoParse(const void *data, size_t size, icoFile *ico)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+	memset(ico, 0, sizeof(*ico));
+
+	// ICONDIR: reserved (0), type (1 = icon), count
+	if (size < ICONDIR_SIZE || read16(bytes) != 0 || read16(bytes + 2) != 1) {
+		return 0;
+	}
+
+	uint32_t count = read16(bytes + 4);
+	if (size < ICONDIR_SIZE + (size_t)count * ICONDIRENTRY_SIZE) {
+		return 0;
+	}
+
+	for (uint32_t n = 0; n < count && ico->count < ICO_MAX_IMAGES; n++) {
+		const uint8_t *entry = bytes + ICONDIR_SIZE + n * ICONDIRENTRY_SIZE;
+		uint32_t imageSize = read32(entry + 8);
+		uint32_t offset = read32(entry + 12);
+		if (offset >= size || imageSize > size - offset) {
+			continue;
+		}
+
+		icoImage image = { 0 };
+		if (!readBitmap(bytes + offset, imageSize, &image)) {
+			continue;
+		}
+
+		// Keep them sorted by size.
+		uint32_t at = ico->count;
+		while (at > 0 && ico->images[at - 1].width > image.width) {
+			ico->images[at] = ico->images[at - 1];
+			at--;
+		}
+		ico->images[at] = image;
+		ico->count++;
+	}
+
+	return ico->count;
+}
+
+void icoFree(icoFile *ico)
+{
+	for (uint32_t n = 0; n < ico->count; n++) {
+		free(ico->images[n].pixels);
+	}
+	memset(ico, 0, sizeof(*ico));
+}
+
+const icoImage *icoSelect(const icoFile *ico, int32_t size)
+{
+	for (uint32_t n = 0; n < ico->count; n++) {
+		if (ico->images[n].width >= size) {
+			return &ico->images[n];
+		}
+	}
+	return ico->count ? &ico->images[ico->count - 1] : null;
+}
+
+void icoScale(const icoImage *image, int32_t size, uint32_t *dest)
+{
+	if (image->width == size && image->height == size) {
+		memcpy(dest, image->pixels, (size_t)size * size * sizeof(uint32_t));
+		return;
+	}
+
+	// Work in 1/size source pixels, so the edges of each destination pixel land on whole units.
+	int32_t sw = image->width, sh = image->height;
+	for (int32_t y = 0; y < size; y++) {
+		int32_t top = y * sh, bottom = top + sh;
+		for (int32_t x = 0; x < size; x++) {
+			int32_t left = x * sw, right = left + sw;
+			uint64_t a = 0, r = 0, g = 0, b = 0, total = 0;
+
+			for (int32_t sy = top / size; sy * size < bottom; sy++) {
+				// How much of the source row is covered
+				int32_t h = (sy * size + size < bottom ? sy * size + size : bottom) - (sy * size > top ? sy * size : top);
+				for (int32_t sx = left / size; sx * size < right; sx++) {
+					int32_t w = (sx * size + size < right ? sx * size + size : right)
+						- (sx * size > left ? sx * size : left);
+					uint32_t weight = (uint32_t)(w * h);
+					uint32_t pixel = image->pixels[(size_t)sy * sw + sx];
+					uint32_t alpha = pixel >> 24;
+
+					// Premultiply, so transparent pixels don't bleed their colour.
+					a += (uint64_t)alpha * weight;
+					r += (uint64_t)((pixel >> 16) & 0xff) * alpha * weight;
+					g += (uint64_t)((pixel >> 8) & 0xff) * alpha * weight;
+					b += (uint64_t)(pixel & 0xff) * alpha * weight;
+					total += weight;
+				}
+			}
+
+			uint32_t result = 0;
+			if (a) {
+				// Back to straight alpha (rounded)
+				uint32_t outA = (uint32_t)((a + total / 2) / total);
+				uint32_t outR = (uint32_t)((r + a / 2) / a);
+				uint32_t outG = (uint32_t)((g + a / 2) / a);
+				uint32_t outB = (uint32_t)((b + a / 2) / a);
+				result = (outA << 24) | (outR << 16) | (outG << 8) | outB;
+			}
+			dest[(size_t)y * size + x] = result;
+		}
+	}
+}
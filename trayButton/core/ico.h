@@ -0,0 +1,70 @@
+/* Task tray button - platform-neutral core.
+ * Reads .ico files, and picks or scales the image for a given size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ICO_H
+#define TRAY_BUTTON_ICO_H
+
+#include "common.h"
+
+/** Most images read from a file. */
+#define ICO_MAX_IMAGES 16
+/** Largest image read (pixels, either way). */
+#define ICO_MAX_SIZE 256
+
+/** An image from an icon file. */
+typedef struct {
+	int32_t width, height;
+	/** width * height 32-bit BGRA pixels (not premultiplied), top-down */
+	uint32_t *pixels;
+} icoImage;
+
+/** The images from an icon file. */
+typedef struct {
+	uint32_t count;
+	/** The images, smallest first */
+	icoImage images[ICO_MAX_IMAGES];
+} icoFile;
+
+/**
+ * Reads the images in an icon file. Uncompressed 32-bit and 24-bit images are read; others (PNG, palettes) are skipped.
+ * @param data The file contents.
+ * @param size Size of the data.
+ * @param ico Receives the images. Free with icoFree, even on failure.
+ * @return The number of images read (0 if the file isn't an icon, or has no usable images).
+ */
+uint32_t icoParse(const void *data, size_t size, icoFile *ico);
+
+/**
+ * Frees the images read by icoParse.
+ * @param ico The images.
+ */
+void icoFree(icoFile *ico);
+
+/**
+ * Picks the best image to draw at the given size: the same size, otherwise the smallest larger one (scaling down looks
+ * better than scaling up), otherwise the largest.
+ * @param ico The images.
+ * @param size Required size.
+ * @return The image, or null if there are none.
+ */
+const icoImage *icoSelect(const icoFile *ico, int32_t size);
+
+/**
+ * Scales an image to a square of the given size, averaging the source pixels each destination pixel covers (a box
+ * filter, on premultiplied colour).
+ * @param image The image.
+ * @param size The size of the new image.
+ * @param dest Receives size * size pixels, top-down, in the same format as the image.
+ */
+void icoScale(const icoImage *image, int32_t size, uint32_t *dest);
+
+#endif /* TRAY_BUTTON_ICO_H */
@@ -0,0 +1,71 @@
+/* Task tray button - platform-neutral core.
+ * Keeps the parsed icon files, so they're only read from disk once.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "icon-cache.h"
+
+const icoFile *iconCacheFind(iconCache *cache, const void *key, size_t keySize)
+{
+	for (int n = 0; n < ICON_CACHE_SIZE; n++) {
+		iconCacheEntry *entry = &cache->entries[n];
+		if (entry->key && entry->keySize == keySize && memcmp(entry->key, key, keySize) == 0) {
+			entry->lastUsed = ++cache->clock;
+			cache->hits++;
+			return &entry->ico;
+		}
+	}
+
+	cache->misses++;
+	return null;
+}
+
+static void freeEntry(iconCacheEntry *entry)
+{
+	free(entry->key);
+	entry->key = null;
+	icoFree(&entry->ico);
+}
+
+const icoFile *iconCacheAdd(iconCache *cache, const void *key, size_t keySize, icoFile *ico)
+{
+	// Use a free entry, or the least recently used one.
+	iconCacheEntry *entry = &cache->entries[0];
+	for (int n = 0; n < ICON_CACHE_SIZE && entry->key; n++) {
+		iconCacheEntry *e = &cache->entries[n];
+		if (!e->key || e->lastUsed < entry->lastUsed) {
+			entry = e;
+		}
+	}
+
+	freeEntry(entry);
+	entry->key = malloc(keySize ? keySize : 1);
+	if (!entry->key) {
+		icoFree(ico);
+		return null;
+	}
+
+	memcpy(entry->key, key, keySize);
+	entry->keySize = keySize;
+	entry->ico = *ico;
+	entry->lastUsed = ++cache->clock;
+	// The cache owns the images now.
+	memset(ico, 0, sizeof(*ico));
+	return &entry->ico;
+}
+
+void iconCacheClear(iconCache *cache)
+{
+	for (int n = 0; n < ICON_CACHE_SIZE; n++) {
+		freeEntry(&cache->entries[n]);
+	}
+}
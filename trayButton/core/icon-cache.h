@@ -0,0 +1,63 @@
+/* Task tray button - platform-neutral core.
+ * Keeps the parsed icon files, so they're only read from disk once.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ICON_CACHE_H
+#define TRAY_BUTTON_ICON_CACHE_H
+
+#include "common.h"
+#include "ico.h"
+
+/** Number of files kept. There's the normal and high-contrast icons, plus whatever the icon is changed to. */
+#define ICON_CACHE_SIZE 4
+
+typedef struct {
+	/** Identifies the file (the path); null if the entry is unused */
+	void *key;
+	size_t keySize;
+	icoFile ico;
+	/** When the entry was last used (cache clock) */
+	uint32_t lastUsed;
+} iconCacheEntry;
+
+typedef struct {
+	iconCacheEntry entries[ICON_CACHE_SIZE];
+	uint32_t clock;
+	/** Statistics */
+	uint32_t hits, misses;
+} iconCache;
+
+/**
+ * Finds a previously read icon file.
+ * @param cache The cache.
+ * @param key Identifies the file.
+ * @param keySize Size of the key, in bytes.
+ * @return The images, or null if the file isn't cached.
+ */
+const icoFile *iconCacheFind(iconCache *cache, const void *key, size_t keySize);
+
+/**
+ * Adds an icon file, replacing the least recently used one if the cache is full.
+ * @param cache The cache.
+ * @param key Identifies the file (copied).
+ * @param keySize Size of the key, in bytes.
+ * @param ico The images, which the cache takes ownership of (even on failure).
+ * @return The cached images, or null if allocation failed.
+ */
+const icoFile *iconCacheAdd(iconCache *cache, const void *key, size_t keySize, icoFile *ico);
+
+/**
+ * Discards all files.
+ * @param cache The cache.
+ */
+void iconCacheClear(iconCache *cache);
+
+#endif /* TRAY_BUTTON_ICON_CACHE_H */
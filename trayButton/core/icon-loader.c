@@ -0,0 +1,100 @@
+/* Task tray button - platform-neutral core.
+ * Hands icons to another thread to be decoded, and the results back, so slow file reads don't hold up the UI thread.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "atomics.h"
+#include "icon-loader.h"
+
+bool iconQueuePush(iconQueue *queue, const iconJob *job)
+{
+	uint32_t head = queue->head;
+	if (head - atomicLoad(&queue->tail) >= ICON_QUEUE_SIZE) {
+		return false;
+	}
+
+	queue->jobs[head & (ICON_QUEUE_SIZE - 1)] = *job;
+	// Publish the job.
+	atomicStore(&queue->head, head + 1);
+	return true;
+}
+
+bool iconQueuePop(iconQueue *queue, iconJob *job)
+{
+	uint32_t tail = queue->tail;
+	if (atomicLoad(&queue->head) == tail) {
+		return false;
+	}
+
+	*job = queue->jobs[tail & (ICON_QUEUE_SIZE - 1)];
+	// Give the slot back.
+	atomicStore(&queue->tail, tail + 1);
+	return true;
+}
+
+bool iconLoaderPending(const iconLoader *loader, uint32_t iconId, int32_t size)
+{
+	for (uint32_t n = 0; n < loader->pendingCount; n++) {
+		if (loader->pending[n].iconId == iconId && loader->pending[n].size == size) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int iconLoaderRequest(iconLoader *loader, const iconJob *job)
+{
+	if (iconLoaderPending(loader, job->iconId, job->size)) {
+		loader->duplicates++;
+		return ICON_REQUEST_PENDING;
+	}
+
+	// There's room in the results queue for every icon being decoded.
+	if (loader->pendingCount == ICON_QUEUE_SIZE || !iconQueuePush(&loader->requests, job)) {
+		loader->refused++;
+		return ICON_REQUEST_FULL;
+	}
+
+	loader->pending[loader->pendingCount].iconId = job->iconId;
+	loader->pending[loader->pendingCount].size = job->size;
+	loader->pendingCount++;
+	loader->requested++;
+	return ICON_REQUEST_QUEUED;
+}
+
+bool iconLoaderNext(iconLoader *loader, iconJob *job)
+{
+	if (!iconQueuePop(&loader->requests, job)) {
+		return false;
+	}
+	job->result = null;
+	return true;
+}
+
+void iconLoaderDone(iconLoader *loader, const iconJob *job)
+{
+	iconQueuePush(&loader->results, job);
+}
+
+bool iconLoaderTake(iconLoader *loader, iconJob *job)
+{
+	if (!iconQueuePop(&loader->results, job)) {
+		return false;
+	}
+
+	for (uint32_t n = 0; n < loader->pendingCount; n++) {
+		if (loader->pending[n].iconId == job->iconId && loader->pending[n].size == job->size) {
+			loader->pending[n] = loader->pending[--loader->pendingCount];
+			break;
+		}
+	}
+	loader->completed++;
+	return true;
+}
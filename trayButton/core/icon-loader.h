@@ -0,0 +1,129 @@
+/* Task tray button - platform-neutral core.
+ * Hands icons to another thread to be decoded, and the results back, so slow file reads don't hold up the UI thread.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_ICON_LOADER_H
+#define TRAY_BUTTON_ICON_LOADER_H
+
+#include "common.h"
+
+/*
+ * The UI thread puts requests on one lock-free queue, and wakes the worker (the platform's event). The worker decodes
+ * each icon, puts the result on the other queue, and tells the UI thread (the platform's posted message). Each queue
+ * has a single producer and a single consumer, so neither thread waits for the other.
+ *
+ * An icon that's already being decoded isn't requested again (buttons of the same size share the icon). Because the
+ * number of icons being decoded is limited to the size of a queue, the worker never finds the results queue full.
+ */
+
+/** Number of jobs a queue holds (a power of 2), and the most icons being decoded at once. */
+#define ICON_QUEUE_SIZE 16
+
+/** An icon to decode, and the result. */
+typedef struct {
+	/** Identifies the icon, and the size to decode it at */
+	uint32_t iconId;
+	int32_t size;
+	/** What the platform needs to decode it (like the file names), owned by the job */
+	void *request;
+	/** The decoded icon (null if it couldn't be decoded), owned by the job */
+	void *result;
+} iconJob;
+
+/** A single-producer, single-consumer queue of jobs. */
+typedef struct {
+	/** Next job to write (only changed by the producer) */
+	volatile uint32_t head;
+	/** Next job to read (only changed by the consumer) */
+	volatile uint32_t tail;
+	iconJob jobs[ICON_QUEUE_SIZE];
+} iconQueue;
+
+/**
+ * Adds a job to a queue. Called by the producer.
+ * @param queue The queue.
+ * @param job The job (copied).
+ * @return false if the queue is full.
+ */
+bool iconQueuePush(iconQueue *queue, const iconJob *job);
+
+/**
+ * Takes the next job from a queue. Called by the consumer.
+ * @param queue The queue.
+ * @param job Receives the job.
+ * @return false if the queue is empty.
+ */
+bool iconQueuePop(iconQueue *queue, iconJob *job);
+
+// iconLoaderRequest results
+#define ICON_REQUEST_QUEUED  0
+#define ICON_REQUEST_PENDING 1
+#define ICON_REQUEST_FULL    2
+
+typedef struct {
+	/** UI thread to worker */
+	iconQueue requests;
+	/** Worker to UI thread */
+	iconQueue results;
+	/** The icons being decoded: requested, and their results not yet taken (UI thread) */
+	struct {
+		uint32_t iconId;
+		int32_t size;
+	} pending[ICON_QUEUE_SIZE];
+	uint32_t pendingCount;
+	/** Statistics (UI thread): requests queued, requests for an icon already being decoded, refused, results taken */
+	uint32_t requested, duplicates, refused, completed;
+} iconLoader;
+
+/**
+ * Asks for an icon to be decoded, unless it's already being decoded. Called by the UI thread, which then wakes the
+ * worker.
+ * @param loader The loader.
+ * @param job The icon, and the request (result is ignored). The loader takes ownership of the request only if the
+ * job is queued.
+ * @return ICON_REQUEST_QUEUED; ICON_REQUEST_PENDING if the icon is already being decoded; or ICON_REQUEST_FULL if too
+ * many icons are being decoded.
+ */
+int iconLoaderRequest(iconLoader *loader, const iconJob *job);
+
+/**
+ * Determines if an icon is being decoded. Called by the UI thread.
+ * @param loader The loader.
+ * @param iconId Identifies the icon.
+ * @param size The size.
+ * @return true if it's been requested, and its result not yet taken.
+ */
+bool iconLoaderPending(const iconLoader *loader, uint32_t iconId, int32_t size);
+
+/**
+ * Gets the next icon to decode. Called by the worker.
+ * @param loader The loader.
+ * @param job Receives the job.
+ * @return false if there's nothing to do.
+ */
+bool iconLoaderNext(iconLoader *loader, iconJob *job);
+
+/**
+ * Hands a decoded icon back. Called by the worker, which then tells the UI thread.
+ * @param loader The loader.
+ * @param job The job from iconLoaderNext, with its result.
+ */
+void iconLoaderDone(iconLoader *loader, const iconJob *job);
+
+/**
+ * Takes the next decoded icon. Called by the UI thread, until it returns false.
+ * @param loader The loader.
+ * @param job Receives the job, whose request and result now belong to the caller.
+ * @return false if there are no more.
+ */
+bool iconLoaderTake(iconLoader *loader, iconJob *job);
+
+#endif /* TRAY_BUTTON_ICON_LOADER_H */
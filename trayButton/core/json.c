@@ -0,0 +1,40 @@
+/* Task tray button - platform-neutral core.
+ * Writing JSON into a fixed buffer.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "json.h"
+
+void jsonAppend(char *buffer, size_t size, size_t *length, const char *format, ...)
+{
+	if (*length >= size) {
+		return;
+	}
+
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(buffer + *length, size - *length, format, args);
+	va_end(args);
+
+	*length = written < 0 ? size : *length + written;
+}
+
+size_t jsonFinish(char *buffer, size_t size, size_t length)
+{
+	if (length >= size) {
+		if (size) {
+			buffer[0] = 0;
+		}
+		return 0;
+	}
+	return length;
+}
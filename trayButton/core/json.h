@@ -0,0 +1,36 @@
+/* Task tray button - platform-neutral core.
+ * Writing JSON into a fixed buffer.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_JSON_H
+#define TRAY_BUTTON_JSON_H
+
+#include "common.h"
+
+/**
+ * Appends to a buffer, keeping track of the length. Sets *length past the end on overflow, so nothing more is added.
+ * @param buffer The buffer.
+ * @param size Size of the buffer.
+ * @param length The length so far; updated.
+ * @param format printf-style format.
+ */
+void jsonAppend(char *buffer, size_t size, size_t *length, const char *format, ...);
+
+/**
+ * Null-terminates the buffer, or empties it if the JSON didn't fit.
+ * @param buffer The buffer.
+ * @param size Size of the buffer.
+ * @param length The length, from jsonAppend.
+ * @return The length of the JSON, or 0 if it didn't fit.
+ */
+size_t jsonFinish(char *buffer, size_t size, size_t length);
+
+#endif /* TRAY_BUTTON_JSON_H */
@@ -0,0 +1,97 @@
+/* Task tray button - platform-neutral core.
+ * Calculates where the button and the task list go on the taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "layout.h"
+
+void layoutCompute(const layoutInput *input, layoutResult *result)
+{
+	const coreRect *tray = &input->trayRect;
+	const coreRect *notify = &input->notifyRect;
+	coreRect *taskRect = &result->tasksRect;
+	coreRect *buttonRect = &result->buttonRect;
+	int32_t buttonWidth = scaleDpi(input->buttonWidth, input->dpi);
+
+	memset(result, 0, sizeof(*result));
+	*taskRect = input->tasksRect;
+
+	// Check the orientation, from the shape (the screen height is only the primary monitor's, which secondary taskbars
+	// needn't be on)
+	result->vertical = rectHeight(*tray) > rectWidth(*tray);
+
+	if (result->vertical) {
+		// Shrink the tasks window
+		taskRect->bottom = notify->top - buttonWidth;
+		// Put the button between
+		buttonRect->top = taskRect->bottom - tray->top;
+		buttonRect->bottom = notify->top - tray->top;
+		buttonRect->left = input->highContrast ? 1 : 0;
+		buttonRect->right = input->trayClient.right;
+	} else {
+		// Check the reading direction - if the notification icons are left of the task list, then assume right-to-left.
+		result->rtl = notify->left < taskRect->left;
+
+		if (result->rtl) {
+			// notification area is on the left
+			// Shrink the tasks window
+			taskRect->left = notify->right + buttonWidth;
+			// Put the button between (the client coordinates are mirrored)
+			buttonRect->left = input->trayClient.right - (taskRect->left - tray->left);
+			buttonRect->right = input->trayClient.right - (notify->right - tray->left);
+		} else {
+			// notification area is on the right (the common way)
+			// Shrink the tasks window
+			taskRect->right = notify->left - buttonWidth;
+			// Put the button between
+			buttonRect->left = taskRect->right - tray->left;
+			buttonRect->right = notify->left - tray->left;
+		}
+
+		buttonRect->top = input->highContrast ? 1 : 0;
+		buttonRect->bottom = input->trayClient.bottom;
+	}
+
+	// The position on the screen
+	coreRect *screen = &result->buttonScreenRect;
+	if (result->rtl) {
+		screen->left = tray->left + input->trayClient.right - buttonRect->right;
+		screen->right = tray->left + input->trayClient.right - buttonRect->left;
+	} else {
+		screen->left = tray->left + buttonRect->left;
+		screen->right = tray->left + buttonRect->right;
+	}
+	screen->top = tray->top + buttonRect->top;
+	screen->bottom = tray->top + buttonRect->bottom;
+}
+
+uint32_t layoutDiff(layoutState *state, const layoutInput *input, const layoutResult *result, bool force)
+{
+	uint32_t ops = 0;
+
+	// The task list only needs resizing if it's not the right size (the shell sometimes puts it back).
+	if (force || rectWidth(input->tasksRect) != rectWidth(result->tasksRect)
+		|| rectHeight(input->tasksRect) != rectHeight(result->tasksRect)) {
+		ops |= LAYOUT_RESIZE_TASKS;
+	}
+
+	if (force || !rectEquals(&state->buttonRect, &result->buttonRect)) {
+		ops |= LAYOUT_MOVE_BUTTON;
+		state->buttonRect = result->buttonRect;
+	}
+
+	if (!rectEquals(&state->notifiedRect, &result->buttonScreenRect)) {
+		ops |= LAYOUT_NOTIFY_POSITION;
+		state->notifiedRect = result->buttonScreenRect;
+	}
+
+	return ops;
+}
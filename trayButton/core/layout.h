@@ -0,0 +1,80 @@
+/* Task tray button - platform-neutral core.
+ * Calculates where the button and the task list go on the taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_LAYOUT_H
+#define TRAY_BUTTON_LAYOUT_H
+
+#include "common.h"
+
+/** The current geometry of the taskbar. */
+typedef struct {
+	/** The taskbar window (screen coordinates) */
+	coreRect trayRect;
+	/** The client area of the taskbar */
+	coreRect trayClient;
+	/** The container of the task list (screen coordinates) */
+	coreRect tasksRect;
+	/** The notification icons (screen coordinates) */
+	coreRect notifyRect;
+	/** Height of the client area of a full-screen window on the primary monitor (SM_CYFULLSCREEN); only traced */
+	int32_t screenHeight;
+	/** DPI of the taskbar */
+	uint32_t dpi;
+	/** Width of the button, at 96 DPI */
+	int32_t buttonWidth;
+	bool highContrast;
+} layoutInput;
+
+/** Where things should be. */
+typedef struct {
+	/** The task list (screen coordinates) - only the size is applied */
+	coreRect tasksRect;
+	/** The button, in the taskbar's client coordinates */
+	coreRect buttonRect;
+	/** The button, in screen coordinates */
+	coreRect buttonScreenRect;
+	bool vertical, rtl;
+} layoutResult;
+
+/** What was done last time, to determine what needs to be done next. */
+typedef struct {
+	/** Where the button was last put (client coordinates) */
+	coreRect buttonRect;
+	/** The last position reported to GPII (screen coordinates) */
+	coreRect notifiedRect;
+} layoutState;
+
+/** The operations returned by layoutDiff */
+#define LAYOUT_RESIZE_TASKS    1
+#define LAYOUT_MOVE_BUTTON     2
+#define LAYOUT_NOTIFY_POSITION 4
+
+/**
+ * Calculates the position of the button, and the size of the task list so the button fits between it and the
+ * notification icons. This has no side-effects.
+ * @param input The current geometry.
+ * @param result Receives the new geometry.
+ */
+void layoutCompute(const layoutInput *input, layoutResult *result);
+
+/**
+ * Determines which operations are needed to get from the current geometry to the calculated one, and records them
+ * as done.
+ * @param state What was done previously.
+ * @param input The current geometry.
+ * @param result The calculated geometry, from layoutCompute.
+ * @param force true to resize and move, even if not required.
+ * @return Bitmask of LAYOUT_* operations.
+ */
+uint32_t layoutDiff(layoutState *state, const layoutInput *input, const layoutResult *result, bool force);
+
+#endif /* TRAY_BUTTON_LAYOUT_H */
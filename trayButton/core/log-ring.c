@@ -0,0 +1,58 @@
+/* Task tray button - platform-neutral core.
+ * Lock-free queue of log messages, written to stdout by another thread.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "atomics.h"
+#include "log-ring.h"
+
+bool logRingWrite(logRing *ring, int level, const wchar_t *format, va_list args)
+{
+	uint32_t head = ring->head;
+	if (head - atomicLoad(&ring->tail) >= LOG_RING_SIZE) {
+		// Full; don't wait for the consumer.
+		atomicStore(&ring->dropped, ring->dropped + 1);
+		return false;
+	}
+
+	logRecord *record = &ring->records[head & (LOG_RING_SIZE - 1)];
+	record->level = level;
+	if (vswprintf(record->text, LOG_MESSAGE_LENGTH, format, args) < 0) {
+		// Too long (or bad) - keep what fitted.
+		record->text[LOG_MESSAGE_LENGTH - 1] = 0;
+	}
+
+	// Publish the record.
+	atomicStore(&ring->head, head + 1);
+	return true;
+}
+
+uint32_t logRingRead(logRing *ring, void (*sink)(void *context, const logRecord *record), void *context)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = atomicLoad(&ring->head);
+	uint32_t count = head - tail;
+
+	for (; tail != head; tail++) {
+		sink(context, &ring->records[tail & (LOG_RING_SIZE - 1)]);
+		// Give the slot back.
+		atomicStore(&ring->tail, tail + 1);
+	}
+
+	return count;
+}
+
+uint32_t logRingTakeDropped(logRing *ring)
+{
+	uint32_t dropped = atomicLoad(&ring->dropped);
+	uint32_t count = dropped - ring->droppedReported;
+	ring->droppedReported = dropped;
+	return count;
+}
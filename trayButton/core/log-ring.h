@@ -0,0 +1,86 @@
+/* Task tray button - platform-neutral core.
+ * Lock-free queue of log messages, written to stdout by another thread.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_LOG_RING_H
+#define TRAY_BUTTON_LOG_RING_H
+
+#include <stdarg.h>
+#include <wchar.h>
+#include "common.h"
+
+// Log levels
+#define LOG_DEBUG 0
+#define LOG_INFO  1
+#define LOG_FAIL  2
+
+/** Messages below this level are not compiled in. */
+#ifndef LOG_LEVEL
+# ifdef _DEBUG
+#  define LOG_LEVEL LOG_DEBUG
+# else
+#  define LOG_LEVEL LOG_INFO
+# endif
+#endif
+
+/** Number of messages the queue holds (a power of 2). */
+#define LOG_RING_SIZE 64
+/** Longest message (characters). Longer messages are truncated. */
+#define LOG_MESSAGE_LENGTH 2048
+
+typedef struct {
+	int level;
+	wchar_t text[LOG_MESSAGE_LENGTH];
+} logRecord;
+
+/**
+ * A single-producer, single-consumer ring buffer of log messages. The producer never waits: if the buffer is full,
+ * the message is dropped and counted.
+ */
+typedef struct {
+	/** Next record to write (only changed by the producer) */
+	volatile uint32_t head;
+	/** Next record to read (only changed by the consumer) */
+	volatile uint32_t tail;
+	/** Number of messages dropped because the buffer was full (only changed by the producer) */
+	volatile uint32_t dropped;
+	/** Number of dropped messages already reported (consumer) */
+	uint32_t droppedReported;
+	logRecord records[LOG_RING_SIZE];
+} logRing;
+
+/**
+ * Adds a message to the queue. Called by the producer.
+ * @param ring The queue.
+ * @param level The log level (LOG_*).
+ * @param format printf-style format (vswprintf).
+ * @param args The format arguments.
+ * @return false if the queue was full, and the message was dropped.
+ */
+bool logRingWrite(logRing *ring, int level, const wchar_t *format, va_list args);
+
+/**
+ * Takes the messages from the queue. Called by the consumer.
+ * @param ring The queue.
+ * @param sink Called for each message.
+ * @param context Passed to sink.
+ * @return The number of messages taken.
+ */
+uint32_t logRingRead(logRing *ring, void (*sink)(void *context, const logRecord *record), void *context);
+
+/**
+ * Gets the number of messages that have been dropped since the last call. Called by the consumer.
+ * @param ring The queue.
+ * @return The number of newly dropped messages.
+ */
+uint32_t logRingTakeDropped(logRing *ring);
+
+#endif /* TRAY_BUTTON_LOG_RING_H */
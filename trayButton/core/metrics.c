@@ -0,0 +1,96 @@
+/* Task tray button - platform-neutral core.
+ * Counters and latency histograms of the button's hot paths.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "json.h"
+#include "metrics.h"
+
+void metricTimerAdd(metricTimer *timer, uint64_t duration)
+{
+	uint64_t us = duration / 1000;
+	int bucket = 0;
+	while (bucket < HISTOGRAM_BUCKETS - 1 && us >= ((uint64_t)1 << bucket)) {
+		bucket++;
+	}
+
+	timer->count++;
+	timer->total += duration;
+	if (duration > timer->max) {
+		timer->max = duration;
+	}
+	timer->buckets[bucket]++;
+}
+
+uint32_t metricTimerPercentile(const metricTimer *timer, uint32_t percent)
+{
+	if (!timer->count) {
+		return 0;
+	}
+
+	// The number of samples at or below the percentile, rounded up.
+	uint64_t target = ((uint64_t)timer->count * percent + 99) / 100;
+	uint64_t seen = 0;
+	for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+		seen += timer->buckets[bucket];
+		if (seen >= target && seen > 0) {
+			if (bucket == HISTOGRAM_BUCKETS - 1) {
+				// Unbounded; the longest is the best estimate.
+				return (uint32_t)(timer->max / 1000);
+			}
+			return 1u << bucket;
+		}
+	}
+	return (uint32_t)(timer->max / 1000);
+}
+
+size_t metricsFormat(char *buffer, size_t size, const metricCounter *counters, int counterCount,
+	const metricTimer *timers, int timerCount)
+{
+	size_t length = 0;
+
+	jsonAppend(buffer, size, &length, "{\"counters\":{");
+	for (int n = 0; n < counterCount; n++) {
+		jsonAppend(buffer, size, &length, "%s\"%s\":%u", n ? "," : "", counters[n].name, counters[n].count);
+	}
+
+	jsonAppend(buffer, size, &length, "},\"timers\":{");
+	for (int n = 0; n < timerCount; n++) {
+		const metricTimer *t = &timers[n];
+		jsonAppend(buffer, size, &length, "%s\"%s\":{\"count\":%u,\"totalUs\":%llu,\"maxUs\":%llu,\"p50Us\":%u,\"p99Us\":%u,"
+			"\"buckets\":[", n ? "," : "", t->name, t->count, (unsigned long long)(t->total / 1000),
+			(unsigned long long)(t->max / 1000), metricTimerPercentile(t, 50), metricTimerPercentile(t, 99));
+		// Trailing empty buckets are left out.
+		int last = HISTOGRAM_BUCKETS - 1;
+		while (last >= 0 && !t->buckets[last]) {
+			last--;
+		}
+		for (int b = 0; b <= last; b++) {
+			jsonAppend(buffer, size, &length, "%s%u", b ? "," : "", t->buckets[b]);
+		}
+		jsonAppend(buffer, size, &length, "]}");
+	}
+	jsonAppend(buffer, size, &length, "}}");
+
+	return jsonFinish(buffer, size, length);
+}
+
+void metricsReset(metricCounter *counters, int counterCount, metricTimer *timers, int timerCount)
+{
+	for (int n = 0; n < counterCount; n++) {
+		counters[n].count = 0;
+	}
+	for (int n = 0; n < timerCount; n++) {
+		const char *name = timers[n].name;
+		memset(&timers[n], 0, sizeof(timers[n]));
+		timers[n].name = name;
+	}
+}
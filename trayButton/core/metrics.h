@@ -0,0 +1,77 @@
+/* Task tray button - platform-neutral core.
+ * Counters and latency histograms of the button's hot paths.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_METRICS_H
+#define TRAY_BUTTON_METRICS_H
+
+#include "common.h"
+
+/**
+ * Number of histogram buckets. Bucket n holds durations under 2^n microseconds, the last one holds everything else
+ * (over 0.5 seconds).
+ */
+#define HISTOGRAM_BUCKETS 20
+
+/** Enough room for the JSON of the button's metrics (see metricsFormat) */
+#define METRICS_JSON_LENGTH 4096
+
+/** The durations of calls to something. */
+typedef struct {
+	const char *name;
+	uint32_t count;
+	/** Total and longest durations (ns) */
+	uint64_t total, max;
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+} metricTimer;
+
+/** Counts something. */
+typedef struct {
+	const char *name;
+	uint32_t count;
+} metricCounter;
+
+/**
+ * Records the duration of a call.
+ * @param timer The timer.
+ * @param duration The duration, in nanoseconds.
+ */
+void metricTimerAdd(metricTimer *timer, uint64_t duration);
+
+/**
+ * Estimates a percentile of the durations, from the histogram.
+ * @param timer The timer.
+ * @param percent The percentile (0 - 100).
+ * @return The upper bound of the bucket containing the percentile, in microseconds (0 if there's nothing recorded).
+ */
+uint32_t metricTimerPercentile(const metricTimer *timer, uint32_t percent);
+
+/**
+ * Writes a snapshot of the metrics as JSON:
+ * {"counters":{"name":n,...},"timers":{"name":{"count":n,"totalUs":n,"maxUs":n,"p50Us":n,"p99Us":n,"buckets":[...]}}}
+ *
+ * @param buffer Receives the JSON (always null-terminated).
+ * @param size Size of the buffer.
+ * @param counters The counters.
+ * @param counterCount Number of counters.
+ * @param timers The timers.
+ * @param timerCount Number of timers.
+ * @return The length of the JSON, or 0 if the buffer is too small.
+ */
+size_t metricsFormat(char *buffer, size_t size, const metricCounter *counters, int counterCount,
+	const metricTimer *timers, int timerCount);
+
+/**
+ * Resets the values (but not the names) of the metrics.
+ */
+void metricsReset(metricCounter *counters, int counterCount, metricTimer *timers, int timerCount);
+
+#endif /* TRAY_BUTTON_METRICS_H */
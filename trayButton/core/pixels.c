@@ -0,0 +1,102 @@
+/* Task tray button - platform-neutral core.
+ * Operations on 32-bit pixel buffers.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "pixels.h"
+
+void copyPixels(uint32_t *dest, int destStride, const uint32_t *src, int srcStride, int width, int height)
+{
+	if (destStride == width && srcStride == width) {
+		memcpy(dest, src, (size_t)width * height * sizeof(uint32_t));
+		return;
+	}
+
+	for (int y = 0; y < height; y++) {
+		memcpy(dest, src, (size_t)width * sizeof(uint32_t));
+		dest += destStride;
+		src += srcStride;
+	}
+}
+
+void fillPixels(uint32_t *dest, int destStride, int left, int top, int right, int bottom, uint32_t pixel)
+{
+	dest += (size_t)top * destStride;
+	for (int y = top; y < bottom; y++) {
+		for (int x = left; x < right; x++) {
+			dest[x] = pixel;
+		}
+		dest += destStride;
+	}
+}
+
+/** Divides a product of two 8-bit values by 255, rounding. */
+static inline uint32_t div255(uint32_t v)
+{
+	v += 128;
+	return (v + (v >> 8)) >> 8;
+}
+
+void blendPixels(uint32_t *dest, int destStride, const uint32_t *src, int srcStride, int width, int height)
+{
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint32_t s = src[x];
+			uint32_t inv = 255 - (s >> 24);
+			if (inv == 255) {
+				continue;
+			} else if (inv == 0) {
+				dest[x] = s;
+				continue;
+			}
+			uint32_t d = dest[x];
+			// The red and blue channels together, then alpha and green.
+			uint32_t rb = div255((d & 0xff) * inv) | (div255(((d >> 16) & 0xff) * inv) << 16);
+			uint32_t ag = div255(((d >> 8) & 0xff) * inv) | (div255((d >> 24) * inv) << 16);
+			dest[x] = s + (rb | (ag << 8));
+		}
+		dest += destStride;
+		src += srcStride;
+	}
+}
+
+void premultiplyPixels(uint32_t *pixels, size_t count)
+{
+	for (size_t n = 0; n < count; n++) {
+		uint32_t p = pixels[n];
+		uint32_t a = p >> 24;
+		if (a == 255) {
+			continue;
+		}
+		pixels[n] = (a << 24) | (div255(((p >> 16) & 0xff) * a) << 16) | (div255(((p >> 8) & 0xff) * a) << 8)
+			| div255((p & 0xff) * a);
+	}
+}
+
+/** Divides a premultiplied channel by its alpha. */
+static inline uint32_t unpremultiply(uint32_t v, uint32_t a)
+{
+	v = (v * 255 + a / 2) / a;
+	return v > 255 ? 255 : v;
+}
+
+void unpremultiplyPixels(uint32_t *pixels, size_t count)
+{
+	for (size_t n = 0; n < count; n++) {
+		uint32_t p = pixels[n];
+		uint32_t a = p >> 24;
+		if (a == 255 || a == 0) {
+			continue;
+		}
+		pixels[n] = (a << 24) | (unpremultiply((p >> 16) & 0xff, a) << 16) | (unpremultiply((p >> 8) & 0xff, a) << 8)
+			| unpremultiply(p & 0xff, a);
+	}
+}
@@ -0,0 +1,66 @@
+/* Task tray button - platform-neutral core.
+ * Operations on 32-bit pixel buffers.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_PIXELS_H
+#define TRAY_BUTTON_PIXELS_H
+
+#include "common.h"
+
+/**
+ * Copies a block of pixels.
+ * @param dest The destination.
+ * @param destStride Width of a destination row, in pixels.
+ * @param src The source.
+ * @param srcStride Width of a source row, in pixels.
+ * @param width Number of pixels to copy from each row.
+ * @param height Number of rows.
+ */
+void copyPixels(uint32_t *dest, int destStride, const uint32_t *src, int srcStride, int width, int height);
+
+/**
+ * Fills a rectangle with a pixel value, without blending. Used to clear a buffer to a premultiplied colour.
+ * @param dest The buffer.
+ * @param destStride Width of a row, in pixels.
+ * @param left The rectangle.
+ * @param top
+ * @param right
+ * @param bottom
+ * @param pixel The pixel value.
+ */
+void fillPixels(uint32_t *dest, int destStride, int left, int top, int right, int bottom, uint32_t pixel);
+
+/**
+ * Blends a block of premultiplied pixels over another (source-over, like AlphaBlend with AC_SRC_ALPHA).
+ * @param dest The destination.
+ * @param destStride Width of a destination row, in pixels.
+ * @param src The source.
+ * @param srcStride Width of a source row, in pixels.
+ * @param width Number of pixels to blend from each row.
+ * @param height Number of rows.
+ */
+void blendPixels(uint32_t *dest, int destStride, const uint32_t *src, int srcStride, int width, int height);
+
+/**
+ * Converts pixels with straight alpha (like those of an icon file) to premultiplied alpha, in place.
+ * @param pixels The pixels.
+ * @param count Number of pixels.
+ */
+void premultiplyPixels(uint32_t *pixels, size_t count);
+
+/**
+ * Converts pixels with premultiplied alpha back to straight alpha, in place.
+ * @param pixels The pixels.
+ * @param count Number of pixels.
+ */
+void unpremultiplyPixels(uint32_t *pixels, size_t count);
+
+#endif /* TRAY_BUTTON_PIXELS_H */
@@ -0,0 +1,255 @@
+/* Task tray button - platform-neutral core.
+ * Anti-aliased scan-line rasterizer, for filling the shapes of vector icons.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "raster.h"
+
+bool rasterInit(rasterizer *r, int32_t width, int32_t height)
+{
+	memset(r, 0, sizeof(*r));
+	r->width = width;
+	r->height = height;
+	r->partial = calloc((size_t)width + 1, sizeof(float));
+	r->full = calloc((size_t)width + 1, sizeof(float));
+	r->starts = malloc(((size_t)height * RASTER_SUBSAMPLES + 1) * sizeof(uint32_t));
+	if (!r->partial || !r->full || !r->starts) {
+		rasterFree(r);
+		return false;
+	}
+	return true;
+}
+
+void rasterFree(rasterizer *r)
+{
+	free(r->edges);
+	free(r->active);
+	free(r->crossings);
+	free(r->sorted);
+	free(r->starts);
+	free(r->partial);
+	free(r->full);
+	memset(r, 0, sizeof(*r));
+}
+
+bool rasterLine(rasterizer *r, float x0, float y0, float x1, float y1)
+{
+	if (y0 == y1) {
+		// Doesn't cross any scan-lines.
+		return true;
+	}
+	if (!isfinite(x0) || !isfinite(y0) || !isfinite(x1) || !isfinite(y1)) {
+		// Can't be drawn (and its slope would be NaN).
+		return true;
+	}
+
+	if (r->edgeCount == r->edgeCapacity) {
+		uint32_t capacity = r->edgeCapacity ? r->edgeCapacity * 2 : 64;
+		rasterEdge *edges = realloc(r->edges, capacity * sizeof(rasterEdge));
+		if (edges) {
+			r->edges = edges;
+		}
+		uint32_t *active = realloc(r->active, capacity * sizeof(uint32_t));
+		if (active) {
+			r->active = active;
+		}
+		rasterCrossing *crossings = realloc(r->crossings, capacity * sizeof(rasterCrossing));
+		if (crossings) {
+			r->crossings = crossings;
+		}
+		rasterEdge *sorted = realloc(r->sorted, capacity * sizeof(rasterEdge));
+		if (sorted) {
+			r->sorted = sorted;
+		}
+		if (!edges || !active || !crossings || !sorted) {
+			return false;
+		}
+		r->edgeCapacity = capacity;
+	}
+
+	rasterEdge *e = &r->edges[r->edgeCount++];
+	if (y0 < y1) {
+		e->x = x0;
+		e->top = y0;
+		e->bottom = y1;
+		e->winding = 1;
+	} else {
+		e->x = x1;
+		e->top = y1;
+		e->bottom = y0;
+		e->winding = -1;
+	}
+	e->slope = (x1 - x0) / (y1 - y0);
+	r->edgesAdded++;
+	return true;
+}
+
+/** The first scan-line an edge crosses (or the number of scan-lines, if it doesn't cross any). */
+static uint32_t firstScanLine(const rasterizer *r, const rasterEdge *e)
+{
+	float line = ceilf(e->top * RASTER_SUBSAMPLES - 0.5f);
+	uint32_t lines = (uint32_t)r->height * RASTER_SUBSAMPLES;
+	return line <= 0 ? 0 : line >= (float)lines ? lines : (uint32_t)line;
+}
+
+/** Puts the edges in order of the first scan-line they cross. */
+static void sortEdges(rasterizer *r)
+{
+	uint32_t lines = (uint32_t)r->height * RASTER_SUBSAMPLES;
+	memset(r->starts, 0, (lines + 1) * sizeof(uint32_t));
+	for (uint32_t n = 0; n < r->edgeCount; n++) {
+		r->starts[firstScanLine(r, &r->edges[n])]++;
+	}
+	uint32_t total = 0;
+	for (uint32_t line = 0; line <= lines; line++) {
+		uint32_t count = r->starts[line];
+		r->starts[line] = total;
+		total += count;
+	}
+	for (uint32_t n = 0; n < r->edgeCount; n++) {
+		r->sorted[r->starts[firstScanLine(r, &r->edges[n])]++] = r->edges[n];
+	}
+}
+
+/** Adds the coverage of a span of a scan-line to the row. */
+static void addSpan(rasterizer *r, float x0, float x1, float weight)
+{
+	float width = (float)r->width;
+	// Written so a NaN ends up as 0, rather than indexing the row.
+	if (!(x0 > 0)) {
+		x0 = 0;
+	} else if (x0 > width) {
+		x0 = width;
+	}
+	if (!(x1 > 0)) {
+		x1 = 0;
+	} else if (x1 > width) {
+		x1 = width;
+	}
+	if (x1 <= x0) {
+		return;
+	}
+
+	int32_t i0 = (int32_t)x0, i1 = (int32_t)x1;
+	if (i0 == i1) {
+		r->partial[i0] += (x1 - x0) * weight;
+	} else {
+		// The ends are partly covered; the pixels between are fully covered.
+		r->partial[i0] += ((float)(i0 + 1) - x0) * weight;
+		r->full[i0 + 1] += weight;
+		r->full[i1] -= weight;
+		r->partial[i1] += (x1 - (float)i1) * weight;
+	}
+}
+
+void rasterFill(rasterizer *r, bool evenOdd, uint8_t *mask)
+{
+	const float weight = 1.0f / RASTER_SUBSAMPLES;
+	int32_t width = r->width;
+	uint32_t count = r->edgeCount, next = 0, activeCount = 0;
+
+	memset(mask, 0, (size_t)width * r->height);
+	r->fills++;
+	if (!count) {
+		return;
+	}
+
+	sortEdges(r);
+	int32_t y = (int32_t)(firstScanLine(r, &r->sorted[0]) / RASTER_SUBSAMPLES);
+
+	for (; y < r->height && (next < count || activeCount); y++) {
+		bool covered = false;
+		memset(r->partial, 0, ((size_t)width + 1) * sizeof(float));
+		memset(r->full, 0, ((size_t)width + 1) * sizeof(float));
+
+		for (int sample = 0; sample < RASTER_SUBSAMPLES; sample++) {
+			float scanY = (float)y + ((float)sample + 0.5f) * weight;
+
+			// After sorting, starts[line] is the end of the edges starting at the line.
+			while (next < r->starts[y * RASTER_SUBSAMPLES + sample]) {
+				r->active[activeCount++] = next++;
+			}
+
+			// Where the edges cross the scan-line, in order.
+			uint32_t crossingCount = 0;
+			for (uint32_t n = 0; n < activeCount;) {
+				rasterEdge *e = &r->sorted[r->active[n]];
+				if (e->bottom <= scanY) {
+					r->active[n] = r->active[--activeCount];
+					continue;
+				}
+
+				rasterCrossing c;
+				c.x = e->x + (scanY - e->top) * e->slope;
+				c.winding = e->winding;
+				uint32_t k = crossingCount++;
+				while (k > 0 && r->crossings[k - 1].x > c.x) {
+					r->crossings[k] = r->crossings[k - 1];
+					k--;
+				}
+				r->crossings[k] = c;
+				n++;
+			}
+
+			// The spans which are inside.
+			int32_t winding = 0;
+			float start = 0;
+			for (uint32_t n = 0; n < crossingCount; n++) {
+				bool wasInside = evenOdd ? (winding & 1) != 0 : winding != 0;
+				winding += r->crossings[n].winding;
+				bool inside = evenOdd ? (winding & 1) != 0 : winding != 0;
+				if (inside && !wasInside) {
+					start = r->crossings[n].x;
+				} else if (wasInside && !inside) {
+					addSpan(r, start, r->crossings[n].x, weight);
+					covered = true;
+				}
+			}
+		}
+
+		if (covered) {
+			uint8_t *row = mask + (size_t)y * width;
+			float full = 0;
+			for (int32_t x = 0; x < width; x++) {
+				full += r->full[x];
+				float coverage = (full + r->partial[x]) * 255.0f + 0.5f;
+				row[x] = coverage >= 255.0f ? 255 : coverage <= 0 ? 0 : (uint8_t)coverage;
+			}
+		}
+	}
+
+	r->edgeCount = 0;
+}
+
+void rasterBlend(uint32_t *pixels, const uint8_t *mask, size_t count, uint32_t color)
+{
+	for (size_t n = 0; n < count; n++) {
+		uint32_t m = mask[n];
+		if (!m) {
+			continue;
+		}
+
+		// The colour, scaled by the coverage, over the pixel.
+		uint32_t src = 0, dest = pixels[n], out = 0;
+		for (int shift = 0; shift < 32; shift += 8) {
+			uint32_t v = ((color >> shift) & 0xff) * m + 128;
+			src |= ((v + (v >> 8)) >> 8) << shift;
+		}
+		uint32_t inv = 255 - (src >> 24);
+		for (int shift = 0; shift < 32; shift += 8) {
+			uint32_t v = ((dest >> shift) & 0xff) * inv + 128;
+			out |= (((src >> shift) & 0xff) + ((v + (v >> 8)) >> 8)) << shift;
+		}
+		pixels[n] = out;
+	}
+}
@@ -0,0 +1,104 @@
+/* Task tray button - platform-neutral core.
+ * Anti-aliased scan-line rasterizer, for filling the shapes of vector icons.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_RASTER_H
+#define TRAY_BUTTON_RASTER_H
+
+#include "common.h"
+
+/*
+ * A shape is added as a set of edges (closed polygons, in pixel co-ordinates), then filled into a coverage mask. Each
+ * row of pixels is sampled by RASTER_SUBSAMPLES scan-lines; on each one, the spans inside the shape (by the non-zero or
+ * even-odd rule) are found from the edges crossing it, and their exact horizontal coverage is added to the pixels.
+ * The edges are put in order of the first scan-line they cross with a counting sort, rather than by comparing them.
+ */
+
+/** Scan-lines per row of pixels */
+#define RASTER_SUBSAMPLES 16
+
+/** An edge, going down the image. */
+typedef struct {
+	float x, top, bottom;
+	/** Change in x for each unit of y */
+	float slope;
+	/** +1 if it went down, -1 if it went up */
+	int32_t winding;
+} rasterEdge;
+
+/** A crossing of an edge and a scan-line. */
+typedef struct {
+	float x;
+	int32_t winding;
+} rasterCrossing;
+
+typedef struct {
+	int32_t width, height;
+	rasterEdge *edges;
+	uint32_t edgeCount, edgeCapacity;
+	/** Edges crossing the current scan-line, and where (edgeCapacity of each) */
+	uint32_t *active;
+	rasterCrossing *crossings;
+	/** The edges, in the order of the first scan-line they cross (edgeCapacity) */
+	rasterEdge *sorted;
+	/** Index in sorted of the first edge starting at each scan-line (height * RASTER_SUBSAMPLES + 1) */
+	uint32_t *starts;
+	/** Coverage of the current row: the partly covered pixels, and the change in full coverage (width + 1 each) */
+	float *partial, *full;
+	/** Statistics: edges added, shapes filled */
+	uint32_t edgesAdded, fills;
+} rasterizer;
+
+/**
+ * Initialises a rasterizer.
+ * @param r The rasterizer.
+ * @param width Size of the image.
+ * @param height
+ * @return false if there's no memory.
+ */
+bool rasterInit(rasterizer *r, int32_t width, int32_t height);
+
+/**
+ * Frees the rasterizer's memory.
+ * @param r The rasterizer.
+ */
+void rasterFree(rasterizer *r);
+
+/**
+ * Adds an edge of the shape. The edges must make closed polygons; horizontal ones are ignored, as are those with a
+ * co-ordinate that isn't finite.
+ * @param r The rasterizer.
+ * @param x0 Start of the edge.
+ * @param y0
+ * @param x1 End of the edge.
+ * @param y1
+ * @return false if there's no memory.
+ */
+bool rasterLine(rasterizer *r, float x0, float y0, float x1, float y1);
+
+/**
+ * Fills the shape made by the edges, and removes them for the next shape.
+ * @param r The rasterizer.
+ * @param evenOdd true for the even-odd fill rule, false for non-zero.
+ * @param mask Receives width * height coverage values, 0 to 255.
+ */
+void rasterFill(rasterizer *r, bool evenOdd, uint8_t *mask);
+
+/**
+ * Blends a colour over pixels, through a coverage mask.
+ * @param pixels The premultiplied pixels.
+ * @param mask The coverage of each pixel.
+ * @param count Number of pixels.
+ * @param color The premultiplied colour.
+ */
+void rasterBlend(uint32_t *pixels, const uint8_t *mask, size_t count, uint32_t color);
+
+#endif /* TRAY_BUTTON_RASTER_H */
@@ -0,0 +1,202 @@
+/* Task tray button - platform-neutral core.
+ * High-contrast recolouring of the button image.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "recolor.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+# define RECOLOR_X86 1
+# ifdef _MSC_VER
+#  include <intrin.h>
+#  define TARGET_SSE2
+#  define TARGET_AVX2
+# else
+#  define TARGET_SSE2 __attribute__((target("sse2")))
+#  define TARGET_AVX2 __attribute__((target("avx2")))
+# endif
+# include <immintrin.h>
+#endif
+
+#define OPAQUE 0xff000000
+
+void recolorTableInit(recolorTable *table, uint32_t foreground, uint32_t background)
+{
+	if (table->valid && table->foreground == foreground && table->background == background) {
+		return;
+	}
+
+	uint32_t fg = COLORREF_TO_PIXEL(foreground), bg = COLORREF_TO_PIXEL(background);
+	for (uint32_t c = 0; c < 256; c++) {
+		uint32_t color = OPAQUE;
+		for (int shift = 0; shift < 24; shift += 8) {
+			uint32_t f = (fg >> shift) & 0xff, b = (bg >> shift) & 0xff;
+			color |= ((f * c + b * (255 - c) + 127) / 255) << shift;
+		}
+		table->colors[c] = color;
+	}
+
+	table->foreground = foreground;
+	table->background = background;
+	table->valid = true;
+}
+
+static void recolorScalar(const recolorTable *table, uint32_t *pixels, size_t count)
+{
+	for (size_t n = 0; n < count; n++) {
+		pixels[n] = table->colors[recolorCoverage(pixels[n])];
+	}
+}
+
+#ifdef RECOLOR_X86
+
+/** Calculates the coverage (see recolorCoverage) of 4 pixels. */
+TARGET_SSE2 static __m128i coverageSse2(__m128i p)
+{
+	const __m128i mask = _mm_set1_epi32(0xff);
+	__m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+	__m128i b = _mm_and_si128(p, mask);
+	__m128i a = _mm_srli_epi32(p, 24);
+
+	// The products fit in 16 bits, and the upper half of each 32-bit lane is 0.
+	__m128i lum = _mm_add_epi32(
+		_mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(77)), _mm_mullo_epi16(g, _mm_set1_epi32(150))),
+		_mm_add_epi32(_mm_mullo_epi16(b, _mm_set1_epi32(29)), _mm_set1_epi32(128)));
+	lum = _mm_srli_epi32(lum, 8);
+
+	__m128i x = _mm_add_epi32(_mm_mullo_epi16(lum, a), _mm_set1_epi32(128));
+	return _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 8)), 8);
+}
+
+TARGET_SSE2 static void recolorSse2(const recolorTable *table, uint32_t *pixels, size_t count)
+{
+	size_t n = 0;
+	uint32_t index[4];
+	for (; n + 4 <= count; n += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(pixels + n));
+		_mm_storeu_si128((__m128i*)index, coverageSse2(p));
+		pixels[n] = table->colors[index[0]];
+		pixels[n + 1] = table->colors[index[1]];
+		pixels[n + 2] = table->colors[index[2]];
+		pixels[n + 3] = table->colors[index[3]];
+	}
+	recolorScalar(table, pixels + n, count - n);
+}
+
+TARGET_AVX2 static void recolorAvx2(const recolorTable *table, uint32_t *pixels, size_t count)
+{
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	const __m256i round = _mm256_set1_epi32(128);
+	size_t n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i*)(pixels + n));
+		__m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+		__m256i b = _mm256_and_si256(p, mask);
+		__m256i a = _mm256_srli_epi32(p, 24);
+
+		__m256i lum = _mm256_add_epi32(
+			_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(77)), _mm256_mullo_epi32(g, _mm256_set1_epi32(150))),
+			_mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(29)), round));
+		lum = _mm256_srli_epi32(lum, 8);
+
+		__m256i x = _mm256_add_epi32(_mm256_mullo_epi32(lum, a), round);
+		__m256i coverage = _mm256_srli_epi32(_mm256_add_epi32(x, _mm256_srli_epi32(x, 8)), 8);
+
+		__m256i result = _mm256_i32gather_epi32((const int*)table->colors, coverage, 4);
+		_mm256_storeu_si256((__m256i*)(pixels + n), result);
+	}
+	recolorScalar(table, pixels + n, count - n);
+}
+
+/**
+ * Checks if the CPU (and OS) supports AVX2.
+ */
+static bool hasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	// OSXSAVE and AVX
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+		return false;
+	}
+	// The OS saves the YMM registers
+	if ((_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool hasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif /* RECOLOR_X86 */
+
+recolorImpl recolorBestImpl()
+{
+	static recolorImpl best = RECOLOR_AUTO;
+	if (best == RECOLOR_AUTO) {
+#ifdef RECOLOR_X86
+		best = hasAvx2() ? RECOLOR_AVX2 : hasSse2() ? RECOLOR_SSE2 : RECOLOR_SCALAR;
+#else
+		best = RECOLOR_SCALAR;
+#endif
+	}
+	return best;
+}
+
+void recolorPixelsWith(recolorImpl impl, const recolorTable *table, uint32_t *pixels, size_t count)
+{
+	recolorImpl best = recolorBestImpl();
+	if (impl == RECOLOR_AUTO || impl > best) {
+		impl = best;
+	}
+
+	switch (impl) {
+#ifdef RECOLOR_X86
+	case RECOLOR_AVX2:
+		recolorAvx2(table, pixels, count);
+		break;
+	case RECOLOR_SSE2:
+		recolorSse2(table, pixels, count);
+		break;
+#endif
+	default:
+		recolorScalar(table, pixels, count);
+		break;
+	}
+}
+
+void recolorPixels(const recolorTable *table, uint32_t *pixels, size_t count)
+{
+	recolorPixelsWith(RECOLOR_AUTO, table, pixels, count);
+}
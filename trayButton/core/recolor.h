@@ -0,0 +1,88 @@
+/* Task tray button - platform-neutral core.
+ * High-contrast recolouring of the button image.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_RECOLOR_H
+#define TRAY_BUTTON_RECOLOR_H
+
+#include "common.h"
+
+/** Convert a COLORREF (0x00bbggrr) to a 32-bit DIB pixel (0xaarrggbb) */
+#define COLORREF_TO_PIXEL(C) ((((C) << 16) & 0xff0000) | ((C) & 0xff00) | (((C) >> 16) & 0xff))
+
+/**
+ * The result of every blend between the background and foreground colours. Indexed by coverage, 0 (background) to
+ * 255 (foreground).
+ */
+typedef struct {
+	uint32_t colors[256];
+	/** The colours the table was made for (COLORREF) */
+	uint32_t foreground, background;
+	bool valid;
+} recolorTable;
+
+/** The implementations of the kernel. */
+typedef enum {
+	RECOLOR_SCALAR,
+	RECOLOR_SSE2,
+	RECOLOR_AVX2,
+	RECOLOR_AUTO
+} recolorImpl;
+
+/**
+ * Fills the blend table for a pair of colours. Does nothing if the table is already for these colours.
+ * @param table The table.
+ * @param foreground Foreground colour (COLORREF).
+ * @param background Background colour (COLORREF).
+ */
+void recolorTableInit(recolorTable *table, uint32_t foreground, uint32_t background);
+
+/**
+ * Change the pixels of an image to the high-contrast colours, while taking the image's anti-aliasing into
+ * consideration. The image is assumed to be light on dark: the coverage of a pixel is its luminance multiplied by its
+ * alpha, so black or transparent becomes the background colour, opaque white becomes the foreground colour, and
+ * everything between is blended. The result is opaque.
+ *
+ * @param table Blend table for the colours.
+ * @param pixels The 32-bit ARGB pixels, modified in place.
+ * @param count Number of pixels.
+ */
+void recolorPixels(const recolorTable *table, uint32_t *pixels, size_t count);
+
+/**
+ * Like recolorPixels, using a specific implementation. The SIMD implementations produce the same result as the scalar
+ * one.
+ * @param impl The implementation; falls back to the scalar one if it's not supported by the CPU.
+ */
+void recolorPixelsWith(recolorImpl impl, const recolorTable *table, uint32_t *pixels, size_t count);
+
+/**
+ * Gets the implementation used by recolorPixels: the best one supported by the CPU.
+ * @return The implementation.
+ */
+recolorImpl recolorBestImpl();
+
+/**
+ * Determines the coverage of a pixel, as used by the kernels.
+ * @param pixel The pixel.
+ * @return Coverage of the foreground colour, 0 - 255.
+ */
+static inline uint32_t recolorCoverage(uint32_t pixel)
+{
+	uint32_t r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff, a = pixel >> 24;
+	// BT.601 luminance, weights add up to 256.
+	uint32_t lum = (r * 77 + g * 150 + b * 29 + 128) >> 8;
+	// lum * a / 255, rounded (exact for the range)
+	uint32_t x = lum * a + 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+#endif /* TRAY_BUTTON_RECOLOR_H */
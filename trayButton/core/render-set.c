@@ -0,0 +1,171 @@
+/* Task tray button - platform-neutral core.
+ * Rendering resources shared by the buttons: an atlas for each size of button, and the icon decoded at each size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "render-set.h"
+
+void renderSetInit(renderSet *set, const renderHooks *hooks)
+{
+	memset(set, 0, sizeof(*set));
+	set->hooks = *hooks;
+}
+
+static bool atlasMatches(const renderAtlas *a, int32_t width, int32_t height, int32_t iconSize)
+{
+	return a->slot.used && a->atlas.key.width == width && a->atlas.key.height == height
+		&& a->atlas.key.iconSize == iconSize;
+}
+
+static bool iconMatches(const renderIcon *i, uint32_t iconId, int32_t size)
+{
+	return i->slot.used && i->iconId == iconId && i->size == size;
+}
+
+/** Takes a slot which matched: one being used by another button, or one being kept. */
+static void takeSlot(renderSet *set, renderSlot *slot)
+{
+	if (slot->users++) {
+		set->shared++;
+	} else {
+		set->kept++;
+	}
+}
+
+static void releaseSlot(renderSet *set, renderSlot *slot)
+{
+	if (slot && slot->users && !--slot->users) {
+		slot->released = ++set->clock;
+	}
+}
+
+/**
+ * Determines if a free slot is a better one to re-use than another: one that's never been used, otherwise the one
+ * released the longest time ago.
+ */
+static bool betterFree(const renderSlot *slot, const renderSlot *best)
+{
+	if (slot->users) {
+		return false;
+	} else if (!best) {
+		return true;
+	} else if (!slot->used || !best->used) {
+		return !slot->used && best->used;
+	}
+	return slot->released < best->released;
+}
+
+renderAtlas *renderAtlasAcquire(renderSet *set, renderAtlas *current, int32_t width, int32_t height,
+	int32_t iconSize)
+{
+	if (current && atlasMatches(current, width, height, iconSize)) {
+		return current;
+	}
+	releaseSlot(set, current ? &current->slot : null);
+
+	renderAtlas *best = null;
+	for (int n = 0; n < RENDER_SLOTS; n++) {
+		renderAtlas *a = &set->atlases[n];
+		if (atlasMatches(a, width, height, iconSize)) {
+			takeSlot(set, &a->slot);
+			return a;
+		} else if (betterFree(&a->slot, best ? &best->slot : null)) {
+			best = a;
+		}
+	}
+
+	if (!best) {
+		return null;
+	}
+
+	if (best->slot.used) {
+		set->evicted++;
+	}
+	if (best->surface) {
+		set->hooks.freeSurface(set->hooks.context, best->surface);
+	}
+	memset(best, 0, sizeof(*best));
+	best->slot.used = true;
+	best->slot.users = 1;
+	best->atlas.key.width = width;
+	best->atlas.key.height = height;
+	best->atlas.key.iconSize = iconSize;
+	set->created++;
+	return best;
+}
+
+void renderAtlasRelease(renderSet *set, renderAtlas *atlas)
+{
+	releaseSlot(set, atlas ? &atlas->slot : null);
+}
+
+renderIcon *renderIconAcquire(renderSet *set, renderIcon *current, uint32_t iconId, int32_t size)
+{
+	if (current && iconMatches(current, iconId, size)) {
+		return current;
+	}
+	releaseSlot(set, current ? &current->slot : null);
+
+	renderIcon *best = null;
+	for (int n = 0; n < RENDER_SLOTS; n++) {
+		renderIcon *i = &set->icons[n];
+		if (iconMatches(i, iconId, size)) {
+			takeSlot(set, &i->slot);
+			return i;
+		} else if (betterFree(&i->slot, best ? &best->slot : null)) {
+			best = i;
+		}
+	}
+
+	if (!best) {
+		return null;
+	}
+
+	if (best->slot.used) {
+		set->evicted++;
+	}
+	if (best->icon) {
+		set->hooks.freeIcon(set->hooks.context, best->icon);
+	}
+	memset(best, 0, sizeof(*best));
+	best->slot.used = true;
+	best->slot.users = 1;
+	best->iconId = iconId;
+	best->size = size;
+	set->created++;
+	return best;
+}
+
+void renderIconRelease(renderSet *set, renderIcon *icon)
+{
+	releaseSlot(set, icon ? &icon->slot : null);
+}
+
+void renderSetInvalidate(renderSet *set)
+{
+	for (int n = 0; n < RENDER_SLOTS; n++) {
+		atlasInvalidate(&set->atlases[n].atlas);
+	}
+}
+
+void renderSetClear(renderSet *set)
+{
+	for (int n = 0; n < RENDER_SLOTS; n++) {
+		if (set->atlases[n].surface) {
+			set->hooks.freeSurface(set->hooks.context, set->atlases[n].surface);
+		}
+		if (set->icons[n].icon) {
+			set->hooks.freeIcon(set->hooks.context, set->icons[n].icon);
+		}
+	}
+	memset(set->atlases, 0, sizeof(set->atlases));
+	memset(set->icons, 0, sizeof(set->icons));
+}
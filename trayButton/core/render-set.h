@@ -0,0 +1,130 @@
+/* Task tray button - platform-neutral core.
+ * Rendering resources shared by the buttons: an atlas for each size of button, and the icon decoded at each size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_RENDER_SET_H
+#define TRAY_BUTTON_RENDER_SET_H
+
+#include "common.h"
+#include "atlas.h"
+
+/*
+ * Buttons on taskbars with the same DPI are the same size, so they can use the same atlas and icon. When no button is
+ * using one, it's kept (with its surface or icon) until the slot is needed for a different size, in case a button
+ * goes back to it (like a window being dragged between monitors).
+ */
+
+/** Number of atlases, and of icons */
+#define RENDER_SLOTS 8
+
+/** Use count, and age, of an atlas or icon. */
+typedef struct {
+	/** Number of buttons using it */
+	uint32_t users;
+	/** When it was last released (for picking which free one to re-use) */
+	uint32_t released;
+	/** It has a size (and maybe a surface or icon) */
+	bool used;
+} renderSlot;
+
+/** The rendered frames of one size of button. */
+typedef struct {
+	renderSlot slot;
+	/** The cells; the size fields of the key identify it */
+	spriteAtlas atlas;
+	/** The platform's surface (null until it's created) */
+	void *surface;
+} renderAtlas;
+
+/** An icon, decoded at one size. */
+typedef struct {
+	renderSlot slot;
+	/** Identifies the icon */
+	uint32_t iconId;
+	int32_t size;
+	/** The platform's icon (null until it's decoded) */
+	void *icon;
+} renderIcon;
+
+/** How the platform's resources are freed. */
+typedef struct {
+	void (*freeSurface)(void *context, void *surface);
+	void (*freeIcon)(void *context, void *icon);
+	void *context;
+} renderHooks;
+
+typedef struct {
+	renderHooks hooks;
+	renderAtlas atlases[RENDER_SLOTS];
+	renderIcon icons[RENDER_SLOTS];
+	/** Incremented on each release */
+	uint32_t clock;
+	/** Statistics: acquired one another button was using, acquired a kept one, made a new one, freed one to re-use */
+	uint32_t shared, kept, created, evicted;
+} renderSet;
+
+/**
+ * Initialises the set.
+ * @param set The set.
+ * @param hooks How the resources are freed.
+ */
+void renderSetInit(renderSet *set, const renderHooks *hooks);
+
+/**
+ * Gets the atlas for a size of button, for a button which was using another one (which is released).
+ * Call atlasUpdate with the rest of the key; the surface needs creating if it's null, or if atlasUpdate returns true.
+ * @param set The set.
+ * @param current The atlas the button currently has (or null).
+ * @param width Width of the button.
+ * @param height Height of the button.
+ * @param iconSize Size of the icon.
+ * @return The atlas, or null if every one is being used by buttons of other sizes.
+ */
+renderAtlas *renderAtlasAcquire(renderSet *set, renderAtlas *current, int32_t width, int32_t height,
+	int32_t iconSize);
+
+/**
+ * Releases an atlas, when the button has gone.
+ * @param set The set.
+ * @param atlas The atlas (or null).
+ */
+void renderAtlasRelease(renderSet *set, renderAtlas *atlas);
+
+/**
+ * Gets an icon at a size, for a button which was using another one (which is released).
+ * @param set The set.
+ * @param current The icon the button currently has (or null).
+ * @param iconId Identifies the icon.
+ * @param size The size.
+ * @return The icon, which needs decoding if its icon field is null; or null if every one is being used.
+ */
+renderIcon *renderIconAcquire(renderSet *set, renderIcon *current, uint32_t iconId, int32_t size);
+
+/**
+ * Releases an icon, when the button has gone.
+ * @param set The set.
+ * @param icon The icon (or null).
+ */
+void renderIconRelease(renderSet *set, renderIcon *icon);
+
+/**
+ * Discards the cells of every atlas (the system colours have changed).
+ * @param set The set.
+ */
+void renderSetInvalidate(renderSet *set);
+
+/**
+ * Frees all the surfaces and icons. Nothing should be using them.
+ * @param set The set.
+ */
+void renderSetClear(renderSet *set);
+
+#endif /* TRAY_BUTTON_RENDER_SET_H */
@@ -0,0 +1,59 @@
+/* Task tray button - platform-neutral core.
+ * Decides how often the button checks the taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "scheduler.h"
+
+void schedulerInit(pollScheduler *scheduler, uint32_t resizeDelay, uint32_t minCheckDelay, uint32_t maxCheckDelay)
+{
+	pollScheduler s = { 0 };
+	s.resizeDelay = resizeDelay;
+	s.minCheckDelay = minCheckDelay;
+	s.maxCheckDelay = maxCheckDelay;
+	s.checkDelay = minCheckDelay;
+	*scheduler = s;
+}
+
+uint32_t schedulerActivity(pollScheduler *scheduler, uint64_t now)
+{
+	scheduler->activity++;
+	scheduler->lastActivity = now;
+	scheduler->checkDelay = scheduler->minCheckDelay;
+	scheduler->checkDue = now + scheduler->checkDelay;
+	return scheduler->checkDelay;
+}
+
+uint32_t schedulerCheck(pollScheduler *scheduler, uint64_t now)
+{
+	scheduler->wakeups++;
+
+	// Nothing has changed, so wait twice as long next time.
+	uint32_t delay = scheduler->checkDelay * 2;
+	if (delay > scheduler->maxCheckDelay || delay < scheduler->checkDelay) {
+		delay = scheduler->maxCheckDelay;
+	}
+
+	scheduler->checkDelay = delay;
+	scheduler->checkDue = now + delay;
+	return delay;
+}
+
+uint32_t schedulerResize(pollScheduler *scheduler, bool changed)
+{
+	scheduler->wakeups++;
+	return changed ? scheduler->resizeDelay : 0;
+}
+
+uint32_t schedulerTolerance(uint32_t delay)
+{
+	// Being a quarter late doesn't matter when nothing's happening; the fast timers need to be on time.
+	return delay < 1000 ? 0 : delay / 4;
+}
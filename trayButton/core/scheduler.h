@@ -0,0 +1,82 @@
+/* Task tray button - platform-neutral core.
+ * Decides how often the button checks the taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_SCHEDULER_H
+#define TRAY_BUTTON_SCHEDULER_H
+
+#include "common.h"
+
+/**
+ * The shell sometimes moves things around without telling anyone, so the button polls the taskbar. Shortly after
+ * something has happened, it polls quickly (the "resize" timer). After that, it checks periodically (the "check"
+ * timer), backing off exponentially while nothing changes, and returning to the shortest delay when there's activity.
+ */
+typedef struct {
+	/** Delay of the resize timer, while things are changing (ms) */
+	uint32_t resizeDelay;
+	/** Delay of the first check after some activity (ms) */
+	uint32_t minCheckDelay;
+	/** Longest delay between checks (ms) */
+	uint32_t maxCheckDelay;
+
+	/** The delay of the current check timer */
+	uint32_t checkDelay;
+	/** When the check timer is due */
+	uint64_t checkDue;
+	/** When something last happened */
+	uint64_t lastActivity;
+
+	/** Statistics */
+	uint32_t wakeups, activity;
+} pollScheduler;
+
+/**
+ * Initialises the scheduler.
+ * @param scheduler The scheduler.
+ * @param resizeDelay Delay of the resize timer (ms).
+ * @param minCheckDelay Delay of the first check after activity (ms).
+ * @param maxCheckDelay Longest delay between checks (ms).
+ */
+void schedulerInit(pollScheduler *scheduler, uint32_t resizeDelay, uint32_t minCheckDelay, uint32_t maxCheckDelay);
+
+/**
+ * Something has happened (a shell or size event, or the taskbar changed).
+ * @param scheduler The scheduler.
+ * @param now The current time (ms).
+ * @return The delay of the next check.
+ */
+uint32_t schedulerActivity(pollScheduler *scheduler, uint64_t now);
+
+/**
+ * The check timer has fired, and nothing has changed.
+ * @param scheduler The scheduler.
+ * @param now The current time (ms).
+ * @return The delay of the next check.
+ */
+uint32_t schedulerCheck(pollScheduler *scheduler, uint64_t now);
+
+/**
+ * The resize timer has fired.
+ * @param scheduler The scheduler.
+ * @param changed true if the taskbar changed since the last tick.
+ * @return The delay of the next resize tick, or 0 to stop the timer.
+ */
+uint32_t schedulerResize(pollScheduler *scheduler, bool changed);
+
+/**
+ * Gets the amount a timer can be delayed by, so it can be coalesced with other timers.
+ * @param delay The delay of the timer (ms).
+ * @return The tolerance (ms).
+ */
+uint32_t schedulerTolerance(uint32_t delay);
+
+#endif /* TRAY_BUTTON_SCHEDULER_H */
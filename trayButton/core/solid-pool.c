@@ -0,0 +1,65 @@
+/* Task tray button - platform-neutral core.
+ * Pool of the single-pixel surfaces used to draw translucent rectangles.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "solid-pool.h"
+
+uint32_t premultiplyColor(uint32_t color, uint8_t alpha)
+{
+	uint32_t r = color & 0xff, g = (color >> 8) & 0xff, b = (color >> 16) & 0xff;
+	return ((uint32_t)alpha << 24)
+		| ((alpha * r / 0xff) << 16)
+		| ((alpha * g / 0xff) << 8)
+		| (alpha * b / 0xff);
+}
+
+void *solidPoolFind(solidPool *pool, uint32_t pixel)
+{
+	for (int n = 0; n < SOLID_POOL_SIZE; n++) {
+		solidPoolEntry *entry = &pool->entries[n];
+		if (entry->surface && entry->pixel == pixel) {
+			entry->lastUsed = ++pool->clock;
+			pool->hits++;
+			return entry->surface;
+		}
+	}
+
+	pool->misses++;
+	return null;
+}
+
+void *solidPoolAdd(solidPool *pool, uint32_t pixel, void *surface)
+{
+	// Use a free entry, or the least recently used one.
+	solidPoolEntry *entry = &pool->entries[0];
+	for (int n = 0; n < SOLID_POOL_SIZE && entry->surface; n++) {
+		solidPoolEntry *e = &pool->entries[n];
+		if (!e->surface || e->lastUsed < entry->lastUsed) {
+			entry = e;
+		}
+	}
+
+	void *removed = entry->surface;
+	entry->pixel = pixel;
+	entry->surface = surface;
+	entry->lastUsed = ++pool->clock;
+	return removed;
+}
+
+void solidPoolClear(solidPool *pool, void (*freeSurface)(void *surface))
+{
+	for (int n = 0; n < SOLID_POOL_SIZE; n++) {
+		if (pool->entries[n].surface) {
+			freeSurface(pool->entries[n].surface);
+			pool->entries[n].surface = null;
+		}
+	}
+}
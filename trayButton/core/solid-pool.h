@@ -0,0 +1,68 @@
+/* Task tray button - platform-neutral core.
+ * Pool of the single-pixel surfaces used to draw translucent rectangles.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_SOLID_POOL_H
+#define TRAY_BUTTON_SOLID_POOL_H
+
+#include "common.h"
+
+/** Number of surfaces kept. Only a handful of colours are used. */
+#define SOLID_POOL_SIZE 8
+
+typedef struct {
+	/** The premultiplied pixel of the surface */
+	uint32_t pixel;
+	/** The platform's surface (null if the entry is unused) */
+	void *surface;
+	uint32_t lastUsed;
+} solidPoolEntry;
+
+typedef struct {
+	solidPoolEntry entries[SOLID_POOL_SIZE];
+	uint32_t clock;
+	/** Statistics */
+	uint32_t hits, misses;
+} solidPool;
+
+/**
+ * Makes the premultiplied 32-bit pixel of a translucent colour.
+ * @param color The colour (COLORREF, 0x00bbggrr).
+ * @param alpha Alpha amount, 0 (transparent) - 0xff (opaque)
+ * @return The pixel (0xaarrggbb, premultiplied).
+ */
+uint32_t premultiplyColor(uint32_t color, uint8_t alpha);
+
+/**
+ * Gets the surface for a pixel.
+ * @param pool The pool.
+ * @param pixel The premultiplied pixel.
+ * @return The surface, or null if the pool doesn't have one.
+ */
+void *solidPoolFind(solidPool *pool, uint32_t pixel);
+
+/**
+ * Adds a surface to the pool, replacing the least recently used one if the pool is full.
+ * @param pool The pool.
+ * @param pixel The premultiplied pixel of the surface.
+ * @param surface The surface.
+ * @return The surface that was removed from the pool to make room (to be freed by the caller), or null.
+ */
+void *solidPoolAdd(solidPool *pool, uint32_t pixel, void *surface);
+
+/**
+ * Removes all surfaces from the pool.
+ * @param pool The pool.
+ * @param freeSurface Called for each surface.
+ */
+void solidPoolClear(solidPool *pool, void (*freeSurface)(void *surface));
+
+#endif /* TRAY_BUTTON_SOLID_POOL_H */
@@ -0,0 +1,77 @@
+/* Task tray button - platform-neutral core.
+ * Spans of time taken by the button, for a timeline of a click (or anything else), in the Chrome trace-event format.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "json.h"
+#include "span.h"
+
+/** The category of the button's events */
+#define SPAN_CATEGORY "tray-button"
+
+const span *spanRecord(spanRecorder *recorder, const char *name, uint32_t sequence, uint32_t flags, uint64_t start,
+	uint64_t end)
+{
+	span *s = &recorder->spans[recorder->count++ % SPAN_CAPACITY];
+	s->name = name;
+	s->sequence = sequence;
+	s->flags = flags;
+	s->start = start;
+	// A clock that went backwards makes an empty span, rather than a huge one.
+	s->end = end < start ? start : end;
+	return s;
+}
+
+uint32_t spanCount(const spanRecorder *recorder)
+{
+	return recorder->count < SPAN_CAPACITY ? recorder->count : SPAN_CAPACITY;
+}
+
+const span *spanGet(const spanRecorder *recorder, uint32_t index)
+{
+	uint32_t count = spanCount(recorder);
+	if (index >= count) {
+		return null;
+	}
+	return &recorder->spans[(recorder->count - count + index) % SPAN_CAPACITY];
+}
+
+/** Appends the events of a span. */
+static void appendSpan(char *buffer, size_t size, size_t *length, const span *s, uint32_t pid, uint32_t tid)
+{
+	jsonAppend(buffer, size, length, "{\"name\":\"%s\",\"cat\":\"" SPAN_CATEGORY "\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+		"\"pid\":%u,\"tid\":%u,\"args\":{\"sequence\":%u}}", s->name, (unsigned long long)s->start,
+		(unsigned long long)(s->end - s->start), pid, tid, s->sequence);
+	if ((s->flags & SPAN_FLOW_OUT) && s->sequence) {
+		jsonAppend(buffer, size, length, ",{\"name\":\"notification\",\"cat\":\"" SPAN_CATEGORY "\",\"ph\":\"s\","
+			"\"id\":%u,\"ts\":%llu,\"pid\":%u,\"tid\":%u}", s->sequence, (unsigned long long)s->start, pid, tid);
+	}
+}
+
+size_t spanFormatEvent(const span *s, uint32_t pid, uint32_t tid, char *buffer, size_t size)
+{
+	size_t length = 0;
+	appendSpan(buffer, size, &length, s, pid, tid);
+	return jsonFinish(buffer, size, length);
+}
+
+size_t spanFormatTrace(const spanRecorder *recorder, const char *process, uint32_t pid, uint32_t tid, char *buffer,
+	size_t size)
+{
+	size_t length = 0;
+	jsonAppend(buffer, size, &length, "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+		"\"args\":{\"name\":\"%s\"}}", pid, tid, process);
+	for (uint32_t n = 0; n < spanCount(recorder); n++) {
+		jsonAppend(buffer, size, &length, ",");
+		appendSpan(buffer, size, &length, spanGet(recorder, n), pid, tid);
+	}
+	jsonAppend(buffer, size, &length, "],\"displayTimeUnit\":\"ms\"}");
+	return jsonFinish(buffer, size, length);
+}
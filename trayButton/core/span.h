@@ -0,0 +1,111 @@
+/* Task tray button - platform-neutral core.
+ * Spans of time taken by the button, for a timeline of a click (or anything else), in the Chrome trace-event format.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_SPAN_H
+#define TRAY_BUTTON_SPAN_H
+
+#include "common.h"
+
+/*
+ * Each span is written as a complete event ("ph":"X"), which chrome://tracing (or Perfetto) shows on a timeline:
+ *
+ *   {"name":"click","cat":"tray-button","ph":"X","ts":1000,"dur":250,"pid":1,"tid":2,"args":{"sequence":7}}
+ *
+ * The times are microseconds. A span in which a notification was sent (SPAN_FLOW_OUT) also starts a flow event
+ * ("ph":"s") with the notification's sequence number as its ID; the host application ends the flow ("ph":"f") in the
+ * span where it received the notification, so the viewer draws an arrow between the two processes. For the two sides
+ * to line up, both need the same clock: on Windows, the button and node both use QueryPerformanceCounter.
+ */
+
+/** Number of spans kept; the oldest are replaced. */
+#define SPAN_CAPACITY 64
+
+/** A notification was sent in the span */
+#define SPAN_FLOW_OUT 1
+
+/** Long enough for any formatted span (the flow event included) */
+#define SPAN_EVENT_LENGTH 512
+
+/** A span of time. */
+typedef struct {
+	/** What it was (written as-is, so it mustn't need escaping in JSON) */
+	const char *name;
+	/** The notification it belongs to (0 if none) */
+	uint32_t sequence;
+	/** SPAN_FLOW_* */
+	uint32_t flags;
+	/** When it started and ended (microseconds) */
+	uint64_t start, end;
+} span;
+
+/** The most recent spans. */
+typedef struct {
+	span spans[SPAN_CAPACITY];
+	/** Number of spans recorded (the ones replaced included) */
+	uint32_t count;
+} spanRecorder;
+
+/**
+ * Records a span.
+ * @param recorder The recorder.
+ * @param name What it was (kept, not copied).
+ * @param sequence The notification it belongs to (0 if none).
+ * @param flags SPAN_FLOW_*.
+ * @param start When it started (microseconds).
+ * @param end When it ended.
+ * @return The span.
+ */
+const span *spanRecord(spanRecorder *recorder, const char *name, uint32_t sequence, uint32_t flags, uint64_t start,
+	uint64_t end);
+
+/**
+ * Gets the number of spans the recorder has.
+ * @param recorder The recorder.
+ * @return The number of spans (up to SPAN_CAPACITY).
+ */
+uint32_t spanCount(const spanRecorder *recorder);
+
+/**
+ * Gets one of the spans, oldest first.
+ * @param recorder The recorder.
+ * @param index Which one (0 for the oldest).
+ * @return The span, or null if there isn't one.
+ */
+const span *spanGet(const spanRecorder *recorder, uint32_t index);
+
+/**
+ * Formats a span as trace events: the complete event, and the flow event if it has one (separated by a comma).
+ * @param s The span.
+ * @param pid The process ID.
+ * @param tid The thread ID.
+ * @param buffer Receives the JSON (always null-terminated).
+ * @param size Size of the buffer.
+ * @return The length of the JSON, or 0 if the buffer is too small.
+ */
+size_t spanFormatEvent(const span *s, uint32_t pid, uint32_t tid, char *buffer, size_t size);
+
+/**
+ * Formats the spans as a trace, which can be loaded by chrome://tracing:
+ * {"traceEvents":[<process name>,<span events>...],"displayTimeUnit":"ms"}
+ *
+ * @param recorder The recorder.
+ * @param process The name of the process (written as-is).
+ * @param pid The process ID.
+ * @param tid The thread ID.
+ * @param buffer Receives the JSON (always null-terminated).
+ * @param size Size of the buffer.
+ * @return The length of the JSON, or 0 if the buffer is too small.
+ */
+size_t spanFormatTrace(const spanRecorder *recorder, const char *process, uint32_t pid, uint32_t tid, char *buffer,
+	size_t size);
+
+#endif /* TRAY_BUTTON_SPAN_H */
@@ -0,0 +1,75 @@
+/* Task tray button - platform-neutral core.
+ * Getting the button onto the taskbar quickly: retry delays, and timing of the startup milestones.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "startup.h"
+
+void backoffInit(backoff *b, uint32_t minDelay, uint32_t maxDelay)
+{
+	b->minDelay = minDelay ? minDelay : 1;
+	b->maxDelay = maxDelay < b->minDelay ? b->minDelay : maxDelay;
+	backoffReset(b);
+}
+
+uint32_t backoffNext(backoff *b)
+{
+	uint32_t delay = b->delay;
+	b->attempts++;
+	b->delay = delay > b->maxDelay / 2 ? b->maxDelay : delay * 2;
+	return delay;
+}
+
+void backoffReset(backoff *b)
+{
+	b->delay = b->minDelay;
+	b->attempts = 0;
+}
+
+static const char *milestoneNames[MILESTONE_COUNT] = {
+	"started",
+	"taskbar",
+	"window",
+	"shellHook",
+	"icon",
+	"visible"
+};
+
+const char *milestoneName(uint32_t milestone)
+{
+	return milestone < MILESTONE_COUNT ? milestoneNames[milestone] : null;
+}
+
+void milestonesStart(startupMilestones *milestones, uint64_t start)
+{
+	memset(milestones, 0, sizeof(*milestones));
+	milestones->start = start;
+}
+
+void milestonesRestart(startupMilestones *milestones, uint64_t now)
+{
+	milestones->restarts++;
+	milestones->start = now;
+	milestones->reached = 1u << MILESTONE_STARTED;
+	memset(milestones->times, 0, sizeof(milestones->times));
+}
+
+bool milestoneReach(startupMilestones *milestones, uint32_t milestone, uint64_t now)
+{
+	if (milestone >= MILESTONE_COUNT || (milestones->reached & (1u << milestone))) {
+		return false;
+	}
+
+	uint64_t elapsed = now > milestones->start ? now - milestones->start : 0;
+	milestones->times[milestone] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+	milestones->reached |= 1u << milestone;
+	return true;
+}
@@ -0,0 +1,100 @@
+/* Task tray button - platform-neutral core.
+ * Getting the button onto the taskbar quickly: retry delays, and timing of the startup milestones.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_STARTUP_H
+#define TRAY_BUTTON_STARTUP_H
+
+#include "common.h"
+
+/** Retry delays, which double each time up to a limit. */
+typedef struct {
+	uint32_t minDelay, maxDelay;
+	/** The next delay */
+	uint32_t delay;
+	/** Number of retries since the last reset */
+	uint32_t attempts;
+} backoff;
+
+/**
+ * Initialises the delays.
+ * @param b The delays.
+ * @param minDelay The first delay (ms).
+ * @param maxDelay The longest delay (ms).
+ */
+void backoffInit(backoff *b, uint32_t minDelay, uint32_t maxDelay);
+
+/**
+ * Gets the delay before the next retry, and doubles the one after.
+ * @param b The delays.
+ * @return The delay (ms).
+ */
+uint32_t backoffNext(backoff *b);
+
+/**
+ * Starts again from the shortest delay (it worked).
+ * @param b The delays.
+ */
+void backoffReset(backoff *b);
+
+/** The milestones on the way to a visible button */
+#define MILESTONE_STARTED    0
+#define MILESTONE_TASKBAR    1
+#define MILESTONE_WINDOW     2
+#define MILESTONE_SHELL_HOOK 3
+#define MILESTONE_ICON       4
+#define MILESTONE_VISIBLE    5
+#define MILESTONE_COUNT      6
+
+/** When each milestone was reached, since the process started (or since explorer restarted). */
+typedef struct {
+	/** When the clock started (ms, on the caller's clock) */
+	uint64_t start;
+	/** Time of each milestone, since start (ms) */
+	uint32_t times[MILESTONE_COUNT];
+	/** Bit mask of the milestones reached */
+	uint32_t reached;
+	/** Number of restarts (explorer restarting) */
+	uint32_t restarts;
+} startupMilestones;
+
+/**
+ * Starts the clock.
+ * @param milestones The milestones.
+ * @param start When the process started.
+ */
+void milestonesStart(startupMilestones *milestones, uint64_t start);
+
+/**
+ * Restarts the clock, when the button needs to be put back (explorer has restarted). The time of the process start is
+ * kept.
+ * @param milestones The milestones.
+ * @param now The current time.
+ */
+void milestonesRestart(startupMilestones *milestones, uint64_t now);
+
+/**
+ * Records a milestone, the first time it's reached.
+ * @param milestones The milestones.
+ * @param milestone The milestone (MILESTONE_*).
+ * @param now The current time.
+ * @return true if it's the first time, false if it was already reached (or is unknown).
+ */
+bool milestoneReach(startupMilestones *milestones, uint32_t milestone, uint64_t now);
+
+/**
+ * Gets the name of a milestone.
+ * @param milestone The milestone (MILESTONE_*).
+ * @return The name, or null if it's unknown.
+ */
+const char *milestoneName(uint32_t milestone);
+
+#endif /* TRAY_BUTTON_STARTUP_H */
@@ -0,0 +1,149 @@
+/* Task tray button - platform-neutral core.
+ * The button's state, kept in shared memory so a restarted button looks the same straight away.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "atomics.h"
+#include "state-snapshot.h"
+
+static const uint8_t magic[4] = { 'T', 'B', 'S', 'S' };
+
+/** Where the generation is, in the header */
+#define GENERATION_OFFSET 8
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void putRect(uint8_t *p, const coreRect *rect)
+{
+	put32(p, (uint32_t)rect->left);
+	put32(p + 4, (uint32_t)rect->top);
+	put32(p + 8, (uint32_t)rect->right);
+	put32(p + 12, (uint32_t)rect->bottom);
+}
+
+static void getRect(const uint8_t *p, coreRect *rect)
+{
+	rect->left = (int32_t)get32(p);
+	rect->top = (int32_t)get32(p + 4);
+	rect->right = (int32_t)get32(p + 8);
+	rect->bottom = (int32_t)get32(p + 12);
+}
+
+static volatile uint32_t *generation(const void *memory)
+{
+	return (volatile uint32_t*)((uint8_t*)memory + GENERATION_OFFSET);
+}
+
+bool snapshotEquals(const stateSnapshot *a, const stateSnapshot *b)
+{
+	return rectEquals(&a->taskbarRect, &b->taskbarRect) && rectEquals(&a->buttonRect, &b->buttonRect)
+		&& rectEquals(&a->screenRect, &b->screenRect) && a->dpi == b->dpi && a->batchLength == b->batchLength
+		&& !memcmp(a->batch, b->batch, a->batchLength * sizeof(uint16_t));
+}
+
+bool snapshotWrite(void *memory, const stateSnapshot *snapshot)
+{
+	if (snapshot->batchLength > SNAPSHOT_MAX_BATCH) {
+		return false;
+	}
+
+	uint8_t body[SNAPSHOT_SIZE - SNAPSHOT_HEADER_SIZE];
+	putRect(body, &snapshot->taskbarRect);
+	putRect(body + 16, &snapshot->buttonRect);
+	putRect(body + 32, &snapshot->screenRect);
+	put32(body + 48, snapshot->dpi);
+	put32(body + 52, (uint32_t)snapshot->batchLength);
+	uint8_t *p = body + SNAPSHOT_FIXED_SIZE;
+	for (size_t n = 0; n < snapshot->batchLength; n++) {
+		p[n * 2] = (uint8_t)snapshot->batch[n];
+		p[n * 2 + 1] = (uint8_t)(snapshot->batch[n] >> 8);
+	}
+	uint32_t length = SNAPSHOT_FIXED_SIZE + (uint32_t)snapshot->batchLength * 2;
+	uint32_t checksum = hashBytes(body, length);
+
+	uint8_t *header = memory;
+	uint32_t current = atomicLoad(generation(memory));
+	// The same state again (the first save after a restart, say) leaves the snapshot as it was.
+	if (!(current & 1) && !memcmp(header, magic, sizeof(magic)) && get32(header + 4) == SNAPSHOT_VERSION
+		&& get32(header + 12) == length && get32(header + 16) == checksum
+		&& !memcmp(header + SNAPSHOT_HEADER_SIZE, body, length)) {
+		return true;
+	}
+
+	// Odd while it's being written (a different odd number, if the last writer died half way).
+	current = (current + 1) | 1;
+	atomicStore(generation(memory), current);
+	atomicFence();
+	memcpy(header, magic, sizeof(magic));
+	put32(header + 4, SNAPSHOT_VERSION);
+	put32(header + 12, length);
+	put32(header + 16, checksum);
+	memset(header + 20, 0, 12);
+	memcpy(header + SNAPSHOT_HEADER_SIZE, body, length);
+	atomicStore(generation(memory), current + 1);
+	return true;
+}
+
+int snapshotRead(const void *memory, stateSnapshot *snapshot)
+{
+	const uint8_t *header = memory;
+	uint8_t copy[SNAPSHOT_SIZE];
+
+	uint32_t before = atomicLoad(generation(memory));
+	if (before & 1) {
+		return SNAPSHOT_BUSY;
+	}
+	memcpy(copy, header, SNAPSHOT_SIZE);
+	atomicFence();
+	if (atomicLoad(generation(memory)) != before) {
+		return SNAPSHOT_BUSY;
+	}
+
+	if (memcmp(copy, magic, sizeof(magic))) {
+		return SNAPSHOT_EMPTY;
+	}
+	if (get32(copy + 4) != SNAPSHOT_VERSION) {
+		return SNAPSHOT_OTHER_VERSION;
+	}
+
+	uint32_t length = get32(copy + 12);
+	const uint8_t *body = copy + SNAPSHOT_HEADER_SIZE;
+	if (length < SNAPSHOT_FIXED_SIZE || length > SNAPSHOT_SIZE - SNAPSHOT_HEADER_SIZE
+		|| get32(copy + 16) != hashBytes(body, length)) {
+		return SNAPSHOT_DAMAGED;
+	}
+	size_t batchLength = get32(body + 52);
+	if (batchLength > SNAPSHOT_MAX_BATCH || SNAPSHOT_FIXED_SIZE + batchLength * 2 != length) {
+		return SNAPSHOT_DAMAGED;
+	}
+
+	getRect(body, &snapshot->taskbarRect);
+	getRect(body + 16, &snapshot->buttonRect);
+	getRect(body + 32, &snapshot->screenRect);
+	snapshot->dpi = get32(body + 48);
+	snapshot->batchLength = batchLength;
+	const uint8_t *p = body + SNAPSHOT_FIXED_SIZE;
+	for (size_t n = 0; n < batchLength; n++) {
+		snapshot->batch[n] = (uint16_t)(p[n * 2] | (p[n * 2 + 1] << 8));
+	}
+	return SNAPSHOT_OK;
+}
@@ -0,0 +1,94 @@
+/* Task tray button - platform-neutral core.
+ * The button's state, kept in shared memory so a restarted button looks the same straight away.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_STATE_SNAPSHOT_H
+#define TRAY_BUTTON_STATE_SNAPSHOT_H
+
+#include "common.h"
+
+/*
+ * The snapshot is a block of SNAPSHOT_SIZE bytes, which the platform maps from a file. It's rewritten whenever the
+ * state changes, and read when the button starts. Little-endian, apart from the generation:
+ *
+ *   Header (SNAPSHOT_HEADER_SIZE bytes)
+ *     uint8  magic[4]    "TBSS"
+ *     uint32 version     SNAPSHOT_VERSION
+ *     uint32 generation  Incremented before and after each write: odd while it's being written (native byte order)
+ *     uint32 length      Size of the body
+ *     uint32 checksum    hashBytes of the body
+ *     uint32 reserved[3] 0
+ *
+ *   Body
+ *     int32  taskbarRect[4]  The primary taskbar (screen coordinates)
+ *     int32  buttonRect[4]   The button on it (the taskbar's client coordinates)
+ *     int32  screenRect[4]   The button (screen coordinates)
+ *     uint32 dpi             The taskbar's DPI
+ *     uint32 batchLength     Code units in the batch
+ *     uint16 batch[]         The host's settings, as a batch of commands (see batch.h and trayHostSaveBatch)
+ *
+ * The settings are kept as a batch so they're restored the same way gpii-app sets them: in one go, with one layout.
+ * A snapshot from another version is ignored. One that was being written when the button died (an odd generation, or
+ * a body that doesn't match the checksum) is also ignored; so is one that changes while it's being read.
+ */
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_SIZE 4096
+#define SNAPSHOT_HEADER_SIZE 32
+/** Size of the body, without the batch */
+#define SNAPSHOT_FIXED_SIZE 56
+/** Room for the batch (code units) */
+#define SNAPSHOT_MAX_BATCH ((SNAPSHOT_SIZE - SNAPSHOT_HEADER_SIZE - SNAPSHOT_FIXED_SIZE) / 2)
+
+/** Results of snapshotRead */
+#define SNAPSHOT_OK            0
+/** Nothing has been written (the memory is new) */
+#define SNAPSHOT_EMPTY         1
+/** Written by another version of the button */
+#define SNAPSHOT_OTHER_VERSION 2
+/** Being written */
+#define SNAPSHOT_BUSY          3
+/** Not what was written */
+#define SNAPSHOT_DAMAGED       4
+
+/** The state of the button. */
+typedef struct {
+	/** The primary taskbar, and the button on it (see layoutResult), when it was last laid out */
+	coreRect taskbarRect, buttonRect, screenRect;
+	uint32_t dpi;
+	/** The host's settings, as a batch of commands */
+	uint16_t batch[SNAPSHOT_MAX_BATCH];
+	size_t batchLength;
+} stateSnapshot;
+
+/**
+ * Compares two states, so the snapshot is only written when something has changed.
+ * @return true if they're the same.
+ */
+bool snapshotEquals(const stateSnapshot *a, const stateSnapshot *b);
+
+/**
+ * Writes a snapshot, unless it's the same as the one already there.
+ * @param memory The shared memory: SNAPSHOT_SIZE bytes, 4-byte aligned.
+ * @param snapshot The state.
+ * @return false if the batch is too long.
+ */
+bool snapshotWrite(void *memory, const stateSnapshot *snapshot);
+
+/**
+ * Reads a snapshot.
+ * @param memory The shared memory: SNAPSHOT_SIZE bytes, 4-byte aligned.
+ * @param snapshot Receives the state (only complete when the result is SNAPSHOT_OK).
+ * @return SNAPSHOT_OK, or why there isn't one (SNAPSHOT_*).
+ */
+int snapshotRead(const void *memory, stateSnapshot *snapshot);
+
+#endif /* TRAY_BUTTON_STATE_SNAPSHOT_H */
@@ -0,0 +1,1453 @@
+/* Task tray button - platform-neutral core.
+ * Reads SVG icons, and draws them at any size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "svg.h"
+#include "pixels.h"
+#include "raster.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+/** A paint is PAINT_SET | 0xrrggbb, or 0 for none. */
+#define PAINT_SET 0x1000000
+
+/** Distance a flattened curve may be from the real one, in pixels (the lines are inside it, so this thins a shape). */
+#define FLATNESS 0.025f
+/** The same, for the polygons of round joins and caps (which are as big as the circle, so don't thin the stroke). */
+#define CIRCLE_FLATNESS 0.1f
+
+/** Most attributes of an element that are looked at. */
+#define MAX_ATTRIBUTES 32
+
+/** The painting properties of an element, which its children inherit. */
+typedef struct {
+	uint32_t fill, stroke;
+	float fillOpacity, strokeOpacity, strokeWidth;
+	/** The element's own opacity, and the product of it and its groups' */
+	float ownOpacity, opacity;
+	bool evenOdd;
+	uint8_t cap;
+	/** Not drawn: display: none, or in a definition */
+	bool hidden;
+	/** Transform to the image's co-ordinates: x' = a*x + c*y + e, y' = b*x + d*y + f */
+	float matrix[6];
+} svgState;
+
+/** A class rule of the style sheet: ".name { declarations }" (pointing into the file). */
+typedef struct {
+	const char *name, *declarations;
+	size_t nameLength, declarationsLength;
+} svgRule;
+
+typedef struct {
+	const char *name, *value;
+	size_t nameLength, valueLength;
+} svgAttribute;
+
+typedef struct {
+	svgImage *image;
+	svgState states[SVG_MAX_DEPTH];
+	int depth;
+	bool rootFound;
+	svgRule *rules;
+	uint32_t ruleCount, ruleCapacity;
+} svgParser;
+
+/** Makes room for more items in an array. */
+static bool grow(void **items, uint32_t *capacity, uint32_t needed, size_t itemSize)
+{
+	if (needed <= *capacity) {
+		return true;
+	}
+	uint32_t newCapacity = *capacity ? *capacity : 16;
+	while (newCapacity < needed) {
+		newCapacity *= 2;
+	}
+	void *newItems = realloc(*items, newCapacity * itemSize);
+	if (!newItems) {
+		return false;
+	}
+	*items = newItems;
+	*capacity = newCapacity;
+	return true;
+}
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline bool isLetter(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool isNameChar(char c)
+{
+	return isLetter(c) || isDigit(c) || c == '-' || c == '_' || c == ':' || c == '.';
+}
+
+static const char *skipSpace(const char *s, const char *end)
+{
+	while (s < end && isSpace(*s)) {
+		s++;
+	}
+	return s;
+}
+
+/** Finds a character, returning the end if it's not there. */
+static const char *findChar(const char *s, const char *end, char c)
+{
+	const char *found = memchr(s, c, (size_t)(end - s));
+	return found ? found : end;
+}
+
+/** Finds a string, returning the position after it (or the end). */
+static const char *skipPast(const char *s, const char *end, const char *text)
+{
+	size_t length = strlen(text);
+	for (; s + length <= end; s++) {
+		if (!memcmp(s, text, length)) {
+			return s + length;
+		}
+	}
+	return end;
+}
+
+static bool startsWith(const char *s, const char *end, const char *text)
+{
+	size_t length = strlen(text);
+	return (size_t)(end - s) >= length && !memcmp(s, text, length);
+}
+
+static bool equals(const char *s, size_t length, const char *text)
+{
+	return strlen(text) == length && !memcmp(s, text, length);
+}
+
+/** Trims the white-space from both ends of a string. */
+static void trim(const char **s, const char **end)
+{
+	*s = skipSpace(*s, *end);
+	while (*end > *s && isSpace((*end)[-1])) {
+		(*end)--;
+	}
+}
+
+/**
+ * Reads a number, after any white-space and a comma. The locale isn't used, and numbers can run into each other like
+ * they do in path data (".5.5" is two numbers).
+ */
+static bool readNumber(const char **text, const char *end, float *value)
+{
+	const char *s = skipSpace(*text, end);
+	if (s < end && *s == ',') {
+		s = skipSpace(s + 1, end);
+	}
+
+	double sign = 1, v = 0;
+	bool digits = false;
+	if (s < end && (*s == '+' || *s == '-')) {
+		sign = *s == '-' ? -1 : 1;
+		s++;
+	}
+	for (; s < end && isDigit(*s); s++) {
+		v = v * 10 + (*s - '0');
+		digits = true;
+	}
+	if (s < end && *s == '.') {
+		double scale = 0.1;
+		for (s++; s < end && isDigit(*s); s++) {
+			v += (*s - '0') * scale;
+			scale /= 10;
+			digits = true;
+		}
+	}
+	if (!digits) {
+		return false;
+	}
+
+	// An exponent, if it's got digits (otherwise the "e" isn't part of it).
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		const char *e = s + 1;
+		int exponentSign = 1, exponent = 0;
+		if (e < end && (*e == '+' || *e == '-')) {
+			exponentSign = *e == '-' ? -1 : 1;
+			e++;
+		}
+		if (e < end && isDigit(*e)) {
+			for (; e < end && isDigit(*e); e++) {
+				exponent = exponent < 1000 ? exponent * 10 + (*e - '0') : exponent;
+			}
+			v *= pow(10, exponentSign * exponent);
+			s = e;
+		}
+	}
+
+	// Too big for a float (anything drawn from it couldn't be rasterized).
+	float number = (float)(sign * v);
+	if (!isfinite(number)) {
+		return false;
+	}
+	*value = number;
+	*text = s;
+	return true;
+}
+
+static bool readNumbers(const char **text, const char *end, float *values, int count)
+{
+	for (int n = 0; n < count; n++) {
+		if (!readNumber(text, end, &values[n])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Reads an arc flag, which doesn't need to be separated from what follows it. */
+static bool readFlag(const char **text, const char *end, bool *flag)
+{
+	const char *s = skipSpace(*text, end);
+	if (s < end && *s == ',') {
+		s = skipSpace(s + 1, end);
+	}
+	if (s >= end || (*s != '0' && *s != '1')) {
+		return false;
+	}
+	*flag = *s == '1';
+	*text = s + 1;
+	return true;
+}
+
+/** Multiplies two transforms: m = m * t (t is applied first). */
+static void multiply(float *m, const float *t)
+{
+	float r[6];
+	r[0] = m[0] * t[0] + m[2] * t[1];
+	r[1] = m[1] * t[0] + m[3] * t[1];
+	r[2] = m[0] * t[2] + m[2] * t[3];
+	r[3] = m[1] * t[2] + m[3] * t[3];
+	r[4] = m[0] * t[4] + m[2] * t[5] + m[4];
+	r[5] = m[1] * t[4] + m[3] * t[5] + m[5];
+	memcpy(m, r, sizeof(r));
+}
+
+/**
+ * Applies a transform attribute, like "translate(10 20) scale(2)".
+ * @return false if the result isn't finite.
+ */
+static bool parseTransform(const char *s, const char *end, float *matrix)
+{
+	while (s < end) {
+		while (s < end && (isSpace(*s) || *s == ',')) {
+			s++;
+		}
+		const char *name = s;
+		while (s < end && isLetter(*s)) {
+			s++;
+		}
+		size_t nameLength = (size_t)(s - name);
+		s = skipSpace(s, end);
+		if (!nameLength || s >= end || *s != '(') {
+			break;
+		}
+		s++;
+
+		float a[6];
+		int count = 0;
+		while (count < 6 && readNumber(&s, end, &a[count])) {
+			count++;
+		}
+		s = skipSpace(s, end);
+		if (s >= end || *s != ')' || !count) {
+			break;
+		}
+		s++;
+
+		float t[6] = { 1, 0, 0, 1, 0, 0 };
+		if (equals(name, nameLength, "matrix") && count == 6) {
+			memcpy(t, a, sizeof(t));
+		} else if (equals(name, nameLength, "translate")) {
+			t[4] = a[0];
+			t[5] = count > 1 ? a[1] : 0;
+		} else if (equals(name, nameLength, "scale")) {
+			t[0] = a[0];
+			t[3] = count > 1 ? a[1] : a[0];
+		} else if (equals(name, nameLength, "rotate")) {
+			float angle = a[0] * (float)M_PI / 180, c = cosf(angle), sn = sinf(angle);
+			float cx = count == 3 ? a[1] : 0, cy = count == 3 ? a[2] : 0;
+			t[0] = c;
+			t[1] = sn;
+			t[2] = -sn;
+			t[3] = c;
+			t[4] = cx - c * cx + sn * cy;
+			t[5] = cy - sn * cx - c * cy;
+		} else if (equals(name, nameLength, "skewX")) {
+			t[2] = tanf(a[0] * (float)M_PI / 180);
+		} else if (equals(name, nameLength, "skewY")) {
+			t[1] = tanf(a[0] * (float)M_PI / 180);
+		} else {
+			break;
+		}
+		multiply(matrix, t);
+	}
+
+	for (int n = 0; n < 6; n++) {
+		if (!isfinite(matrix[n])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int hexDigit(char c)
+{
+	return isDigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+/** Reads a paint: a colour, or none. Returns false if it's not understood. */
+static bool parsePaint(const char *s, const char *end, uint32_t *paint)
+{
+	static const struct {
+		const char *name;
+		uint32_t rgb;
+	} names[] = {
+		{ "black", 0x000000 }, { "white", 0xffffff }, { "red", 0xff0000 }, { "lime", 0x00ff00 },
+		{ "blue", 0x0000ff }, { "yellow", 0xffff00 }, { "cyan", 0x00ffff }, { "aqua", 0x00ffff },
+		{ "magenta", 0xff00ff }, { "fuchsia", 0xff00ff }, { "green", 0x008000 }, { "gray", 0x808080 },
+		{ "grey", 0x808080 }, { "silver", 0xc0c0c0 }, { "maroon", 0x800000 }, { "navy", 0x000080 },
+		{ "purple", 0x800080 }, { "olive", 0x808000 }, { "teal", 0x008080 }, { "orange", 0xffa500 },
+		{ "currentColor", 0x000000 }
+	};
+
+	trim(&s, &end);
+	size_t length = (size_t)(end - s);
+
+	if (startsWith(s, end, "url(")) {
+		// Gradients and patterns aren't drawn, but the fallback colour after the reference is.
+		const char *fallback = findChar(s, end, ')');
+		if (fallback < end && parsePaint(fallback + 1, end, paint)) {
+			return true;
+		}
+		*paint = 0;
+		return true;
+	}
+
+	if (equals(s, length, "none") || equals(s, length, "transparent")) {
+		*paint = 0;
+		return true;
+	}
+
+	if (length && *s == '#') {
+		int digits[6];
+		for (size_t n = 1; n < length && n <= 6; n++) {
+			if ((digits[n - 1] = hexDigit(s[n])) < 0) {
+				return false;
+			}
+		}
+		if (length == 4) {
+			*paint = PAINT_SET | (uint32_t)(digits[0] * 0x110000 + digits[1] * 0x1100 + digits[2] * 0x11);
+			return true;
+		} else if (length == 7) {
+			uint32_t rgb = 0;
+			for (int n = 0; n < 6; n++) {
+				rgb = (rgb << 4) | (uint32_t)digits[n];
+			}
+			*paint = PAINT_SET | rgb;
+			return true;
+		}
+		return false;
+	}
+
+	if (startsWith(s, end, "rgb(")) {
+		const char *p = s + 4;
+		uint32_t rgb = 0;
+		for (int n = 0; n < 3; n++) {
+			float v;
+			if (!readNumber(&p, end, &v)) {
+				return false;
+			}
+			if (p < end && *p == '%') {
+				v = v * 255 / 100;
+				p++;
+			}
+			rgb = (rgb << 8) | (uint32_t)(v < 0 ? 0 : v > 255 ? 255 : v + 0.5f);
+		}
+		*paint = PAINT_SET | rgb;
+		return true;
+	}
+
+	for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+		if (equals(s, length, names[n].name)) {
+			*paint = PAINT_SET | names[n].rgb;
+			return true;
+		}
+	}
+	return false;
+}
+
+static float clampOpacity(float value)
+{
+	return value < 0 ? 0 : value > 1 ? 1 : value;
+}
+
+/** Sets a painting property, from a presentation attribute or a style declaration. Unknown ones are ignored. */
+static void applyProperty(svgState *state, const char *name, size_t nameLength, const char *value, const char *end)
+{
+	float number;
+	trim(&value, &end);
+	size_t length = (size_t)(end - value);
+	const char *v = value;
+
+	if (equals(name, nameLength, "fill")) {
+		parsePaint(value, end, &state->fill);
+	} else if (equals(name, nameLength, "stroke")) {
+		parsePaint(value, end, &state->stroke);
+	} else if (equals(name, nameLength, "stroke-width")) {
+		if (readNumber(&v, end, &number) && number >= 0) {
+			state->strokeWidth = number;
+		}
+	} else if (equals(name, nameLength, "fill-rule")) {
+		state->evenOdd = equals(value, length, "evenodd");
+	} else if (equals(name, nameLength, "opacity")) {
+		if (readNumber(&v, end, &number)) {
+			state->ownOpacity = clampOpacity(number);
+		}
+	} else if (equals(name, nameLength, "fill-opacity")) {
+		if (readNumber(&v, end, &number)) {
+			state->fillOpacity = clampOpacity(number);
+		}
+	} else if (equals(name, nameLength, "stroke-opacity")) {
+		if (readNumber(&v, end, &number)) {
+			state->strokeOpacity = clampOpacity(number);
+		}
+	} else if (equals(name, nameLength, "stroke-linecap")) {
+		state->cap = equals(value, length, "round") ? SVG_CAP_ROUND
+			: equals(value, length, "square") ? SVG_CAP_SQUARE : SVG_CAP_BUTT;
+	} else if (equals(name, nameLength, "display")) {
+		if (equals(value, length, "none")) {
+			state->hidden = true;
+		}
+	} else if (equals(name, nameLength, "visibility")) {
+		if (equals(value, length, "hidden") || equals(value, length, "collapse")) {
+			state->hidden = true;
+		}
+	}
+}
+
+/** Sets the properties in a list of declarations, like "fill:#fff;stroke-width:2". */
+static void applyDeclarations(svgState *state, const char *s, const char *end)
+{
+	while (s < end) {
+		const char *next = findChar(s, end, ';');
+		const char *colon = findChar(s, next, ':');
+		if (colon < next) {
+			const char *nameEnd = colon;
+			trim(&s, &nameEnd);
+			applyProperty(state, s, (size_t)(nameEnd - s), colon + 1, next);
+		}
+		s = next + (next < end);
+	}
+}
+
+/** Reads the class rules of a style sheet; other rules are ignored. */
+static bool parseStyleSheet(svgParser *p, const char *s, const char *end)
+{
+	s = skipSpace(s, end);
+	if (startsWith(s, end, "<![CDATA[")) {
+		s += 9;
+	}
+
+	while (s < end) {
+		const char *open = findChar(s, end, '{');
+		const char *close = findChar(open, end, '}');
+		if (close == end) {
+			break;
+		}
+
+		// Each selector of the rule.
+		while (s < open) {
+			const char *selector = s, *selectorEnd = findChar(s, open, ',');
+			s = selectorEnd + 1;
+			trim(&selector, &selectorEnd);
+			if (selector >= selectorEnd || *selector != '.') {
+				continue;
+			}
+			const char *name = selector + 1, *nameEnd = name;
+			while (nameEnd < selectorEnd && (isNameChar(*nameEnd) && *nameEnd != '.' && *nameEnd != ':')) {
+				nameEnd++;
+			}
+			if (nameEnd != selectorEnd || nameEnd == name) {
+				continue;
+			}
+
+			if (!grow((void**)&p->rules, &p->ruleCapacity, p->ruleCount + 1, sizeof(svgRule))) {
+				return false;
+			}
+			svgRule *rule = &p->rules[p->ruleCount++];
+			rule->name = name;
+			rule->nameLength = (size_t)(nameEnd - name);
+			rule->declarations = open + 1;
+			rule->declarationsLength = (size_t)(close - open - 1);
+		}
+		s = close + 1;
+	}
+	return true;
+}
+
+static const svgAttribute *getAttribute(const svgAttribute *attributes, int count, const char *name)
+{
+	for (int n = 0; n < count; n++) {
+		if (equals(attributes[n].name, attributes[n].nameLength, name)) {
+			return &attributes[n];
+		}
+	}
+	return null;
+}
+
+/** Gets a number (or length, whose units are ignored) attribute. */
+static float numberAttribute(const svgAttribute *attributes, int count, const char *name, float defaultValue)
+{
+	const svgAttribute *a = getAttribute(attributes, count, name);
+	float value;
+	if (a) {
+		const char *s = a->value;
+		if (readNumber(&s, s + a->valueLength, &value)) {
+			return value;
+		}
+	}
+	return defaultValue;
+}
+
+/** Sets the properties of an element: presentation attributes, then class rules, then the style attribute. */
+static void applyStyle(svgParser *p, svgState *state, const svgAttribute *attributes, int count)
+{
+	for (int n = 0; n < count; n++) {
+		const svgAttribute *a = &attributes[n];
+		applyProperty(state, a->name, a->nameLength, a->value, a->value + a->valueLength);
+	}
+
+	const svgAttribute *classes = getAttribute(attributes, count, "class");
+	if (classes) {
+		const char *s = classes->value, *end = s + classes->valueLength;
+		while ((s = skipSpace(s, end)) < end) {
+			const char *name = s;
+			while (s < end && !isSpace(*s)) {
+				s++;
+			}
+			for (uint32_t r = 0; r < p->ruleCount; r++) {
+				const svgRule *rule = &p->rules[r];
+				if (rule->nameLength == (size_t)(s - name) && !memcmp(rule->name, name, rule->nameLength)) {
+					applyDeclarations(state, rule->declarations, rule->declarations + rule->declarationsLength);
+				}
+			}
+		}
+	}
+
+	const svgAttribute *style = getAttribute(attributes, count, "style");
+	if (style) {
+		applyDeclarations(state, style->value, style->value + style->valueLength);
+	}
+}
+
+/** Adds a path command, with its points transformed to the image's co-ordinates. */
+static bool addCommand(svgParser *p, uint8_t command, const float *points, uint32_t count)
+{
+	svgImage *image = p->image;
+	if (!grow((void**)&image->commands, &image->commandCapacity, image->commandCount + 1, sizeof(uint8_t))
+		|| !grow((void**)&image->points, &image->pointCapacity, image->pointCount + count * 2, sizeof(float))) {
+		return false;
+	}
+
+	const float *m = p->states[p->depth].matrix;
+	for (uint32_t n = 0; n < count; n++) {
+		float x = points[n * 2], y = points[n * 2 + 1];
+		image->points[image->pointCount++] = m[0] * x + m[2] * y + m[4];
+		image->points[image->pointCount++] = m[1] * x + m[3] * y + m[5];
+	}
+	image->commands[image->commandCount++] = command;
+	return true;
+}
+
+static bool moveTo(svgParser *p, float x, float y)
+{
+	float points[] = { x, y };
+	return addCommand(p, SVG_MOVE, points, 1);
+}
+
+static bool lineTo(svgParser *p, float x, float y)
+{
+	float points[] = { x, y };
+	return addCommand(p, SVG_LINE, points, 1);
+}
+
+static bool cubicTo(svgParser *p, float x1, float y1, float x2, float y2, float x, float y)
+{
+	float points[] = { x1, y1, x2, y2, x, y };
+	return addCommand(p, SVG_CUBIC, points, 3);
+}
+
+static bool closePath(svgParser *p)
+{
+	return addCommand(p, SVG_CLOSE, null, 0);
+}
+
+/** Adds an elliptical arc, as cubic curves (the endpoint to centre conversion of the SVG implementation notes). */
+static bool arcTo(svgParser *p, float x0, float y0, float rx, float ry, float angle, bool large, bool sweep,
+	float x, float y)
+{
+	if (x0 == x && y0 == y) {
+		return true;
+	}
+	rx = fabsf(rx);
+	ry = fabsf(ry);
+	if (rx == 0 || ry == 0) {
+		return lineTo(p, x, y);
+	}
+
+	double phi = angle * M_PI / 180, cosPhi = cos(phi), sinPhi = sin(phi);
+	double hx = (x0 - x) / 2.0, hy = (y0 - y) / 2.0;
+	double x1 = cosPhi * hx + sinPhi * hy, y1 = -sinPhi * hx + cosPhi * hy;
+
+	// Radii which are too small are scaled up to fit.
+	double lambda = (x1 * x1) / ((double)rx * rx) + (y1 * y1) / ((double)ry * ry);
+	double a = rx, b = ry;
+	if (lambda > 1) {
+		a *= sqrt(lambda);
+		b *= sqrt(lambda);
+	}
+
+	double numerator = a * a * b * b - a * a * y1 * y1 - b * b * x1 * x1;
+	double denominator = a * a * y1 * y1 + b * b * x1 * x1;
+	double coefficient = denominator > 0 && numerator > 0 ? sqrt(numerator / denominator) : 0;
+	if (large == sweep) {
+		coefficient = -coefficient;
+	}
+	double cx1 = coefficient * a * y1 / b, cy1 = -coefficient * b * x1 / a;
+	double cx = cosPhi * cx1 - sinPhi * cy1 + (x0 + x) / 2.0;
+	double cy = sinPhi * cx1 + cosPhi * cy1 + (y0 + y) / 2.0;
+
+	double ux = (x1 - cx1) / a, uy = (y1 - cy1) / b, vx = (-x1 - cx1) / a, vy = (-y1 - cy1) / b;
+	double theta = atan2(uy, ux);
+	double delta = atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+	if (!sweep && delta > 0) {
+		delta -= 2 * M_PI;
+	} else if (sweep && delta < 0) {
+		delta += 2 * M_PI;
+	}
+
+	// Up to a quarter of the ellipse per curve.
+	int segments = (int)ceil(fabs(delta) / (M_PI / 2) - 1e-6);
+	segments = segments < 1 ? 1 : segments;
+	double step = delta / segments, k = 4.0 / 3.0 * tan(step / 4);
+	for (int n = 0; n < segments; n++) {
+		double t1 = theta + step * n, t2 = t1 + step;
+		double c1 = cos(t1), s1 = sin(t1), c2 = cos(t2), s2 = sin(t2);
+		double px1 = cx + a * c1 * cosPhi - b * s1 * sinPhi, py1 = cy + a * c1 * sinPhi + b * s1 * cosPhi;
+		double dx1 = -a * s1 * cosPhi - b * c1 * sinPhi, dy1 = -a * s1 * sinPhi + b * c1 * cosPhi;
+		double px2 = cx + a * c2 * cosPhi - b * s2 * sinPhi, py2 = cy + a * c2 * sinPhi + b * s2 * cosPhi;
+		double dx2 = -a * s2 * cosPhi - b * c2 * sinPhi, dy2 = -a * s2 * sinPhi + b * c2 * cosPhi;
+		bool last = n == segments - 1;
+		if (!cubicTo(p, (float)(px1 + k * dx1), (float)(py1 + k * dy1), (float)(px2 - k * dx2),
+			(float)(py2 - k * dy2), last ? x : (float)px2, last ? y : (float)py2)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Reads path data. Like a browser, the path is drawn up to the first error in it.
+ * @return false if there's no memory.
+ */
+static bool parsePath(svgParser *p, const char *s, const char *end)
+{
+	float x = 0, y = 0, startX = 0, startY = 0, controlX = 0, controlY = 0;
+	char command = 0, previous = 0;
+	bool needMove = false, ok = true;
+
+	while (ok) {
+		while (s < end && (isSpace(*s) || *s == ',')) {
+			s++;
+		}
+		if (s >= end) {
+			break;
+		}
+		if (isLetter(*s)) {
+			command = *s++;
+			if (!previous && command != 'M' && command != 'm') {
+				break;
+			}
+		} else if (!command) {
+			break;
+		}
+
+		bool relative = command >= 'a';
+		char upper = relative ? (char)(command - 'a' + 'A') : command;
+		float dx = relative ? x : 0, dy = relative ? y : 0, a[7];
+		bool large, sweep;
+
+		if (upper != 'M' && upper != 'Z' && needMove) {
+			// Drawing after a close starts from the start of the closed sub-path.
+			ok = moveTo(p, x, y);
+			needMove = false;
+		}
+
+		switch (upper) {
+		case 'M':
+			if (!readNumbers(&s, end, a, 2)) {
+				return true;
+			}
+			x = startX = a[0] + dx;
+			y = startY = a[1] + dy;
+			ok = moveTo(p, x, y);
+			needMove = false;
+			// Further points are lines.
+			command = relative ? 'l' : 'L';
+			break;
+
+		case 'Z':
+			ok = closePath(p);
+			x = startX;
+			y = startY;
+			needMove = true;
+			command = 0;
+			break;
+
+		case 'L':
+			if (!readNumbers(&s, end, a, 2)) {
+				return true;
+			}
+			x = a[0] + dx;
+			y = a[1] + dy;
+			ok = lineTo(p, x, y);
+			break;
+
+		case 'H':
+			if (!readNumbers(&s, end, a, 1)) {
+				return true;
+			}
+			x = a[0] + dx;
+			ok = lineTo(p, x, y);
+			break;
+
+		case 'V':
+			if (!readNumbers(&s, end, a, 1)) {
+				return true;
+			}
+			y = a[0] + dy;
+			ok = lineTo(p, x, y);
+			break;
+
+		case 'C':
+		case 'S':
+			if (upper == 'C') {
+				if (!readNumbers(&s, end, a, 6)) {
+					return true;
+				}
+				a[0] += dx;
+				a[1] += dy;
+			} else {
+				if (!readNumbers(&s, end, a + 2, 4)) {
+					return true;
+				}
+				// The first control point is the reflection of the last one.
+				bool smooth = previous == 'C' || previous == 'S';
+				a[0] = smooth ? 2 * x - controlX : x;
+				a[1] = smooth ? 2 * y - controlY : y;
+			}
+			controlX = a[2] + dx;
+			controlY = a[3] + dy;
+			ok = cubicTo(p, a[0], a[1], controlX, controlY, a[4] + dx, a[5] + dy);
+			x = a[4] + dx;
+			y = a[5] + dy;
+			break;
+
+		case 'Q':
+		case 'T':
+			if (upper == 'Q') {
+				if (!readNumbers(&s, end, a, 4)) {
+					return true;
+				}
+				controlX = a[0] + dx;
+				controlY = a[1] + dy;
+			} else {
+				if (!readNumbers(&s, end, a + 2, 2)) {
+					return true;
+				}
+				bool smooth = previous == 'Q' || previous == 'T';
+				controlX = smooth ? 2 * x - controlX : x;
+				controlY = smooth ? 2 * y - controlY : y;
+			}
+			{
+				// As a cubic.
+				float endX = a[2] + dx, endY = a[3] + dy;
+				ok = cubicTo(p, x + 2.0f / 3 * (controlX - x), y + 2.0f / 3 * (controlY - y),
+					endX + 2.0f / 3 * (controlX - endX), endY + 2.0f / 3 * (controlY - endY), endX, endY);
+				x = endX;
+				y = endY;
+			}
+			break;
+
+		case 'A':
+			if (!readNumbers(&s, end, a, 3) || !readFlag(&s, end, &large) || !readFlag(&s, end, &sweep)
+				|| !readNumbers(&s, end, a + 3, 2)) {
+				return true;
+			}
+			ok = arcTo(p, x, y, a[0], a[1], a[2], large, sweep, a[3] + dx, a[4] + dy);
+			x = a[3] + dx;
+			y = a[4] + dy;
+			break;
+
+		default:
+			return true;
+		}
+
+		previous = upper;
+	}
+
+	return ok;
+}
+
+/** Reads the points of a polyline or polygon. */
+static bool parsePoints(svgParser *p, const char *s, const char *end, bool close)
+{
+	float point[2];
+	bool ok = true, first = true;
+	while (ok && readNumbers(&s, end, point, 2)) {
+		ok = first ? moveTo(p, point[0], point[1]) : lineTo(p, point[0], point[1]);
+		first = false;
+	}
+	return ok && (!close || first || closePath(p));
+}
+
+/** Adds an ellipse, or a quarter of one going from (x0, y0) to (x, y) around the corner (cx, cy). */
+static bool corner(svgParser *p, float x0, float y0, float cx, float cy, float x, float y)
+{
+	const float k = 0.5522847498f;
+	return cubicTo(p, x0 + (cx - x0) * k, y0 + (cy - y0) * k, x + (cx - x) * k, y + (cy - y) * k, x, y);
+}
+
+static bool ellipse(svgParser *p, float cx, float cy, float rx, float ry)
+{
+	return rx > 0 && ry > 0
+		? moveTo(p, cx + rx, cy)
+			&& corner(p, cx + rx, cy, cx + rx, cy + ry, cx, cy + ry)
+			&& corner(p, cx, cy + ry, cx - rx, cy + ry, cx - rx, cy)
+			&& corner(p, cx - rx, cy, cx - rx, cy - ry, cx, cy - ry)
+			&& corner(p, cx, cy - ry, cx + rx, cy - ry, cx + rx, cy)
+			&& closePath(p)
+		: true;
+}
+
+static bool rect(svgParser *p, float x, float y, float width, float height, float rx, float ry)
+{
+	if (width <= 0 || height <= 0) {
+		return true;
+	}
+	rx = rx > width / 2 ? width / 2 : rx;
+	ry = ry > height / 2 ? height / 2 : ry;
+	if (rx <= 0 || ry <= 0) {
+		return moveTo(p, x, y) && lineTo(p, x + width, y) && lineTo(p, x + width, y + height)
+			&& lineTo(p, x, y + height) && closePath(p);
+	}
+
+	float right = x + width, bottom = y + height;
+	return moveTo(p, x + rx, y) && lineTo(p, right - rx, y)
+		&& corner(p, right - rx, y, right, y, right, y + ry) && lineTo(p, right, bottom - ry)
+		&& corner(p, right, bottom - ry, right, bottom, right - rx, bottom) && lineTo(p, x + rx, bottom)
+		&& corner(p, x + rx, bottom, x, bottom, x, bottom - ry) && lineTo(p, x, y + ry)
+		&& corner(p, x, y + ry, x, y, x + rx, y) && closePath(p);
+}
+
+/** ARGB of a paint, at an opacity. */
+static uint32_t paintColor(uint32_t paint, float opacity)
+{
+	uint32_t alpha = (uint32_t)(opacity * 255 + 0.5f);
+	return (paint & PAINT_SET) && alpha ? (alpha << 24) | (paint & 0xffffff) : 0;
+}
+
+/** Adds the shape of an element (or nothing, if it isn't a shape). */
+static bool addShape(svgParser *p, const char *name, size_t nameLength, const svgAttribute *attributes, int count)
+{
+	svgImage *image = p->image;
+	const svgState *state = &p->states[p->depth];
+	uint32_t firstCommand = image->commandCount, firstPoint = image->pointCount;
+	bool ok = true;
+
+	#define number(NAME, DEFAULT) numberAttribute(attributes, count, NAME, DEFAULT)
+	if (equals(name, nameLength, "path")) {
+		const svgAttribute *d = getAttribute(attributes, count, "d");
+		ok = !d || parsePath(p, d->value, d->value + d->valueLength);
+	} else if (equals(name, nameLength, "polygon") || equals(name, nameLength, "polyline")) {
+		const svgAttribute *points = getAttribute(attributes, count, "points");
+		ok = !points || parsePoints(p, points->value, points->value + points->valueLength,
+			equals(name, nameLength, "polygon"));
+	} else if (equals(name, nameLength, "circle")) {
+		float r = number("r", 0);
+		ok = ellipse(p, number("cx", 0), number("cy", 0), r, r);
+	} else if (equals(name, nameLength, "ellipse")) {
+		ok = ellipse(p, number("cx", 0), number("cy", 0), number("rx", 0), number("ry", 0));
+	} else if (equals(name, nameLength, "rect")) {
+		// A missing corner radius is the same as the other one.
+		float rx = number("rx", -1), ry = number("ry", -1);
+		rx = rx < 0 ? (ry < 0 ? 0 : ry) : rx;
+		ry = ry < 0 ? rx : ry;
+		ok = rect(p, number("x", 0), number("y", 0), number("width", 0), number("height", 0), rx, ry);
+	} else if (equals(name, nameLength, "line")) {
+		ok = moveTo(p, number("x1", 0), number("y1", 0)) && lineTo(p, number("x2", 0), number("y2", 0));
+	} else {
+		return true;
+	}
+	#undef number
+
+	if (!ok) {
+		return false;
+	}
+
+	// Stroke widths are scaled by the transform (the average, if it's not uniform).
+	const float *m = state->matrix;
+	float strokeWidth = state->strokeWidth * sqrtf(fabsf(m[0] * m[3] - m[1] * m[2]));
+	uint32_t fill = paintColor(state->fill, state->fillOpacity * state->opacity);
+	uint32_t stroke = strokeWidth > 0 ? paintColor(state->stroke, state->strokeOpacity * state->opacity) : 0;
+
+	if (image->commandCount == firstCommand || (!fill && !stroke)) {
+		// Nothing to draw.
+		image->commandCount = firstCommand;
+		image->pointCount = firstPoint;
+		return true;
+	}
+
+	if (!grow((void**)&image->shapes, &image->shapeCapacity, image->shapeCount + 1, sizeof(svgShape))) {
+		return false;
+	}
+	svgShape *shape = &image->shapes[image->shapeCount++];
+	shape->fill = fill;
+	shape->stroke = stroke;
+	shape->strokeWidth = strokeWidth;
+	shape->evenOdd = state->evenOdd;
+	shape->cap = state->cap;
+	shape->firstCommand = firstCommand;
+	shape->commandCount = image->commandCount - firstCommand;
+	shape->firstPoint = firstPoint;
+	return true;
+}
+
+/** Reads the size of the drawing, from the root element. */
+static bool readViewBox(svgImage *image, const svgAttribute *attributes, int count)
+{
+	const svgAttribute *viewBox = getAttribute(attributes, count, "viewBox");
+	float box[4];
+	const char *s;
+	if (viewBox && (s = viewBox->value, readNumbers(&s, s + viewBox->valueLength, box, 4))) {
+		image->viewX = box[0];
+		image->viewY = box[1];
+		image->viewWidth = box[2];
+		image->viewHeight = box[3];
+	} else {
+		image->viewWidth = numberAttribute(attributes, count, "width", 0);
+		image->viewHeight = numberAttribute(attributes, count, "height", 0);
+	}
+	// The numbers are finite (see readNumber), but the scale to pixels must be too.
+	return image->viewWidth > 0 && image->viewHeight > 0 && isfinite(1 / image->viewWidth)
+		&& isfinite(1 / image->viewHeight);
+}
+
+/** Handles a start tag. */
+static bool startElement(svgParser *p, const char *name, size_t nameLength, const svgAttribute *attributes, int count)
+{
+	static const char *notDrawn[] = {
+		"defs", "clipPath", "mask", "pattern", "linearGradient", "radialGradient", "symbol", "marker", "filter",
+		"title", "desc", "metadata", "text", "style", "script", "image", "foreignObject"
+	};
+
+	if (!p->rootFound) {
+		if (!equals(name, nameLength, "svg") || !readViewBox(p->image, attributes, count)) {
+			return false;
+		}
+		p->rootFound = true;
+	}
+
+	if (p->depth + 1 >= SVG_MAX_DEPTH) {
+		return false;
+	}
+	svgState *parent = &p->states[p->depth];
+	svgState *state = &p->states[++p->depth];
+	*state = *parent;
+	state->ownOpacity = 1;
+
+	for (size_t n = 0; n < sizeof(notDrawn) / sizeof(notDrawn[0]); n++) {
+		if (equals(name, nameLength, notDrawn[n])) {
+			state->hidden = true;
+		}
+	}
+	if (state->hidden) {
+		return true;
+	}
+
+	applyStyle(p, state, attributes, count);
+	state->opacity = parent->opacity * state->ownOpacity;
+	const svgAttribute *transform = getAttribute(attributes, count, "transform");
+	if (transform && !equals(name, nameLength, "svg")
+		&& !parseTransform(transform->value, transform->value + transform->valueLength, state->matrix)) {
+		// Scaled out of range: nothing in it can be drawn.
+		state->hidden = true;
+	}
+
+	return state->hidden || addShape(p, name, nameLength, attributes, count);
+}
+
+bool svgParse(const void *data, size_t size, svgImage *image)
+{
+	const char *s = data, *end = s + size;
+	svgParser p;
+	memset(image, 0, sizeof(*image));
+	memset(&p, 0, sizeof(p));
+	p.image = image;
+
+	// The initial values of the properties.
+	svgState *root = &p.states[0];
+	root->fill = PAINT_SET;
+	root->fillOpacity = root->strokeOpacity = root->strokeWidth = 1;
+	root->ownOpacity = root->opacity = 1;
+	root->matrix[0] = root->matrix[3] = 1;
+
+	bool ok = true;
+	while (ok && s < end) {
+		s = findChar(s, end, '<');
+		if (s == end) {
+			break;
+		}
+		s++;
+
+		if (startsWith(s, end, "?")) {
+			s = skipPast(s, end, "?>");
+		} else if (startsWith(s, end, "!--")) {
+			s = skipPast(s, end, "-->");
+		} else if (startsWith(s, end, "![CDATA[")) {
+			s = skipPast(s, end, "]]>");
+		} else if (startsWith(s, end, "!")) {
+			s = skipPast(s, end, ">");
+		} else if (startsWith(s, end, "/")) {
+			// End tag.
+			s = skipPast(s, end, ">");
+			if (p.depth > 0) {
+				p.depth--;
+			}
+		} else {
+			// Start tag: the name, then the attributes.
+			const char *name = s;
+			while (s < end && isNameChar(*s)) {
+				s++;
+			}
+			size_t nameLength = (size_t)(s - name);
+
+			svgAttribute attributes[MAX_ATTRIBUTES];
+			int count = 0;
+			bool empty = false;
+			for (;;) {
+				s = skipSpace(s, end);
+				if (s >= end) {
+					ok = false;
+					break;
+				} else if (*s == '>') {
+					s++;
+					break;
+				} else if (startsWith(s, end, "/>")) {
+					s += 2;
+					empty = true;
+					break;
+				}
+
+				svgAttribute a;
+				a.name = s;
+				while (s < end && isNameChar(*s)) {
+					s++;
+				}
+				a.nameLength = (size_t)(s - a.name);
+				s = skipSpace(s, end);
+				if (!a.nameLength || s >= end || *s != '=') {
+					ok = false;
+					break;
+				}
+				s = skipSpace(s + 1, end);
+				if (s >= end || (*s != '"' && *s != '\'')) {
+					ok = false;
+					break;
+				}
+				a.value = s + 1;
+				s = findChar(a.value, end, *s);
+				a.valueLength = (size_t)(s - a.value);
+				s += s < end;
+				if (count < MAX_ATTRIBUTES) {
+					attributes[count++] = a;
+				}
+			}
+
+			if (ok && nameLength) {
+				ok = startElement(&p, name, nameLength, attributes, count);
+				if (ok && !empty && equals(name, nameLength, "style")) {
+					const char *sheetEnd = s;
+					while ((sheetEnd = findChar(sheetEnd, end, '<')) < end && !startsWith(sheetEnd, end, "</")) {
+						// Skip past a CDATA section's start.
+						sheetEnd++;
+					}
+					ok = parseStyleSheet(&p, s, sheetEnd);
+					s = sheetEnd;
+				}
+				if (empty) {
+					p.depth--;
+				}
+			}
+		}
+	}
+
+	free(p.rules);
+	return ok && p.rootFound;
+}
+
+void svgFree(svgImage *image)
+{
+	free(image->shapes);
+	free(image->commands);
+	free(image->points);
+	memset(image, 0, sizeof(*image));
+}
+
+/** The flattened sub-paths of a shape, in pixels. */
+typedef struct {
+	/** x, y pairs */
+	float *points;
+	uint32_t pointCount, pointCapacity;
+	struct {
+		uint32_t first, count;
+		bool closed;
+	} *paths;
+	uint32_t pathCount, pathCapacity;
+} svgOutline;
+
+static bool outlinePoint(svgOutline *o, float x, float y)
+{
+	if (!o->pathCount) {
+		return true;
+	}
+	uint32_t *count = &o->paths[o->pathCount - 1].count;
+	if (*count && o->points[o->pointCount - 2] == x && o->points[o->pointCount - 1] == y) {
+		// Nothing to join.
+		return true;
+	}
+	if (!grow((void**)&o->points, &o->pointCapacity, o->pointCount + 2, sizeof(float))) {
+		return false;
+	}
+	o->points[o->pointCount++] = x;
+	o->points[o->pointCount++] = y;
+	(*count)++;
+	return true;
+}
+
+/** Flattens the path of a shape into lines, transforming it into pixels. */
+static bool flatten(const svgImage *image, const svgShape *shape, const float *m, svgOutline *o)
+{
+	const float *points = image->points + shape->firstPoint;
+	float x = 0, y = 0;
+	o->pointCount = o->pathCount = 0;
+
+	for (uint32_t n = 0; n < shape->commandCount; n++) {
+		uint8_t command = image->commands[shape->firstCommand + n];
+		if (command == SVG_CLOSE) {
+			if (o->pathCount) {
+				o->paths[o->pathCount - 1].closed = true;
+			}
+			continue;
+		}
+
+		float px[3], py[3];
+		int count = command == SVG_CUBIC ? 3 : 1;
+		for (int i = 0; i < count; i++) {
+			px[i] = points[0] * m[0] + m[2];
+			py[i] = points[1] * m[1] + m[3];
+			points += 2;
+		}
+
+		if (command == SVG_MOVE) {
+			if (!grow((void**)&o->paths, &o->pathCapacity, o->pathCount + 1, sizeof(*o->paths))) {
+				return false;
+			}
+			o->paths[o->pathCount].first = o->pointCount / 2;
+			o->paths[o->pathCount].count = 0;
+			o->paths[o->pathCount].closed = false;
+			o->pathCount++;
+			if (!outlinePoint(o, px[0], py[0])) {
+				return false;
+			}
+		} else if (command == SVG_LINE) {
+			if (!outlinePoint(o, px[0], py[0])) {
+				return false;
+			}
+		} else {
+			// Enough lines to be within FLATNESS of the curve (Wang's formula).
+			float ddx = fmaxf(fabsf(x - 2 * px[0] + px[1]), fabsf(px[0] - 2 * px[1] + px[2]));
+			float ddy = fmaxf(fabsf(y - 2 * py[0] + py[1]), fabsf(py[0] - 2 * py[1] + py[2]));
+			float lines = ceilf(sqrtf(0.75f * sqrtf(ddx * ddx + ddy * ddy) / FLATNESS));
+			// Clamped before converting, in case it's out of range (or NaN).
+			int steps = !(lines > 1) ? 1 : lines > 100 ? 100 : (int)lines;
+			for (int i = 1; i <= steps; i++) {
+				float t = (float)i / steps, u = 1 - t;
+				float a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+				if (!outlinePoint(o, a * x + b * px[0] + c * px[1] + d * px[2],
+					a * y + b * py[0] + c * py[1] + d * py[2])) {
+					return false;
+				}
+			}
+		}
+		x = px[count - 1];
+		y = py[count - 1];
+	}
+	return true;
+}
+
+/** Adds a convex polygon to the rasterizer, always going the same way round (so overlapping ones add together). */
+static bool addPolygon(rasterizer *r, const float *points, int count)
+{
+	float area = 0;
+	for (int n = 0; n < count; n++) {
+		int next = (n + 1) % count;
+		area += points[n * 2] * points[next * 2 + 1] - points[next * 2] * points[n * 2 + 1];
+	}
+	if (fabsf(area) < 1e-6f) {
+		return true;
+	}
+	for (int n = 0; n < count; n++) {
+		int a = area > 0 ? n : count - 1 - n, b = area > 0 ? (n + 1) % count : (2 * count - 2 - n) % count;
+		if (!rasterLine(r, points[a * 2], points[a * 2 + 1], points[b * 2], points[b * 2 + 1])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool addCircle(rasterizer *r, float cx, float cy, float radius)
+{
+	float points[64 * 2];
+	// Enough sides to be within CIRCLE_FLATNESS of the circle.
+	float exact = radius > CIRCLE_FLATNESS ? ceilf((float)M_PI / acosf(1 - CIRCLE_FLATNESS / radius)) : 8;
+	int sides = !(exact > 8) ? 8 : exact > 64 ? 64 : (int)exact;
+	// The polygon has the same area as the circle, rather than being inside it.
+	float step = 2 * (float)M_PI / sides;
+	radius *= sqrtf(step / sinf(step));
+	for (int n = 0; n < sides; n++) {
+		points[n * 2] = cx + radius * cosf(step * n);
+		points[n * 2 + 1] = cy + radius * sinf(step * n);
+	}
+	return addPolygon(r, points, sides);
+}
+
+/** Adds the outline of a stroke: a rectangle for each line, with round joins between them, and the caps. */
+static bool addStroke(rasterizer *r, const svgOutline *o, float halfWidth, uint8_t cap)
+{
+	for (uint32_t path = 0; path < o->pathCount; path++) {
+		const float *points = o->points + o->paths[path].first * 2;
+		int count = (int)o->paths[path].count;
+		bool closed = o->paths[path].closed;
+		if (closed && count > 1 && points[0] == points[count * 2 - 2] && points[1] == points[count * 2 - 1]) {
+			count--;
+		}
+
+		if (count == 1) {
+			// A dot, which only has caps.
+			if (cap == SVG_CAP_ROUND && !addCircle(r, points[0], points[1], halfWidth)) {
+				return false;
+			} else if (cap == SVG_CAP_SQUARE) {
+				float x = points[0], y = points[1], h = halfWidth;
+				float square[] = { x - h, y - h, x + h, y - h, x + h, y + h, x - h, y + h };
+				if (!addPolygon(r, square, 4)) {
+					return false;
+				}
+			}
+			continue;
+		}
+
+		int lines = closed ? count : count - 1;
+		for (int n = 0; n < lines; n++) {
+			int next = (n + 1) % count;
+			float x0 = points[n * 2], y0 = points[n * 2 + 1], x1 = points[next * 2], y1 = points[next * 2 + 1];
+			float length = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+			float dx = (x1 - x0) / length * halfWidth, dy = (y1 - y0) / length * halfWidth;
+
+			if (!closed && cap == SVG_CAP_SQUARE) {
+				if (n == 0) {
+					x0 -= dx;
+					y0 -= dy;
+				}
+				if (n == lines - 1) {
+					x1 += dx;
+					y1 += dy;
+				}
+			}
+
+			float quad[] = { x0 - dy, y0 + dx, x1 - dy, y1 + dx, x1 + dy, y1 - dx, x0 + dy, y0 - dx };
+			if (!addPolygon(r, quad, 4)) {
+				return false;
+			}
+
+			// The join at the end of the line.
+			if (closed || next != count - 1) {
+				int after = (next + 1) % count;
+				float x2 = points[after * 2], y2 = points[after * 2 + 1];
+				float length2 = sqrtf((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+				float ex = (x2 - x1) / length2 * halfWidth, ey = (y2 - y1) / length2 * halfWidth;
+				float cosine = (dx * ex + dy * ey) / (halfWidth * halfWidth);
+				if (halfWidth * (1 - sqrtf((1 + fmaxf(cosine, -1)) / 2)) < FLATNESS / 2) {
+					// A shallow bend (like along a curve): the gap on the outside of it is filled with a triangle (the
+					// lines overlap on the inside).
+					float px = points[next * 2], py = points[next * 2 + 1], side = dx * ey - dy * ex > 0 ? 1.0f : -1.0f;
+					float outer[] = { px, py, px + dy * side, py - dx * side, px + ey * side, py - ex * side };
+					if (!addPolygon(r, outer, 3)) {
+						return false;
+					}
+				} else if (!addCircle(r, points[next * 2], points[next * 2 + 1], halfWidth)) {
+					return false;
+				}
+			}
+		}
+
+		if (!closed && cap == SVG_CAP_ROUND) {
+			if (!addCircle(r, points[0], points[1], halfWidth)
+				|| !addCircle(r, points[count * 2 - 2], points[count * 2 - 1], halfWidth)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/** Premultiplied pixel of an ARGB colour. */
+static uint32_t premultiplied(uint32_t color)
+{
+	uint32_t a = color >> 24, out = a << 24;
+	for (int shift = 0; shift < 24; shift += 8) {
+		out |= ((((color >> shift) & 0xff) * a + 127) / 255) << shift;
+	}
+	return out;
+}
+
+bool svgRender(const svgImage *image, int32_t size, uint32_t *pixels)
+{
+	size_t count = (size_t)size * size;
+	memset(pixels, 0, count * sizeof(uint32_t));
+	if (image->viewWidth <= 0 || image->viewHeight <= 0 || size <= 0) {
+		return true;
+	}
+
+	// Fit the view box into the square, in the middle.
+	float scale = fminf(size / image->viewWidth, size / image->viewHeight);
+	float m[4] = {
+		scale, scale,
+		(size - image->viewWidth * scale) / 2 - image->viewX * scale,
+		(size - image->viewHeight * scale) / 2 - image->viewY * scale
+	};
+
+	rasterizer r;
+	svgOutline outline = { 0 };
+	uint8_t *mask = malloc(count);
+	bool ok = mask && rasterInit(&r, size, size);
+
+	for (uint32_t n = 0; ok && n < image->shapeCount; n++) {
+		const svgShape *shape = &image->shapes[n];
+		ok = flatten(image, shape, m, &outline);
+
+		if (ok && shape->fill) {
+			// Fills are closed.
+			for (uint32_t path = 0; ok && path < outline.pathCount; path++) {
+				const float *points = outline.points + outline.paths[path].first * 2;
+				uint32_t pointCount = outline.paths[path].count;
+				for (uint32_t i = 0; ok && i < pointCount; i++) {
+					uint32_t next = (i + 1) % pointCount;
+					ok = rasterLine(&r, points[i * 2], points[i * 2 + 1], points[next * 2], points[next * 2 + 1]);
+				}
+			}
+			if (ok) {
+				rasterFill(&r, shape->evenOdd, mask);
+				rasterBlend(pixels, mask, count, premultiplied(shape->fill));
+			}
+		}
+
+		if (ok && shape->stroke) {
+			ok = addStroke(&r, &outline, shape->strokeWidth * scale / 2, shape->cap);
+			if (ok) {
+				rasterFill(&r, false, mask);
+				rasterBlend(pixels, mask, count, premultiplied(shape->stroke));
+			}
+		}
+	}
+
+	if (mask) {
+		rasterFree(&r);
+	}
+	free(mask);
+	free(outline.points);
+	free(outline.paths);
+
+	unpremultiplyPixels(pixels, count);
+	return ok;
+}
+
+const uint32_t *svgIconGet(svgIcon *icon, int32_t size)
+{
+	uint32_t oldest = 0;
+	icon->clock++;
+	for (uint32_t n = 0; n < SVG_CACHE_SIZES; n++) {
+		if (icon->sizes[n].pixels && icon->sizes[n].size == size) {
+			icon->sizes[n].lastUsed = icon->clock;
+			icon->hits++;
+			return icon->sizes[n].pixels;
+		}
+		if (!icon->sizes[n].pixels || (icon->sizes[oldest].pixels
+			&& icon->sizes[n].lastUsed < icon->sizes[oldest].lastUsed)) {
+			oldest = n;
+		}
+	}
+
+	// Replace the least recently used size (or an unused entry).
+	uint32_t *pixels = realloc(icon->sizes[oldest].pixels, (size_t)size * size * sizeof(uint32_t));
+	if (!pixels) {
+		return null;
+	}
+	icon->sizes[oldest].pixels = pixels;
+	icon->sizes[oldest].size = size;
+	icon->sizes[oldest].lastUsed = icon->clock;
+	icon->renders++;
+	if (!svgRender(&icon->image, size, pixels)) {
+		free(pixels);
+		icon->sizes[oldest].pixels = null;
+		return null;
+	}
+	return pixels;
+}
+
+void svgIconFree(svgIcon *icon)
+{
+	svgFree(&icon->image);
+	for (uint32_t n = 0; n < SVG_CACHE_SIZES; n++) {
+		free(icon->sizes[n].pixels);
+	}
+	memset(icon, 0, sizeof(*icon));
+}
@@ -0,0 +1,123 @@
+/* Task tray button - platform-neutral core.
+ * Reads SVG icons, and draws them at any size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_SVG_H
+#define TRAY_BUTTON_SVG_H
+
+#include "common.h"
+
+/*
+ * Enough of SVG for icons like those exported by Illustrator: path, polygon, polyline, line, rect, circle and ellipse
+ * elements in nested groups, with transforms; solid fills and strokes, set by presentation attributes, style attributes,
+ * or class rules in a <style> element. Gradients, patterns, text, images, clipping, masks and filters aren't drawn.
+ * Strokes always have round joins, whatever the line-join and miter settings. Group opacity is applied to each shape in
+ * the group, rather than to the group as a whole.
+ *
+ * The shapes are kept as paths, so the icon can be drawn at the exact size it's needed at, rather than scaled.
+ */
+
+// Path commands
+#define SVG_MOVE  1
+#define SVG_LINE  2
+#define SVG_CUBIC 3
+#define SVG_CLOSE 4
+
+// Line caps
+#define SVG_CAP_BUTT   0
+#define SVG_CAP_ROUND  1
+#define SVG_CAP_SQUARE 2
+
+/** Most nested groups. */
+#define SVG_MAX_DEPTH 32
+
+/** A shape: a path, and how it's painted. */
+typedef struct {
+	/** Fill and stroke colours: 0xaarrggbb, not premultiplied (0 for none) */
+	uint32_t fill, stroke;
+	float strokeWidth;
+	bool evenOdd;
+	/** Line cap (SVG_CAP_*) */
+	uint8_t cap;
+	/** The path's commands and points, in the image's arrays */
+	uint32_t firstCommand, commandCount;
+	uint32_t firstPoint;
+} svgShape;
+
+typedef struct {
+	/** The area of the drawing shown (the viewBox) */
+	float viewX, viewY, viewWidth, viewHeight;
+	svgShape *shapes;
+	uint32_t shapeCount, shapeCapacity;
+	/** Path commands (SVG_*), and their points: x, y pairs (a move or line has 1, a cubic has 3) */
+	uint8_t *commands;
+	uint32_t commandCount, commandCapacity;
+	float *points;
+	uint32_t pointCount, pointCapacity;
+} svgImage;
+
+/** Number of sizes an SVG icon is kept at. */
+#define SVG_CACHE_SIZES 4
+
+/** An SVG image, and the sizes it has been drawn at. */
+typedef struct {
+	svgImage image;
+	struct {
+		int32_t size;
+		/** size * size pixels, or null if the entry is unused */
+		uint32_t *pixels;
+		/** When the entry was last used (cache clock) */
+		uint32_t lastUsed;
+	} sizes[SVG_CACHE_SIZES];
+	uint32_t clock;
+	/** Statistics */
+	uint32_t hits, renders;
+} svgIcon;
+
+/**
+ * Reads an SVG file.
+ * @param data The file contents (UTF-8).
+ * @param size Size of the data.
+ * @param image Receives the image. Free with svgFree, even on failure.
+ * @return false if it's not an SVG file, it's malformed, or there's no memory.
+ */
+bool svgParse(const void *data, size_t size, svgImage *image);
+
+/**
+ * Frees an image read by svgParse.
+ * @param image The image.
+ */
+void svgFree(svgImage *image);
+
+/**
+ * Draws an image into a square, keeping its aspect ratio and centring it (like preserveAspectRatio="xMidYMid meet").
+ * @param image The image.
+ * @param size Size of the square.
+ * @param pixels Receives size * size 32-bit BGRA pixels (not premultiplied, like icoImage), top-down.
+ * @return false if there's no memory.
+ */
+bool svgRender(const svgImage *image, int32_t size, uint32_t *pixels);
+
+/**
+ * Gets an SVG icon drawn at a size, drawing it if it's not one of the recently used sizes.
+ * @param icon The icon.
+ * @param size The size.
+ * @return size * size pixels, as svgRender; or null if there's no memory.
+ */
+const uint32_t *svgIconGet(svgIcon *icon, int32_t size);
+
+/**
+ * Frees the image and the pixels of an icon.
+ * @param icon The icon.
+ */
+void svgIconFree(svgIcon *icon);
+
+#endif /* TRAY_BUTTON_SVG_H */
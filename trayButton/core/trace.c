@@ -0,0 +1,230 @@
+/* Task tray button - platform-neutral core.
+ * Traces of what the button receives, for replaying on other platforms.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+#define TRACE_PREFIX "trace: "
+
+static const char *typeNames[] = {
+	null,
+	"shell",
+	"setting",
+	"display",
+	"size",
+	"erase",
+	"icon",
+	"hide",
+	"geometry",
+	"dpi",
+	"contrast",
+	"expect"
+};
+
+#define TYPE_COUNT (sizeof(typeNames) / sizeof(typeNames[0]))
+
+const char *traceTypeName(uint32_t type)
+{
+	return type < TYPE_COUNT ? typeNames[type] : null;
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char *skipSpace(const char *p)
+{
+	while (isSpace(*p)) {
+		p++;
+	}
+	return p;
+}
+
+/**
+ * Reads a word.
+ * @param p The current position (updated to after the word).
+ * @param word Receives the word.
+ * @param size Size of word.
+ * @return false if there's no word, or it's too long.
+ */
+static bool readWord(const char **p, char *word, size_t size)
+{
+	const char *s = skipSpace(*p);
+	size_t length = 0;
+	while (s[length] && !isSpace(s[length])) {
+		length++;
+	}
+	if (length == 0 || length >= size) {
+		return false;
+	}
+	memcpy(word, s, length);
+	word[length] = '\0';
+	*p = s + length;
+	return true;
+}
+
+/**
+ * Reads a decimal number.
+ * @param p The current position (updated to after the number).
+ * @param value Receives the value.
+ * @param allowNegative true to accept a leading '-'.
+ * @return false if there's no number, or it's out of range.
+ */
+static bool readNumber(const char **p, int64_t *value, bool allowNegative)
+{
+	const char *s = skipSpace(*p);
+	bool negative = false;
+	if (*s == '-' && allowNegative) {
+		negative = true;
+		s++;
+	}
+	if (*s < '0' || *s > '9') {
+		return false;
+	}
+
+	int64_t n = 0;
+	while (*s >= '0' && *s <= '9') {
+		if (n > (INT64_MAX - 9) / 10) {
+			return false;
+		}
+		n = n * 10 + (*s++ - '0');
+	}
+	if (*s && !isSpace(*s)) {
+		return false;
+	}
+
+	*value = negative ? -n : n;
+	*p = s;
+	return true;
+}
+
+static bool readInt32(const char **p, int32_t *value)
+{
+	int64_t n;
+	if (!readNumber(p, &n, true) || n < INT32_MIN || n > INT32_MAX) {
+		return false;
+	}
+	*value = (int32_t)n;
+	return true;
+}
+
+static bool readUint32(const char **p, uint32_t *value)
+{
+	int64_t n;
+	if (!readNumber(p, &n, false) || n > UINT32_MAX) {
+		return false;
+	}
+	*value = (uint32_t)n;
+	return true;
+}
+
+static bool readRect(const char **p, coreRect *rect)
+{
+	return readInt32(p, &rect->left) && readInt32(p, &rect->top)
+		&& readInt32(p, &rect->right) && readInt32(p, &rect->bottom);
+}
+
+int traceParse(const char *line, traceEvent *event)
+{
+	const char *p = strstr(line, TRACE_PREFIX);
+	p = p ? p + strlen(TRACE_PREFIX) : line;
+	p = skipSpace(p);
+
+	if (*p == '\0' || *p == '#') {
+		return TRACE_LINE_NONE;
+	}
+
+	memset(event, 0, sizeof(*event));
+
+	int64_t time;
+	char type[TRACE_NAME_LENGTH];
+	if (!readNumber(&p, &time, false) || !readWord(&p, type, sizeof(type))) {
+		return TRACE_LINE_ERROR;
+	}
+	event->time = (uint64_t)time;
+
+	for (uint32_t t = 1; t < TYPE_COUNT; t++) {
+		if (strcmp(type, typeNames[t]) == 0) {
+			event->type = t;
+			break;
+		}
+	}
+
+	bool ok;
+	switch (event->type) {
+	case TRACE_GEOMETRY:
+		ok = readRect(&p, &event->geometry.trayRect) && readRect(&p, &event->geometry.trayClient)
+			&& readRect(&p, &event->geometry.tasksRect) && readRect(&p, &event->geometry.notifyRect)
+			&& readInt32(&p, &event->geometry.screenHeight);
+		break;
+	case TRACE_DPI:
+		ok = readUint32(&p, &event->value) && event->value > 0;
+		break;
+	case TRACE_CONTRAST:
+		ok = readUint32(&p, &event->value) && event->value <= 1;
+		break;
+	case TRACE_EXPECT:
+		ok = readWord(&p, event->name, sizeof(event->name)) && readUint32(&p, &event->value);
+		break;
+	case 0:
+		ok = false;
+		break;
+	default:
+		ok = true;
+		break;
+	}
+
+	// Nothing else on the line.
+	return ok && *skipSpace(p) == '\0' ? TRACE_LINE_EVENT : TRACE_LINE_ERROR;
+}
+
+size_t traceFormat(const traceEvent *event, char *buffer, size_t size)
+{
+	const char *name = traceTypeName(event->type);
+	const layoutInput *g = &event->geometry;
+	int length;
+
+	if (!name || !size) {
+		return 0;
+	}
+
+	switch (event->type) {
+	case TRACE_GEOMETRY:
+		length = snprintf(buffer, size, "%llu %s %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+			(unsigned long long)event->time, name,
+			g->trayRect.left, g->trayRect.top, g->trayRect.right, g->trayRect.bottom,
+			g->trayClient.left, g->trayClient.top, g->trayClient.right, g->trayClient.bottom,
+			g->tasksRect.left, g->tasksRect.top, g->tasksRect.right, g->tasksRect.bottom,
+			g->notifyRect.left, g->notifyRect.top, g->notifyRect.right, g->notifyRect.bottom,
+			g->screenHeight);
+		break;
+	case TRACE_DPI:
+	case TRACE_CONTRAST:
+		length = snprintf(buffer, size, "%llu %s %u", (unsigned long long)event->time, name, event->value);
+		break;
+	case TRACE_EXPECT:
+		length = snprintf(buffer, size, "%llu %s %s %u", (unsigned long long)event->time, name, event->name,
+			event->value);
+		break;
+	default:
+		length = snprintf(buffer, size, "%llu %s", (unsigned long long)event->time, name);
+		break;
+	}
+
+	if (length < 0 || (size_t)length >= size) {
+		buffer[0] = '\0';
+		return 0;
+	}
+	return (size_t)length;
+}
@@ -0,0 +1,103 @@
+/* Task tray button - platform-neutral core.
+ * Traces of what the button receives, for replaying on other platforms.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_TRACE_H
+#define TRAY_BUTTON_TRACE_H
+
+#include "common.h"
+#include "layout.h"
+
+/*
+ * A trace is text, one event per line: "<ms> <type> [values]". Blank lines and lines starting with '#' are ignored.
+ * Anything before "trace: " is also ignored, so the button's log output can be used as-is.
+ *
+ * Messages, which the replay passes to the button logic:
+ *   <ms> shell                         A SHELLHOOK message
+ *   <ms> setting                       WM_SETTINGCHANGE
+ *   <ms> display                       WM_DISPLAYCHANGE
+ *   <ms> size                          WM_SIZE or WM_WINDOWPOSCHANGED
+ *   <ms> erase                         WM_ERASEBKGND
+ *   <ms> icon                          gpii set the icon
+ *   <ms> hide                          The button was hidden
+ *
+ * Snapshots, which the replay returns the next time the button asks:
+ *   <ms> geometry <tray> <client> <tasks> <notify> <screenHeight>
+ *                                      The taskbar (each rectangle is "left top right bottom")
+ *   <ms> dpi <dpi>                     The taskbar's DPI
+ *   <ms> contrast <0|1>                High-contrast mode
+ *
+ * Expectations, for regression checks:
+ *   <ms> expect <counter> <max>        The replay should do no more than max of something
+ *
+ * Timers aren't recorded; the replay fires them when the button's schedule says they're due.
+ */
+
+#define TRACE_SHELL    1
+#define TRACE_SETTING  2
+#define TRACE_DISPLAY  3
+#define TRACE_SIZE     4
+#define TRACE_ERASE    5
+#define TRACE_ICON     6
+#define TRACE_HIDE     7
+#define TRACE_GEOMETRY 8
+#define TRACE_DPI      9
+#define TRACE_CONTRAST 10
+#define TRACE_EXPECT   11
+
+/** Results of traceParse */
+#define TRACE_LINE_ERROR -1
+#define TRACE_LINE_NONE   0
+#define TRACE_LINE_EVENT  1
+
+#define TRACE_NAME_LENGTH 32
+/** Long enough for any formatted event */
+#define TRACE_LINE_LENGTH 256
+
+/** An event in a trace. */
+typedef struct {
+	/** Time since the start of the trace (ms) */
+	uint64_t time;
+	/** TRACE_* */
+	uint32_t type;
+	/** TRACE_DPI, TRACE_CONTRAST, and TRACE_EXPECT */
+	uint32_t value;
+	/** TRACE_EXPECT: the counter */
+	char name[TRACE_NAME_LENGTH];
+	/** TRACE_GEOMETRY: the rectangles and screenHeight */
+	layoutInput geometry;
+} traceEvent;
+
+/**
+ * Parses a line of a trace.
+ * @param line The line (null-terminated; a trailing new-line is allowed).
+ * @param event Receives the event.
+ * @return TRACE_LINE_EVENT, TRACE_LINE_NONE for lines without an event, or TRACE_LINE_ERROR.
+ */
+int traceParse(const char *line, traceEvent *event);
+
+/**
+ * Formats an event as a line of a trace (without the new-line).
+ * @param event The event.
+ * @param buffer Receives the line (null-terminated).
+ * @param size Size of the buffer.
+ * @return The length of the line, or 0 if the event is invalid or doesn't fit.
+ */
+size_t traceFormat(const traceEvent *event, char *buffer, size_t size);
+
+/**
+ * Gets the name of an event type, as used in the trace.
+ * @param type The type (TRACE_*).
+ * @return The name, or null if it's unknown.
+ */
+const char *traceTypeName(uint32_t type);
+
+#endif /* TRAY_BUTTON_TRACE_H */
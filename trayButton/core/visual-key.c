@@ -0,0 +1,61 @@
+/* Task tray button - platform-neutral core.
+ * Identifies what the button looks like, so redraws that wouldn't change anything can be skipped.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "visual-key.h"
+
+uint32_t visualState(uint32_t state, bool highContrast)
+{
+	if (highContrast) {
+		return state & (STATE_CHECKED | STATE_HOVER);
+	} else if (state & STATE_PRESSED) {
+		return STATE_PRESSED;
+	} else {
+		return state & STATE_HOVER;
+	}
+}
+
+void visualKeyInit(visualKey *key, uint32_t state, bool highContrast, uint32_t iconId, int32_t iconSize,
+	int32_t width, int32_t height, uint32_t foreground, uint32_t background)
+{
+	key->state = visualState(state, highContrast);
+	key->iconId = iconId;
+	key->iconSize = iconId ? iconSize : 0;
+	key->width = width;
+	key->height = height;
+	key->highContrast = highContrast;
+	key->foreground = highContrast ? foreground : 0;
+	key->background = highContrast ? background : 0;
+}
+
+bool visualRedrawNeeded(visualTracker *tracker, const visualKey *key)
+{
+	if (tracker->valid && memcmp(&tracker->painted, key, sizeof(*key)) == 0) {
+		tracker->skipped++;
+		return false;
+	}
+
+	visualPainted(tracker, key);
+	tracker->performed++;
+	return true;
+}
+
+void visualPainted(visualTracker *tracker, const visualKey *key)
+{
+	tracker->painted = *key;
+	tracker->valid = true;
+}
+
+void visualInvalidate(visualTracker *tracker)
+{
+	tracker->valid = false;
+}
@@ -0,0 +1,93 @@
+/* Task tray button - platform-neutral core.
+ * Identifies what the button looks like, so redraws that wouldn't change anything can be skipped.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_VISUAL_KEY_H
+#define TRAY_BUTTON_VISUAL_KEY_H
+
+#include "common.h"
+
+// Button states
+#define STATE_NORMAL  1
+#define STATE_HOVER   2
+#define STATE_PRESSED 4
+#define STATE_CHECKED 8
+
+/** Everything that affects the button's appearance. Every field is 32-bit, so it can be compared with memcmp. */
+typedef struct {
+	/** The state bits that are drawn, in the current mode (see visualState) */
+	uint32_t state;
+	/** Identifies the icon (0 for none) */
+	uint32_t iconId;
+	int32_t iconSize;
+	/** Size of the button */
+	int32_t width, height;
+	uint32_t highContrast;
+	/** The high-contrast colours (COLORREF); 0 when not in high-contrast */
+	uint32_t foreground, background;
+} visualKey;
+
+/** Remembers the last frame, and counts the redraws. */
+typedef struct {
+	/** The last frame painted (or about to be) */
+	visualKey painted;
+	bool valid;
+	uint32_t performed, skipped;
+} visualTracker;
+
+/**
+ * Gets the state bits that affect how the button is drawn. In high-contrast, the checked and hover states are shown;
+ * otherwise pressed or hover (pressed taking precedence).
+ * @param state The button state (STATE_*).
+ * @param highContrast true if high-contrast mode is on.
+ * @return The state bits which are drawn.
+ */
+uint32_t visualState(uint32_t state, bool highContrast);
+
+/**
+ * Makes the key of the button's appearance.
+ * @param key Receives the key.
+ * @param state The button state (STATE_*).
+ * @param highContrast true if high-contrast mode is on.
+ * @param iconId Identifies the icon (0 for none).
+ * @param iconSize Size of the icon.
+ * @param width Width of the button.
+ * @param height Height of the button.
+ * @param foreground The high-contrast foreground colour (ignored if not high-contrast).
+ * @param background The high-contrast background colour (ignored if not high-contrast).
+ */
+void visualKeyInit(visualKey *key, uint32_t state, bool highContrast, uint32_t iconId, int32_t iconSize,
+	int32_t width, int32_t height, uint32_t foreground, uint32_t background);
+
+/**
+ * Determines if the button needs to be redrawn, because it would look different to the last frame. If so, the key is
+ * remembered as the last frame.
+ * @param tracker The tracker.
+ * @param key The key of the frame that would be drawn.
+ * @return true to redraw.
+ */
+bool visualRedrawNeeded(visualTracker *tracker, const visualKey *key);
+
+/**
+ * Records the frame that was painted.
+ * @param tracker The tracker.
+ * @param key The key of the frame.
+ */
+void visualPainted(visualTracker *tracker, const visualKey *key);
+
+/**
+ * Forgets the last frame, so the next redraw is performed. For when something outside of the key changes the
+ * appearance, such as the window moving.
+ * @param tracker The tracker.
+ */
+void visualInvalidate(visualTracker *tracker);
+
+#endif /* TRAY_BUTTON_VISUAL_KEY_H */
@@ -0,0 +1,70 @@
+/* Task tray button - platform-neutral core.
+ * Remembers the taskbar's windows, so they don't need to be searched for each time.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "window-cache.h"
+
+void windowCacheInit(windowCache *cache, const windowSystem *system)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->system = *system;
+	// Nothing has been found yet.
+	cache->generation = 1;
+}
+
+/** Searches for all the windows. */
+static void findWindows(windowCache *cache)
+{
+	windowSystem *system = &cache->system;
+	windowHandle tray;
+
+	cache->lookups++;
+	memset(cache->windows, 0, sizeof(cache->windows));
+
+	tray = system->find(system->context, null, WINDOW_TRAY);
+	cache->searches++;
+	if (!tray) {
+		// No taskbar (explorer isn't running); try again next time.
+		return;
+	}
+
+	cache->windows[WINDOW_TRAY] = tray;
+	for (uint32_t which = WINDOW_TRAY + 1; which < WINDOW_COUNT; which++) {
+		cache->windows[which] = system->find(system->context, tray, which);
+		cache->searches++;
+	}
+	cache->foundGeneration = cache->generation;
+}
+
+windowHandle windowCacheGet(windowCache *cache, uint32_t which)
+{
+	if (which >= WINDOW_COUNT) {
+		return null;
+	}
+
+	windowHandle window = cache->windows[which];
+	if (cache->foundGeneration == cache->generation && window
+		&& cache->system.isWindow(cache->system.context, window)) {
+		cache->hits++;
+		return window;
+	}
+
+	findWindows(cache);
+	return cache->windows[which];
+}
+
+void windowCacheInvalidate(windowCache *cache)
+{
+	cache->invalidations++;
+	cache->generation++;
+	memset(cache->windows, 0, sizeof(cache->windows));
+}
@@ -0,0 +1,82 @@
+/* Task tray button - platform-neutral core.
+ * Remembers the taskbar's windows, so they don't need to be searched for each time.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_WINDOW_CACHE_H
+#define TRAY_BUTTON_WINDOW_CACHE_H
+
+#include "common.h"
+
+/** The taskbar's windows */
+#define WINDOW_TRAY   0
+#define WINDOW_TASKS  1
+#define WINDOW_NOTIFY 2
+#define WINDOW_COUNT  3
+
+/** A window handle (HWND) */
+typedef void *windowHandle;
+
+/** How the windows are found. */
+typedef struct {
+	/**
+	 * Searches for a window (FindWindow/FindWindowEx).
+	 * @param context The context.
+	 * @param parent The parent window (null for WINDOW_TRAY).
+	 * @param which The window (WINDOW_*).
+	 * @return The window, or null if it's not found.
+	 */
+	windowHandle (*find)(void *context, windowHandle parent, uint32_t which);
+	/**
+	 * Determines if a window still exists (IsWindow). This needs to be much cheaper than find.
+	 * @param context The context.
+	 * @param window The window.
+	 */
+	bool (*isWindow)(void *context, windowHandle window);
+	void *context;
+} windowSystem;
+
+/**
+ * The taskbar's windows, from the last search. They're found again if one of them no longer exists, or after the
+ * cache is invalidated (when the taskbar is re-created, a new window could re-use an old handle).
+ */
+typedef struct {
+	windowSystem system;
+	windowHandle windows[WINDOW_COUNT];
+	/** Incremented when the cache is invalidated */
+	uint32_t generation;
+	/** The generation of the current windows */
+	uint32_t foundGeneration;
+	/** Statistics */
+	uint32_t lookups, searches, hits, invalidations;
+} windowCache;
+
+/**
+ * Initialises the cache.
+ * @param cache The cache.
+ * @param system How the windows are found.
+ */
+void windowCacheInit(windowCache *cache, const windowSystem *system);
+
+/**
+ * Gets one of the taskbar's windows, searching for them if the cached ones aren't valid.
+ * @param cache The cache.
+ * @param which The window (WINDOW_*).
+ * @return The window, or null if there isn't one.
+ */
+windowHandle windowCacheGet(windowCache *cache, uint32_t which);
+
+/**
+ * Forgets the windows, so they're searched for next time (the taskbar has been re-created).
+ * @param cache The cache.
+ */
+void windowCacheInvalidate(windowCache *cache);
+
+#endif /* TRAY_BUTTON_WINDOW_CACHE_H */
@@ -0,0 +1,225 @@
+/* Task tray button - unit tests.
+ * Tests for the animation command, the frame scheduler (using a fake clock), and the frame composition.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/animation.h"
+#include "../core/pixels.h"
+
+/** Copies an ASCII string into a UTF-16 buffer. */
+static const hostChar *utf16(hostChar *buffer, const char *text)
+{
+	size_t n = 0;
+	do {
+		buffer[n] = (hostChar)text[n];
+	} while (text[n++]);
+	return buffer;
+}
+
+static bool parse(const char *text, animationSpec *spec)
+{
+	hostChar buffer[1024];
+	return animationParse(utf16(buffer, text), strlen(text), spec);
+}
+
+/** The command is "<ms>;<loops>;<file>;<file>...". */
+static void testParse()
+{
+	animationSpec spec;
+	assertTrue("valid", parse("40;2;a.ico;bb.ico;c.ico", &spec));
+	assertEquals("interval", 40, spec.interval);
+	assertEquals("loops", 2, spec.loops);
+	assertEquals("frames", 3, spec.frameCount);
+	assertEquals("second file offset", 11, spec.frames[1].offset);
+	assertEquals("second file length", 6, spec.frames[1].length);
+	assertEquals("last file length", 5, spec.frames[2].length);
+
+	assertTrue("trailing separator", parse("40;0;a.ico;", &spec));
+	assertEquals("trailing separator frames", 1, spec.frameCount);
+
+	assertTrue("no frames", !parse("40;0;", &spec));
+	assertTrue("no loops", !parse("40;a.ico", &spec));
+	assertTrue("not a number", !parse("4x;0;a.ico", &spec));
+	assertTrue("empty number", !parse(";0;a.ico", &spec));
+	assertTrue("empty file", !parse("40;0;a.ico;;b.ico", &spec));
+	assertTrue("overflow", !parse("99999999999;0;a.ico", &spec));
+	assertTrue("null", !animationParse(null, 0, &spec));
+
+	// Too many frames.
+	char many[ANIMATION_MAX_FRAMES * 2 + 16] = "40;0;";
+	for (int n = 0; n <= ANIMATION_MAX_FRAMES; n++) {
+		strcat(many, "a;");
+	}
+	assertTrue("too many frames", !parse(many, &spec));
+}
+
+/** Frames follow the clock, and it stops after the last loop. */
+static void testFrames()
+{
+	frameScheduler s;
+	frameSchedulerInit(&s);
+	assertEquals("not animating", -1, s.frame);
+	assertEquals("tick while stopped", 0, frameSchedulerTick(&s, 0));
+
+	assertEquals("first delay", 100, frameSchedulerStart(&s, 3, 100, 2, 1000));
+	assertEquals("first frame", 0, s.frame);
+
+	int expected[] = { 1, 2, 0, 1, 2 };
+	uint64_t now = 1000;
+	for (int n = 0; n < 5; n++) {
+		now += 100;
+		assertEquals("on time", 100, frameSchedulerTick(&s, now));
+		assertEquals("frame", expected[n], s.frame);
+	}
+
+	now += 100;
+	assertEquals("ended", 0, frameSchedulerTick(&s, now));
+	assertEquals("icon shown again", -1, s.frame);
+	assertTrue("stopped", !s.running);
+	assertEquals("every frame shown", 6, s.shown);
+	assertEquals("none dropped", 0, s.dropped);
+}
+
+/** A late timer skips frames rather than slowing down; an early one waits for the rest of the frame. */
+static void testLateTimer()
+{
+	frameScheduler s;
+	frameSchedulerInit(&s);
+	frameSchedulerStart(&s, 10, 50, 0, 0);
+
+	assertEquals("delay to the boundary", 20, frameSchedulerTick(&s, 130));
+	assertEquals("skipped to the frame for the time", 2, s.frame);
+	assertEquals("one dropped", 1, s.dropped);
+
+	assertEquals("early", 15, frameSchedulerTick(&s, 135));
+	assertEquals("same frame", 2, s.frame);
+
+	// Wraps around, forever.
+	frameSchedulerTick(&s, 50 * 1234);
+	assertEquals("looped", 1234 % 10, s.frame);
+	assertTrue("still running", s.running);
+
+	frameSchedulerStop(&s);
+	assertEquals("stopped", -1, s.frame);
+	assertEquals("no timer once stopped", 0, frameSchedulerTick(&s, 50 * 1300));
+}
+
+/** The timer doesn't run while it's hidden, and it resumes on the same frame. */
+static void testHidden()
+{
+	frameScheduler s;
+	frameSchedulerInit(&s);
+	frameSchedulerStart(&s, 4, 100, 0, 0);
+	frameSchedulerTick(&s, 100);
+	assertEquals("frame 1", 1, s.frame);
+
+	assertEquals("hidden: no timer", 0, frameSchedulerSetHidden(&s, true, 150));
+	assertEquals("tick while hidden", 0, frameSchedulerTick(&s, 200));
+	assertEquals("not moved on", 1, s.frame);
+
+	assertEquals("shown: rest of the frame", 50, frameSchedulerSetHidden(&s, false, 10150));
+	assertEquals("next frame", 100, frameSchedulerTick(&s, 10200));
+	assertEquals("frame 2", 2, s.frame);
+	assertEquals("nothing dropped while hidden", 0, s.dropped);
+
+	// Started while hidden: no timer until it's shown.
+	frameSchedulerSetHidden(&s, true, 20000);
+	assertEquals("start hidden", 0, frameSchedulerStart(&s, 4, 100, 1, 20000));
+	assertEquals("shown", 100, frameSchedulerSetHidden(&s, false, 30000));
+	assertEquals("from the start", 0, s.frame);
+
+	// Nothing to show.
+	assertEquals("no frames", 0, frameSchedulerStart(&s, 0, 100, 0, 30000));
+	assertTrue("not running", !s.running);
+	assertEquals("no timer when shown", 0, frameSchedulerSetHidden(&s, false, 30000));
+}
+
+/** Intervals are limited, so a bad command can't spin the CPU. */
+static void testMinimumInterval()
+{
+	frameScheduler s;
+	frameSchedulerInit(&s);
+	assertEquals("clamped", ANIMATION_MIN_INTERVAL, frameSchedulerStart(&s, 4, 0, 0, 0));
+}
+
+/** The strip is only rendered when the animation or size changes. */
+static void testStrip()
+{
+	animationStrip strip = { 0 };
+	assertTrue("new", animationStripPrepare(&strip, 1, 16, 4));
+	animationStripFrame(&strip, 3)[16 * 16 - 1] = 0xffffffff;
+	assertTrue("same", !animationStripPrepare(&strip, 1, 16, 4));
+	assertEquals("kept", 0xffffffff, animationStripFrame(&strip, 3)[16 * 16 - 1]);
+
+	assertTrue("new size", animationStripPrepare(&strip, 1, 24, 4));
+	assertTrue("new animation", animationStripPrepare(&strip, 2, 24, 4));
+	assertEquals("cleared", 0, animationStripFrame(&strip, 3)[24 * 24 - 1]);
+	assertEquals("renders", 3, strip.renders);
+
+	animationStripFree(&strip);
+	assertTrue("freed", strip.pixels == null);
+}
+
+/** A frame is blended over the background, centred. */
+static void testCompose()
+{
+	uint32_t background[6 * 4], dest[6 * 4], frame[2 * 2];
+	fillPixels(background, 6, 0, 0, 6, 4, 0x40404040);
+	frame[0] = 0xff00ff00;
+	frame[1] = 0;
+	frame[2] = 0x80800000;
+	frame[3] = 0xff0000ff;
+
+	animationCompose(dest, 6, background, 6, 6, 4, frame, 2, null);
+	assertEquals("background", 0x40404040, dest[0]);
+	assertEquals("opaque", 0xff00ff00, dest[1 * 6 + 2]);
+	assertEquals("transparent", 0x40404040, dest[1 * 6 + 3]);
+	assertEquals("half", 0xa0a02020, dest[2 * 6 + 2]);
+	assertEquals("opaque 2", 0xff0000ff, dest[2 * 6 + 3]);
+
+	// High-contrast: the icon is recoloured, and the rest is the background colour.
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x00ffffff, 0x00000000);
+	frame[0] = 0xffffffff;
+	animationCompose(dest, 6, background, 6, 6, 4, frame, 2, &table);
+	assertEquals("hc background", 0xff000000, dest[0]);
+	assertEquals("hc foreground", 0xffffffff, dest[1 * 6 + 2]);
+
+	// Bigger than the button: clipped.
+	uint32_t big[8 * 8];
+	fillPixels(big, 8, 0, 0, 8, 8, 0xff123456);
+	animationCompose(dest, 6, background, 6, 6, 4, big, 8, null);
+	assertEquals("clipped corner", 0xff123456, dest[0]);
+	assertEquals("clipped end", 0xff123456, dest[6 * 4 - 1]);
+}
+
+/** Straight alpha to premultiplied. */
+static void testPremultiply()
+{
+	uint32_t pixels[] = { 0xffabcdef, 0x80ff8000, 0x00ffffff };
+	premultiplyPixels(pixels, 3);
+	assertEquals("opaque", 0xffabcdef, pixels[0]);
+	assertEquals("half", 0x80804000, pixels[1]);
+	assertEquals("transparent", 0, pixels[2]);
+}
+
+int main()
+{
+	runTest(testParse);
+	runTest(testFrames);
+	runTest(testLateTimer);
+	runTest(testHidden);
+	runTest(testMinimumInterval);
+	runTest(testStrip);
+	runTest(testCompose);
+	runTest(testPremultiply);
+	return testResult();
+}
@@ -0,0 +1,121 @@
+/* Task tray button - unit tests.
+ * Tests for the sprite atlas layout and invalidation.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/atlas.h"
+#include "../core/visual-key.h"
+
+/** Each drawn state has its own cell, and states that look the same share one. */
+static void testCells()
+{
+	assertEquals("normal", 0, atlasCell(STATE_NORMAL, false));
+	assertEquals("hover", 1, atlasCell(STATE_NORMAL | STATE_HOVER, false));
+	assertEquals("pressed", 2, atlasCell(STATE_NORMAL | STATE_HOVER | STATE_PRESSED, false));
+	assertEquals("checked looks normal", 0, atlasCell(STATE_NORMAL | STATE_CHECKED, false));
+	assertEquals("checked hover looks like hover", 1, atlasCell(STATE_HOVER | STATE_CHECKED, false));
+
+	assertEquals("hc", 6, atlasCell(STATE_NORMAL, true));
+	assertEquals("hc hover", 7, atlasCell(STATE_HOVER, true));
+	assertEquals("hc pressed looks like hover", 7, atlasCell(STATE_HOVER | STATE_PRESSED, true));
+	assertEquals("hc checked", 9, atlasCell(STATE_CHECKED, true));
+	assertEquals("hc checked hover", 10, atlasCell(STATE_CHECKED | STATE_HOVER, true));
+
+	// Every state maps to a cell in the atlas
+	int outside = 0;
+	for (uint32_t state = 0; state < 16; state++) {
+		for (int hc = 0; hc < 2; hc++) {
+			int cell = atlasCell(state, hc);
+			outside += cell < 0 || cell >= ATLAS_CELLS || (cell >= 6) != hc;
+		}
+	}
+	assertEquals("cells in range", 0, outside);
+}
+
+/** Cells are laid out in a grid, without overlapping. */
+static void testCellRects()
+{
+	spriteAtlas atlas = { 0 };
+	atlasKey key = { 24, 40, 1, 16, 0 };
+	atlasUpdate(&atlas, &key);
+
+	coreRect rect;
+	atlasCellRect(&atlas, 0, &rect);
+	assertTrue("first cell", rect.left == 0 && rect.top == 0 && rect.right == 24 && rect.bottom == 40);
+	atlasCellRect(&atlas, 5, &rect);
+	assertTrue("sixth cell", rect.left == 48 && rect.top == 40 && rect.right == 72 && rect.bottom == 80);
+	atlasCellRect(&atlas, ATLAS_CELLS - 1, &rect);
+	assertEquals("atlas width", 24 * ATLAS_COLUMNS, rect.right);
+	assertEquals("atlas height", 40 * ATLAS_ROWS, rect.bottom);
+
+	int overlaps = 0;
+	for (int a = 0; a < ATLAS_CELLS; a++) {
+		for (int b = a + 1; b < ATLAS_CELLS; b++) {
+			coreRect ra, rb;
+			atlasCellRect(&atlas, a, &ra);
+			atlasCellRect(&atlas, b, &rb);
+			overlaps += ra.left < rb.right && rb.left < ra.right && ra.top < rb.bottom && rb.top < ra.bottom;
+		}
+	}
+	assertEquals("no overlaps", 0, overlaps);
+}
+
+/** Cells are rendered once, and again after anything they depend on changes. */
+static void testInvalidation()
+{
+	spriteAtlas atlas = { 0 };
+	atlasKey key = { 24, 40, 1, 16, 0 };
+
+	assertTrue("new atlas needs a surface", atlasUpdate(&atlas, &key));
+	assertTrue("first use renders", atlasNeedsRender(&atlas, 1));
+	atlasRendered(&atlas, 1);
+	assertTrue("second use doesn't", !atlasNeedsRender(&atlas, 1));
+	assertTrue("other cells still need rendering", atlasNeedsRender(&atlas, 2));
+
+	assertTrue("same key keeps the surface", !atlasUpdate(&atlas, &key));
+	assertTrue("same key keeps the cells", !atlasNeedsRender(&atlas, 1));
+
+	atlasKey changed = key;
+	changed.iconId = 2;
+	assertTrue("new icon keeps the surface", !atlasUpdate(&atlas, &changed));
+	assertTrue("new icon discards the cells", atlasNeedsRender(&atlas, 1));
+	atlasRendered(&atlas, 1);
+
+	changed.colors = 5;
+	atlasUpdate(&atlas, &changed);
+	assertTrue("new colours discard the cells", atlasNeedsRender(&atlas, 1));
+	atlasRendered(&atlas, 1);
+
+	changed.iconSize = 20;
+	atlasUpdate(&atlas, &changed);
+	assertTrue("new icon size discards the cells", atlasNeedsRender(&atlas, 1));
+	atlasRendered(&atlas, 1);
+
+	changed.height = 48;
+	assertTrue("new size needs a new surface", atlasUpdate(&atlas, &changed));
+	assertTrue("new size discards the cells", atlasNeedsRender(&atlas, 1));
+	atlasRendered(&atlas, 1);
+
+	atlasInvalidate(&atlas);
+	assertTrue("invalidated", atlasNeedsRender(&atlas, 1));
+
+	assertEquals("renders counted", 5, atlas.renders);
+	assertEquals("hits counted", 2, atlas.hits);
+	assertEquals("invalidations counted", 5, atlas.invalidations);
+}
+
+int main()
+{
+	runTest(testCells);
+	runTest(testCellRects);
+	runTest(testInvalidation);
+	return testResult();
+}
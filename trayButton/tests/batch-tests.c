@@ -0,0 +1,214 @@
+/* Task tray button - unit tests.
+ * Tests for the batched commands.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/batch.h"
+
+/** Copies an ASCII string into UTF-16 */
+static size_t utf16(uint16_t *dest, const char *src)
+{
+	size_t n = 0;
+	for (; src[n]; n++) {
+		dest[n] = (uint16_t)src[n];
+	}
+	return n;
+}
+
+/** What gpii-app sends in response to GPII_MSG_UPDATE. */
+static void testRoundTrip()
+{
+	uint16_t buffer[256], text[64];
+	batchWriter writer;
+	batchWriterInit(&writer, buffer, sizeof(buffer) / sizeof(buffer[0]));
+
+	size_t length = utf16(text, "c:\\icons\\hc.ico");
+	assertTrue("add hc icon", batchAdd(&writer, 2, text, length));
+	length = utf16(text, "true");
+	assertTrue("add state", batchAdd(&writer, 5, text, length));
+	assertTrue("add null icon", batchAdd(&writer, 1, null, 0));
+	assertTrue("add empty tooltip", batchAdd(&writer, 3, text, 0));
+	assertTrue("no overflow", !writer.overflow);
+	assertEquals("encoded length", 2 + 15 + 2 + 4 + 2 + 2, writer.length);
+
+	batchReader reader;
+	batchRecord record;
+	batchReaderInit(&reader, buffer, writer.length * sizeof(uint16_t));
+
+	assertEquals("record 1", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("record 1 command", 2, record.command);
+	assertEquals("record 1 length", 15, record.length);
+	assertTrue("record 1 data", record.data == buffer + 2 && record.data[0] == 'c');
+
+	assertEquals("record 2", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("record 2 command", 5, record.command);
+	assertEquals("record 2 length", 4, record.length);
+	assertTrue("record 2 data", record.data[0] == 't' && record.data[3] == 'e');
+
+	assertEquals("record 3", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("record 3 command", 1, record.command);
+	assertTrue("record 3 has no data", record.data == null);
+
+	assertEquals("record 4", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("record 4 command", 3, record.command);
+	assertTrue("record 4 is empty, not null", record.data != null && record.length == 0);
+
+	assertEquals("end", BATCH_END, batchNext(&reader, &record));
+	assertEquals("still the end", BATCH_END, batchNext(&reader, &record));
+}
+
+/** A string terminator ends the batch, as does an odd trailing byte. */
+static void testTerminator()
+{
+	uint16_t buffer[] = { 5, 1, 'x', 0, 6, 0xffff };
+	batchReader reader;
+	batchRecord record;
+
+	batchReaderInit(&reader, buffer, sizeof(buffer));
+	assertEquals("record", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("terminated", BATCH_END, batchNext(&reader, &record));
+
+	batchReaderInit(&reader, buffer, 3 * sizeof(uint16_t) + 1);
+	assertEquals("record", BATCH_RECORD, batchNext(&reader, &record));
+	assertEquals("odd byte ignored", BATCH_END, batchNext(&reader, &record));
+
+	batchReaderInit(&reader, null, 0);
+	assertEquals("no data", BATCH_END, batchNext(&reader, &record));
+}
+
+/** Malformed batches are rejected. */
+static void testMalformed()
+{
+	batchReader reader;
+	batchRecord record;
+
+	uint16_t truncatedHeader[] = { 5 };
+	batchReaderInit(&reader, truncatedHeader, sizeof(truncatedHeader));
+	assertEquals("truncated header", BATCH_ERROR, batchNext(&reader, &record));
+
+	uint16_t truncatedData[] = { 5, 10, 'x', 'y' };
+	batchReaderInit(&reader, truncatedData, sizeof(truncatedData));
+	assertEquals("truncated data", BATCH_ERROR, batchNext(&reader, &record));
+	assertEquals("nothing after an error", BATCH_END, batchNext(&reader, &record));
+}
+
+/** The writer refuses what it can't encode, or what doesn't fit. */
+static void testWriterLimits()
+{
+	uint16_t buffer[8], text[8] = { 0 };
+	batchWriter writer;
+	batchWriterInit(&writer, buffer, 8);
+
+	assertTrue("command 0 is the terminator", !batchAdd(&writer, 0, text, 1));
+	assertTrue("command too big", !batchAdd(&writer, 0x10000, text, 1));
+	assertTrue("data too long", !batchAdd(&writer, 1, text, BATCH_MAX_LENGTH + 1));
+	assertTrue("not an overflow", !writer.overflow);
+
+	assertTrue("fits", batchAdd(&writer, 1, text, 4));
+	assertTrue("doesn't fit", !batchAdd(&writer, 1, text, 1));
+	assertTrue("overflow", writer.overflow);
+	assertTrue("fits exactly", batchAdd(&writer, 1, null, 0));
+	assertEquals("full", 8, writer.length);
+}
+
+#define FUZZ_ROUNDS 20000
+#define FUZZ_SIZE 64
+
+/** Random records survive the round trip. */
+static void testRandomRoundTrip()
+{
+	static uint16_t buffer[FUZZ_SIZE * (FUZZ_SIZE + 2)], data[FUZZ_SIZE][FUZZ_SIZE];
+	uint32_t commands[FUZZ_SIZE], lengths[FUZZ_SIZE];
+	bool nulls[FUZZ_SIZE];
+	int failures = 0;
+
+	srand(1);
+	for (int round = 0; round < FUZZ_ROUNDS / 10; round++) {
+		batchWriter writer;
+		batchWriterInit(&writer, buffer, sizeof(buffer) / sizeof(buffer[0]));
+		int count = rand() % FUZZ_SIZE;
+		for (int n = 0; n < count; n++) {
+			commands[n] = 1 + rand() % 0xfffe;
+			lengths[n] = rand() % FUZZ_SIZE;
+			nulls[n] = rand() % 8 == 0;
+			for (uint32_t i = 0; i < lengths[n]; i++) {
+				data[n][i] = (uint16_t)rand();
+			}
+			batchAdd(&writer, commands[n], nulls[n] ? null : data[n], lengths[n]);
+		}
+
+		batchReader reader;
+		batchRecord record;
+		batchReaderInit(&reader, buffer, writer.length * sizeof(uint16_t));
+		for (int n = 0; n < count; n++) {
+			if (batchNext(&reader, &record) != BATCH_RECORD
+				|| record.command != commands[n]
+				|| (record.data == null) != nulls[n]
+				|| (!nulls[n] && (record.length != lengths[n]
+					|| memcmp(record.data, data[n], lengths[n] * sizeof(uint16_t))))) {
+				failures++;
+				break;
+			}
+		}
+		if (batchNext(&reader, &record) != BATCH_END) {
+			failures++;
+		}
+	}
+
+	assertEquals("all rounds decoded", 0, failures);
+}
+
+/** Random (mostly invalid) input never makes the reader run past the end, or loop forever. */
+static void testFuzz()
+{
+	static uint16_t buffer[FUZZ_SIZE];
+	int outside = 0, runaway = 0;
+
+	srand(2);
+	for (int round = 0; round < FUZZ_ROUNDS; round++) {
+		size_t size = rand() % (sizeof(buffer) + 1);
+		for (size_t n = 0; n < FUZZ_SIZE; n++) {
+			// Small values, so the lengths are sometimes valid.
+			buffer[n] = (uint16_t)(rand() % 4 ? rand() % 16 : rand());
+		}
+
+		batchReader reader;
+		batchRecord record;
+		batchReaderInit(&reader, buffer, size);
+		const uint16_t *end = buffer + size / sizeof(uint16_t);
+
+		int result, records = 0;
+		while ((result = batchNext(&reader, &record)) == BATCH_RECORD) {
+			if (record.data && (record.data < buffer || record.data + record.length > end)) {
+				outside++;
+			}
+			if (++records > FUZZ_SIZE) {
+				runaway++;
+				break;
+			}
+		}
+	}
+
+	assertEquals("data always inside the buffer", 0, outside);
+	assertEquals("always ends", 0, runaway);
+}
+
+int main()
+{
+	runTest(testRoundTrip);
+	runTest(testTerminator);
+	runTest(testMalformed);
+	runTest(testWriterLimits);
+	runTest(testRandomRoundTrip);
+	runTest(testFuzz);
+	return testResult();
+}
@@ -0,0 +1,224 @@
+/* Task tray button - unit tests.
+ * A button on each taskbar, with a simulated taskbar on each monitor.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "sim-taskbar.h"
+#include "../core/button-set.h"
+
+#define MONITORS (BUTTON_SET_MAX + 2)
+#define NOTIFY_WIDTH 150
+
+/** A monitor, with a taskbar. The taskbar's handle is its index, plus one. */
+typedef struct {
+	/** Configuration */
+	simEdge edge;
+	uint32_t dpi;
+	int32_t originX, originY;
+	/** The button can't be created */
+	bool refuse;
+
+	simTaskbar sim;
+	trayButton button;
+	bool attached, primary;
+	uint32_t attaches, detaches;
+} monitor;
+
+static monitor monitors[MONITORS];
+
+#define taskbarOf(N) ((windowHandle)(uintptr_t)((N) + 1))
+
+static trayButton *attachButton(void *context, windowHandle taskbar, bool primary)
+{
+	monitor *m = &monitors[(uintptr_t)taskbar - 1];
+	if (m->refuse) {
+		return null;
+	}
+	m->attached = true;
+	m->primary = primary;
+	m->attaches++;
+	// Secondary taskbars have no notification icons.
+	simInit(&m->sim, &m->button, m->edge, false, m->dpi, primary ? NOTIFY_WIDTH : 0);
+	simSetOrigin(&m->sim, m->originX, m->originY);
+	simStart(&m->sim);
+	return &m->button;
+}
+
+static void detachButton(void *context, trayButton *button)
+{
+	for (int n = 0; n < MONITORS; n++) {
+		if (&monitors[n].button == button) {
+			monitors[n].attached = false;
+			monitors[n].detaches++;
+		}
+	}
+}
+
+static void initSet(buttonSet *set)
+{
+	buttonSetHooks hooks = { attachButton, detachButton, null };
+	memset(monitors, 0, sizeof(monitors));
+	for (int n = 0; n < MONITORS; n++) {
+		monitors[n].edge = SIM_EDGE_BOTTOM;
+		monitors[n].dpi = 96;
+		monitors[n].originX = n * SIM_SCREEN_WIDTH;
+	}
+	buttonSetInit(set, &hooks);
+}
+
+/** Taskbars come and go, and the buttons follow them. */
+static void testSync()
+{
+	buttonSet set;
+	initSet(&set);
+
+	windowHandle three[] = { taskbarOf(0), taskbarOf(1), taskbarOf(2) };
+	assertEquals("three added", 3, buttonSetSync(&set, three, 3));
+	assertEquals("count", 3, set.count);
+	assertTrue("primary", buttonSetPrimary(&set) == &monitors[0].button && monitors[0].primary);
+	assertTrue("secondary", monitors[1].attached && !monitors[1].primary);
+	assertEquals("nothing changed", 0, buttonSetSync(&set, three, 3));
+
+	// A monitor is unplugged.
+	windowHandle two[] = { taskbarOf(0), taskbarOf(2) };
+	assertEquals("one removed", 1, buttonSetSync(&set, two, 2));
+	assertTrue("detached", !monitors[1].attached && monitors[1].detaches == 1);
+	assertTrue("order kept", set.entries[0].button == &monitors[0].button && set.entries[1].button == &monitors[2].button);
+	assertTrue("not found", buttonSetFind(&set, taskbarOf(1)) == null);
+
+	// The other one becomes the primary.
+	windowHandle swapped[] = { taskbarOf(2), taskbarOf(0) };
+	assertEquals("both re-created", 4, buttonSetSync(&set, swapped, 2));
+	assertTrue("new primary", buttonSetPrimary(&set) == &monitors[2].button && monitors[2].primary);
+	assertEquals("re-attached", 2, monitors[0].attaches);
+
+	// Explorer has gone.
+	windowHandle none[] = { null };
+	assertEquals("all removed", 2, buttonSetSync(&set, none, 1));
+	assertEquals("empty", 0, set.count);
+	assertTrue("no primary", buttonSetPrimary(&set) == null);
+
+	// Only the secondaries are there yet.
+	windowHandle secondaries[] = { null, taskbarOf(3) };
+	assertEquals("secondary without a primary", 1, buttonSetSync(&set, secondaries, 2));
+	assertTrue("still no primary", buttonSetPrimary(&set) == null);
+	buttonSetClear(&set);
+	assertEquals("cleared", 0, set.count);
+	assertTrue("clear detaches", !monitors[3].attached);
+}
+
+/** A button which can't be created is tried again; there's a limit to how many there are. */
+static void testRefused()
+{
+	buttonSet set;
+	initSet(&set);
+	monitors[1].refuse = true;
+
+	windowHandle taskbars[MONITORS];
+	for (int n = 0; n < MONITORS; n++) {
+		taskbars[n] = taskbarOf(n);
+	}
+
+	assertEquals("one refused, and some too many", BUTTON_SET_MAX, buttonSetSync(&set, taskbars, MONITORS));
+	assertEquals("failed", 2, set.failed);
+
+	monitors[1].refuse = false;
+	buttonSetSync(&set, taskbars, MONITORS);
+	assertTrue("still full", !monitors[1].attached);
+
+	// One goes by itself (its window was destroyed), making room.
+	assertTrue("removed", buttonSetRemove(&set, &monitors[5].button));
+	assertTrue("removed once", !buttonSetRemove(&set, &monitors[5].button));
+	assertEquals("not detached", 0, monitors[5].detaches);
+	taskbars[5] = null;
+	assertEquals("retried", 1, buttonSetSync(&set, taskbars, MONITORS));
+	assertTrue("created now", monitors[1].attached);
+	buttonSetClear(&set);
+}
+
+/** Each button is laid out for its own taskbar and DPI, on its own monitor. */
+static void testMonitors()
+{
+	buttonSet set;
+	initSet(&set);
+
+	// A 4K monitor to the right of the primary, and a vertical taskbar on one to the left.
+	monitors[1].dpi = 192;
+	monitors[1].originX = SIM_SCREEN_WIDTH;
+	monitors[2].edge = SIM_EDGE_LEFT;
+	monitors[2].dpi = 120;
+	monitors[2].originX = -SIM_SCREEN_WIDTH;
+	monitors[2].originY = -200;
+
+	windowHandle taskbars[] = { taskbarOf(0), taskbarOf(1), taskbarOf(2) };
+	buttonSetSync(&set, taskbars, 3);
+	for (int n = 0; n < 3; n++) {
+		simAdvance(&monitors[n].sim, 1000);
+		memset(&monitors[n].sim.counts, 0, sizeof(monitors[n].sim.counts));
+	}
+
+	for (int n = 0; n < 3; n++) {
+		simTaskbar *sim = &monitors[n].sim;
+		const coreRect *rc = &sim->notifiedRect;
+		int32_t width = scaleDpi(24, sim->dpi);
+
+		assertTrue("shown", sim->buttonShown);
+		assertEquals("own dpi", sim->dpi, monitors[n].button.dpi);
+		assertTrue("on its monitor", rc->left >= sim->originX && rc->right <= sim->originX + SIM_SCREEN_WIDTH
+			&& rc->top >= sim->originY && rc->bottom <= sim->originY + SIM_SCREEN_HEIGHT);
+		if (sim->edge == SIM_EDGE_LEFT) {
+			assertEquals("height", width, rectHeight(*rc));
+			assertEquals("after the tasks", sim->geometry.tasksRect.bottom, rc->top);
+		} else {
+			assertEquals("width", width, rectWidth(*rc));
+			assertEquals("after the tasks", sim->geometry.tasksRect.right, rc->left);
+			assertEquals("before the notification icons", sim->geometry.notifyRect.left, rc->right);
+		}
+	}
+	assertEquals("at the end of the secondary taskbar", 2 * SIM_SCREEN_WIDTH, monitors[1].sim.notifiedRect.right);
+
+	// The shell changes every taskbar.
+	for (int n = 0; n < 3; n++) {
+		simShellLayout(&monitors[n].sim);
+	}
+	buttonSetShellMessage(&set);
+	for (int n = 0; n < 3; n++) {
+		assertEquals("each resized once", 1, monitors[n].sim.counts.resizes);
+		assertEquals("not moved", 0, monitors[n].sim.counts.moves);
+	}
+
+	// Only one taskbar changes.
+	simShellLayout(&monitors[1].sim);
+	assertEquals("one repositioned", 1, buttonSetPosition(&set, false));
+	assertEquals("resized again", 2, monitors[1].sim.counts.resizes);
+	assertEquals("others left alone", 1, monitors[0].sim.counts.resizes);
+	assertEquals("others left alone", 1, monitors[2].sim.counts.resizes);
+
+	// High-contrast is turned on: every button reloads its own icon.
+	for (int n = 0; n < 3; n++) {
+		monitors[n].sim.highContrast = true;
+	}
+	buttonSetSettingChange(&set);
+	for (int n = 0; n < 3; n++) {
+		assertEquals("reloaded", 1, monitors[n].sim.counts.reloads);
+		assertTrue("high contrast", monitors[n].button.highContrast);
+	}
+
+	buttonSetClear(&set);
+}
+
+int main()
+{
+	runTest(testSync);
+	runTest(testRefused);
+	runTest(testMonitors);
+	return testResult();
+}
@@ -0,0 +1,281 @@
+/* Task tray button - unit tests.
+ * The button logic, driven by a simulated taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "sim-taskbar.h"
+
+#define NOTIFY_WIDTH 150
+#define HOUR (60 * 60 * 1000)
+/** Long enough for the check timer to fire, however far it has backed off */
+#define CHECK_WAIT 61000
+
+static const uint32_t dpis[] = { 96, 120, 144, 192 };
+#define DPI_COUNT (sizeof(dpis) / sizeof(dpis[0]))
+
+static const char *edgeNames[] = { "bottom", "top", "left", "right" };
+
+/** Starts a button, and lets it settle. */
+static void startButton(simTaskbar *sim, trayButton *button, simEdge edge, bool rtl, uint32_t dpi)
+{
+	simInit(sim, button, edge, rtl, dpi, NOTIFY_WIDTH);
+	simStart(sim);
+	simAdvance(sim, 1000);
+	memset(&sim->counts, 0, sizeof(sim->counts));
+}
+
+/** Checks the button is between the task list and the notification icons. */
+static void checkPlacement(const simTaskbar *sim)
+{
+	const layoutInput *g = &sim->geometry;
+	const coreRect *rc = &sim->notifiedRect;
+	int32_t width = scaleDpi(24, sim->dpi);
+
+	assertTrue("button should be shown", sim->buttonShown);
+	if (sim->edge == SIM_EDGE_LEFT || sim->edge == SIM_EDGE_RIGHT) {
+		assertEquals("button height", width, rectHeight(*rc));
+		assertEquals("button should follow the tasks", g->tasksRect.bottom, rc->top);
+		assertEquals("button should touch the notification icons", g->notifyRect.top, rc->bottom);
+	} else if (sim->rtl) {
+		assertEquals("button width", width, rectWidth(*rc));
+		assertEquals("button should follow the notification icons", g->notifyRect.right, rc->left);
+		assertEquals("tasks should follow the button", rc->right, g->tasksRect.left);
+	} else {
+		assertEquals("button width", width, rectWidth(*rc));
+		assertEquals("button should follow the tasks", g->tasksRect.right, rc->left);
+		assertEquals("button should touch the notification icons", g->notifyRect.left, rc->right);
+	}
+}
+
+/** The button is placed correctly, with one of each operation, on every kind of taskbar. */
+static void testStartup()
+{
+	for (int e = SIM_EDGE_BOTTOM; e <= SIM_EDGE_RIGHT; e++) {
+		for (int rtl = 0; rtl < 2; rtl++) {
+			for (size_t d = 0; d < DPI_COUNT; d++) {
+				simTaskbar sim;
+				trayButton button;
+				simInit(&sim, &button, (simEdge)e, rtl, dpis[d], NOTIFY_WIDTH);
+				int32_t original = simTasksLength(&sim);
+
+				simStart(&sim);
+				assertEquals("one resize", 1, sim.counts.resizes);
+				assertEquals("one move", 1, sim.counts.moves);
+				assertEquals("one notification", 1, sim.counts.notifies);
+				assertEquals("task list should make room", original - scaleDpi(24, dpis[d]), simTasksLength(&sim));
+				checkPlacement(&sim);
+
+				// The resize timer sees nothing changing, and stops.
+				simAdvance(&sim, 1000);
+				assertEquals("nothing more to do", 3, simOps(&sim.counts));
+				assertTrue("resize timer should stop", !sim.timers[TIMER_RESIZE].active);
+				assertTrue("check timer should run", sim.timers[TIMER_CHECK].active);
+			}
+		}
+	}
+}
+
+/** An idle taskbar is left alone, and checked less often. */
+static void testIdle()
+{
+	simTaskbar sim;
+	trayButton button;
+	startButton(&sim, &button, SIM_EDGE_BOTTOM, false, 96);
+
+	simAdvance(&sim, HOUR);
+	assertEquals("no operations", 0, simOps(&sim.counts));
+	assertEquals("no redraws", 0, sim.counts.redraws);
+	// 1s, 2s, 4s ... 32s, then every minute.
+	assertTrue("checks should back off", sim.counts.timerFires <= 6 + HOUR / 60000);
+	assertEquals("each check looks at the taskbar", sim.counts.timerFires, sim.counts.getTaskbar);
+}
+
+/** When explorer puts the task list back, only the task list is fixed. */
+static void testFightBack()
+{
+	for (int e = SIM_EDGE_BOTTOM; e <= SIM_EDGE_RIGHT; e++) {
+		for (int rtl = 0; rtl < 2; rtl++) {
+			simTaskbar sim;
+			trayButton button;
+			startButton(&sim, &button, (simEdge)e, rtl, 120);
+			int32_t length = simTasksLength(&sim);
+
+			// Explorer resets the task list, without telling anyone; the check timer finds it.
+			simShellLayoutAfter(&sim, 10);
+			simAdvance(&sim, CHECK_WAIT);
+			assertEquals("one resize", 1, sim.counts.resizes);
+			assertEquals("no move", 0, sim.counts.moves);
+			assertEquals("no notification", 0, sim.counts.notifies);
+			assertEquals("task list should be repaired", length, simTasksLength(&sim));
+			checkPlacement(&sim);
+		}
+	}
+}
+
+/** Explorer relayouts in response to shell events; the button reacts straight away. */
+static void testShellEvent()
+{
+	simTaskbar sim;
+	trayButton button;
+	startButton(&sim, &button, SIM_EDGE_BOTTOM, false, 96);
+	int32_t length = simTasksLength(&sim);
+
+	// A window was opened, and the taskbar was laid out.
+	simShellLayout(&sim);
+	buttonShellMessage(&button);
+	assertEquals("one resize", 1, sim.counts.resizes);
+	assertEquals("task list should be repaired", length, simTasksLength(&sim));
+	assertEquals("forced redraw", 1, sim.counts.forcedRedraws);
+
+	// Nothing changed; only a cheap redraw.
+	memset(&sim.counts, 0, sizeof(sim.counts));
+	buttonShellMessage(&button);
+	assertEquals("no operations", 0, simOps(&sim.counts));
+	assertEquals("one redraw", 1, sim.counts.redraws);
+	assertEquals("not forced", 0, sim.counts.forcedRedraws);
+
+	// Explorer is slow to react; the check timer catches it soon after.
+	memset(&sim.counts, 0, sizeof(sim.counts));
+	buttonShellMessage(&button);
+	simShellLayoutAfter(&sim, 500);
+	simAdvance(&sim, 1000);
+	assertEquals("one resize", 1, sim.counts.resizes);
+	assertEquals("task list should be repaired", length, simTasksLength(&sim));
+}
+
+/** A DPI change reloads the icon, and puts the button in the right place at the new size. */
+static void testDpiChange()
+{
+	simTaskbar sim;
+	trayButton button;
+	startButton(&sim, &button, SIM_EDGE_BOTTOM, false, 96);
+
+	sim.dpi = 144;
+	simShellLayout(&sim);
+	simAdvance(&sim, CHECK_WAIT);
+
+	assertEquals("icon reloaded", 1, sim.counts.reloads);
+	assertEquals("button DPI", 144, button.dpi);
+	checkPlacement(&sim);
+	assertEquals("one resize", 1, sim.counts.resizes);
+	assertEquals("one move", 1, sim.counts.moves);
+	assertEquals("one notification", 1, sim.counts.notifies);
+}
+
+/** Toggling high-contrast reloads the icon, and moves the button away from the edge. */
+static void testHighContrast()
+{
+	simTaskbar sim;
+	trayButton button;
+	startButton(&sim, &button, SIM_EDGE_BOTTOM, false, 96);
+	coreRect before = sim.notifiedRect;
+
+	sim.highContrast = true;
+	buttonSettingChange(&button);
+	assertEquals("icon reloaded", 1, sim.counts.reloads);
+	assertTrue("button high-contrast", button.highContrast);
+	assertEquals("button moved down", before.top + 1, sim.notifiedRect.top);
+	// Reloading forces a resize and move, but only once.
+	assertEquals("one resize", 1, sim.counts.resizes);
+	assertEquals("one move", 1, sim.counts.moves);
+
+	// An unrelated setting (which may have changed the taskbar) forces a layout, but gpii isn't bothered.
+	memset(&sim.counts, 0, sizeof(sim.counts));
+	buttonSettingChange(&button);
+	assertEquals("no reload", 0, sim.counts.reloads);
+	assertEquals("forced move", 1, sim.counts.moves);
+	assertEquals("no notification", 0, sim.counts.notifies);
+}
+
+/** The button does nothing until it has an icon, or after it's hidden. */
+static void testHidden()
+{
+	simTaskbar sim;
+	trayButton button;
+	simInit(&sim, &button, SIM_EDGE_BOTTOM, false, 96, NOTIFY_WIDTH);
+
+	assertTrue("no icon, no position", !buttonPosition(&button, true));
+	assertEquals("taskbar untouched", 0, simOps(&sim.counts));
+
+	simStart(&sim);
+	button.hasIcon = false;
+	buttonHidden(&button);
+	simShellLayout(&sim);
+	memset(&sim.counts, 0, sizeof(sim.counts));
+	simAdvance(&sim, HOUR);
+	assertEquals("hidden button leaves the taskbar alone", 0, simOps(&sim.counts));
+
+	// Shown again; it needs to be put back in full.
+	sim.platform.reloadIcon(&sim.platform);
+	assertEquals("put back", 3, simOps(&sim.counts));
+}
+
+/** Prints the operations performed per event. */
+static void printOps()
+{
+	static const char *events[] = { "startup", "idle hour", "explorer reset", "shell event", "dpi change",
+		"high-contrast" };
+	printf("%-8s %-16s %8s %8s %8s %8s %8s %8s\n", "edge", "event", "queries", "resizes", "moves", "notifies",
+		"redraws", "timers");
+
+	for (int e = SIM_EDGE_BOTTOM; e <= SIM_EDGE_RIGHT; e++) {
+		for (size_t ev = 0; ev < sizeof(events) / sizeof(events[0]); ev++) {
+			simTaskbar sim;
+			trayButton button;
+			simInit(&sim, &button, (simEdge)e, false, 96, NOTIFY_WIDTH);
+			if (ev == 0) {
+				simStart(&sim);
+				simAdvance(&sim, 1000);
+			} else {
+				simStart(&sim);
+				simAdvance(&sim, 1000);
+				memset(&sim.counts, 0, sizeof(sim.counts));
+				switch (ev) {
+				case 1:
+					simAdvance(&sim, HOUR);
+					break;
+				case 2:
+					simShellLayoutAfter(&sim, 10);
+					simAdvance(&sim, CHECK_WAIT);
+					break;
+				case 3:
+					simShellLayout(&sim);
+					buttonShellMessage(&button);
+					break;
+				case 4:
+					sim.dpi = 144;
+					simShellLayout(&sim);
+					simAdvance(&sim, CHECK_WAIT);
+					break;
+				case 5:
+					sim.highContrast = true;
+					buttonSettingChange(&button);
+					break;
+				}
+			}
+			printf("%-8s %-16s %8u %8u %8u %8u %8u %8u\n", edgeNames[e], events[ev], sim.counts.getTaskbar,
+				sim.counts.resizes, sim.counts.moves, sim.counts.notifies, sim.counts.redraws, sim.counts.timerFires);
+		}
+	}
+}
+
+int main()
+{
+	runTest(testStartup);
+	runTest(testIdle);
+	runTest(testFightBack);
+	runTest(testShellEvent);
+	runTest(testDpiChange);
+	runTest(testHighContrast);
+	runTest(testHidden);
+	printOps();
+	return testResult();
+}
@@ -0,0 +1,239 @@
+/* Task tray button - unit tests.
+ * Tests for the file of rendered frames.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/frame-cache.h"
+
+static frameCacheKey makeKey(uint32_t path, uint32_t source, uint32_t dpi, uint32_t state)
+{
+	frameCacheKey key = { path, source, dpi, 0, state, scaleDpi(24, dpi), scaleDpi(40, dpi) };
+	return key;
+}
+
+/** Makes the pixels of a frame, in a buffer wider than the frame (like a cell of the atlas). */
+static uint32_t *makeFrame(const frameCacheKey *key, uint32_t seed, int stride)
+{
+	uint32_t *pixels = malloc((size_t)stride * key->height * sizeof(uint32_t));
+	for (int32_t n = 0; n < stride * key->height; n++) {
+		pixels[n] = seed * 0x01000193 + (uint32_t)n;
+	}
+	return pixels;
+}
+
+static bool sameFrame(const uint32_t *found, const uint32_t *pixels, const frameCacheKey *key, int stride)
+{
+	for (int32_t row = 0; row < key->height; row++) {
+		if (memcmp(found + (size_t)row * key->width, pixels + (size_t)row * stride, key->width * sizeof(uint32_t))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Frames written to the file are found in it, with the same pixels. */
+static void testRoundTrip()
+{
+	static const uint32_t dpis[] = { 96, 144, 192 };
+	frameCacheKey keys[3];
+	uint32_t *pixels[3];
+	int stride = 200;
+
+	frameCacheWriter writer;
+	frameCacheWriterInit(&writer);
+	for (int n = 0; n < 3; n++) {
+		keys[n] = makeKey(1, 2, dpis[n], 1u << n);
+		pixels[n] = makeFrame(&keys[n], n, stride);
+		assertTrue("added", frameCacheWriterAdd(&writer, &keys[n], pixels[n], stride));
+	}
+
+	size_t size;
+	uint8_t *data = frameCacheWriterFinish(&writer, &size);
+	assertTrue("written", data != null);
+	assertEquals("entries", 3, (int)data[8]);
+	frameCacheWriterFree(&writer);
+
+	frameCache cache;
+	assertTrue("opened", frameCacheOpen(&cache, data, size));
+	assertEquals("count", 3, cache.count);
+	for (int n = 0; n < 3; n++) {
+		const uint32_t *found = frameCacheFind(&cache, &keys[n]);
+		assertTrue("found", found != null);
+		assertTrue("aligned", ((uintptr_t)found & 15) == 0);
+		assertTrue("same pixels", found && sameFrame(found, pixels[n], &keys[n], stride));
+	}
+
+	frameCacheKey other = keys[0];
+	other.colors = 5;
+	assertTrue("colours are part of the key", frameCacheFind(&cache, &other) == null);
+	other = keys[0];
+	other.state |= FRAME_CACHE_HIGH_CONTRAST;
+	assertTrue("state is part of the key", frameCacheFind(&cache, &other) == null);
+	assertEquals("hits", 3, cache.hits);
+
+	assertTrue("has the icon", frameCacheHasIcon(&cache, 1, 2, 144));
+	assertTrue("not at that dpi", !frameCacheHasIcon(&cache, 1, 2, 120));
+	assertTrue("not that version", !frameCacheHasIcon(&cache, 1, 3, 144));
+	assertTrue("not that icon", !frameCacheHasIcon(&cache, 2, 2, 144));
+
+	assertEquals("misses", 2, cache.misses);
+
+	frameCacheClose(&cache);
+	assertTrue("closed", frameCacheFind(&cache, &keys[0]) == null);
+	assertTrue("closed has no icons", !frameCacheHasIcon(&cache, 1, 2, 96));
+
+	for (int n = 0; n < 3; n++) {
+		free(pixels[n]);
+	}
+	free(data);
+}
+
+/** Frames of an icon file that has changed are removed when a frame of the new version is added. */
+static void testStale()
+{
+	frameCacheKey oldNormal = makeKey(1, 100, 96, 1), oldHover = makeKey(1, 100, 96, 2),
+		otherIcon = makeKey(7, 300, 96, 1), newNormal = makeKey(1, 200, 96, 1);
+	uint32_t *pixels = makeFrame(&oldNormal, 1, oldNormal.width);
+
+	frameCacheWriter writer;
+	frameCacheWriterInit(&writer);
+	frameCacheWriterAdd(&writer, &oldNormal, pixels, oldNormal.width);
+	frameCacheWriterAdd(&writer, &oldHover, pixels, oldHover.width);
+	frameCacheWriterAdd(&writer, &otherIcon, pixels, otherIcon.width);
+	size_t size;
+	uint8_t *data = frameCacheWriterFinish(&writer, &size);
+	frameCacheWriterFree(&writer);
+
+	// The next run: the icon file has changed.
+	frameCache cache;
+	frameCacheOpen(&cache, data, size);
+	assertTrue("old version is a miss", frameCacheFind(&cache, &newNormal) == null);
+
+	frameCacheWriterInit(&writer);
+	frameCacheWriterKeep(&writer, &cache);
+	assertEquals("kept", 3, writer.count);
+	frameCacheWriterAdd(&writer, &newNormal, pixels, newNormal.width);
+	assertEquals("stale frames removed", 2, writer.stale);
+	assertEquals("count", 2, writer.count);
+
+	size_t newSize;
+	uint8_t *newData = frameCacheWriterFinish(&writer, &newSize);
+	frameCacheWriterFree(&writer);
+	frameCacheClose(&cache);
+	free(data);
+
+	frameCacheOpen(&cache, newData, newSize);
+	assertTrue("new version found", frameCacheFind(&cache, &newNormal) != null);
+	assertTrue("other icon kept", frameCacheFind(&cache, &otherIcon) != null);
+	assertTrue("old version gone", frameCacheFind(&cache, &oldHover) == null);
+
+	// The newest is first.
+	frameCacheKey first;
+	memcpy(&first, newData + FRAME_CACHE_HEADER_SIZE, sizeof(first));
+	assertEquals("newest first", 200, first.sourceHash);
+
+	free(newData);
+	free(pixels);
+}
+
+/** The oldest frame is removed when there are too many; a frame with the same key is replaced. */
+static void testEviction()
+{
+	frameCacheKey key = makeKey(1, 1, 96, 0);
+	uint32_t *pixels = makeFrame(&key, 0, key.width);
+	frameCacheWriter writer;
+	frameCacheWriterInit(&writer);
+
+	for (uint32_t n = 0; n <= FRAME_CACHE_MAX_ENTRIES; n++) {
+		key.state = n;
+		frameCacheWriterAdd(&writer, &key, pixels, key.width);
+	}
+	assertEquals("full", FRAME_CACHE_MAX_ENTRIES, writer.count);
+	assertEquals("evicted", 1, writer.evicted);
+	assertEquals("oldest removed", 1, writer.items[0].key.state);
+
+	key.state = 10;
+	pixels[0] = 0x12345678;
+	frameCacheWriterAdd(&writer, &key, pixels, key.width);
+	assertEquals("replaced", FRAME_CACHE_MAX_ENTRIES, writer.count);
+	assertEquals("not evicted", 1, writer.evicted);
+	assertEquals("moved to the end", 10, writer.items[writer.count - 1].key.state);
+	assertEquals("new pixels", 0x12345678, writer.items[writer.count - 1].pixels[0]);
+
+	key.width = FRAME_CACHE_MAX_SIZE + 1;
+	assertTrue("too big", !frameCacheWriterAdd(&writer, &key, pixels, key.width));
+
+	frameCacheWriterFree(&writer);
+	assertEquals("emptied", 0, writer.count);
+	free(pixels);
+}
+
+/** Files that are damaged, cut short or from another version are ignored. */
+static void testInvalid()
+{
+	frameCacheKey key = makeKey(1, 1, 96, 1);
+	uint32_t *pixels = makeFrame(&key, 0, key.width);
+	frameCacheWriter writer;
+	frameCacheWriterInit(&writer);
+	frameCacheWriterAdd(&writer, &key, pixels, key.width);
+	size_t size;
+	uint8_t *data = frameCacheWriterFinish(&writer, &size);
+	frameCacheWriterFree(&writer);
+	uint8_t *copy = malloc(size + 16);
+
+	frameCache cache;
+	assertTrue("valid", frameCacheOpen(&cache, data, size));
+	assertTrue("null", !frameCacheOpen(&cache, null, 0));
+	assertTrue("empty after failure", cache.count == 0 && frameCacheFind(&cache, &key) == null);
+	assertTrue("truncated", !frameCacheOpen(&cache, data, size - 4));
+	assertTrue("header only", !frameCacheOpen(&cache, data, FRAME_CACHE_HEADER_SIZE));
+
+	// Each byte of the header and entry that matters.
+	static const size_t damage[] = { 0, 3, 4, 8, 12, 16, FRAME_CACHE_HEADER_SIZE, FRAME_CACHE_HEADER_SIZE + 20,
+		FRAME_CACHE_HEADER_SIZE + 28 };
+	for (size_t n = 0; n < sizeof(damage) / sizeof(damage[0]); n++) {
+		memcpy(copy, data, size);
+		copy[damage[n]] ^= 0x40;
+		assertTrue("damaged", !frameCacheOpen(&cache, copy, size));
+	}
+
+	// A frame beyond the end, with the checksum fixed up.
+	memcpy(copy, data, size);
+	copy[FRAME_CACHE_HEADER_SIZE + 29] = 0x10;
+	uint32_t checksum = hashBytes(copy + FRAME_CACHE_HEADER_SIZE, FRAME_CACHE_ENTRY_SIZE);
+	for (int n = 0; n < 4; n++) {
+		copy[16 + n] = (uint8_t)(checksum >> (n * 8));
+	}
+	assertTrue("frame out of bounds", !frameCacheOpen(&cache, copy, size));
+
+	// Only the pixels changed: still opens.
+	memcpy(copy, data, size);
+	copy[size - 1] ^= 0xff;
+	assertTrue("pixels aren't checked", frameCacheOpen(&cache, copy, size));
+
+	// Not aligned.
+	memmove(copy + 1, data, size);
+	assertTrue("misaligned", !frameCacheOpen(&cache, copy + 1, size));
+
+	free(copy);
+	free(data);
+	free(pixels);
+}
+
+int main()
+{
+	runTest(testRoundTrip);
+	runTest(testStale);
+	runTest(testEviction);
+	runTest(testInvalid);
+	return testResult();
+}
@@ -0,0 +1,235 @@
+/* Task tray button - unit tests.
+ * Framing of the messages between the button and gpii.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/frame.h"
+
+static frameReader reader;
+
+/** Frames survive encoding and decoding, with the header as documented. */
+static void testEncode()
+{
+	uint8_t buffer[64];
+	size_t length = frameEncode(buffer, sizeof(buffer), FRAME_PING, 0x01020304, 0x1122334455667788ull, "abc", 3);
+	assertEquals("length", FRAME_HEADER_SIZE + 3, length);
+
+	static const uint8_t header[FRAME_HEADER_SIZE] = {
+		23, 0, 0, 0,
+		FRAME_PING, 0,
+		0, 0,
+		4, 3, 2, 1,
+		0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11
+	};
+	assertTrue("little-endian header", memcmp(buffer, header, sizeof(header)) == 0);
+	assertTrue("payload", memcmp(buffer + FRAME_HEADER_SIZE, "abc", 3) == 0);
+
+	frameReaderInit(&reader);
+	frame f;
+	assertEquals("appended", length, frameReaderAppend(&reader, buffer, length));
+	assertEquals("read", FRAME_READ, frameReaderNext(&reader, &f));
+	assertEquals("type", FRAME_PING, f.type);
+	assertEquals("sequence", 0x01020304, f.sequence);
+	assertTrue("timestamp", f.timestamp == 0x1122334455667788ull);
+	assertEquals("payload length", 3, f.payloadLength);
+	assertTrue("payload", memcmp(f.payload, "abc", 3) == 0);
+	assertEquals("nothing else", FRAME_NONE, frameReaderNext(&reader, &f));
+
+	// Doesn't fit
+	assertEquals("too small", 0, frameEncode(buffer, FRAME_HEADER_SIZE + 2, FRAME_PING, 0, 0, "abc", 3));
+	assertEquals("bad type", 0, frameEncode(buffer, sizeof(buffer), 0, 0, 0, null, 0));
+	assertEquals("no payload", FRAME_HEADER_SIZE, frameEncode(buffer, sizeof(buffer), FRAME_PONG, 0, 0, null, 0));
+}
+
+/** Positions keep their sign, and all 32 bits. */
+static void testPosition()
+{
+	static const coreRect rects[] = {
+		{ 0, 1040, 24, 1080 },
+		{ -1920, -40, -1896, 0 },
+		{ -100000, 70000, -99976, 70040 },
+		{ INT32_MIN, INT32_MIN, INT32_MIN + 24, INT32_MIN + 40 }
+	};
+
+	for (size_t n = 0; n < sizeof(rects) / sizeof(rects[0]); n++) {
+		uint8_t buffer[64];
+		size_t length = frameEncodePosition(buffer, sizeof(buffer), (uint32_t)n, 0, &rects[n]);
+		frameReaderAppend(&reader, buffer, length);
+
+		frame f;
+		coreRect rect;
+		uint32_t notification, event;
+		assertEquals("read", FRAME_READ, frameReaderNext(&reader, &f));
+		assertTrue("decoded", frameDecodePosition(&f, &rect));
+		assertTrue("same rectangle", rectEquals(&rect, &rects[n]));
+		assertTrue("not a notification", !frameDecodeNotify(&f, &notification, &event));
+	}
+
+	uint8_t buffer[64];
+	frame f;
+	uint32_t notification, event;
+	coreRect rect;
+	frameReaderAppend(&reader, buffer, frameEncodeNotify(buffer, sizeof(buffer), 4, 0, 3, 77));
+	assertEquals("read", FRAME_READ, frameReaderNext(&reader, &f));
+	assertTrue("notification", frameDecodeNotify(&f, &notification, &event));
+	assertEquals("notification value", 3, notification);
+	assertEquals("event sequence", 77, event);
+	assertTrue("not a position", !frameDecodePosition(&f, &rect));
+
+	// An older button's notification has no event sequence.
+	uint8_t payload[4] = { 2, 0, 0, 0 };
+	frameReaderAppend(&reader, buffer, frameEncode(buffer, sizeof(buffer), FRAME_NOTIFY, 5, 0, payload, 4));
+	assertEquals("read old", FRAME_READ, frameReaderNext(&reader, &f));
+	assertTrue("old notification", frameDecodeNotify(&f, &notification, &event));
+	assertTrue("old values", notification == 2 && event == 0);
+}
+
+/** Frames arriving a byte at a time, and many at once. */
+static void testStream()
+{
+	uint8_t stream[4096];
+	size_t length = 0;
+	const int count = 100;
+
+	for (int n = 0; n < count; n++) {
+		char payload[40];
+		size_t payloadLength = (size_t)(n % sizeof(payload));
+		memset(payload, 'a' + n % 26, payloadLength);
+		length += frameEncode(stream + length, sizeof(stream) - length, FRAME_COMMAND, (uint32_t)n, (uint64_t)n * 1000,
+			payload, payloadLength);
+	}
+
+	for (int chunk = 1; chunk <= 64; chunk *= 4) {
+		frameReaderInit(&reader);
+		int read = 0;
+		size_t offset = 0;
+		bool ok = true;
+		while (offset < length) {
+			size_t size = length - offset < (size_t)chunk ? length - offset : (size_t)chunk;
+			offset += frameReaderAppend(&reader, stream + offset, size);
+
+			frame f;
+			int result;
+			while ((result = frameReaderNext(&reader, &f)) == FRAME_READ) {
+				ok = ok && f.sequence == (uint32_t)read && f.timestamp == (uint64_t)read * 1000
+					&& f.payloadLength == (uint32_t)(read % 40) && (!f.payloadLength || f.payload[0] == 'a' + read % 26);
+				read++;
+			}
+			ok = ok && result == FRAME_NONE;
+		}
+		assertTrue("frames should be intact", ok);
+		assertEquals("all frames read", count, read);
+		assertEquals("none missed", 0, reader.missed);
+	}
+}
+
+/** Gaps in the sequence are counted. */
+static void testSequence()
+{
+	static const uint32_t sequences[] = { 10, 11, 15, 16, 16, 20 };
+	uint8_t buffer[64];
+	frame f;
+
+	frameReaderInit(&reader);
+	for (size_t n = 0; n < sizeof(sequences) / sizeof(sequences[0]); n++) {
+		frameReaderAppend(&reader, buffer, frameEncode(buffer, sizeof(buffer), FRAME_PING, sequences[n], 0, null, 0));
+		assertEquals("read", FRAME_READ, frameReaderNext(&reader, &f));
+	}
+	assertEquals("frames", 6, reader.frames);
+	// 12-14, then 17-19; the repeat isn't a gap.
+	assertEquals("missed", 6, reader.missed);
+}
+
+/** A corrupt stream is detected, and stays failed. */
+static void testCorrupt()
+{
+	uint8_t buffer[FRAME_HEADER_SIZE] = { 0 };
+	frame f;
+
+	// Length shorter than a header.
+	frameReaderInit(&reader);
+	buffer[0] = FRAME_HEADER_SIZE - 1;
+	buffer[4] = FRAME_PING;
+	frameReaderAppend(&reader, buffer, sizeof(buffer));
+	assertEquals("short length", FRAME_ERROR, frameReaderNext(&reader, &f));
+	assertEquals("still failed", FRAME_ERROR, frameReaderNext(&reader, &f));
+
+	// Too long.
+	frameReaderInit(&reader);
+	buffer[0] = 0;
+	buffer[2] = 2;
+	frameReaderAppend(&reader, buffer, sizeof(buffer));
+	assertEquals("too long", FRAME_ERROR, frameReaderNext(&reader, &f));
+
+	// No type.
+	frameReaderInit(&reader);
+	buffer[0] = FRAME_HEADER_SIZE;
+	buffer[2] = 0;
+	buffer[4] = 0;
+	frameReaderAppend(&reader, buffer, sizeof(buffer));
+	assertEquals("no type", FRAME_ERROR, frameReaderNext(&reader, &f));
+
+	// Random bytes never crash, or read beyond what was given.
+	srand(16);
+	for (int n = 0; n < 10000; n++) {
+		uint8_t junk[64];
+		for (size_t i = 0; i < sizeof(junk); i++) {
+			junk[i] = (uint8_t)rand();
+		}
+		// Keep the length plausible, sometimes.
+		if (n % 2) {
+			junk[0] = (uint8_t)(FRAME_HEADER_SIZE + rand() % 40);
+			junk[1] = junk[2] = junk[3] = 0;
+		}
+		frameReaderInit(&reader);
+		frameReaderAppend(&reader, junk, sizeof(junk));
+		int result;
+		while ((result = frameReaderNext(&reader, &f)) == FRAME_READ) {
+			assertTrue("inside the buffer", f.payload + f.payloadLength <= reader.buffer + sizeof(junk));
+		}
+	}
+}
+
+/** A full buffer only takes what fits. */
+static void testFull()
+{
+	static uint8_t big[FRAME_MAX_SIZE + 100];
+	// Apart from the frame (one byte more than fits).
+	static uint8_t payload[FRAME_MAX_PAYLOAD + 1];
+	frame f;
+
+	frameReaderInit(&reader);
+	size_t length = frameEncode(big, sizeof(big), FRAME_COMMAND, 0, 0, payload, FRAME_MAX_PAYLOAD);
+	assertEquals("largest frame", FRAME_MAX_SIZE, length);
+	assertEquals("too big", 0, frameEncode(big + length, sizeof(big) - length, FRAME_COMMAND, 0, 0, payload,
+		FRAME_MAX_PAYLOAD + 1));
+
+	// Followed by the start of another.
+	frameEncode(big + length, sizeof(big) - length, FRAME_PING, 1, 0, null, 0);
+	assertEquals("only what fits", FRAME_MAX_SIZE, frameReaderAppend(&reader, big, length + 10));
+	assertEquals("full frame", FRAME_READ, frameReaderNext(&reader, &f));
+	assertEquals("full payload", FRAME_MAX_PAYLOAD, f.payloadLength);
+	assertEquals("room again", FRAME_HEADER_SIZE, frameReaderAppend(&reader, big + length, FRAME_HEADER_SIZE));
+	assertEquals("next frame", FRAME_READ, frameReaderNext(&reader, &f));
+	assertEquals("next sequence", 1, f.sequence);
+}
+
+int main()
+{
+	runTest(testEncode);
+	runTest(testPosition);
+	runTest(testStream);
+	runTest(testSequence);
+	runTest(testCorrupt);
+	runTest(testFull);
+	return testResult();
+}
@@ -0,0 +1,424 @@
+/* Task tray button - unit tests.
+ * The button's settings and events, against a stand-in backend on a simulated taskbar.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "sim-taskbar.h"
+#include "../core/batch.h"
+#include "../core/host.h"
+
+/** Stands in for the Win32 backend: a button on a simulated taskbar. */
+typedef struct {
+	/** The taskbar (first, so the platform functions can get the stand-in) */
+	simTaskbar sim;
+	trayButton button;
+	trayHost *host;
+	/** What the backend was asked to do */
+	uint32_t applies, changes, metrics, destroys;
+	bool destroyed;
+	/** The events the host application received */
+	hostEvent events[16];
+	uint32_t eventCount;
+	/** The clock (microseconds) */
+	uint64_t now;
+	/** How gpii is reached: the pipe is connected, its window exists */
+	bool pipeConnected, windowExists;
+} standIn;
+
+static bool (*simGetTaskbar)(buttonPlatform *platform, layoutInput *input);
+static void (*simNotifyPosition)(buttonPlatform *platform, const coreRect *rect);
+
+/** Like win32GetTaskbar: when gpii has gone, the button hides, and forgets the settings. */
+static bool standInGetTaskbar(buttonPlatform *platform, layoutInput *input)
+{
+	standIn *s = (standIn*)platform;
+	if (!trayHostReachable(false, s->pipeConnected, s->windowExists)) {
+		trayHostReset(s->host);
+		s->button.hasIcon = false;
+		return false;
+	}
+	return simGetTaskbar(platform, input);
+}
+
+/** The button has moved; the backend tells the host. */
+static void standInNotifyPosition(buttonPlatform *platform, const coreRect *rect)
+{
+	standIn *s = (standIn*)platform;
+	simNotifyPosition(platform, rect);
+	trayHostPosition(s->host, rect);
+}
+
+static void standInApply(trayHost *host, uint32_t changes)
+{
+	standIn *s = host->backend.context;
+	s->applies++;
+	s->changes |= changes;
+	if (changes & HOST_CHANGED_ICON) {
+		// Like setImage: the button is only shown when there's an icon.
+		s->button.hasIcon = host->iconFile != null;
+		buttonPosition(&s->button, true);
+	}
+}
+
+static void standInMetrics(trayHost *host)
+{
+	((standIn*)host->backend.context)->metrics++;
+}
+
+static void standInDestroy(trayHost *host)
+{
+	standIn *s = host->backend.context;
+	s->destroys++;
+	s->destroyed = true;
+}
+
+static uint64_t standInNow(trayHost *host)
+{
+	return ((standIn*)host->backend.context)->now += 10;
+}
+
+/** The host application's callback. */
+static void gotEvent(void *context, const hostEvent *event)
+{
+	standIn *s = context;
+	if (s->eventCount < sizeof(s->events) / sizeof(s->events[0])) {
+		s->events[s->eventCount++] = *event;
+	}
+}
+
+static void initStandIn(standIn *s)
+{
+	memset(s, 0, sizeof(*s));
+	simInit(&s->sim, &s->button, SIM_EDGE_BOTTOM, false, 96, 150);
+	simNotifyPosition = s->sim.platform.notifyPosition;
+	s->sim.platform.notifyPosition = standInNotifyPosition;
+	simGetTaskbar = s->sim.platform.getTaskbar;
+	s->sim.platform.getTaskbar = standInGetTaskbar;
+	s->windowExists = true;
+
+	hostBackend backend = { standInApply, standInMetrics, standInDestroy, standInNow, s };
+	s->host = trayHostCreate(&backend, gotEvent, s);
+	s->button.dpi = s->sim.dpi;
+}
+
+/** Copies an ASCII string into a UTF-16 buffer. */
+static const hostChar *utf16(hostChar *buffer, const char *text)
+{
+	size_t n = 0;
+	do {
+		buffer[n] = (hostChar)text[n];
+	} while (text[n++]);
+	return buffer;
+}
+
+static bool stringEquals(const hostChar *text, const char *expected)
+{
+	hostChar buffer[64];
+	utf16(buffer, expected);
+	return text && hostStringLength(text) == strlen(expected)
+		&& memcmp(text, buffer, strlen(expected) * sizeof(hostChar)) == 0;
+}
+
+/** The setters tell the backend, unless nothing changed. */
+static void testSetters()
+{
+	static standIn s;
+	hostChar buffer[64];
+	initStandIn(&s);
+	trayHost *host = s.host;
+	assertTrue("created", host != null);
+
+	assertTrue("icon", trayHostSetIcon(host, utf16(buffer, "icon.ico")));
+	assertTrue("copied", stringEquals(host->iconFile, "icon.ico") && host->iconFile != buffer);
+	assertEquals("applied", 1, s.applies);
+	assertEquals("icon change", HOST_CHANGED_ICON, s.changes);
+	assertTrue("shown", s.sim.buttonShown);
+
+	assertTrue("same icon", trayHostSetIcon(host, utf16(buffer, "icon.ico")));
+	assertEquals("not applied again", 1, s.applies);
+	assertEquals("unchanged", 1, host->unchanged);
+
+	trayHostSetToolTip(host, utf16(buffer, "Morphic"));
+	trayHostSetState(host, true);
+	trayHostSetState(host, true);
+	assertEquals("tool-tip and state", 3, s.applies);
+	assertEquals("all changes", HOST_CHANGED_ICON | HOST_CHANGED_TOOLTIP | HOST_CHANGED_STATE, s.changes);
+	assertTrue("checked", host->checked);
+
+	trayHostSetHighContrastIcon(host, utf16(buffer, "hc.ico"));
+	assertTrue("high-contrast icon", stringEquals(host->iconFileHC, "hc.ico"));
+
+	// No icon hides the button.
+	trayHostSetIcon(host, null);
+	assertTrue("no icon", host->iconFile == null);
+	assertTrue("hidden", !s.button.hasIcon);
+	trayHostSetIcon(host, null);
+	assertEquals("still no icon", 5, s.applies);
+
+	// gpii went away; when it's back, the same settings are applied again.
+	trayHostReset(host);
+	assertTrue("forgotten", host->toolTip == null && !host->checked);
+	assertEquals("not applied", 5, s.applies);
+	trayHostSetToolTip(host, utf16(buffer, "Morphic"));
+	assertEquals("tool-tip again", 6, s.applies);
+
+	trayHostDestroy(host);
+}
+
+/** Commands are what gpii sends in WM_COPYDATA; a batch of them is applied once. */
+static void testCommands()
+{
+	static standIn s;
+	hostChar buffer[64];
+	initStandIn(&s);
+	trayHost *host = s.host;
+
+	assertTrue("state", trayHostCommand(host, HOST_COMMAND_STATE, utf16(buffer, "True"), 4));
+	assertTrue("on, ignoring the case", host->checked);
+	trayHostCommand(host, HOST_COMMAND_STATE, utf16(buffer, "false"), 5);
+	assertTrue("off", !host->checked);
+	trayHostCommand(host, HOST_COMMAND_STATE, null, 0);
+	assertTrue("still off", !host->checked);
+
+	// Not null-terminated.
+	trayHostCommand(host, HOST_COMMAND_TOOLTIP, utf16(buffer, "tip-and-more"), 3);
+	assertTrue("length respected", stringEquals(host->toolTip, "tip"));
+	trayHostCommand(host, HOST_COMMAND_METRICS, null, 0);
+	assertEquals("metrics", 1, s.metrics);
+	assertTrue("unknown", !trayHostCommand(host, 99, null, 0));
+
+	// A batch, like gpii-app's response to HOST_EVENT_UPDATE.
+	uint16_t data[256];
+	batchWriter writer;
+	batchWriterInit(&writer, data, sizeof(data) / sizeof(data[0]));
+	batchAdd(&writer, HOST_COMMAND_ICON_HC, utf16(buffer, "hc.ico"), 6);
+	batchAdd(&writer, HOST_COMMAND_STATE, utf16(buffer, "true"), 4);
+	batchAdd(&writer, HOST_COMMAND_ICON, utf16(buffer, "icon.ico"), 8);
+	batchAdd(&writer, HOST_COMMAND_TOOLTIP, utf16(buffer, "Morphic"), 7);
+
+	s.applies = s.changes = 0;
+	assertTrue("batch", trayHostCommand(host, HOST_COMMAND_BATCH, data, writer.length));
+	assertEquals("applied once", 1, s.applies);
+	assertEquals("everything changed", HOST_CHANGED_ICON | HOST_CHANGED_TOOLTIP | HOST_CHANGED_STATE, s.changes);
+	assertTrue("icon", stringEquals(host->iconFile, "icon.ico"));
+	assertTrue("checked", host->checked);
+
+	// The same again changes nothing.
+	assertTrue("same batch", trayHostBatch(host, data, writer.length * sizeof(uint16_t)));
+	assertEquals("not applied", 1, s.applies);
+
+	// Nothing after a destroy.
+	batchWriterInit(&writer, data, sizeof(data) / sizeof(data[0]));
+	batchAdd(&writer, HOST_COMMAND_ICON, utf16(buffer, "other.ico"), 9);
+	batchAdd(&writer, HOST_COMMAND_DESTROY, null, 0);
+	batchAdd(&writer, HOST_COMMAND_TOOLTIP, utf16(buffer, "gone"), 4);
+	trayHostBatch(host, data, writer.length * sizeof(uint16_t));
+	assertTrue("destroyed", s.destroyed);
+	assertEquals("changes before it not applied", 1, s.applies);
+	assertTrue("tool-tip unchanged", stringEquals(host->toolTip, "Morphic"));
+
+	// Malformed: the length runs past the end.
+	uint16_t bad[] = { HOST_COMMAND_TOOLTIP, 10, 'x' };
+	assertTrue("malformed", !trayHostBatch(host, bad, sizeof(bad)));
+
+	trayHostDestroy(host);
+}
+
+/** An animation is started by its command, and stopped by an empty one. */
+static void testAnimation()
+{
+	static standIn s;
+	hostChar buffer[64];
+	initStandIn(&s);
+	trayHost *host = s.host;
+
+	assertTrue("animate", trayHostCommand(host, HOST_COMMAND_ANIMATE, utf16(buffer, "100;0;a.ico;b.ico"), 17));
+	assertEquals("animation change", HOST_CHANGED_ANIMATION, s.changes);
+	assertTrue("animation", stringEquals(host->animation, "100;0;a.ico;b.ico"));
+
+	s.applies = s.changes = 0;
+	trayHostCommand(host, HOST_COMMAND_ANIMATE, utf16(buffer, "100;0;a.ico;b.ico"), 17);
+	assertEquals("same animation not applied", 0, s.applies);
+
+	trayHostCommand(host, HOST_COMMAND_ANIMATE, buffer, 0);
+	assertEquals("stopped", HOST_CHANGED_ANIMATION, s.changes);
+	assertTrue("no animation", host->animation == null);
+	trayHostCommand(host, HOST_COMMAND_ANIMATE, null, 0);
+	assertEquals("null is the same as empty", 1, s.applies);
+
+	trayHostSetAnimation(host, utf16(buffer, "50;1;a.ico"));
+	trayHostReset(host);
+	assertTrue("forgotten", host->animation == null);
+
+	trayHostDestroy(host);
+}
+
+/** The SVG icon is part of the icon. */
+static void testSvgIcon()
+{
+	static standIn s;
+	hostChar buffer[64];
+	initStandIn(&s);
+	trayHost *host = s.host;
+
+	assertTrue("svg", trayHostCommand(host, HOST_COMMAND_ICON_SVG, utf16(buffer, "icon.svg"), 8));
+	assertEquals("icon change", HOST_CHANGED_ICON, s.changes);
+	assertTrue("svg file", stringEquals(host->iconSvg, "icon.svg"));
+
+	s.changes = 0;
+	trayHostCommand(host, HOST_COMMAND_ICON_SVG, buffer, 0);
+	assertEquals("removed", HOST_CHANGED_ICON, s.changes);
+	assertTrue("no svg", host->iconSvg == null);
+	s.applies = 0;
+	trayHostSetSvgIcon(host, null);
+	assertEquals("null is the same as empty", 0, s.applies);
+
+	trayHostSetSvgIcon(host, utf16(buffer, "icon.svg"));
+	trayHostReset(host);
+	assertTrue("forgotten", host->iconSvg == null);
+
+	trayHostDestroy(host);
+}
+
+/** The settings can be saved as a batch, which restores them in one go; setting them again changes nothing. */
+static void testSaveBatch()
+{
+	static standIn s, restored;
+	hostChar buffer[64];
+	uint16_t batch[256];
+	initStandIn(&s);
+	initStandIn(&restored);
+
+	// Only the state.
+	assertEquals("nothing set", 7, trayHostSaveBatch(s.host, batch, 256));
+
+	trayHostSetIcon(s.host, utf16(buffer, "icon.ico"));
+	trayHostSetHighContrastIcon(s.host, utf16(buffer, "hc.ico"));
+	trayHostSetSvgIcon(s.host, utf16(buffer, "icon.svg"));
+	trayHostSetToolTip(s.host, utf16(buffer, "Morphic"));
+	trayHostSetState(s.host, true);
+	trayHostSetAnimation(s.host, utf16(buffer, "100;0;a.ico"));
+	size_t length = trayHostSaveBatch(s.host, batch, 256);
+	assertTrue("saved", length > 0);
+	assertEquals("too small", 0, trayHostSaveBatch(s.host, batch, 20));
+	length = trayHostSaveBatch(s.host, batch, 256);
+
+	assertTrue("restored", trayHostBatch(restored.host, batch, length * sizeof(uint16_t)));
+	trayHost *host = restored.host;
+	assertEquals("applied once", 1, restored.applies);
+	assertEquals("all changed", HOST_CHANGED_ICON | HOST_CHANGED_TOOLTIP | HOST_CHANGED_STATE, restored.changes);
+	assertTrue("icon", stringEquals(host->iconFile, "icon.ico"));
+	assertTrue("high-contrast icon", stringEquals(host->iconFileHC, "hc.ico"));
+	assertTrue("svg", stringEquals(host->iconSvg, "icon.svg"));
+	assertTrue("tool-tip", stringEquals(host->toolTip, "Morphic"));
+	assertTrue("checked", host->checked);
+	assertTrue("not the animation", host->animation == null);
+	assertTrue("shown", restored.sim.buttonShown);
+
+	// gpii then says it all again: only what's different is applied.
+	trayHostSetAnimation(s.host, null);
+	trayHostSetState(s.host, false);
+	length = trayHostSaveBatch(s.host, batch, 256);
+	restored.changes = 0;
+	trayHostBatch(host, batch, length * sizeof(uint16_t));
+	assertEquals("applied the difference", 2, restored.applies);
+	assertEquals("only the state", HOST_CHANGED_STATE, restored.changes);
+	assertTrue("unchecked", !host->checked);
+
+	trayHostDestroy(s.host);
+	trayHostDestroy(host);
+}
+
+/**
+ * A restored button is laid out before gpii has sent anything; over the pipe, gpii is there without its window having
+ * been looked for.
+ */
+static void testRestoreWithoutWindow()
+{
+	static standIn s, restored;
+	hostChar buffer[64];
+	uint16_t batch[256];
+	initStandIn(&s);
+	initStandIn(&restored);
+	restored.windowExists = false;
+	restored.pipeConnected = true;
+
+	trayHostSetIcon(s.host, utf16(buffer, "icon.ico"));
+	trayHostSetToolTip(s.host, utf16(buffer, "Morphic"));
+	size_t length = trayHostSaveBatch(s.host, batch, 256);
+
+	trayHostBatch(restored.host, batch, length * sizeof(uint16_t));
+	simShellLayout(&restored.sim);
+	simAdvance(&restored.sim, 1000);
+	assertTrue("shown", restored.sim.buttonShown);
+	assertTrue("positioned", rectWidth(restored.sim.notifiedRect) > 0);
+	assertTrue("settings kept", stringEquals(restored.host->iconFile, "icon.ico"));
+	assertTrue("tool-tip kept", stringEquals(restored.host->toolTip, "Morphic"));
+
+	// Neither: gpii has gone.
+	restored.pipeConnected = false;
+	buttonPosition(&restored.button, true);
+	assertTrue("forgotten", restored.host->iconFile == null);
+	assertTrue("hidden", !restored.button.hasIcon);
+
+	// In-process, there's nothing to look for.
+	assertTrue("in-process", trayHostReachable(true, false, false));
+
+	trayHostDestroy(s.host);
+	trayHostDestroy(restored.host);
+}
+
+/** The host application gets the button's events, including where it is. */
+static void testEvents()
+{
+	static standIn s;
+	hostChar buffer[64];
+	initStandIn(&s);
+	trayHost *host = s.host;
+
+	assertEquals("click sequence", 1, trayHostEvent(host, HOST_EVENT_CLICK));
+	assertEquals("menu sequence", 2, trayHostEvent(host, HOST_EVENT_MENU));
+	assertEquals("events", 2, s.eventCount);
+	assertEquals("click", HOST_EVENT_CLICK, s.events[0].type);
+	assertEquals("menu", HOST_EVENT_MENU, s.events[1].type);
+	// Each is numbered, and has the time.
+	assertTrue("numbered", s.events[0].sequence == 1 && s.events[1].sequence == 2);
+	assertTrue("timestamped", s.events[0].timestamp == 10 && s.events[1].timestamp == 20);
+
+	// Showing the button lays it out, which tells the host where it is.
+	s.eventCount = 0;
+	trayHostSetIcon(host, utf16(buffer, "icon.ico"));
+	assertEquals("position", 1, s.eventCount);
+	assertEquals("position type", HOST_EVENT_POSITION, s.events[0].type);
+	assertTrue("position rect", rectEquals(&s.events[0].rect, &s.sim.notifiedRect));
+	assertEquals("width", 24, rectWidth(s.events[0].rect));
+	assertEquals("position numbered too", 3, s.events[0].sequence);
+
+	// Without a callback, the events go nowhere.
+	host->callback = null;
+	trayHostEvent(host, HOST_EVENT_ENTER);
+	assertEquals("counted", 4, host->events);
+
+	trayHostDestroy(host);
+	trayHostDestroy(null);
+}
+
+int main()
+{
+	runTest(testSetters);
+	runTest(testCommands);
+	runTest(testAnimation);
+	runTest(testSvgIcon);
+	runTest(testSaveBatch);
+	runTest(testRestoreWithoutWindow);
+	runTest(testEvents);
+	return testResult();
+}
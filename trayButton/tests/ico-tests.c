@@ -0,0 +1,209 @@
+/* Task tray button - unit tests.
+ * Tests for the icon file reader, using gpii-app's own icons.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/ico.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+
+/** Reads a file from src/icons */
+static uint8_t *readIcon(const char *name, size_t *size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", ICONS_DIR, name);
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		printf("Can't open %s\n", path);
+		*size = 0;
+		return null;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	if (fread(data, 1, *size, f) != *size) {
+		*size = 0;
+	}
+	fclose(f);
+	return data;
+}
+
+/** The tray icons have 4 32-bit images, and are white (or green) on a transparent background. */
+static void testTrayIcon()
+{
+	size_t size;
+	uint8_t *data = readIcon("Morphic-tray-icon-white.ico", &size);
+	icoFile ico;
+
+	assertEquals("all images read", 4, icoParse(data, size, &ico));
+	int32_t sizes[] = { 16, 20, 24, 32 };
+	for (int n = 0; n < 4; n++) {
+		const icoImage *image = &ico.images[n];
+		assertEquals("sorted by size", sizes[n], image->width);
+		assertEquals("square", image->width, image->height);
+
+		int transparent = 0, opaque = 0, notWhite = 0;
+		for (int32_t i = 0; i < image->width * image->height; i++) {
+			uint32_t alpha = image->pixels[i] >> 24;
+			transparent += alpha == 0;
+			opaque += alpha == 0xff;
+			notWhite += alpha == 0xff && (image->pixels[i] & 0xffffff) != 0xffffff;
+		}
+		assertTrue("has transparent pixels", transparent > 0);
+		assertTrue("has opaque pixels", opaque > 0);
+		assertEquals("opaque pixels are white", 0, notWhite);
+	}
+
+	// The top-left corner is transparent, the centre isn't (so the rows aren't upside-down).
+	const icoImage *image = &ico.images[3];
+	assertEquals("corner is transparent", 0, image->pixels[0] >> 24);
+
+	icoFree(&ico);
+	assertEquals("freed", 0, ico.count);
+	free(data);
+}
+
+/** The desktop icon has a PNG image, which is skipped. */
+static void testSkipPng()
+{
+	size_t size;
+	uint8_t *data = readIcon("Morphic-Desktop-Icon.ico", &size);
+	icoFile ico;
+
+	assertEquals("PNG skipped", 4, icoParse(data, size, &ico));
+	assertEquals("smallest", 16, ico.images[0].width);
+	assertEquals("largest", 48, ico.images[3].width);
+
+	icoFree(&ico);
+	free(data);
+}
+
+/** The same size, or the next one up, or the largest. */
+static void testSelect()
+{
+	size_t size;
+	uint8_t *data = readIcon("Morphic-tray-icon-green.ico", &size);
+	icoFile ico;
+	icoParse(data, size, &ico);
+
+	assertEquals("exact", 16, icoSelect(&ico, 16)->width);
+	assertEquals("exact", 20, icoSelect(&ico, 20)->width);
+	assertEquals("next larger", 24, icoSelect(&ico, 21)->width);
+	assertEquals("next larger", 32, icoSelect(&ico, 30)->width);
+	assertEquals("tiny", 16, icoSelect(&ico, 1)->width);
+	assertEquals("too large", 32, icoSelect(&ico, 40)->width);
+
+	icoFree(&ico);
+	assertTrue("no images", icoSelect(&ico, 16) == null);
+	free(data);
+}
+
+/** Scaling averages the covered pixels, without transparent pixels bleeding into the colour. */
+static void testScale()
+{
+	uint32_t pixels[4 * 4], dest[6 * 6];
+	icoImage image = { 4, 4, pixels };
+
+	// Left half transparent red, right half opaque green
+	for (int n = 0; n < 16; n++) {
+		pixels[n] = (n % 4) < 2 ? 0x00ff0000 : 0xff00ff00;
+	}
+
+	icoScale(&image, 2, dest);
+	assertEquals("transparent", 0, dest[0]);
+	assertEquals("opaque", 0xff00ff00, dest[1]);
+
+	icoScale(&image, 1, dest);
+	assertEquals("half transparent, but still green", 0x8000ff00, dest[0]);
+
+	icoScale(&image, 4, dest);
+	assertTrue("same size is a copy", memcmp(dest, pixels, sizeof(pixels)) == 0);
+
+	// 4 -> 3: the middle column covers half of each
+	icoScale(&image, 3, dest);
+	assertEquals("left", 0, dest[0]);
+	assertEquals("middle", 0x8000ff00, dest[1]);
+	assertEquals("right", 0xff00ff00, dest[2]);
+
+	// 4 -> 6: upscaling doesn't blend across the edge, which falls between destination pixels
+	icoScale(&image, 6, dest);
+	assertEquals("left", 0, dest[2]);
+	assertEquals("right", 0xff00ff00, dest[3]);
+
+	// A real icon, down to an odd size.
+	size_t size;
+	uint8_t *data = readIcon("Morphic-tray-icon-white.ico", &size);
+	icoFile ico;
+	icoParse(data, size, &ico);
+	uint32_t scaled[18 * 18];
+	icoScale(icoSelect(&ico, 18), 18, scaled);
+	int notWhite = 0;
+	for (int n = 0; n < 18 * 18; n++) {
+		notWhite += (scaled[n] >> 24) && (scaled[n] & 0xffffff) != 0xffffff;
+	}
+	assertEquals("still white", 0, notWhite);
+	icoFree(&ico);
+	free(data);
+}
+
+/** Truncated or corrupt files don't crash, and only complete images are read. */
+static void testCorrupt()
+{
+	size_t size;
+	uint8_t *data = readIcon("Morphic-tray-icon-white.ico", &size);
+	icoFile ico;
+	int bad = 0;
+
+	for (size_t length = 0; length < size; length += 7) {
+		uint8_t *copy = malloc(length ? length : 1);
+		memcpy(copy, data, length);
+		if (icoParse(copy, length, &ico) > 4) {
+			bad++;
+		}
+		icoFree(&ico);
+		free(copy);
+	}
+	assertEquals("truncated files", 0, bad);
+
+	srand(3);
+	for (int round = 0; round < 2000; round++) {
+		uint8_t *copy = malloc(size);
+		memcpy(copy, data, size);
+		for (int n = 0; n < 4; n++) {
+			copy[rand() % size] = (uint8_t)rand();
+		}
+		// Also corrupt the directory, more often.
+		copy[6 + rand() % 64] = (uint8_t)rand();
+		icoParse(copy, size, &ico);
+		icoFree(&ico);
+		free(copy);
+	}
+
+	uint8_t notIcon[] = { 0, 0, 2, 0, 1, 0 };
+	assertEquals("cursor file", 0, icoParse(notIcon, sizeof(notIcon), &ico));
+	assertEquals("empty", 0, icoParse(notIcon, 0, &ico));
+	free(data);
+}
+
+int main()
+{
+	runTest(testTrayIcon);
+	runTest(testSkipPng);
+	runTest(testSelect);
+	runTest(testScale);
+	runTest(testCorrupt);
+	return testResult();
+}
@@ -0,0 +1,65 @@
+/* Task tray button - unit tests.
+ * Tests for the icon file cache.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/icon-cache.h"
+
+/** Makes a file with one image, of the given size. */
+static icoFile makeIco(int32_t size)
+{
+	icoFile ico = { 0 };
+	ico.count = 1;
+	ico.images[0].width = ico.images[0].height = size;
+	ico.images[0].pixels = calloc((size_t)size * size, sizeof(uint32_t));
+	return ico;
+}
+
+/** Files are found by their key, and the least recently used is replaced when full. */
+static void testCache()
+{
+	iconCache cache = { 0 };
+	char keys[ICON_CACHE_SIZE + 1][16];
+
+	assertTrue("empty cache should miss", iconCacheFind(&cache, "a", 1) == null);
+
+	for (int n = 0; n < ICON_CACHE_SIZE; n++) {
+		snprintf(keys[n], sizeof(keys[n]), "file%d.ico", n);
+		icoFile ico = makeIco(16 + n);
+		const icoFile *added = iconCacheAdd(&cache, keys[n], strlen(keys[n]), &ico);
+		assertTrue("added", added != null && added->images[0].width == 16 + n);
+		assertEquals("ownership taken", 0, ico.count);
+	}
+
+	const icoFile *found = iconCacheFind(&cache, keys[0], strlen(keys[0]));
+	assertTrue("should hit", found && found->images[0].width == 16);
+	assertTrue("prefix shouldn't match", iconCacheFind(&cache, keys[0], 4) == null);
+	assertEquals("hits counted", 1, cache.hits);
+	assertEquals("misses counted", 2, cache.misses);
+
+	// file1 is now the least recently used
+	snprintf(keys[ICON_CACHE_SIZE], sizeof(keys[0]), "new.ico");
+	icoFile ico = makeIco(48);
+	iconCacheAdd(&cache, keys[ICON_CACHE_SIZE], strlen(keys[ICON_CACHE_SIZE]), &ico);
+	assertTrue("least recently used should be removed", iconCacheFind(&cache, keys[1], strlen(keys[1])) == null);
+	assertTrue("others kept", iconCacheFind(&cache, keys[0], strlen(keys[0])) != null);
+	assertTrue("new one found", iconCacheFind(&cache, "new.ico", 7) != null);
+
+	iconCacheClear(&cache);
+	assertTrue("should miss after clear", iconCacheFind(&cache, keys[0], strlen(keys[0])) == null);
+}
+
+int main()
+{
+	runTest(testCache);
+	return testResult();
+}
@@ -0,0 +1,322 @@
+/* Task tray button - unit tests.
+ * Tests for handing icons to the decoding thread, and back.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+#include "test.h"
+#include "../core/icon-loader.h"
+
+static iconJob makeJob(uint32_t iconId, int32_t size)
+{
+	iconJob job = { iconId, size, null, null };
+	return job;
+}
+
+/** Jobs come out in the order they went in, until the queue is empty; it holds ICON_QUEUE_SIZE. */
+static void testQueue()
+{
+	static iconQueue queue;
+	iconJob job;
+
+	assertTrue("empty", !iconQueuePop(&queue, &job));
+	for (uint32_t n = 0; n < ICON_QUEUE_SIZE; n++) {
+		job = makeJob(n, 16);
+		assertTrue("pushed", iconQueuePush(&queue, &job));
+	}
+	job = makeJob(99, 16);
+	assertTrue("full", !iconQueuePush(&queue, &job));
+
+	for (uint32_t n = 0; n < ICON_QUEUE_SIZE; n++) {
+		assertTrue("popped", iconQueuePop(&queue, &job));
+		assertEquals("in order", n, job.iconId);
+		// Wraps around.
+		job = makeJob(100 + n, 16);
+		assertTrue("pushed again", iconQueuePush(&queue, &job));
+	}
+	for (uint32_t n = 0; n < ICON_QUEUE_SIZE; n++) {
+		assertTrue("popped again", iconQueuePop(&queue, &job) && job.iconId == 100 + n);
+	}
+	assertTrue("empty again", !iconQueuePop(&queue, &job));
+}
+
+/** An icon that's being decoded isn't requested again; its result makes it requestable again. */
+static void testPending()
+{
+	static iconLoader loader;
+	iconJob job = makeJob(1, 16);
+
+	assertEquals("queued", ICON_REQUEST_QUEUED, iconLoaderRequest(&loader, &job));
+	assertEquals("already pending", ICON_REQUEST_PENDING, iconLoaderRequest(&loader, &job));
+	assertTrue("pending", iconLoaderPending(&loader, 1, 16));
+	assertTrue("other size isn't", !iconLoaderPending(&loader, 1, 24));
+	job.size = 24;
+	assertEquals("other size queued", ICON_REQUEST_QUEUED, iconLoaderRequest(&loader, &job));
+
+	// No result until the worker has done it.
+	assertTrue("no result yet", !iconLoaderTake(&loader, &job));
+
+	assertTrue("worker gets it", iconLoaderNext(&loader, &job));
+	assertEquals("first request first", 16, job.size);
+	job.result = &loader;
+	iconLoaderDone(&loader, &job);
+	assertTrue("result taken", iconLoaderTake(&loader, &job));
+	assertTrue("with its result", job.iconId == 1 && job.size == 16 && job.result == &loader);
+	assertTrue("no longer pending", !iconLoaderPending(&loader, 1, 16));
+	assertTrue("the other still is", iconLoaderPending(&loader, 1, 24));
+
+	job = makeJob(1, 16);
+	assertEquals("requested again", ICON_REQUEST_QUEUED, iconLoaderRequest(&loader, &job));
+
+	// Fill it up.
+	for (uint32_t n = 2; loader.pendingCount < ICON_QUEUE_SIZE; n++) {
+		job = makeJob(n, 16);
+		assertEquals("queued", ICON_REQUEST_QUEUED, iconLoaderRequest(&loader, &job));
+	}
+	job = makeJob(1000, 16);
+	assertEquals("full", ICON_REQUEST_FULL, iconLoaderRequest(&loader, &job));
+	assertTrue("refused one isn't pending", !iconLoaderPending(&loader, 1000, 16));
+
+	// The worker takes them all, which doesn't make room: the results haven't been taken.
+	uint32_t done = 0;
+	while (iconLoaderNext(&loader, &job)) {
+		iconLoaderDone(&loader, &job);
+		done++;
+	}
+	assertEquals("all decoded", ICON_QUEUE_SIZE, done);
+	job = makeJob(1000, 16);
+	assertEquals("still full", ICON_REQUEST_FULL, iconLoaderRequest(&loader, &job));
+
+	while (iconLoaderTake(&loader, &job)) {
+	}
+	assertEquals("none pending", 0, loader.pendingCount);
+	assertEquals("requested", ICON_QUEUE_SIZE + 1, loader.requested);
+	assertEquals("completed", ICON_QUEUE_SIZE + 1, loader.completed);
+	assertEquals("duplicates", 1, loader.duplicates);
+	assertEquals("refused", 2, loader.refused);
+}
+
+/*
+ * The stress test: a worker thread with a stand-in decoder, which makes an "icon" of size * size pixels from the ID.
+ * The UI thread keeps changing the icon of a few buttons, and only shows the new icon once it has arrived.
+ */
+
+#define STRESS_CHANGES 200000
+#define STRESS_BUTTONS 3
+
+/** The platform's event (for waking the worker) and posted message (for waking the UI thread). */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool set;
+} event;
+
+static void eventSet(event *e)
+{
+	pthread_mutex_lock(&e->lock);
+	e->set = true;
+	pthread_cond_signal(&e->cond);
+	pthread_mutex_unlock(&e->lock);
+}
+
+static void eventWait(event *e)
+{
+	pthread_mutex_lock(&e->lock);
+	while (!e->set) {
+		pthread_cond_wait(&e->cond, &e->lock);
+	}
+	e->set = false;
+	pthread_mutex_unlock(&e->lock);
+}
+
+typedef struct {
+	iconLoader loader;
+	event work, posted;
+	volatile bool stopping;
+	/** Number of icons the worker has decoded */
+	uint32_t decoded;
+} stressState;
+
+static uint32_t iconPixel(uint32_t iconId, int32_t n)
+{
+	return iconId * 2654435761u + (uint32_t)n;
+}
+
+/** A decoded icon, shared by the buttons showing it. */
+typedef struct {
+	uint32_t users;
+	uint32_t iconId;
+	int32_t size;
+	uint32_t pixels[];
+} decodedIcon;
+
+static bool iconIntact(const decodedIcon *icon)
+{
+	for (int32_t n = 0; n < icon->size * icon->size; n++) {
+		if (icon->pixels[n] != iconPixel(icon->iconId, n)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void releaseIcon(decodedIcon *icon)
+{
+	if (icon && --icon->users == 0) {
+		free(icon);
+	}
+}
+
+static void *stressWorker(void *param)
+{
+	stressState *s = param;
+	while (!s->stopping) {
+		eventWait(&s->work);
+		iconJob job;
+		while (iconLoaderNext(&s->loader, &job)) {
+			// The request is the file's name.
+			uint32_t *request = job.request;
+			decodedIcon *icon = malloc(sizeof(decodedIcon) + (size_t)job.size * job.size * sizeof(uint32_t));
+			icon->users = 0;
+			icon->iconId = *request;
+			icon->size = job.size;
+			for (int32_t n = 0; n < job.size * job.size; n++) {
+				icon->pixels[n] = iconPixel(*request, n);
+			}
+			job.result = icon;
+			iconLoaderDone(&s->loader, &job);
+			s->decoded++;
+			eventSet(&s->posted);
+		}
+	}
+	return null;
+}
+
+/** A button, showing one icon while waiting for another. */
+typedef struct {
+	decodedIcon *shown;
+	int32_t size;
+	/** The icon it's waiting for (0 for none) */
+	uint32_t wantedId;
+} stressButton;
+
+/** Asks for a button's icon, unless it's already coming. */
+static void requestIcon(stressState *s, stressButton *button)
+{
+	uint32_t *request = malloc(sizeof(uint32_t));
+	*request = button->wantedId;
+	iconJob job = { button->wantedId, button->size, request, null };
+	if (iconLoaderRequest(&s->loader, &job) == ICON_REQUEST_QUEUED) {
+		eventSet(&s->work);
+	} else {
+		free(request);
+	}
+}
+
+static void testStress()
+{
+	static stressState s;
+	stressButton buttons[STRESS_BUTTONS] = { { 0 } };
+	pthread_mutex_init(&s.work.lock, null);
+	pthread_cond_init(&s.work.cond, null);
+	pthread_mutex_init(&s.posted.lock, null);
+	pthread_cond_init(&s.posted.cond, null);
+
+	pthread_t thread;
+	pthread_create(&thread, null, stressWorker, &s);
+
+	uint32_t random = 12345, changes = 0, swaps = 0, wrong = 0, unwanted = 0, waits = 0;
+	while (changes < STRESS_CHANGES || s.loader.pendingCount) {
+		// Change the icons of some buttons (between a few icons, so some are already being decoded).
+		for (int b = 0; b < STRESS_BUTTONS && changes < STRESS_CHANGES; b++) {
+			random = random * 1103515245 + 12345;
+			if ((random >> 16) & 1) {
+				continue;
+			}
+			stressButton *button = &buttons[b];
+			button->size = b == 2 ? 24 : 16;
+			button->wantedId = 1 + ((random >> 20) & 31);
+			changes++;
+			requestIcon(&s, button);
+		}
+
+		random = random * 1103515245 + 12345;
+		if (s.loader.pendingCount && (changes == STRESS_CHANGES || (random >> 16) % 4 == 0)) {
+			// Wait for the posted message.
+			eventWait(&s.posted);
+			waits++;
+		}
+
+		iconJob job;
+		while (iconLoaderTake(&s.loader, &job)) {
+			decodedIcon *icon = job.result;
+			if (icon->iconId != job.iconId || icon->size != job.size || !iconIntact(icon)) {
+				wrong++;
+			}
+
+			for (int b = 0; b < STRESS_BUTTONS; b++) {
+				stressButton *button = &buttons[b];
+				if (button->wantedId == job.iconId && button->size == job.size) {
+					// Ready: show it instead of the previous one.
+					icon->users++;
+					releaseIcon(button->shown);
+					button->shown = icon;
+					button->wantedId = 0;
+					swaps++;
+				}
+			}
+			if (!icon->users) {
+				// Changed again before it arrived.
+				unwanted++;
+				free(icon);
+			}
+			free(job.request);
+		}
+
+		for (int b = 0; b < STRESS_BUTTONS; b++) {
+			stressButton *button = &buttons[b];
+			// The previous icon is still there, whole.
+			if (button->shown && button->shown->pixels[0] != iconPixel(button->shown->iconId, 0)) {
+				wrong++;
+			}
+			// Waiting for one that was refused: ask again.
+			if (button->wantedId && !iconLoaderPending(&s.loader, button->wantedId, button->size)) {
+				requestIcon(&s, button);
+			}
+		}
+	}
+
+	s.stopping = true;
+	eventSet(&s.work);
+	pthread_join(thread, null);
+
+	printf("  %u changes, %u decoded, %u shown, %u arrived too late, %u already coming, %u refused, %u waits\n",
+		changes, s.decoded, swaps, unwanted, s.loader.duplicates, s.loader.refused, waits);
+	assertEquals("every change made", STRESS_CHANGES, changes);
+	assertEquals("every decode handed back", s.decoded, s.loader.completed);
+	assertEquals("every request decoded", s.loader.requested, s.decoded);
+	assertEquals("icons intact", 0, wrong);
+	assertTrue("icons already coming aren't decoded again", s.loader.duplicates > 0 && s.decoded < changes);
+	for (int b = 0; b < STRESS_BUTTONS; b++) {
+		assertEquals("nothing left waiting", 0, buttons[b].wantedId);
+		assertTrue("showing an icon", buttons[b].shown != null && iconIntact(buttons[b].shown));
+		releaseIcon(buttons[b].shown);
+	}
+}
+
+int main()
+{
+	runTest(testQueue);
+	runTest(testPending);
+	runTest(testStress);
+	return testResult();
+}
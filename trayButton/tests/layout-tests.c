@@ -0,0 +1,221 @@
+/* Task tray button - unit tests.
+ * Property tests for the taskbar layout, over every orientation, reading direction and DPI.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/layout.h"
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define BUTTON_WIDTH 24
+
+typedef enum { EDGE_BOTTOM, EDGE_TOP, EDGE_LEFT, EDGE_RIGHT } edge;
+
+static const uint32_t dpis[] = { 96, 120, 144, 168, 192, 240, 288 };
+#define DPI_COUNT (sizeof(dpis) / sizeof(dpis[0]))
+
+/**
+ * Makes the geometry of a taskbar, as the shell lays it out (without the button).
+ */
+static layoutInput makeTaskbar(edge e, bool rtl, uint32_t dpi, bool highContrast)
+{
+	layoutInput input = { 0 };
+	int32_t thickness = scaleDpi(40, dpi);
+	int32_t start = scaleDpi(100, dpi);
+	int32_t notifySize = scaleDpi(150, dpi);
+	coreRect *tray = &input.trayRect;
+
+	switch (e) {
+	case EDGE_BOTTOM:
+		*tray = (coreRect) { 0, SCREEN_HEIGHT - thickness, SCREEN_WIDTH, SCREEN_HEIGHT };
+		break;
+	case EDGE_TOP:
+		*tray = (coreRect) { 0, 0, SCREEN_WIDTH, thickness };
+		break;
+	case EDGE_LEFT:
+		*tray = (coreRect) { 0, 0, thickness, SCREEN_HEIGHT };
+		break;
+	case EDGE_RIGHT:
+		*tray = (coreRect) { SCREEN_WIDTH - thickness, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+		break;
+	}
+
+	input.trayClient = (coreRect) { 0, 0, rectWidth(*tray), rectHeight(*tray) };
+
+	if (e == EDGE_LEFT || e == EDGE_RIGHT) {
+		input.tasksRect = (coreRect) { tray->left, start, tray->right, tray->bottom - notifySize };
+		input.notifyRect = (coreRect) { tray->left, tray->bottom - notifySize, tray->right, tray->bottom };
+		// The full-screen client area is the height of the screen, without a caption.
+		input.screenHeight = SCREEN_HEIGHT - scaleDpi(23, dpi);
+	} else {
+		if (rtl) {
+			input.notifyRect = (coreRect) { 0, tray->top, notifySize, tray->bottom };
+			input.tasksRect = (coreRect) { notifySize, tray->top, SCREEN_WIDTH - start, tray->bottom };
+		} else {
+			input.tasksRect = (coreRect) { start, tray->top, SCREEN_WIDTH - notifySize, tray->bottom };
+			input.notifyRect = (coreRect) { SCREEN_WIDTH - notifySize, tray->top, SCREEN_WIDTH, tray->bottom };
+		}
+		input.screenHeight = SCREEN_HEIGHT - thickness - scaleDpi(23, dpi);
+	}
+
+	input.dpi = dpi;
+	input.buttonWidth = BUTTON_WIDTH;
+	input.highContrast = highContrast;
+	return input;
+}
+
+/**
+ * Applies the result to the geometry, like the shell would. The task list is resized without moving, which keeps the
+ * right edge in place when the coordinates are mirrored.
+ */
+static void applyResult(layoutInput *input, const layoutResult *result)
+{
+	if (result->rtl) {
+		input->tasksRect.left = input->tasksRect.right - rectWidth(result->tasksRect);
+	} else {
+		input->tasksRect.right = input->tasksRect.left + rectWidth(result->tasksRect);
+	}
+	input->tasksRect.bottom = input->tasksRect.top + rectHeight(result->tasksRect);
+}
+
+/** Checks the invariants of a layout. */
+static void checkLayout(edge e, bool rtl, const layoutInput *input, const layoutResult *result)
+{
+	const coreRect *button = &result->buttonScreenRect;
+	int32_t width = scaleDpi(BUTTON_WIDTH, input->dpi);
+	int32_t offset = input->highContrast ? 1 : 0;
+	bool vertical = e == EDGE_LEFT || e == EDGE_RIGHT;
+
+	assertEquals("orientation should be detected", vertical, result->vertical);
+	assertEquals("reading direction should be detected", !vertical && rtl, result->rtl);
+
+	// The button is in the taskbar
+	assertTrue("button should be inside the taskbar",
+		button->left >= input->trayRect.left && button->right <= input->trayRect.right
+		&& button->top >= input->trayRect.top && button->bottom <= input->trayRect.bottom);
+
+	// The client rectangle is the same size as the screen rectangle, and inside the client area.
+	assertEquals("client width", rectWidth(*button), rectWidth(result->buttonRect));
+	assertEquals("client height", rectHeight(*button), rectHeight(result->buttonRect));
+	assertTrue("button should be in the client area",
+		result->buttonRect.left >= 0 && result->buttonRect.right <= input->trayClient.right
+		&& result->buttonRect.top >= 0 && result->buttonRect.bottom <= input->trayClient.bottom);
+
+	if (vertical) {
+		assertEquals("button height", width, rectHeight(*button));
+		assertEquals("button should follow the tasks", result->tasksRect.bottom, button->top);
+		assertEquals("button should touch the notification area", input->notifyRect.top, button->bottom);
+		assertEquals("button should fill the width", rectWidth(input->trayRect) - offset, rectWidth(*button));
+		assertEquals("tasks should keep their top", input->tasksRect.top, result->tasksRect.top);
+	} else {
+		assertEquals("button width", width, rectWidth(*button));
+		assertEquals("button should fill the height", rectHeight(input->trayRect) - offset, rectHeight(*button));
+		assertEquals("high-contrast offset", input->trayRect.top + offset, button->top);
+		if (rtl) {
+			assertEquals("button should follow the notification area", input->notifyRect.right, button->left);
+			assertEquals("tasks should follow the button", result->tasksRect.left, button->right);
+			assertEquals("tasks should keep their right", input->tasksRect.right, result->tasksRect.right);
+		} else {
+			assertEquals("button should follow the tasks", result->tasksRect.right, button->left);
+			assertEquals("button should touch the notification area", input->notifyRect.left, button->right);
+			assertEquals("tasks should keep their left", input->tasksRect.left, result->tasksRect.left);
+		}
+	}
+}
+
+/** The layout is correct for every combination. */
+static void testAllLayouts()
+{
+	for (int e = EDGE_BOTTOM; e <= EDGE_RIGHT; e++) {
+		for (int rtl = 0; rtl < 2; rtl++) {
+			for (size_t d = 0; d < DPI_COUNT; d++) {
+				for (int hc = 0; hc < 2; hc++) {
+					layoutInput input = makeTaskbar((edge)e, rtl, dpis[d], hc);
+					layoutResult result;
+					layoutCompute(&input, &result);
+					checkLayout((edge)e, rtl, &input, &result);
+				}
+			}
+		}
+	}
+}
+
+/** Only the required operations are produced, and a settled layout produces none. */
+static void testDiff()
+{
+	for (int e = EDGE_BOTTOM; e <= EDGE_RIGHT; e++) {
+		for (int rtl = 0; rtl < 2; rtl++) {
+			for (size_t d = 0; d < DPI_COUNT; d++) {
+				layoutState state = { 0 };
+				layoutInput input = makeTaskbar((edge)e, rtl, dpis[d], false);
+				layoutInput original = input;
+				layoutResult result;
+
+				layoutCompute(&input, &result);
+				assertEquals("first layout does everything",
+					LAYOUT_RESIZE_TASKS | LAYOUT_MOVE_BUTTON | LAYOUT_NOTIFY_POSITION,
+					layoutDiff(&state, &input, &result, false));
+
+				// Once applied, nothing more needs to be done.
+				applyResult(&input, &result);
+				layoutCompute(&input, &result);
+				assertEquals("settled layout does nothing", 0, layoutDiff(&state, &input, &result, false));
+				layoutResult settled = result;
+
+				// Doing it again gives the same result.
+				layoutCompute(&input, &result);
+				assertTrue("layout should be stable", rectEquals(&settled.buttonRect, &result.buttonRect)
+					&& rectEquals(&settled.tasksRect, &result.tasksRect));
+
+				// The shell puts the task list back; only that needs to be fixed.
+				layoutCompute(&original, &result);
+				assertEquals("only the task list needs resizing", LAYOUT_RESIZE_TASKS,
+					layoutDiff(&state, &original, &result, false));
+
+				// Forced
+				layoutCompute(&input, &result);
+				assertEquals("forced layout resizes and moves", LAYOUT_RESIZE_TASKS | LAYOUT_MOVE_BUTTON,
+					layoutDiff(&state, &input, &result, true));
+
+				// High-contrast moves the button by a pixel
+				input.highContrast = true;
+				layoutCompute(&input, &result);
+				assertEquals("high-contrast moves the button", LAYOUT_MOVE_BUTTON | LAYOUT_NOTIFY_POSITION,
+					layoutDiff(&state, &input, &result, false));
+			}
+		}
+	}
+}
+
+/** A taskbar on a secondary monitor isn't at the screen origin. */
+static void testOffsetTaskbar()
+{
+	layoutInput input = makeTaskbar(EDGE_BOTTOM, false, 96, false);
+	input.trayRect.left += SCREEN_WIDTH;
+	input.trayRect.right += SCREEN_WIDTH;
+	input.tasksRect.left += SCREEN_WIDTH;
+	input.tasksRect.right += SCREEN_WIDTH;
+	input.notifyRect.left += SCREEN_WIDTH;
+	input.notifyRect.right += SCREEN_WIDTH;
+
+	layoutResult result;
+	layoutCompute(&input, &result);
+	checkLayout(EDGE_BOTTOM, false, &input, &result);
+	assertEquals("client position", SCREEN_WIDTH - 150 - BUTTON_WIDTH, result.buttonRect.left);
+}
+
+int main()
+{
+	runTest(testAllLayouts);
+	runTest(testDiff);
+	runTest(testOffsetTaskbar);
+	return testResult();
+}
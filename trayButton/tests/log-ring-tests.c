@@ -0,0 +1,167 @@
+/* Task tray button - unit tests.
+ * Tests for the log message queue.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <time.h>
+#include "test.h"
+#include "../core/atomics.h"
+#include "../core/log-ring.h"
+
+static bool writeMessage(logRing *ring, int level, const wchar_t *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	bool result = logRingWrite(ring, level, format, args);
+	va_end(args);
+	return result;
+}
+
+typedef struct {
+	uint32_t count;
+	int lastNumber;
+	bool ordered;
+	wchar_t last[LOG_MESSAGE_LENGTH];
+} collector;
+
+static void collect(void *context, const logRecord *record)
+{
+	collector *c = (collector*)context;
+	int number = wcstol(record->text, null, 10);
+	if (c->count > 0 && number <= c->lastNumber) {
+		c->ordered = false;
+	}
+	c->lastNumber = number;
+	c->count++;
+	wcscpy(c->last, record->text);
+}
+
+/** Messages are formatted, and read in order. */
+static void testWriteRead()
+{
+	static logRing ring;
+	collector c = { .ordered = true };
+
+	assertEquals("nothing to read", 0, logRingRead(&ring, collect, &c));
+	assertTrue("write", writeMessage(&ring, LOG_INFO, L"%d %ls", 1, L"one"));
+	assertTrue("write", writeMessage(&ring, LOG_FAIL, L"%d %ls", 2, L"two"));
+	assertEquals("two messages read", 2, logRingRead(&ring, collect, &c));
+	assertTrue("formatted", wcscmp(c.last, L"2 two") == 0);
+	assertTrue("in order", c.ordered);
+	assertEquals("nothing left", 0, logRingRead(&ring, collect, &c));
+}
+
+/** When full, messages are dropped (not waited for), and counted. */
+static void testFull()
+{
+	static logRing ring;
+	collector c = { .ordered = true };
+
+	for (int n = 0; n < LOG_RING_SIZE; n++) {
+		assertTrue("should fit", writeMessage(&ring, LOG_INFO, L"%d", n));
+	}
+	assertTrue("should be dropped", !writeMessage(&ring, LOG_INFO, L"%d", LOG_RING_SIZE));
+	assertTrue("should be dropped", !writeMessage(&ring, LOG_INFO, L"%d", LOG_RING_SIZE + 1));
+	assertEquals("drops counted", 2, logRingTakeDropped(&ring));
+	assertEquals("drops only reported once", 0, logRingTakeDropped(&ring));
+
+	assertEquals("all that fitted are read", LOG_RING_SIZE, logRingRead(&ring, collect, &c));
+	assertTrue("room again", writeMessage(&ring, LOG_INFO, L"%d", 1000));
+	assertEquals("read after wrapping", 1, logRingRead(&ring, collect, &c));
+	assertTrue("in order", c.ordered);
+}
+
+/** Long messages are truncated. */
+static void testTruncate()
+{
+	static logRing ring;
+	static wchar_t longText[LOG_MESSAGE_LENGTH * 2];
+	collector c = { 0 };
+
+	wmemset(longText, L'x', sizeof(longText) / sizeof(longText[0]) - 1);
+	writeMessage(&ring, LOG_INFO, L"%ls", longText);
+	logRingRead(&ring, collect, &c);
+	assertEquals("truncated", LOG_MESSAGE_LENGTH - 1, wcslen(c.last));
+}
+
+#define STRESS_MESSAGES 200000
+/** Messages written past a full ring while the consumer is held */
+#define STRESS_HELD_DROPS 1000
+
+static logRing stressRing;
+static volatile uint32_t stressDone = 0;
+/** Posted to let the consumer start */
+static sem_t stressRelease;
+
+/** A slow consumer, like a blocked stdout; it doesn't read anything until it's released. */
+static void *stressConsumer(void *param)
+{
+	collector *c = (collector*)param;
+	struct timespec pause = { 0, 50000 };
+	sem_wait(&stressRelease);
+	while (true) {
+		bool done = atomicLoad(&stressDone) != 0;
+		logRingRead(&stressRing, collect, c);
+		if (done) {
+			break;
+		}
+		nanosleep(&pause, null);
+	}
+	logRingRead(&stressRing, collect, c);
+	return null;
+}
+
+/** The producer is never held up by the consumer, and every message is either read or counted as dropped. */
+static void testStress()
+{
+	collector c = { .ordered = true };
+	pthread_t thread;
+	sem_init(&stressRelease, 0, 0);
+	pthread_create(&thread, null, stressConsumer, &c);
+
+	// While the consumer is held, the ring fills and the rest are dropped (these calls returning shows they don't
+	// wait for it).
+	uint32_t written = 0;
+	int n = 0;
+	for (; n < LOG_RING_SIZE + STRESS_HELD_DROPS; n++) {
+		written += writeMessage(&stressRing, LOG_INFO, L"%d message", n);
+	}
+	assertEquals("the ring filled", LOG_RING_SIZE, written);
+	assertEquals("the rest dropped", STRESS_HELD_DROPS, logRingTakeDropped(&stressRing));
+
+	// Then both run at once.
+	sem_post(&stressRelease);
+	for (; n < STRESS_MESSAGES; n++) {
+		written += writeMessage(&stressRing, LOG_INFO, L"%d message", n);
+	}
+
+	atomicStore(&stressDone, 1);
+	pthread_join(thread, null);
+	sem_destroy(&stressRelease);
+
+	uint32_t dropped = STRESS_HELD_DROPS + logRingTakeDropped(&stressRing);
+	printf("  %u written, %u dropped\n", written, dropped);
+	assertEquals("every message read or dropped", STRESS_MESSAGES, written + dropped);
+	assertEquals("every written message read", written, c.count);
+	assertTrue("read in order", c.ordered);
+}
+
+int main()
+{
+	runTest(testWriteRead);
+	runTest(testFull);
+	runTest(testTruncate);
+	runTest(testStress);
+	return testResult();
+}
@@ -0,0 +1,86 @@
+/* Task tray button - unit tests.
+ * Tests for the counters and latency histograms.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/metrics.h"
+
+#define US 1000ULL
+
+/** Durations go in the right bucket. */
+static void testBuckets()
+{
+	metricTimer timer = { "t" };
+	metricTimerAdd(&timer, 500);        // < 1us
+	metricTimerAdd(&timer, 1 * US);     // < 2us
+	metricTimerAdd(&timer, 3 * US);     // < 4us
+	metricTimerAdd(&timer, 100 * US);   // < 128us
+	metricTimerAdd(&timer, 10000000 * US); // overflow
+
+	assertEquals("count", 5, timer.count);
+	assertEquals("bucket 0", 1, timer.buckets[0]);
+	assertEquals("bucket 1", 1, timer.buckets[1]);
+	assertEquals("bucket 2", 1, timer.buckets[2]);
+	assertEquals("bucket 7", 1, timer.buckets[7]);
+	assertEquals("last bucket", 1, timer.buckets[HISTOGRAM_BUCKETS - 1]);
+	assertEquals("total", 500 + 1 * US + 3 * US + 100 * US + 10000000 * US, timer.total);
+	assertEquals("max", 10000000 * US, timer.max);
+}
+
+/** Percentiles come from the bucket bounds. */
+static void testPercentiles()
+{
+	metricTimer timer = { "t" };
+	assertEquals("empty", 0, metricTimerPercentile(&timer, 50));
+
+	for (int n = 0; n < 98; n++) {
+		metricTimerAdd(&timer, 3 * US);
+	}
+	metricTimerAdd(&timer, 100 * US);
+	metricTimerAdd(&timer, 1000 * US);
+
+	assertEquals("median", 4, metricTimerPercentile(&timer, 50));
+	assertEquals("98th", 4, metricTimerPercentile(&timer, 98));
+	assertEquals("99th", 128, metricTimerPercentile(&timer, 99));
+	assertEquals("100th", 1024, metricTimerPercentile(&timer, 100));
+}
+
+/** The snapshot is JSON, and fails cleanly when the buffer is too small. */
+static void testFormat()
+{
+	metricCounter counters[] = { { "a", 1 }, { "b", 22 } };
+	metricTimer timers[] = { { "x" }, { "y" } };
+	metricTimerAdd(&timers[0], 3 * US);
+
+	char buffer[512];
+	size_t length = metricsFormat(buffer, sizeof(buffer), counters, 2, timers, 2);
+	const char *expected = "{\"counters\":{\"a\":1,\"b\":22},\"timers\":{"
+		"\"x\":{\"count\":1,\"totalUs\":3,\"maxUs\":3,\"p50Us\":4,\"p99Us\":4,\"buckets\":[0,0,1]},"
+		"\"y\":{\"count\":0,\"totalUs\":0,\"maxUs\":0,\"p50Us\":0,\"p99Us\":0,\"buckets\":[]}}}";
+	assertTrue("should format the JSON", strcmp(buffer, expected) == 0);
+	assertEquals("length", strlen(expected), length);
+
+	assertEquals("too small", 0, metricsFormat(buffer, 20, counters, 2, timers, 2));
+	assertEquals("empty when too small", 0, buffer[0]);
+
+	metricsReset(counters, 2, timers, 2);
+	assertEquals("counter reset", 0, counters[1].count);
+	assertEquals("timer reset", 0, timers[0].count);
+	assertTrue("names kept", strcmp(timers[0].name, "x") == 0);
+}
+
+int main()
+{
+	runTest(testBuckets);
+	runTest(testPercentiles);
+	runTest(testFormat);
+	return testResult();
+}
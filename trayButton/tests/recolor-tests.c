@@ -0,0 +1,128 @@
+/* Task tray button - unit tests.
+ * Tests for the high-contrast recolouring kernel.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "../core/recolor.h"
+
+/** Yellow on navy (COLORREF) */
+#define FOREGROUND 0x0000ffff
+#define BACKGROUND 0x00800000
+
+/** Known inputs and outputs, from an independent implementation of the blend. */
+static const uint32_t goldenInput[] = {
+	0xff000000, 0xffffffff, 0x00ffffff, 0xff808080, 0x80ffffff, 0xffff0000,
+	0xff00ff00, 0xff0000ff, 0x7f404040, 0xffc0c0c0, 0x00000000, 0x40102030
+};
+static const uint32_t goldenOutput[] = {
+	0xff000080, 0xffffff00, 0xff000080, 0xff808040, 0xff808040, 0xff4d4d59,
+	0xff959535, 0xff1d1d71, 0xff202070, 0xffc0c020, 0xff000080, 0xff07077c
+};
+#define GOLDEN_COUNT (sizeof(goldenInput) / sizeof(goldenInput[0]))
+
+/**
+ * Fills a buffer with every combination of grey level and alpha, followed by random pixels.
+ * @param pixels The buffer.
+ * @param count Size of the buffer.
+ * @param seed Seed for the random pixels.
+ */
+static void fillTestPixels(uint32_t *pixels, size_t count, uint32_t seed)
+{
+	for (size_t n = 0; n < count; n++) {
+		if (n < 256 * 256) {
+			pixels[n] = (uint32_t)((n >> 8) << 24) | (uint32_t)(n & 0xff) * 0x010101;
+		} else {
+			// xorshift32
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			pixels[n] = seed;
+		}
+	}
+}
+
+/** The table goes from the background to the foreground colour. */
+static void testTable()
+{
+	recolorTable table = { 0 };
+	recolorTableInit(&table, FOREGROUND, BACKGROUND);
+
+	assertEquals("0 should be the background", 0xff000080, table.colors[0]);
+	assertEquals("255 should be the foreground", 0xffffff00, table.colors[255]);
+	assertEquals("128 should be between", 0xff808040, table.colors[128]);
+}
+
+/** Every implementation produces the golden output, including the tail which doesn't fill a vector. */
+static void testGolden()
+{
+	recolorTable table = { 0 };
+	recolorTableInit(&table, FOREGROUND, BACKGROUND);
+
+	for (int impl = RECOLOR_SCALAR; impl <= RECOLOR_AVX2; impl++) {
+		for (size_t count = 1; count <= GOLDEN_COUNT; count++) {
+			uint32_t pixels[GOLDEN_COUNT];
+			memcpy(pixels, goldenInput, sizeof(pixels));
+			recolorPixelsWith((recolorImpl)impl, &table, pixels, count);
+
+			for (size_t n = 0; n < GOLDEN_COUNT; n++) {
+				uint32_t expected = n < count ? goldenOutput[n] : goldenInput[n];
+				assertEquals("pixel should match the golden output", expected, pixels[n]);
+			}
+		}
+	}
+}
+
+/** Alpha is taken into account, not just the blue channel. */
+static void testCoverage()
+{
+	assertEquals("black", 0, recolorCoverage(0xff000000));
+	assertEquals("white", 255, recolorCoverage(0xffffffff));
+	assertEquals("transparent white", 0, recolorCoverage(0x00ffffff));
+	assertEquals("half transparent white", 128, recolorCoverage(0x80ffffff));
+	assertEquals("blue alone is dark", 29, recolorCoverage(0xff0000ff));
+	assertEquals("red", 77, recolorCoverage(0xffff0000));
+}
+
+/** The SIMD implementations are bit-exact with the scalar one. */
+static void testSimdMatchesScalar()
+{
+	recolorTable table = { 0 };
+	recolorTableInit(&table, 0x00123456, 0x00fedcba);
+
+	// Not a multiple of the vector size
+	size_t count = 256 * 256 + 100003;
+	uint32_t *expected = malloc(count * sizeof(uint32_t));
+	uint32_t *actual = malloc(count * sizeof(uint32_t));
+
+	fillTestPixels(expected, count, 1);
+	recolorPixelsWith(RECOLOR_SCALAR, &table, expected, count);
+
+	for (int impl = RECOLOR_SSE2; impl <= RECOLOR_AVX2; impl++) {
+		fillTestPixels(actual, count, 1);
+		recolorPixelsWith((recolorImpl)impl, &table, actual, count);
+		assertTrue("SIMD output should equal the scalar output",
+			memcmp(expected, actual, count * sizeof(uint32_t)) == 0);
+	}
+
+	free(expected);
+	free(actual);
+}
+
+int main()
+{
+	printf("Best implementation: %d\n", recolorBestImpl());
+	runTest(testTable);
+	runTest(testGolden);
+	runTest(testCoverage);
+	runTest(testSimdMatchesScalar);
+	return testResult();
+}
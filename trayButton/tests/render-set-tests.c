@@ -0,0 +1,150 @@
+/* Task tray button - unit tests.
+ * Atlases and icons shared by the buttons of the same size.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/render-set.h"
+
+/** Number of surfaces and icons that have been freed */
+static int surfacesFreed, iconsFreed;
+/** Something to point at */
+static int resource;
+
+static void freeSurface(void *context, void *surface)
+{
+	surfacesFreed++;
+}
+
+static void freeIcon(void *context, void *icon)
+{
+	iconsFreed++;
+}
+
+static void initSet(renderSet *set)
+{
+	renderHooks hooks = { freeSurface, freeIcon, null };
+	renderSetInit(set, &hooks);
+	surfacesFreed = iconsFreed = 0;
+}
+
+/** Buttons of the same size share an atlas; others get their own. */
+static void testShared()
+{
+	static renderSet set;
+	initSet(&set);
+
+	renderAtlas *primary = renderAtlasAcquire(&set, null, 24, 40, 16);
+	renderAtlas *secondary = renderAtlasAcquire(&set, null, 24, 40, 16);
+	renderAtlas *big = renderAtlasAcquire(&set, null, 48, 80, 32);
+
+	assertTrue("shared", primary && primary == secondary);
+	assertTrue("own atlas", big && big != primary);
+	assertEquals("users", 2, primary->slot.users);
+	assertEquals("size in the key", 48, big->atlas.key.width);
+	assertEquals("shared count", 1, set.shared);
+	assertEquals("created", 2, set.created);
+
+	// The platform renders into it.
+	primary->surface = &resource;
+	atlasKey key = primary->atlas.key;
+	key.iconId = 7;
+	assertTrue("same size, so the surface stays", !atlasUpdate(&primary->atlas, &key));
+	atlasRendered(&primary->atlas, 0);
+	assertTrue("rendered once, for both", !atlasNeedsRender(&secondary->atlas, 0));
+
+	// The same again is a no-op.
+	assertTrue("unchanged", renderAtlasAcquire(&set, primary, 24, 40, 16) == primary);
+	assertEquals("still 2 users", 2, primary->slot.users);
+
+	renderSetInvalidate(&set);
+	assertTrue("invalidated", atlasNeedsRender(&primary->atlas, 0));
+
+	renderSetClear(&set);
+	assertEquals("surface freed", 1, surfacesFreed);
+}
+
+/** A button moving to another DPI releases the old atlas, which is kept until the slot is needed. */
+static void testKept()
+{
+	static renderSet set;
+	initSet(&set);
+
+	renderAtlas *a = renderAtlasAcquire(&set, null, 24, 40, 16);
+	a->surface = &resource;
+
+	// Dragged to a 144 DPI monitor.
+	renderAtlas *b = renderAtlasAcquire(&set, a, 36, 60, 24);
+	assertTrue("different", b != a);
+	assertEquals("released", 0, a->slot.users);
+	assertEquals("kept", 0, surfacesFreed);
+
+	// And back.
+	renderAtlas *c = renderAtlasAcquire(&set, b, 24, 40, 16);
+	assertTrue("same atlas again", c == a);
+	assertTrue("same surface", c->surface == &resource);
+	assertEquals("kept count", 1, set.kept);
+
+	// Fill the rest with other sizes; the kept ones go, oldest first.
+	renderAtlasRelease(&set, c);
+	b->surface = &resource;
+	renderAtlas *sizes[RENDER_SLOTS];
+	for (int n = 0; n < RENDER_SLOTS; n++) {
+		sizes[n] = renderAtlasAcquire(&set, null, 100 + n, 40, 16);
+		assertTrue("acquired", sizes[n] != null);
+	}
+	assertEquals("both kept surfaces freed", 2, surfacesFreed);
+	assertEquals("evicted", 2, set.evicted);
+
+	// No room for another size.
+	assertTrue("full", renderAtlasAcquire(&set, null, 200, 40, 16) == null);
+	renderAtlasRelease(&set, sizes[3]);
+	renderAtlas *last = renderAtlasAcquire(&set, null, 200, 40, 16);
+	assertTrue("room", last == sizes[3]);
+	assertEquals("fresh", 0, last->atlas.valid);
+	renderSetClear(&set);
+}
+
+/** An icon is decoded once for each size, and again when it changes. */
+static void testIcons()
+{
+	static renderSet set;
+	initSet(&set);
+
+	renderIcon *one = renderIconAcquire(&set, null, 1, 16);
+	assertTrue("needs decoding", one && one->icon == null);
+	one->icon = &resource;
+
+	renderIcon *two = renderIconAcquire(&set, null, 1, 16);
+	assertTrue("decoded already", two == one && two->icon == &resource);
+	renderIcon *big = renderIconAcquire(&set, null, 1, 32);
+	assertTrue("another size", big != one && big->icon == null);
+	big->icon = &resource;
+
+	// gpii sends a new icon.
+	renderIcon *newOne = renderIconAcquire(&set, one, 2, 16);
+	renderIcon *newTwo = renderIconAcquire(&set, two, 2, 16);
+	assertTrue("new icon", newOne == newTwo && newOne != one && newOne->icon == null);
+	assertEquals("old one unused", 0, one->slot.users);
+	assertEquals("not freed yet", 0, iconsFreed);
+
+	renderIconRelease(&set, big);
+	renderIconRelease(&set, null);
+	renderSetClear(&set);
+	assertEquals("all freed", 2, iconsFreed);
+}
+
+int main()
+{
+	runTest(testShared);
+	runTest(testKept);
+	runTest(testIcons);
+	return testResult();
+}
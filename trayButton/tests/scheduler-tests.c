@@ -0,0 +1,99 @@
+/* Task tray button - unit tests.
+ * Tests for the polling scheduler, using a fake clock.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/scheduler.h"
+
+#define HOUR (60 * 60 * 1000)
+
+/** The check delay doubles while nothing changes, up to the maximum. */
+static void testBackOff()
+{
+	pollScheduler scheduler;
+	schedulerInit(&scheduler, 100, 1000, 60000);
+	uint64_t now = 0;
+
+	assertEquals("first check after activity", 1000, schedulerActivity(&scheduler, now));
+
+	uint32_t expected[] = { 2000, 4000, 8000, 16000, 32000, 60000, 60000 };
+	for (int n = 0; n < (int)(sizeof(expected) / sizeof(expected[0])); n++) {
+		now = scheduler.checkDue;
+		assertEquals("delay should double, up to the maximum", expected[n], schedulerCheck(&scheduler, now));
+		assertEquals("due time", now + expected[n], scheduler.checkDue);
+	}
+}
+
+/** Activity goes back to the shortest delay. */
+static void testActivity()
+{
+	pollScheduler scheduler;
+	schedulerInit(&scheduler, 100, 1000, 60000);
+	uint64_t now = 0;
+
+	schedulerActivity(&scheduler, now);
+	for (int n = 0; n < 10; n++) {
+		now = scheduler.checkDue;
+		schedulerCheck(&scheduler, now);
+	}
+	assertEquals("backed off", 60000, scheduler.checkDelay);
+
+	now += 500;
+	assertEquals("activity snaps back", 1000, schedulerActivity(&scheduler, now));
+	assertEquals("activity recorded", now, scheduler.lastActivity);
+	now = scheduler.checkDue;
+	assertEquals("and backs off again", 2000, schedulerCheck(&scheduler, now));
+}
+
+/** The resize timer runs while things are changing. */
+static void testResize()
+{
+	pollScheduler scheduler;
+	schedulerInit(&scheduler, 100, 1000, 60000);
+
+	assertEquals("keep going while changing", 100, schedulerResize(&scheduler, true));
+	assertEquals("stop when stable", 0, schedulerResize(&scheduler, false));
+	assertEquals("wakeups counted", 2, scheduler.wakeups);
+}
+
+/** An idle hour wakes up far less than the old fixed 5 second timer (720 times). */
+static void testIdleWakeRate()
+{
+	pollScheduler scheduler;
+	schedulerInit(&scheduler, 100, 1000, 60000);
+	uint64_t now = 0;
+
+	schedulerActivity(&scheduler, now);
+	while (scheduler.checkDue <= HOUR) {
+		now = scheduler.checkDue;
+		schedulerCheck(&scheduler, now);
+	}
+
+	printf("wakeups in an idle hour: %u\n", scheduler.wakeups);
+	assertTrue("idle wake rate should be at most one per minute, after backing off", scheduler.wakeups <= 66);
+}
+
+/** Slow timers can be coalesced, fast ones can't. */
+static void testTolerance()
+{
+	assertEquals("fast timer", 0, schedulerTolerance(100));
+	assertEquals("slow timer", 15000, schedulerTolerance(60000));
+}
+
+int main()
+{
+	runTest(testBackOff);
+	runTest(testActivity);
+	runTest(testResize);
+	runTest(testIdleWakeRate);
+	runTest(testTolerance);
+	return testResult();
+}
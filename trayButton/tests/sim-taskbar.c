@@ -0,0 +1,264 @@
+/* Task tray button - unit tests.
+ * A simulated taskbar, so the button logic can be run without Windows.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "sim-taskbar.h"
+
+// Pixel sizes of the taskbar's parts, at 96 DPI.
+#define SIM_THICKNESS 40
+#define SIM_START_SIZE 100
+#define SIM_CAPTION 23
+
+#define RESIZE_DELAY 100
+#define CHECK_MIN_DELAY 1000
+#define CHECK_MAX_DELAY 60000
+#define BUTTON_WIDTH 24
+
+#define getSim(platform) ((simTaskbar*)(platform))
+
+static bool simGetTaskbar(buttonPlatform *platform, layoutInput *input)
+{
+	simTaskbar *sim = getSim(platform);
+	sim->counts.getTaskbar++;
+	*input = sim->geometry;
+	return true;
+}
+
+static uint32_t simGetDpi(buttonPlatform *platform)
+{
+	return getSim(platform)->dpi;
+}
+
+static bool simIsHighContrast(buttonPlatform *platform)
+{
+	return getSim(platform)->highContrast;
+}
+
+static void simResizeTasks(buttonPlatform *platform, int32_t width, int32_t height)
+{
+	simTaskbar *sim = getSim(platform);
+	coreRect *tasks = &sim->geometry.tasksRect;
+	sim->counts.resizes++;
+
+	// SWP_NOMOVE keeps the origin, which is on the right when the coordinates are mirrored.
+	if (sim->rtl && sim->edge != SIM_EDGE_LEFT && sim->edge != SIM_EDGE_RIGHT) {
+		tasks->left = tasks->right - width;
+	} else {
+		tasks->right = tasks->left + width;
+	}
+	tasks->bottom = tasks->top + height;
+}
+
+static void simMoveButton(buttonPlatform *platform, const coreRect *rect)
+{
+	simTaskbar *sim = getSim(platform);
+	sim->counts.moves++;
+	sim->buttonRect = *rect;
+	sim->buttonShown = true;
+}
+
+static void simRedraw(buttonPlatform *platform, bool force)
+{
+	simTaskbar *sim = getSim(platform);
+	sim->counts.redraws++;
+	if (force) {
+		sim->counts.forcedRedraws++;
+	}
+}
+
+static void simNotifyPosition(buttonPlatform *platform, const coreRect *rect)
+{
+	simTaskbar *sim = getSim(platform);
+	sim->counts.notifies++;
+	sim->notifiedRect = *rect;
+}
+
+static void simReloadIcon(buttonPlatform *platform)
+{
+	simTaskbar *sim = getSim(platform);
+	sim->counts.reloads++;
+	// Like setImage.
+	sim->button->hasIcon = true;
+	buttonPosition(sim->button, true);
+}
+
+static void simStartTimer(buttonPlatform *platform, uint32_t id, uint32_t delay)
+{
+	simTaskbar *sim = getSim(platform);
+	if (id <= SIM_TIMERS) {
+		sim->counts.timerStarts++;
+		sim->timers[id].active = true;
+		sim->timers[id].delay = delay ? delay : 1;
+		sim->timers[id].due = sim->now + sim->timers[id].delay;
+	}
+}
+
+static void simStopTimer(buttonPlatform *platform, uint32_t id)
+{
+	simTaskbar *sim = getSim(platform);
+	if (id <= SIM_TIMERS) {
+		sim->counts.timerStops++;
+		sim->timers[id].active = false;
+	}
+}
+
+static uint64_t simNow(buttonPlatform *platform)
+{
+	return getSim(platform)->now;
+}
+
+static const buttonPlatform simPlatform = {
+	simGetTaskbar,
+	simGetDpi,
+	simIsHighContrast,
+	simResizeTasks,
+	simMoveButton,
+	simRedraw,
+	simNotifyPosition,
+	simReloadIcon,
+	simStartTimer,
+	simStopTimer,
+	simNow
+};
+
+void simInit(simTaskbar *sim, trayButton *button, simEdge edge, bool rtl, uint32_t dpi, int32_t notifyWidth)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->platform = simPlatform;
+	sim->button = button;
+	sim->edge = edge;
+	sim->rtl = rtl;
+	sim->dpi = dpi;
+	sim->notifyWidth = notifyWidth;
+	// Something non-zero, like GetTickCount64.
+	sim->now = 1000000;
+
+	buttonInit(button, &sim->platform, BUTTON_WIDTH, RESIZE_DELAY, CHECK_MIN_DELAY, CHECK_MAX_DELAY);
+	simShellLayout(sim);
+}
+
+void simSetOrigin(simTaskbar *sim, int32_t x, int32_t y)
+{
+	sim->originX = x;
+	sim->originY = y;
+	simShellLayout(sim);
+}
+
+void simStart(simTaskbar *sim)
+{
+	// WinMain
+	sim->button->dpi = sim->dpi;
+	buttonCheckHighContrast(sim->button);
+	// gpii sends the icon
+	sim->platform.reloadIcon(&sim->platform);
+}
+
+void simShellLayout(simTaskbar *sim)
+{
+	layoutInput *g = &sim->geometry;
+	int32_t thickness = scaleDpi(SIM_THICKNESS, sim->dpi);
+	int32_t start = scaleDpi(SIM_START_SIZE, sim->dpi);
+	int32_t notifySize = scaleDpi(sim->notifyWidth, sim->dpi);
+	coreRect *tray = &g->trayRect;
+
+	memset(g, 0, sizeof(*g));
+
+	switch (sim->edge) {
+	case SIM_EDGE_BOTTOM:
+		*tray = (coreRect) { 0, SIM_SCREEN_HEIGHT - thickness, SIM_SCREEN_WIDTH, SIM_SCREEN_HEIGHT };
+		break;
+	case SIM_EDGE_TOP:
+		*tray = (coreRect) { 0, 0, SIM_SCREEN_WIDTH, thickness };
+		break;
+	case SIM_EDGE_LEFT:
+		*tray = (coreRect) { 0, 0, thickness, SIM_SCREEN_HEIGHT };
+		break;
+	case SIM_EDGE_RIGHT:
+		*tray = (coreRect) { SIM_SCREEN_WIDTH - thickness, 0, SIM_SCREEN_WIDTH, SIM_SCREEN_HEIGHT };
+		break;
+	}
+
+	g->trayClient = (coreRect) { 0, 0, rectWidth(*tray), rectHeight(*tray) };
+
+	if (sim->edge == SIM_EDGE_LEFT || sim->edge == SIM_EDGE_RIGHT) {
+		g->tasksRect = (coreRect) { tray->left, start, tray->right, tray->bottom - notifySize };
+		g->notifyRect = (coreRect) { tray->left, tray->bottom - notifySize, tray->right, tray->bottom };
+		g->screenHeight = SIM_SCREEN_HEIGHT - scaleDpi(SIM_CAPTION, sim->dpi);
+	} else {
+		if (sim->rtl) {
+			g->notifyRect = (coreRect) { 0, tray->top, notifySize, tray->bottom };
+			g->tasksRect = (coreRect) { notifySize, tray->top, SIM_SCREEN_WIDTH - start, tray->bottom };
+		} else {
+			g->tasksRect = (coreRect) { start, tray->top, SIM_SCREEN_WIDTH - notifySize, tray->bottom };
+			g->notifyRect = (coreRect) { SIM_SCREEN_WIDTH - notifySize, tray->top, SIM_SCREEN_WIDTH, tray->bottom };
+		}
+		g->screenHeight = SIM_SCREEN_HEIGHT - thickness - scaleDpi(SIM_CAPTION, sim->dpi);
+	}
+
+	// The window rectangles are on the virtual screen; the client rectangle isn't.
+	coreRect *screenRects[] = { tray, &g->tasksRect, &g->notifyRect };
+	for (int n = 0; n < 3; n++) {
+		screenRects[n]->left += sim->originX;
+		screenRects[n]->right += sim->originX;
+		screenRects[n]->top += sim->originY;
+		screenRects[n]->bottom += sim->originY;
+	}
+}
+
+void simShellLayoutAfter(simTaskbar *sim, uint32_t delay)
+{
+	sim->resetDue = sim->now + delay;
+}
+
+void simAdvance(simTaskbar *sim, uint32_t ms)
+{
+	uint64_t end = sim->now + ms;
+
+	for (;;) {
+		// Find the next thing that's due.
+		uint64_t next = sim->resetDue ? sim->resetDue : UINT64_MAX;
+		uint32_t timer = 0;
+		for (uint32_t id = 1; id <= SIM_TIMERS; id++) {
+			if (sim->timers[id].active && sim->timers[id].due < next) {
+				next = sim->timers[id].due;
+				timer = id;
+			}
+		}
+
+		if (next > end) {
+			break;
+		}
+
+		sim->now = next;
+		if (timer) {
+			sim->counts.timerFires++;
+			sim->timers[timer].due += sim->timers[timer].delay;
+			buttonTimer(sim->button, timer);
+		} else {
+			sim->resetDue = 0;
+			simShellLayout(sim);
+		}
+	}
+
+	sim->now = end;
+}
+
+uint32_t simOps(const simCounts *counts)
+{
+	return counts->resizes + counts->moves + counts->notifies;
+}
+
+int32_t simTasksLength(const simTaskbar *sim)
+{
+	const coreRect *tasks = &sim->geometry.tasksRect;
+	return (sim->edge == SIM_EDGE_LEFT || sim->edge == SIM_EDGE_RIGHT) ? rectHeight(*tasks) : rectWidth(*tasks);
+}
@@ -0,0 +1,130 @@
+/* Task tray button - unit tests.
+ * A simulated taskbar, so the button logic can be run without Windows.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_SIM_TASKBAR_H
+#define TRAY_BUTTON_SIM_TASKBAR_H
+
+#include "../core/button.h"
+
+#define SIM_SCREEN_WIDTH 1920
+#define SIM_SCREEN_HEIGHT 1080
+/** Highest timer id */
+#define SIM_TIMERS 4
+
+typedef enum { SIM_EDGE_BOTTOM, SIM_EDGE_TOP, SIM_EDGE_LEFT, SIM_EDGE_RIGHT } simEdge;
+
+/** What the button asked the platform to do. */
+typedef struct {
+	uint32_t getTaskbar, resizes, moves, redraws, forcedRedraws, notifies, reloads;
+	uint32_t timerStarts, timerStops, timerFires;
+} simCounts;
+
+/** A timer; like Win32 timers, they repeat until stopped. */
+typedef struct {
+	bool active;
+	uint32_t delay;
+	uint64_t due;
+} simTimer;
+
+/**
+ * A taskbar, which behaves like explorer's: it lays out the task list to fill the space between the start button and
+ * the notification icons, undoing the button's resize whenever it feels like it.
+ */
+typedef struct {
+	/** The platform given to the button (must be first) */
+	buttonPlatform platform;
+	trayButton *button;
+
+	/** Configuration */
+	simEdge edge;
+	bool rtl;
+	uint32_t dpi;
+	/** Width (or height) of the notification icons, at 96 DPI */
+	int32_t notifyWidth;
+	bool highContrast;
+	/** Where the monitor is, on the virtual screen */
+	int32_t originX, originY;
+
+	/** The current geometry of the taskbar */
+	layoutInput geometry;
+	/** Where the button is (client coordinates) */
+	coreRect buttonRect;
+	bool buttonShown;
+	/** The last position sent to gpii */
+	coreRect notifiedRect;
+
+	uint64_t now;
+	simTimer timers[SIM_TIMERS + 1];
+	/** When explorer will next reset the task list (0 for never) */
+	uint64_t resetDue;
+
+	simCounts counts;
+} simTaskbar;
+
+/**
+ * Initialises the simulated taskbar, and the button which uses it.
+ * @param sim The taskbar.
+ * @param button The button.
+ * @param edge The edge of the screen.
+ * @param rtl Right-to-left reading direction.
+ * @param dpi The DPI.
+ * @param notifyWidth Width of the notification icons, at 96 DPI.
+ */
+void simInit(simTaskbar *sim, trayButton *button, simEdge edge, bool rtl, uint32_t dpi, int32_t notifyWidth);
+
+/**
+ * Moves the taskbar to another monitor, to the side of (or above) the primary one.
+ * @param sim The taskbar.
+ * @param x Left of the monitor.
+ * @param y Top of the monitor.
+ */
+void simSetOrigin(simTaskbar *sim, int32_t x, int32_t y);
+
+/**
+ * Starts the button, like WinMain followed by gpii sending the icon.
+ * @param sim The taskbar.
+ */
+void simStart(simTaskbar *sim);
+
+/**
+ * Lays out the taskbar as explorer does, which resets the task list to its full size.
+ * @param sim The taskbar.
+ */
+void simShellLayout(simTaskbar *sim);
+
+/**
+ * Explorer will lay out the taskbar after a delay, without telling anyone.
+ * @param sim The taskbar.
+ * @param delay The delay (ms).
+ */
+void simShellLayoutAfter(simTaskbar *sim, uint32_t delay);
+
+/**
+ * Moves the clock forward, firing the timers and any pending layout in the order they're due.
+ * @param sim The taskbar.
+ * @param ms The time to advance by.
+ */
+void simAdvance(simTaskbar *sim, uint32_t ms);
+
+/**
+ * Gets the number of operations which affect the taskbar or gpii (resizes, moves and notifications).
+ * @param counts The counts.
+ */
+uint32_t simOps(const simCounts *counts);
+
+/**
+ * Gets the width of the task list.
+ * @param sim The taskbar.
+ */
+int32_t simTasksLength(const simTaskbar *sim);
+
+#endif /* TRAY_BUTTON_SIM_TASKBAR_H */
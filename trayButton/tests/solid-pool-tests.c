@@ -0,0 +1,78 @@
+/* Task tray button - unit tests.
+ * Tests for the solid-colour surface pool, and the pixel fill.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/pixels.h"
+#include "../core/solid-pool.h"
+
+static int freed = 0;
+static void countFree(void *surface)
+{
+	freed++;
+}
+
+/** Colours are premultiplied, and converted from COLORREF. */
+static void testPremultiply()
+{
+	assertEquals("opaque black", 0xff000000, premultiplyColor(0x000000, 255));
+	assertEquals("opaque red", 0xffff0000, premultiplyColor(0x0000ff, 255));
+	assertEquals("translucent white", 0x19191919, premultiplyColor(0xffffff, 25));
+	assertEquals("transparent", 0, premultiplyColor(0xffffff, 0));
+}
+
+/** Surfaces are re-used, and the least recently used one is given back when full. */
+static void testPool()
+{
+	solidPool pool = { 0 };
+	int surfaces[SOLID_POOL_SIZE + 1];
+
+	assertTrue("empty pool should miss", solidPoolFind(&pool, 1) == null);
+	for (int n = 0; n < SOLID_POOL_SIZE; n++) {
+		assertTrue("nothing removed while there's room", solidPoolAdd(&pool, n, &surfaces[n]) == null);
+	}
+
+	assertTrue("should hit", solidPoolFind(&pool, 0) == &surfaces[0]);
+	assertEquals("hits counted", 1, pool.hits);
+	assertEquals("misses counted", 1, pool.misses);
+
+	// 1 is now the least recently used
+	void *removed = solidPoolAdd(&pool, 100, &surfaces[SOLID_POOL_SIZE]);
+	assertTrue("least recently used should be removed", removed == &surfaces[1]);
+	assertTrue("removed pixel should miss", solidPoolFind(&pool, 1) == null);
+	assertTrue("new pixel should hit", solidPoolFind(&pool, 100) == &surfaces[SOLID_POOL_SIZE]);
+
+	solidPoolClear(&pool, countFree);
+	assertEquals("all surfaces freed", SOLID_POOL_SIZE, freed);
+	assertTrue("should miss after clear", solidPoolFind(&pool, 0) == null);
+}
+
+/** Only the rectangle is filled. */
+static void testFill()
+{
+	uint32_t pixels[4 * 3] = { 0 };
+	fillPixels(pixels, 4, 1, 1, 3, 3, 0xff000000);
+
+	for (int y = 0; y < 3; y++) {
+		for (int x = 0; x < 4; x++) {
+			bool inside = x >= 1 && x < 3 && y >= 1;
+			assertEquals("pixel should be filled if inside", inside ? 0xff000000 : 0, pixels[y * 4 + x]);
+		}
+	}
+}
+
+int main()
+{
+	runTest(testPremultiply);
+	runTest(testPool);
+	runTest(testFill);
+	return testResult();
+}
@@ -0,0 +1,129 @@
+/* Task tray button - unit tests.
+ * Tests for the span recorder, and the Chrome trace-event JSON it writes.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <string.h>
+#include "test.h"
+#include "../core/span.h"
+
+/** Spans come back oldest first; the oldest are replaced when it's full. */
+static void testRecord()
+{
+	static spanRecorder recorder;
+	assertEquals("empty", 0, spanCount(&recorder));
+	assertTrue("nothing to get", spanGet(&recorder, 0) == null);
+
+	const span *s = spanRecord(&recorder, "first", 1, 0, 100, 150);
+	assertTrue("recorded", s->start == 100 && s->end == 150 && s->sequence == 1 && !strcmp(s->name, "first"));
+	assertEquals("one", 1, spanCount(&recorder));
+	assertTrue("got it", spanGet(&recorder, 0) == s);
+
+	// The clock going backwards doesn't make a negative span.
+	s = spanRecord(&recorder, "backwards", 0, 0, 200, 190);
+	assertEquals("empty span", 200, s->end);
+
+	for (uint32_t n = 2; n < SPAN_CAPACITY + 10; n++) {
+		spanRecord(&recorder, "more", n, 0, n * 1000, n * 1000 + 1);
+	}
+	assertEquals("full", SPAN_CAPACITY, spanCount(&recorder));
+	assertEquals("recorded", SPAN_CAPACITY + 10, recorder.count);
+	assertEquals("oldest kept", 10, spanGet(&recorder, 0)->sequence);
+	assertEquals("newest", SPAN_CAPACITY + 9, spanGet(&recorder, SPAN_CAPACITY - 1)->sequence);
+	assertTrue("past the end", spanGet(&recorder, SPAN_CAPACITY) == null);
+}
+
+/** A span is a complete event; one which sent a notification also starts a flow. */
+static void testFormatEvent()
+{
+	static spanRecorder recorder;
+	char buffer[SPAN_EVENT_LENGTH];
+
+	const span *s = spanRecord(&recorder, "click", 7, 0, 1000, 1250);
+	size_t length = spanFormatEvent(s, 12, 34, buffer, sizeof(buffer));
+	const char *expected = "{\"name\":\"click\",\"cat\":\"tray-button\",\"ph\":\"X\",\"ts\":1000,\"dur\":250,"
+		"\"pid\":12,\"tid\":34,\"args\":{\"sequence\":7}}";
+	assertTrue("complete event", !strcmp(buffer, expected));
+	assertEquals("length", strlen(expected), length);
+
+	s = spanRecord(&recorder, "notify", 7, SPAN_FLOW_OUT, 1100, 1200);
+	length = spanFormatEvent(s, 12, 34, buffer, sizeof(buffer));
+	expected = "{\"name\":\"notify\",\"cat\":\"tray-button\",\"ph\":\"X\",\"ts\":1100,\"dur\":100,"
+		"\"pid\":12,\"tid\":34,\"args\":{\"sequence\":7}},"
+		"{\"name\":\"notification\",\"cat\":\"tray-button\",\"ph\":\"s\",\"id\":7,\"ts\":1100,\"pid\":12,\"tid\":34}";
+	assertTrue("with the flow", !strcmp(buffer, expected));
+	assertEquals("flow length", strlen(expected), length);
+
+	// Without a notification, there's nothing to flow to.
+	s = spanRecord(&recorder, "notify", 0, SPAN_FLOW_OUT, 1100, 1200);
+	spanFormatEvent(s, 12, 34, buffer, sizeof(buffer));
+	assertTrue("no flow", strstr(buffer, "\"ph\":\"s\"") == null);
+
+	// Large times aren't truncated.
+	s = spanRecord(&recorder, "late", 1, 0, 0x123456789aULL, 0x123456789aULL + 5);
+	spanFormatEvent(s, 1, 1, buffer, sizeof(buffer));
+	assertTrue("64-bit time", strstr(buffer, "\"ts\":78187493530,\"dur\":5,") != null);
+
+	assertEquals("too small", 0, spanFormatEvent(s, 1, 1, buffer, 20));
+	assertEquals("empty when too small", 0, buffer[0]);
+}
+
+/** The trace names the process, and has the spans in order. */
+static void testFormatTrace()
+{
+	static spanRecorder recorder;
+	char buffer[4096];
+
+	size_t length = spanFormatTrace(&recorder, "tray-button", 5, 6, buffer, sizeof(buffer));
+	const char *expected = "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":5,\"tid\":6,"
+		"\"args\":{\"name\":\"tray-button\"}}],\"displayTimeUnit\":\"ms\"}";
+	assertTrue("empty trace", !strcmp(buffer, expected));
+	assertEquals("empty length", strlen(expected), length);
+
+	spanRecord(&recorder, "a", 1, 0, 10, 20);
+	spanRecord(&recorder, "b", 2, SPAN_FLOW_OUT, 30, 40);
+	length = spanFormatTrace(&recorder, "tray-button", 5, 6, buffer, sizeof(buffer));
+	assertEquals("length", strlen(buffer), length);
+
+	const char *a = strstr(buffer, "{\"name\":\"a\"");
+	const char *b = strstr(buffer, "{\"name\":\"b\"");
+	const char *flow = strstr(buffer, "\"ph\":\"s\",\"id\":2,");
+	assertTrue("in order", a && b && flow && a < b && b < flow);
+	assertTrue("separated", !strncmp(b - 2, "},{", 3));
+	assertTrue("ends", !strcmp(buffer + length - 25, "],\"displayTimeUnit\":\"ms\"}"));
+
+	// Every brace and bracket is closed.
+	int depth = 0;
+	for (size_t n = 0; n < length; n++) {
+		depth += (buffer[n] == '{' || buffer[n] == '[') - (buffer[n] == '}' || buffer[n] == ']');
+		if (depth < 0) {
+			break;
+		}
+	}
+	assertEquals("balanced", 0, depth);
+
+	// A full recorder still fits in a reasonable buffer.
+	for (uint32_t n = 0; n < SPAN_CAPACITY; n++) {
+		spanRecord(&recorder, "notify", n + 1, SPAN_FLOW_OUT, 0xffffffffffULL, 0xffffffffffULL + 1000);
+	}
+	static char big[SPAN_CAPACITY * SPAN_EVENT_LENGTH];
+	assertTrue("full trace", spanFormatTrace(&recorder, "tray-button", 0xffffffff, 0xffffffff, big, sizeof(big)) > 0);
+
+	assertEquals("too small", 0, spanFormatTrace(&recorder, "tray-button", 5, 6, buffer, 100));
+	assertEquals("empty when too small", 0, buffer[0]);
+}
+
+int main()
+{
+	runTest(testRecord);
+	runTest(testFormatEvent);
+	runTest(testFormatTrace);
+	return testResult();
+}
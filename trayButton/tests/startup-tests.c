@@ -0,0 +1,78 @@
+/* Task tray button - unit tests.
+ * Startup retry delays and milestones.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/startup.h"
+
+/** The delays double, up to the limit. */
+static void testBackoff()
+{
+	backoff b;
+	backoffInit(&b, 10, 1000);
+
+	static const uint32_t expected[] = { 10, 20, 40, 80, 160, 320, 640, 1000, 1000, 1000 };
+	for (size_t n = 0; n < sizeof(expected) / sizeof(expected[0]); n++) {
+		assertEquals("delay", expected[n], backoffNext(&b));
+	}
+	assertEquals("attempts", 10, b.attempts);
+
+	backoffReset(&b);
+	assertEquals("reset", 10, backoffNext(&b));
+	assertEquals("reset attempts", 1, b.attempts);
+
+	// Silly values
+	backoffInit(&b, 0, 0);
+	assertEquals("at least 1ms", 1, backoffNext(&b));
+	assertEquals("limited", 1, backoffNext(&b));
+
+	backoffInit(&b, 0x80000001u, 0xffffffffu);
+	assertEquals("large", 0x80000001u, backoffNext(&b));
+	assertEquals("no overflow", 0xffffffffu, backoffNext(&b));
+	assertEquals("stays at the limit", 0xffffffffu, backoffNext(&b));
+}
+
+/** Milestones are recorded once, relative to the start. */
+static void testMilestones()
+{
+	startupMilestones m;
+	milestonesStart(&m, 5000);
+
+	assertTrue("started", milestoneReach(&m, MILESTONE_STARTED, 5020));
+	assertTrue("taskbar", milestoneReach(&m, MILESTONE_TASKBAR, 5100));
+	assertTrue("taskbar again", !milestoneReach(&m, MILESTONE_TASKBAR, 6000));
+	assertEquals("started time", 20, m.times[MILESTONE_STARTED]);
+	assertEquals("taskbar time", 100, m.times[MILESTONE_TASKBAR]);
+
+	assertTrue("unknown", !milestoneReach(&m, MILESTONE_COUNT, 6000));
+	assertTrue("unknown name", milestoneName(MILESTONE_COUNT) == null);
+	assertTrue("name", strcmp(milestoneName(MILESTONE_VISIBLE), "visible") == 0);
+
+	// The clock going backwards doesn't make a huge number.
+	assertTrue("window", milestoneReach(&m, MILESTONE_WINDOW, 4000));
+	assertEquals("window time", 0, m.times[MILESTONE_WINDOW]);
+
+	// Explorer restarts: everything but the process start happens again.
+	milestonesRestart(&m, 60000);
+	assertEquals("restarts", 1, m.restarts);
+	assertTrue("not started again", !milestoneReach(&m, MILESTONE_STARTED, 60010));
+	assertTrue("taskbar after restart", milestoneReach(&m, MILESTONE_TASKBAR, 60500));
+	assertEquals("taskbar time after restart", 500, m.times[MILESTONE_TASKBAR]);
+	assertTrue("visible after restart", milestoneReach(&m, MILESTONE_VISIBLE, 60600));
+	assertEquals("reached", (1 << MILESTONE_STARTED) | (1 << MILESTONE_TASKBAR) | (1 << MILESTONE_VISIBLE), m.reached);
+}
+
+int main()
+{
+	runTest(testBackoff);
+	runTest(testMilestones);
+	return testResult();
+}
@@ -0,0 +1,188 @@
+/* Task tray button - unit tests.
+ * Tests for the snapshot of the button's state, in shared memory.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <string.h>
+#include "test.h"
+#include "../core/state-snapshot.h"
+
+/** The shared memory (aligned, like a mapped view). */
+typedef union {
+	uint32_t align;
+	uint8_t bytes[SNAPSHOT_SIZE];
+} sharedMemory;
+
+/** Makes a snapshot, different for each seed. */
+static void makeSnapshot(stateSnapshot *s, uint32_t seed, size_t batchLength)
+{
+	memset(s, 0, sizeof(*s));
+	s->taskbarRect = (coreRect) { -1920, 1040, 0, 1080 };
+	s->buttonRect = (coreRect) { 1700, 0, 1724 + (int32_t)seed, 40 };
+	s->screenRect = (coreRect) { -220, 1040, -196 + (int32_t)seed, 1080 };
+	s->dpi = 96 + seed;
+	s->batchLength = batchLength;
+	for (size_t n = 0; n < batchLength; n++) {
+		s->batch[n] = (uint16_t)(n * 40503u + seed);
+	}
+}
+
+static uint32_t generationOf(const sharedMemory *memory)
+{
+	uint32_t generation;
+	memcpy(&generation, memory->bytes + 8, 4);
+	return generation;
+}
+
+/** What's written is read back; writing the same again doesn't touch it. */
+static void testReadWrite()
+{
+	static sharedMemory memory;
+	static stateSnapshot written, read;
+
+	assertEquals("empty", SNAPSHOT_EMPTY, snapshotRead(&memory, &read));
+
+	makeSnapshot(&written, 1, 40);
+	assertTrue("written", snapshotWrite(&memory, &written));
+	assertEquals("read", SNAPSHOT_OK, snapshotRead(&memory, &read));
+	assertTrue("the same", snapshotEquals(&written, &read));
+	assertEquals("written once", 2, generationOf(&memory));
+	assertTrue("little-endian", !memcmp(memory.bytes, "TBSS\1\0\0\0", 8));
+	// The negative co-ordinates survive.
+	assertEquals("left", -1920, read.taskbarRect.left);
+
+	read = written;
+	read.batch[39]++;
+	assertTrue("different settings", !snapshotEquals(&written, &read));
+	read = written;
+	read.dpi++;
+	assertTrue("different DPI", !snapshotEquals(&written, &read));
+	read = written;
+	read.batch[40]++;
+	assertTrue("only the batch's length is compared", snapshotEquals(&written, &read));
+
+	assertTrue("same again", snapshotWrite(&memory, &written));
+	assertEquals("not rewritten", 2, generationOf(&memory));
+
+	makeSnapshot(&written, 2, 0);
+	assertTrue("no settings", snapshotWrite(&memory, &written));
+	assertEquals("rewritten", 4, generationOf(&memory));
+	assertEquals("read again", SNAPSHOT_OK, snapshotRead(&memory, &read));
+	assertTrue("the new one", snapshotEquals(&written, &read));
+
+	makeSnapshot(&written, 3, SNAPSHOT_MAX_BATCH);
+	assertTrue("largest", snapshotWrite(&memory, &written));
+	assertEquals("largest read", SNAPSHOT_OK, snapshotRead(&memory, &read));
+	assertTrue("largest the same", snapshotEquals(&written, &read));
+
+	written.batchLength = SNAPSHOT_MAX_BATCH + 1;
+	assertTrue("too long", !snapshotWrite(&memory, &written));
+	assertEquals("the last one is kept", SNAPSHOT_OK, snapshotRead(&memory, &read));
+}
+
+/** A snapshot that can't be trusted is ignored, and replaced by the next one. */
+static void testRejected()
+{
+	static sharedMemory memory;
+	static stateSnapshot written, read;
+	makeSnapshot(&written, 1, 100);
+	snapshotWrite(&memory, &written);
+
+	// Another version of the button.
+	memory.bytes[4] = SNAPSHOT_VERSION + 1;
+	assertEquals("other version", SNAPSHOT_OTHER_VERSION, snapshotRead(&memory, &read));
+	snapshotWrite(&memory, &written);
+	assertEquals("replaced", SNAPSHOT_OK, snapshotRead(&memory, &read));
+
+	// The button died while writing it.
+	uint32_t generation = generationOf(&memory) + 1;
+	memcpy(memory.bytes + 8, &generation, 4);
+	assertEquals("half written", SNAPSHOT_BUSY, snapshotRead(&memory, &read));
+	snapshotWrite(&memory, &written);
+	assertEquals("written after", SNAPSHOT_OK, snapshotRead(&memory, &read));
+	assertTrue("even again", !(generationOf(&memory) & 1));
+
+	// Something else wrote over it.
+	memory.bytes[SNAPSHOT_HEADER_SIZE + SNAPSHOT_FIXED_SIZE + 10] ^= 1;
+	assertEquals("damaged", SNAPSHOT_DAMAGED, snapshotRead(&memory, &read));
+	snapshotWrite(&memory, &written);
+	assertEquals("repaired", SNAPSHOT_OK, snapshotRead(&memory, &read));
+
+	// A length past the end.
+	memory.bytes[12 + 1] = 0x40;
+	assertEquals("too long", SNAPSHOT_DAMAGED, snapshotRead(&memory, &read));
+}
+
+/*
+ * The stress test: one thread keeps writing one of two snapshots (like a button changing its icon back and forth),
+ * while another keeps reading (like a button starting). Every snapshot read is one of the two, whole.
+ */
+
+#define STRESS_WRITES 200000
+
+typedef struct {
+	sharedMemory memory;
+	stateSnapshot snapshots[2];
+	volatile bool stopping;
+} stressState;
+
+static void *stressWriter(void *param)
+{
+	stressState *s = param;
+	for (uint32_t n = 0; n < STRESS_WRITES; n++) {
+		snapshotWrite(&s->memory, &s->snapshots[n & 1]);
+	}
+	s->stopping = true;
+	return null;
+}
+
+static void testStress()
+{
+	static stressState s;
+	static stateSnapshot read;
+	makeSnapshot(&s.snapshots[0], 1, 1000);
+	makeSnapshot(&s.snapshots[1], 2, 1500);
+	snapshotWrite(&s.memory, &s.snapshots[1]);
+
+	pthread_t thread;
+	pthread_create(&thread, null, stressWriter, &s);
+
+	uint32_t reads = 0, busy = 0, wrong = 0, damaged = 0;
+	while (!s.stopping) {
+		int result = snapshotRead(&s.memory, &read);
+		if (result == SNAPSHOT_OK) {
+			reads++;
+			if (!snapshotEquals(&read, &s.snapshots[0]) && !snapshotEquals(&read, &s.snapshots[1])) {
+				wrong++;
+			}
+		} else if (result == SNAPSHOT_BUSY) {
+			busy++;
+		} else {
+			damaged++;
+		}
+	}
+	pthread_join(thread, null);
+
+	printf("  %u reads, %u while it was being written\n", reads, busy);
+	assertEquals("never torn", 0, wrong);
+	assertEquals("never damaged", 0, damaged);
+	assertEquals("last one", SNAPSHOT_OK, snapshotRead(&s.memory, &read));
+	assertTrue("last written", snapshotEquals(&read, &s.snapshots[(STRESS_WRITES - 1) & 1]));
+}
+
+int main()
+{
+	runTest(testReadWrite);
+	runTest(testRejected);
+	runTest(testStress);
+	return testResult();
+}
@@ -0,0 +1,519 @@
+/* Task tray button - unit tests.
+ * Tests for the SVG reader and rasterizer, including gpii-app's own SVG icons against reference images.
+ *
+ * The reference images in tests/svg were drawn by tests/svg/reference.js, which works in a different way (point
+ * sampling rather than scan-line coverage), so they're compared with a tolerance.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test.h"
+#include "../core/pixels.h"
+#include "../core/raster.h"
+#include "../core/svg.h"
+
+#ifndef ICONS_DIR
+# define ICONS_DIR "../src/icons"
+#endif
+#ifndef REFERENCE_DIR
+# define REFERENCE_DIR "svg"
+#endif
+
+static uint8_t *readFile(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		printf("Can't open %s\n", path);
+		*size = 0;
+		return null;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = malloc(*size);
+	if (fread(data, 1, *size, f) != *size) {
+		*size = 0;
+	}
+	fclose(f);
+	return data;
+}
+
+static bool parse(const char *text, svgImage *image)
+{
+	return svgParse(text, strlen(text), image);
+}
+
+static uint32_t readBig32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Reads a reference image: an 8-bit RGBA PNG, with the data stored uncompressed and unfiltered (as reference.js writes
+ * them).
+ * @return The BGRA pixels, or null.
+ */
+static uint32_t *readPng(const char *path, int32_t *width, int32_t *height)
+{
+	size_t size;
+	uint8_t *file = readFile(path, &size);
+	if (!file || size < 8 || memcmp(file, "\x89PNG\r\n\x1a\n", 8)) {
+		free(file);
+		return null;
+	}
+
+	// Join the image data chunks.
+	uint8_t *zdata = malloc(size), *raw = null;
+	size_t zsize = 0, offset = 8;
+	uint32_t *pixels = null;
+	*width = *height = 0;
+	while (offset + 12 <= size) {
+		uint32_t length = readBig32(file + offset);
+		const uint8_t *type = file + offset + 4, *data = file + offset + 8;
+		if (offset + 12 + length > size) {
+			break;
+		}
+		if (!memcmp(type, "IHDR", 4)) {
+			*width = (int32_t)readBig32(data);
+			*height = (int32_t)readBig32(data + 4);
+			if (data[8] != 8 || data[9] != 6 || data[12] != 0) {
+				goto done;
+			}
+		} else if (!memcmp(type, "IDAT", 4)) {
+			memcpy(zdata + zsize, data, length);
+			zsize += length;
+		}
+		offset += 12 + length;
+	}
+
+	// The zlib stream: a header, then stored blocks.
+	size_t rowSize = (size_t)*width * 4 + 1, rawSize = rowSize * *height, rawLength = 0;
+	raw = malloc(rawSize);
+	for (size_t z = 2; z + 5 <= zsize;) {
+		uint8_t header = zdata[z];
+		uint32_t length = zdata[z + 1] | ((uint32_t)zdata[z + 2] << 8);
+		if ((header & 6) != 0 || rawLength + length > rawSize || z + 5 + length > zsize) {
+			goto done;
+		}
+		memcpy(raw + rawLength, zdata + z + 5, length);
+		rawLength += length;
+		z += 5 + length;
+		if (header & 1) {
+			break;
+		}
+	}
+	if (rawLength != rawSize) {
+		goto done;
+	}
+
+	pixels = malloc((size_t)*width * *height * sizeof(uint32_t));
+	for (int32_t y = 0; y < *height; y++) {
+		const uint8_t *row = raw + y * rowSize;
+		if (row[0] != 0) {
+			free(pixels);
+			pixels = null;
+			goto done;
+		}
+		for (int32_t x = 0; x < *width; x++) {
+			const uint8_t *p = row + 1 + x * 4;
+			pixels[y * *width + x] = ((uint32_t)p[3] << 24) | ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+		}
+	}
+
+done:
+	free(raw);
+	free(zdata);
+	free(file);
+	return pixels;
+}
+
+/** Style classes, style attributes and presentation attributes, inherited through groups. */
+static void testStyles()
+{
+	svgImage image;
+	bool ok = parse(
+		"<?xml version=\"1.0\"?>\n"
+		"<!-- comment <path d='M0,0'/> -->\n"
+		"<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 18 18\">\n"
+		"<style type=\"text/css\"><![CDATA[\n"
+		"  .st0{fill:#FFFFFF;stroke:#000000;stroke-width:0.75;stroke-miterlimit:10;}\n"
+		"  .st1, .st2 {fill:none;stroke:#f00}\n"
+		"  rect.ignored{fill:#0f0}\n"
+		"]]></style>\n"
+		"<g fill=\"#123456\" opacity=\"0.5\">\n"
+		"  <path d=\"M0,0H10V10Z\"/>\n"
+		"  <path class=\"st0\" d=\"M0,0H10V10Z\"/>\n"
+		"  <path class=\"st2\" style=\"stroke-width:2\" fill=\"blue\" d=\"M0,0H10V10Z\"/>\n"
+		"  <rect style=\"fill: rgb(255, 0, 0); fill-opacity: .5\" width=\"4\" height=\"4\"/>\n"
+		"</g>\n"
+		"<path fill-rule=\"evenodd\" stroke-linecap=\"round\" d=\"M0,0H10V10Z\"/>\n"
+		"<path style=\"display:none\" d=\"M0,0H10V10Z\"/>\n"
+		"<path fill=\"none\" d=\"M0,0H10V10Z\"/>\n"
+		"<defs><path d=\"M0,0H10V10Z\"/></defs>\n"
+		"<circle cx=\"1\" cy=\"1\" r=\"1\" fill=\"url(#gradient) #00ff00\"/>\n"
+		"</svg>\n", &image);
+
+	assertTrue("parsed", ok);
+	assertTrue("view box", image.viewX == 0 && image.viewWidth == 18 && image.viewHeight == 18);
+	assertEquals("shapes (hidden, unpainted and defined ones aren't)", 6, image.shapeCount);
+
+	assertEquals("inherited fill, at the group's opacity", 0x80123456, image.shapes[0].fill);
+	assertEquals("no stroke by default", 0, image.shapes[0].stroke);
+
+	assertEquals("class fill", 0x80ffffff, image.shapes[1].fill);
+	assertEquals("class stroke", 0x80000000, image.shapes[1].stroke);
+	assertTrue("class stroke width", image.shapes[1].strokeWidth == 0.75f);
+
+	assertEquals("class overrides attribute", 0, image.shapes[2].fill);
+	assertEquals("second selector", 0x80ff0000, image.shapes[2].stroke);
+	assertTrue("style overrides class", image.shapes[2].strokeWidth == 2);
+
+	assertEquals("rgb() and fill-opacity", 0x40ff0000, image.shapes[3].fill);
+	assertEquals("rect", 5, image.shapes[3].commandCount);
+
+	assertTrue("fill rule", image.shapes[4].evenOdd && !image.shapes[3].evenOdd);
+	assertEquals("line cap", SVG_CAP_ROUND, image.shapes[4].cap);
+	assertEquals("default fill", 0xff000000, image.shapes[4].fill);
+
+	assertEquals("fallback of an unsupported paint", 0xff00ff00, image.shapes[5].fill);
+	assertEquals("circle", 6, image.shapes[5].commandCount);
+
+	svgFree(&image);
+}
+
+/** Path data: every command, relative and implicit ones, and numbers without separators. */
+static void testPaths()
+{
+	svgImage image;
+	parse("<svg viewBox='0 0 100 100'><path d='m10 10 10 0 0 10zM1.5.5l.5.5H4v-1V0h1e1 "
+		"c1,1 2,2 3,3s1,1 2,2q1 0 2 2t2 2a5 5 0 0 1 10 0A 5 5 0 1010 10z'/></svg>", &image);
+	assertEquals("one shape", 1, image.shapeCount);
+
+	uint8_t expected[] = {
+		SVG_MOVE, SVG_LINE, SVG_LINE, SVG_CLOSE,
+		SVG_MOVE, SVG_LINE, SVG_LINE, SVG_LINE, SVG_LINE, SVG_LINE,
+		SVG_CUBIC, SVG_CUBIC, SVG_CUBIC, SVG_CUBIC, SVG_CUBIC, SVG_CUBIC
+	};
+	assertTrue("commands", image.commandCount > sizeof(expected));
+	for (size_t n = 0; n < sizeof(expected); n++) {
+		assertEquals("command", expected[n], image.commands[n]);
+	}
+	assertEquals("closed", SVG_CLOSE, image.commands[image.commandCount - 1]);
+
+	// Relative moves and implicit lines.
+	assertTrue("implicit line", image.points[2] == 20 && image.points[3] == 10);
+	assertTrue("relative to the previous point", image.points[4] == 20 && image.points[5] == 20);
+	// "1.5.5" is two numbers.
+	assertTrue("run-together numbers", image.points[6] == 1.5f && image.points[7] == 0.5f);
+	assertTrue("exponent", image.points[16] == 14 && image.points[17] == 0);
+
+	// The arc ends where it's meant to, without an error building up.
+	svgImage arc;
+	parse("<svg viewBox='0 0 100 100'><path d='M10,50 A40,40 0 1 1 90,50 A40 40 0 0 0 10 50'/></svg>", &arc);
+	uint32_t last = arc.pointCount;
+	assertTrue("arc end", arc.points[last - 2] == 10 && arc.points[last - 1] == 50);
+	assertEquals("arcs are quarters (or less)", 1 + 2 + 2, arc.commandCount);
+
+	// Drawing continues after an error, up to it.
+	svgImage broken;
+	parse("<svg viewBox='0 0 10 10'><path d='M0,0 L10,0 L10,10 X 0,10'/></svg>", &broken);
+	assertEquals("up to the error", 3, broken.commandCount);
+
+	svgFree(&image);
+	svgFree(&arc);
+	svgFree(&broken);
+}
+
+/** Transforms, on groups and shapes. */
+static void testTransforms()
+{
+	svgImage image;
+	parse("<svg viewBox='0 0 100 100'>"
+		"<g transform='translate(10, 20) scale(2)'><path transform='translate(1 1)' d='M1,2L3,4' stroke='#000'/></g>"
+		"<path transform='matrix(0 1 -1 0 0 0)' d='M1,0L2,0'/>"
+		"<path transform='rotate(90 5 5)' d='M5,0L6,0'/>"
+		"</svg>", &image);
+
+	assertEquals("shapes", 3, image.shapeCount);
+	assertTrue("translated, scaled", image.points[0] == 14 && image.points[1] == 26);
+	assertTrue("end", image.points[2] == 18 && image.points[3] == 30);
+	assertTrue("stroke width scaled", image.shapes[0].strokeWidth == 2);
+	assertTrue("matrix", image.points[4] == 0 && image.points[5] == 1);
+
+	float x = image.points[8], y = image.points[9];
+	assertTrue("rotate about a point", x > 9.99f && x < 10.01f && y > 4.99f && y < 5.01f);
+	svgFree(&image);
+}
+
+/** Things that aren't SVG. */
+static void testInvalid()
+{
+	svgImage image;
+	assertTrue("empty", !parse("", &image));
+	svgFree(&image);
+	assertTrue("not svg", !parse("<html><body/></html>", &image));
+	svgFree(&image);
+	assertTrue("no size", !parse("<svg><path d='M0,0L1,1'/></svg>", &image));
+	svgFree(&image);
+	assertTrue("unterminated tag", !parse("<svg viewBox='0 0 1 1'><path d='M0,0", &image));
+	svgFree(&image);
+	assertTrue("size from width and height", parse("<svg width='16px' height='8px'/>", &image));
+	assertTrue("size", image.viewWidth == 16 && image.viewHeight == 8);
+	svgFree(&image);
+
+	// Too deep.
+	char deep[SVG_MAX_DEPTH * 3 + 64] = "<svg viewBox='0 0 1 1'>";
+	for (int n = 0; n < SVG_MAX_DEPTH; n++) {
+		strcat(deep, "<g>");
+	}
+	assertTrue("too deep", !parse(deep, &image));
+	svgFree(&image);
+}
+
+/** Numbers too big to draw: ignored, rather than reaching the rasterizer. */
+static void testOutOfRange()
+{
+	svgImage image;
+	uint32_t pixels[8 * 8];
+
+	// Like the logo, with one number that's too big for a float: the path is drawn up to it.
+	assertTrue("too big", parse("<svg viewBox='0 0 8 8'><path d='M0,0h8v8.7E123h-8z'/>"
+		"<path d='M0,4H8V8H0z' fill='#fff'/></svg>", &image));
+	assertEquals("drawn up to it", 2, image.shapes[0].commandCount);
+	svgRender(&image, 8, pixels);
+	assertEquals("still rendered", 0xffffffff, pixels[6 * 8 + 2]);
+	svgFree(&image);
+
+	// Finite numbers, which aren't once they're transformed.
+	assertTrue("transformed", parse("<svg viewBox='0 0 8 8'><path transform='scale(1e30)' d='M0,0L1e10,0L1e10,1'/>"
+		"<g transform='scale(1e20) scale(1e20)'><path d='M0,0L1,0L1,1'/></g>"
+		"<path transform='scale(1e30)' d='M0,0h1v1h-1z' stroke='#fff' stroke-width='1e10'/></svg>", &image));
+	assertEquals("transform out of range", 2, image.shapeCount);
+	// What's left can't be drawn properly, but mustn't fault.
+	svgRender(&image, 8, pixels);
+	svgFree(&image);
+
+	assertTrue("viewBox", !parse("<svg viewBox='0 0 1e39 8'/>", &image));
+	svgFree(&image);
+	assertTrue("tiny viewBox", !parse("<svg viewBox='0 0 1e-45 1e-45'><path d='M0,0L1,1L0,1'/></svg>", &image));
+	svgFree(&image);
+}
+
+/** Coverage of simple shapes, which can be worked out exactly. */
+static void testCoverage()
+{
+	svgImage image;
+	uint32_t pixels[4 * 4];
+
+	// A square covering the middle of the image, and half of the pixels around it.
+	parse("<svg viewBox='0 0 4 4'><rect x='0.5' y='1' width='3' height='2' fill='#fff'/></svg>", &image);
+	svgRender(&image, 4, pixels);
+	assertEquals("outside", 0, pixels[0]);
+	assertEquals("inside", 0xffffffff, pixels[1 * 4 + 1]);
+	assertEquals("half covered", 0x80ffffff, pixels[1 * 4 + 0]);
+	assertEquals("half covered, right", 0x80ffffff, pixels[2 * 4 + 3]);
+	svgFree(&image);
+
+	// Even-odd leaves a hole; non-zero doesn't.
+	const char *hole = "<svg viewBox='0 0 4 4'><path fill-rule='%s' d='M0,0H4V4H0Z M1,1H3V3H1Z'/></svg>";
+	char text[256];
+	snprintf(text, sizeof(text), hole, "evenodd");
+	parse(text, &image);
+	svgRender(&image, 4, pixels);
+	assertEquals("even-odd outer", 0xff000000, pixels[0]);
+	assertEquals("even-odd hole", 0, pixels[1 * 4 + 1]);
+	svgFree(&image);
+	snprintf(text, sizeof(text), hole, "nonzero");
+	parse(text, &image);
+	svgRender(&image, 4, pixels);
+	assertEquals("non-zero filled", 0xff000000, pixels[1 * 4 + 1]);
+	svgFree(&image);
+
+	// A stroke along the middle of a row, half as wide as the row: each pixel is half covered; a butt cap ends it.
+	parse("<svg viewBox='0 0 4 4'><line x1='1' y1='1.5' x2='4' y2='1.5' stroke='#0000ff' stroke-width='0.5'/></svg>",
+		&image);
+	svgRender(&image, 4, pixels);
+	assertEquals("stroke", 0x800000ff, pixels[1 * 4 + 2]);
+	assertEquals("butt cap", 0, pixels[1 * 4 + 0]);
+	assertEquals("above", 0, pixels[0 * 4 + 2]);
+	svgFree(&image);
+
+	// The view box is kept square, and centred.
+	parse("<svg viewBox='0 0 4 2'><rect width='4' height='2' fill='#fff'/></svg>", &image);
+	svgRender(&image, 4, pixels);
+	assertEquals("above the image", 0, pixels[0]);
+	assertEquals("image", 0xffffffff, pixels[1 * 4]);
+	assertEquals("below the image", 0, pixels[3 * 4]);
+	svgFree(&image);
+
+	// Overlapping shapes blend.
+	parse("<svg viewBox='0 0 1 1'><rect width='1' height='1' fill='#f00'/>"
+		"<rect width='1' height='1' fill='#00f' fill-opacity='0.5'/></svg>", &image);
+	svgRender(&image, 1, pixels);
+	assertEquals("blended", 0xff7f0080, pixels[0]);
+	svgFree(&image);
+}
+
+/** gpii-app's SVG icons, against the reference images at the sizes of the tray icon. */
+static void testReferences()
+{
+	static const char *icons[] = { "TaskTrayIcon_outline", "Morphic-Logo-White" };
+	static const int32_t sizes[] = { 16, 20, 24, 32 };
+
+	for (size_t i = 0; i < sizeof(icons) / sizeof(icons[0]); i++) {
+		char path[1024];
+		size_t fileSize;
+		snprintf(path, sizeof(path), "%s/%s.svg", ICONS_DIR, icons[i]);
+		uint8_t *file = readFile(path, &fileSize);
+		svgImage image;
+		assertTrue("parsed", file && svgParse(file, fileSize, &image));
+
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+			int32_t size = sizes[s], width, height;
+			snprintf(path, sizeof(path), "%s/%s-%d.png", REFERENCE_DIR, icons[i], size);
+			uint32_t *reference = readPng(path, &width, &height);
+			assertTrue("reference image", reference != null);
+			if (!reference) {
+				continue;
+			}
+			assertEquals("reference size", size, width);
+
+			uint32_t *pixels = malloc((size_t)size * size * sizeof(uint32_t));
+			svgRender(&image, size, pixels);
+
+			// Compare the premultiplied colours, so the colour of nearly transparent pixels doesn't matter.
+			premultiplyPixels(pixels, (size_t)size * size);
+			premultiplyPixels(reference, (size_t)size * size);
+			int maxDiff = 0;
+			double total = 0;
+			for (int32_t n = 0; n < size * size; n++) {
+				for (int shift = 0; shift < 32; shift += 8) {
+					int diff = abs((int)((pixels[n] >> shift) & 0xff) - (int)((reference[n] >> shift) & 0xff));
+					maxDiff = diff > maxDiff ? diff : maxDiff;
+					total += diff;
+				}
+			}
+			double mean = total / (size * size * 4);
+			printf("  %s %d: max difference %d, mean %.3f\n", icons[i], size, maxDiff, mean);
+			assertTrue("close to the reference", maxDiff <= 16);
+			assertTrue("close to the reference on average", mean <= 1.0);
+
+			free(pixels);
+			free(reference);
+		}
+
+		svgFree(&image);
+		free(file);
+	}
+}
+
+/** Each size is drawn once, while it's one of the recently used ones. */
+static void testCache()
+{
+	svgIcon icon = { 0 };
+	parse("<svg viewBox='0 0 1 1'><rect width='1' height='1' fill='#fff'/></svg>", &icon.image);
+
+	const uint32_t *pixels16 = svgIconGet(&icon, 16);
+	assertTrue("drawn", pixels16 && pixels16[0] == 0xffffffff);
+	assertTrue("same pixels", svgIconGet(&icon, 16) == pixels16);
+	assertEquals("hit", 1, icon.hits);
+	assertEquals("rendered once", 1, icon.renders);
+
+	svgIconGet(&icon, 20);
+	svgIconGet(&icon, 24);
+	svgIconGet(&icon, 32);
+	svgIconGet(&icon, 16);
+	assertEquals("all kept", 4, icon.renders);
+
+	// A fifth size replaces the least recently used (20).
+	svgIconGet(&icon, 40);
+	svgIconGet(&icon, 16);
+	svgIconGet(&icon, 24);
+	assertEquals("still kept", 5, icon.renders);
+	svgIconGet(&icon, 20);
+	assertEquals("20 was dropped", 6, icon.renders);
+
+	svgIconFree(&icon);
+	assertTrue("freed", icon.sizes[0].pixels == null);
+}
+
+/** The rasterizer, on its own. */
+static void testRasterizer()
+{
+	rasterizer r;
+	uint8_t mask[4 * 4];
+	rasterInit(&r, 4, 4);
+
+	// A triangle: half of each pixel on the diagonal is covered.
+	rasterLine(&r, 0, 0, 4, 4);
+	rasterLine(&r, 4, 4, 0, 4);
+	rasterLine(&r, 0, 4, 0, 0);
+	rasterFill(&r, false, mask);
+	assertEquals("below the diagonal", 255, mask[3 * 4 + 0]);
+	assertEquals("above the diagonal", 0, mask[0 * 4 + 3]);
+	assertTrue("on the diagonal", mask[1 * 4 + 1] >= 126 && mask[1 * 4 + 1] <= 129);
+	assertEquals("edges used up", 0, r.edgeCount);
+
+	// Partly outside the image.
+	rasterLine(&r, -2, -2, 6, -2);
+	rasterLine(&r, 6, -2, 6, 2);
+	rasterLine(&r, 6, 2, -2, 2);
+	rasterLine(&r, -2, 2, -2, -2);
+	rasterFill(&r, false, mask);
+	assertEquals("clipped", 255, mask[1 * 4 + 3]);
+	assertEquals("below", 0, mask[2 * 4 + 0]);
+
+	// Edges that can't be drawn are dropped.
+	rasterLine(&r, NAN, 0, 2, 4);
+	rasterLine(&r, 0, INFINITY, 2, 4);
+	assertEquals("dropped", 0, r.edgeCount);
+	// A slope that's too steep for a float.
+	rasterLine(&r, 0, 0, 3e38f, 1e-38f);
+	rasterLine(&r, 3e38f, 1e-38f, 0, 4);
+	rasterLine(&r, 0, 4, 0, 0);
+	rasterFill(&r, false, mask);
+	assertEquals("steep", 255, mask[3 * 4 + 0]);
+
+	uint32_t pixels[2] = { 0xff0000ff, 0 };
+	uint8_t half[2] = { 128, 255 };
+	rasterBlend(pixels, half, 2, 0xffff0000);
+	assertEquals("half over", 0xff80007f, pixels[0]);
+	assertEquals("over nothing", 0xffff0000, pixels[1]);
+
+	rasterFree(&r);
+}
+
+/** Premultiplied to straight alpha. */
+static void testUnpremultiply()
+{
+	uint32_t pixels[] = { 0xffabcdef, 0x80804000, 0, 0x40808080 };
+	unpremultiplyPixels(pixels, 4);
+	assertEquals("opaque", 0xffabcdef, pixels[0]);
+	assertEquals("half", 0x80ff8000, pixels[1]);
+	assertEquals("transparent", 0, pixels[2]);
+	assertEquals("clamped", 0x40ffffff, pixels[3]);
+}
+
+int main()
+{
+	runTest(testStyles);
+	runTest(testPaths);
+	runTest(testTransforms);
+	runTest(testInvalid);
+	runTest(testOutOfRange);
+	runTest(testCoverage);
+	runTest(testReferences);
+	runTest(testCache);
+	runTest(testRasterizer);
+	runTest(testUnpremultiply);
+	return testResult();
+}
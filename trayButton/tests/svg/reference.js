@@ -0,0 +1,536 @@
+/**
+ * Makes the reference images for the SVG icon tests (svg-tests.c).
+ *
+ * This is deliberately a different way of drawing the icons to the button's own rasterizer (core/svg.c), so the two can
+ * be checked against each other: curves are split into many small lines, and each pixel is sampled at 16x16 points.
+ * A point is in a fill by counting the edges crossing its row, and in a stroke if it's within half the stroke width of
+ * a line (so joins and caps are round). Only what the referenced icons use is supported.
+ *
+ *   node reference.js
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+"use strict";
+
+var fs = require("fs");
+var path = require("path");
+var zlib = require("zlib");
+
+var iconsDir = path.join(__dirname, "../../../src/icons");
+var icons = ["TaskTrayIcon_outline", "Morphic-Logo-White"];
+var sizes = [16, 20, 24, 32];
+
+/** Samples per pixel, in each direction. */
+var SAMPLES = 16;
+/** Lines per curve. */
+var CURVE_STEPS = 64;
+
+/**
+ * Reads the attributes of a tag.
+ * @param {String} text - The text of the tag, after its name.
+ * @return {Object} The attributes.
+ */
+var readAttributes = function (text) {
+    var attributes = {};
+    var re = /([\w:.-]+)\s*=\s*("([^"]*)"|'([^']*)')/g;
+    var match;
+    while ((match = re.exec(text))) {
+        attributes[match[1]] = match[3] !== undefined ? match[3] : match[4];
+    }
+    return attributes;
+};
+
+/**
+ * Reads the class rules of the style sheets.
+ * @param {String} svg - The file.
+ * @return {Object} The declarations of each class.
+ */
+var readClasses = function (svg) {
+    var classes = {};
+    var styleRe = /<style[^>]*>([\s\S]*?)<\/style>/g;
+    var style;
+    while ((style = styleRe.exec(svg))) {
+        var ruleRe = /([^{}]+)\{([^}]*)\}/g;
+        var rule;
+        while ((rule = ruleRe.exec(style[1]))) {
+            rule[1].split(",").forEach(function (selector) {
+                var name = selector.trim().replace(/^<!\[CDATA\[\s*/, "");
+                if (/^\.[\w-]+$/.test(name)) {
+                    classes[name.substring(1)] = (classes[name.substring(1)] || "") + ";" + rule[2];
+                }
+            });
+        }
+    }
+    return classes;
+};
+
+var parseDeclarations = function (text, into) {
+    text.split(";").forEach(function (declaration) {
+        var colon = declaration.indexOf(":");
+        if (colon > 0) {
+            into[declaration.substring(0, colon).trim()] = declaration.substring(colon + 1).trim();
+        }
+    });
+};
+
+var parseColor = function (value) {
+    if (!value || value === "none") {
+        return null;
+    }
+    var hex = /^#([0-9a-f]{3}|[0-9a-f]{6})$/i.exec(value);
+    if (hex) {
+        var digits = hex[1].length === 3 ? hex[1].replace(/(.)/g, "$1$1") : hex[1];
+        return [0, 2, 4].map(function (n) {
+            return parseInt(digits.substr(n, 2), 16);
+        });
+    }
+    return { black: [0, 0, 0], white: [255, 255, 255] }[value] || null;
+};
+
+/** Multiplies two matrices [a, b, c, d, e, f]; n is applied first. */
+var multiply = function (m, n) {
+    return [
+        m[0] * n[0] + m[2] * n[1], m[1] * n[0] + m[3] * n[1],
+        m[0] * n[2] + m[2] * n[3], m[1] * n[2] + m[3] * n[3],
+        m[0] * n[4] + m[2] * n[5] + m[4], m[1] * n[4] + m[3] * n[5] + m[5]
+    ];
+};
+
+var parseTransform = function (text, matrix) {
+    var re = /(\w+)\s*\(([^)]*)\)/g;
+    var match;
+    while ((match = re.exec(text || ""))) {
+        var a = match[2].trim().split(/[\s,]+/).map(Number);
+        var t = {
+            matrix: a,
+            translate: [1, 0, 0, 1, a[0], a[1] || 0],
+            scale: [a[0], 0, 0, a.length > 1 ? a[1] : a[0], 0, 0]
+        }[match[1]];
+        if (t) {
+            matrix = multiply(matrix, t);
+        }
+    }
+    return matrix;
+};
+
+/**
+ * Splits path data into commands and numbers.
+ * @param {String} d - The path data.
+ * @return {Array} The tokens: command letters, and numbers.
+ */
+var tokenize = function (d) {
+    var tokens = [];
+    var re = /([MmLlHhVvCcSsQqTtAaZz])|([+-]?(\d+\.?\d*|\.\d+)([eE][+-]?\d+)?)/g;
+    var match;
+    while ((match = re.exec(d))) {
+        tokens.push(match[1] || Number(match[2]));
+    }
+    return tokens;
+};
+
+/**
+ * Turns path data into poly-lines.
+ * @param {String} d - The path data.
+ * @return {Array} The sub-paths: {points: [[x, y]...], closed}.
+ */
+var parsePath = function (d) {
+    var tokens = tokenize(d);
+    var paths = [], current = null;
+    var x = 0, y = 0, cx = 0, cy = 0, previous = "";
+    var i = 0, command = "";
+
+    var add = function (px, py) {
+        if (!current) {
+            current = { points: [[x, y]], closed: false };
+            paths.push(current);
+        }
+        current.points.push([px, py]);
+    };
+
+    var cubic = function (x1, y1, x2, y2, x3, y3) {
+        for (var n = 1; n <= CURVE_STEPS; n++) {
+            var t = n / CURVE_STEPS, u = 1 - t;
+            add(u * u * u * x + 3 * u * u * t * x1 + 3 * u * t * t * x2 + t * t * t * x3,
+                u * u * u * y + 3 * u * u * t * y1 + 3 * u * t * t * y2 + t * t * t * y3);
+        }
+    };
+
+    // The arc is sampled directly, around its centre.
+    var arc = function (rx, ry, angle, large, sweep, x2, y2) {
+        var phi = angle * Math.PI / 180, cos = Math.cos(phi), sin = Math.sin(phi);
+        var hx = (x - x2) / 2, hy = (y - y2) / 2;
+        var x1 = cos * hx + sin * hy, y1 = -sin * hx + cos * hy;
+        rx = Math.abs(rx);
+        ry = Math.abs(ry);
+        var lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+        if (lambda > 1) {
+            rx *= Math.sqrt(lambda);
+            ry *= Math.sqrt(lambda);
+        }
+        var num = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        var k = Math.sqrt(Math.max(0, num / (rx * rx * y1 * y1 + ry * ry * x1 * x1))) * (large === sweep ? -1 : 1);
+        var ccx = k * rx * y1 / ry, ccy = -k * ry * x1 / rx;
+        var centreX = cos * ccx - sin * ccy + (x + x2) / 2, centreY = sin * ccx + cos * ccy + (y + y2) / 2;
+        var start = Math.atan2((y1 - ccy) / ry, (x1 - ccx) / rx);
+        var end = Math.atan2((-y1 - ccy) / ry, (-x1 - ccx) / rx);
+        var delta = end - start;
+        if (sweep && delta < 0) {
+            delta += 2 * Math.PI;
+        } else if (!sweep && delta > 0) {
+            delta -= 2 * Math.PI;
+        }
+        for (var n = 1; n <= CURVE_STEPS; n++) {
+            var t = start + delta * n / CURVE_STEPS;
+            add(centreX + rx * Math.cos(t) * cos - ry * Math.sin(t) * sin,
+                centreY + rx * Math.cos(t) * sin + ry * Math.sin(t) * cos);
+        }
+    };
+
+    var next = function () {
+        return tokens[i++];
+    };
+
+    while (i < tokens.length) {
+        if (typeof tokens[i] === "string") {
+            command = next();
+        }
+        var rel = command === command.toLowerCase();
+        var dx = rel ? x : 0, dy = rel ? y : 0;
+        var upper = command.toUpperCase();
+        var a;
+        if (upper === "M") {
+            x = next() + dx;
+            y = next() + dy;
+            current = null;
+            add(x, y);
+            current.points.pop();
+            command = rel ? "l" : "L";
+        } else if (upper === "Z") {
+            if (current) {
+                current.closed = true;
+                x = current.points[0][0];
+                y = current.points[0][1];
+            }
+            current = null;
+        } else if (upper === "L") {
+            a = [next() + dx, next() + dy];
+            add(a[0], a[1]);
+            x = a[0];
+            y = a[1];
+        } else if (upper === "H") {
+            x = next() + dx;
+            add(x, y);
+        } else if (upper === "V") {
+            y = next() + dy;
+            add(x, y);
+        } else if (upper === "C" || upper === "S") {
+            if (upper === "C") {
+                a = [next() + dx, next() + dy];
+            } else {
+                a = /[CS]/.test(previous) ? [2 * x - cx, 2 * y - cy] : [x, y];
+            }
+            a.push(next() + dx, next() + dy, next() + dx, next() + dy);
+            cubic(a[0], a[1], a[2], a[3], a[4], a[5]);
+            cx = a[2];
+            cy = a[3];
+            x = a[4];
+            y = a[5];
+        } else if (upper === "Q" || upper === "T") {
+            if (upper === "Q") {
+                a = [next() + dx, next() + dy];
+            } else {
+                a = /[QT]/.test(previous) ? [2 * x - cx, 2 * y - cy] : [x, y];
+            }
+            a.push(next() + dx, next() + dy);
+            cubic(x + 2 / 3 * (a[0] - x), y + 2 / 3 * (a[1] - y), a[2] + 2 / 3 * (a[0] - a[2]),
+                a[3] + 2 / 3 * (a[1] - a[3]), a[2], a[3]);
+            cx = a[0];
+            cy = a[1];
+            x = a[2];
+            y = a[3];
+        } else if (upper === "A") {
+            a = [next(), next(), next(), next(), next(), next() + dx, next() + dy];
+            arc(a[0], a[1], a[2], !!a[3], !!a[4], a[5], a[6]);
+            x = a[5];
+            y = a[6];
+        } else {
+            throw new Error("Unsupported path command " + command);
+        }
+        previous = upper;
+    }
+    return paths;
+};
+
+var ellipse = function (cx, cy, rx, ry) {
+    var points = [];
+    for (var n = 0; n < CURVE_STEPS * 4; n++) {
+        var t = 2 * Math.PI * n / (CURVE_STEPS * 4);
+        points.push([cx + rx * Math.cos(t), cy + ry * Math.sin(t)]);
+    }
+    return [{ points: points, closed: true }];
+};
+
+/**
+ * Reads the shapes of an SVG file.
+ * @param {String} svg - The file.
+ * @return {Object} The view box, and the shapes: {paths, fill, stroke, strokeWidth, evenOdd}.
+ */
+var readSvg = function (svg) {
+    var classes = readClasses(svg);
+    var shapes = [], stack = [{ style: { fill: "#000" }, matrix: [1, 0, 0, 1, 0, 0] }], viewBox = null;
+    var tagRe = /<(\/?)([\w:-]+)([^>]*?)(\/?)>/g;
+    var tag;
+
+    svg = svg.replace(/<!--[\s\S]*?-->/g, "").replace(/<\?[\s\S]*?\?>/g, "");
+    while ((tag = tagRe.exec(svg))) {
+        if (tag[1]) {
+            stack.pop();
+            continue;
+        }
+        var name = tag[2], attributes = readAttributes(tag[3]);
+        var parent = stack[stack.length - 1];
+        var style = Object.assign({}, parent.style);
+        ["fill", "stroke", "stroke-width", "fill-rule"].forEach(function (property) {
+            if (attributes[property] !== undefined) {
+                style[property] = attributes[property];
+            }
+        });
+        (attributes["class"] || "").split(/\s+/).forEach(function (className) {
+            if (classes[className]) {
+                parseDeclarations(classes[className], style);
+            }
+        });
+        parseDeclarations(attributes.style || "", style);
+        var state = { style: style, matrix: parseTransform(attributes.transform, parent.matrix) };
+
+        if (name === "svg" && !viewBox) {
+            viewBox = attributes.viewBox.trim().split(/[\s,]+/).map(Number);
+        }
+
+        var number = function (attribute) {
+            return parseFloat(attributes[attribute] || "0");
+        };
+        var paths = null;
+        if (name === "path") {
+            paths = parsePath(attributes.d || "");
+        } else if (name === "circle") {
+            paths = ellipse(number("cx"), number("cy"), number("r"), number("r"));
+        } else if (name === "ellipse") {
+            paths = ellipse(number("cx"), number("cy"), number("rx"), number("ry"));
+        } else if (name === "polygon" || name === "polyline") {
+            var values = (attributes.points || "").trim().split(/[\s,]+/).map(Number), points = [];
+            for (var n = 0; n + 1 < values.length; n += 2) {
+                points.push([values[n], values[n + 1]]);
+            }
+            paths = [{ points: points, closed: name === "polygon" }];
+        } else if (name === "rect") {
+            var x = number("x"), y = number("y"), w = number("width"), h = number("height");
+            paths = [{ points: [[x, y], [x + w, y], [x + w, y + h], [x, y + h]], closed: true }];
+        }
+
+        if (paths) {
+            var m = state.matrix;
+            paths.forEach(function (p) {
+                p.points = p.points.map(function (pt) {
+                    return [m[0] * pt[0] + m[2] * pt[1] + m[4], m[1] * pt[0] + m[3] * pt[1] + m[5]];
+                });
+            });
+            shapes.push({
+                paths: paths,
+                fill: parseColor(style.fill),
+                stroke: parseColor(style.stroke),
+                strokeWidth: parseFloat(style["stroke-width"] || "1") * Math.sqrt(Math.abs(m[0] * m[3] - m[1] * m[2])),
+                evenOdd: style["fill-rule"] === "evenodd"
+            });
+        }
+
+        if (!tag[4]) {
+            stack.push(state);
+        }
+    }
+    return { viewBox: viewBox, shapes: shapes };
+};
+
+/** Marks the samples inside the paths (which are closed). */
+var sampleFill = function (paths, evenOdd, samples, count) {
+    var edges = [];
+    paths.forEach(function (p) {
+        for (var n = 0; n < p.points.length; n++) {
+            var a = p.points[n], b = p.points[(n + 1) % p.points.length];
+            if (a[1] !== b[1]) {
+                edges.push(a[1] < b[1] ? [a[0], a[1], b[0], b[1], 1] : [b[0], b[1], a[0], a[1], -1]);
+            }
+        }
+    });
+
+    for (var row = 0; row < count; row++) {
+        var sy = (row + 0.5) / SAMPLES;
+        var crossings = [];
+        edges.forEach(function (e) {
+            if (e[1] <= sy && sy < e[3]) {
+                crossings.push([e[0] + (sy - e[1]) * (e[2] - e[0]) / (e[3] - e[1]), e[4]]);
+            }
+        });
+        crossings.sort(function (a, b) {
+            return a[0] - b[0];
+        });
+        var winding = 0, c = 0;
+        for (var column = 0; column < count; column++) {
+            var sx = (column + 0.5) / SAMPLES;
+            while (c < crossings.length && crossings[c][0] <= sx) {
+                winding += crossings[c++][1];
+            }
+            samples[row * count + column] = evenOdd ? winding & 1 : winding !== 0;
+        }
+    }
+};
+
+/** Marks the samples within half the width of any line of the paths. */
+var sampleStroke = function (paths, halfWidth, samples, count) {
+    paths.forEach(function (p) {
+        var lines = p.closed ? p.points.length : p.points.length - 1;
+        for (var n = 0; n < lines; n++) {
+            var a = p.points[n], b = p.points[(n + 1) % p.points.length];
+            var dx = b[0] - a[0], dy = b[1] - a[1], lengthSquared = dx * dx + dy * dy;
+            var left = Math.max(0, Math.floor((Math.min(a[0], b[0]) - halfWidth) * SAMPLES));
+            var right = Math.min(count - 1, Math.ceil((Math.max(a[0], b[0]) + halfWidth) * SAMPLES));
+            var top = Math.max(0, Math.floor((Math.min(a[1], b[1]) - halfWidth) * SAMPLES));
+            var bottom = Math.min(count - 1, Math.ceil((Math.max(a[1], b[1]) + halfWidth) * SAMPLES));
+            for (var row = top; row <= bottom; row++) {
+                for (var column = left; column <= right; column++) {
+                    var sx = (column + 0.5) / SAMPLES - a[0], sy = (row + 0.5) / SAMPLES - a[1];
+                    var t = lengthSquared ? Math.max(0, Math.min(1, (sx * dx + sy * dy) / lengthSquared)) : 0;
+                    var ex = sx - t * dx, ey = sy - t * dy;
+                    if (ex * ex + ey * ey <= halfWidth * halfWidth) {
+                        samples[row * count + column] = 1;
+                    }
+                }
+            }
+        }
+    });
+};
+
+/**
+ * Draws an image into a square, centred.
+ * @param {Object} image - The image, from readSvg.
+ * @param {Number} size - The size of the square.
+ * @return {Buffer} The RGBA pixels, not premultiplied.
+ */
+var render = function (image, size) {
+    var vb = image.viewBox;
+    var scale = Math.min(size / vb[2], size / vb[3]);
+    var offsetX = (size - vb[2] * scale) / 2 - vb[0] * scale, offsetY = (size - vb[3] * scale) / 2 - vb[1] * scale;
+    var count = size * SAMPLES;
+    var premultiplied = new Float64Array(size * size * 4);
+
+    var paint = function (samples, color) {
+        for (var pixel = 0; pixel < size * size; pixel++) {
+            var px = pixel % size, py = Math.floor(pixel / size), covered = 0;
+            for (var sy = 0; sy < SAMPLES; sy++) {
+                for (var sx = 0; sx < SAMPLES; sx++) {
+                    covered += samples[(py * SAMPLES + sy) * count + px * SAMPLES + sx] ? 1 : 0;
+                }
+            }
+            var alpha = covered / (SAMPLES * SAMPLES);
+            for (var c = 0; c < 4; c++) {
+                var value = c < 3 ? color[c] / 255 : 1;
+                premultiplied[pixel * 4 + c] = value * alpha + premultiplied[pixel * 4 + c] * (1 - alpha);
+            }
+        }
+    };
+
+    image.shapes.forEach(function (shape) {
+        var paths = shape.paths.map(function (p) {
+            return {
+                closed: p.closed,
+                points: p.points.map(function (pt) {
+                    return [pt[0] * scale + offsetX, pt[1] * scale + offsetY];
+                })
+            };
+        });
+        if (shape.fill) {
+            var fill = new Uint8Array(count * count);
+            sampleFill(paths, shape.evenOdd, fill, count);
+            paint(fill, shape.fill);
+        }
+        if (shape.stroke && shape.strokeWidth > 0) {
+            var stroke = new Uint8Array(count * count);
+            sampleStroke(paths, shape.strokeWidth * scale / 2, stroke, count);
+            paint(stroke, shape.stroke);
+        }
+    });
+
+    var rgba = Buffer.alloc(size * size * 4);
+    for (var pixel = 0; pixel < size * size; pixel++) {
+        var a = premultiplied[pixel * 4 + 3];
+        for (var c = 0; c < 3; c++) {
+            rgba[pixel * 4 + c] = a ? Math.round(premultiplied[pixel * 4 + c] / a * 255) : 0;
+        }
+        rgba[pixel * 4 + 3] = Math.round(a * 255);
+    }
+    return rgba;
+};
+
+var crcTable = [];
+for (var n = 0; n < 256; n++) {
+    var c = n;
+    for (var k = 0; k < 8; k++) {
+        c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+    }
+    crcTable[n] = c >>> 0;
+}
+
+var crc32 = function (buffer) {
+    var crc = 0xffffffff;
+    for (var i = 0; i < buffer.length; i++) {
+        crc = crcTable[(crc ^ buffer[i]) & 0xff] ^ (crc >>> 8);
+    }
+    return (crc ^ 0xffffffff) >>> 0;
+};
+
+var chunk = function (type, data) {
+    var length = Buffer.alloc(4), crc = Buffer.alloc(4);
+    var body = Buffer.concat([Buffer.from(type, "ascii"), data]);
+    length.writeUInt32BE(data.length);
+    crc.writeUInt32BE(crc32(body));
+    return Buffer.concat([length, body, crc]);
+};
+
+/**
+ * Makes an 8-bit RGBA PNG file. The image data isn't compressed (zlib level 0), so the test can read it easily.
+ * @param {Number} size - The width and height.
+ * @param {Buffer} rgba - The pixels.
+ * @return {Buffer} The file.
+ */
+var png = function (size, rgba) {
+    var header = Buffer.alloc(13);
+    header.writeUInt32BE(size, 0);
+    header.writeUInt32BE(size, 4);
+    header[8] = 8;
+    header[9] = 6;
+    var raw = Buffer.alloc(size * (size * 4 + 1));
+    for (var y = 0; y < size; y++) {
+        rgba.copy(raw, y * (size * 4 + 1) + 1, y * size * 4, (y + 1) * size * 4);
+    }
+    return Buffer.concat([
+        Buffer.from([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a]),
+        chunk("IHDR", header),
+        chunk("IDAT", zlib.deflateSync(raw, { level: 0 })),
+        chunk("IEND", Buffer.alloc(0))
+    ]);
+};
+
+icons.forEach(function (icon) {
+    var image = readSvg(fs.readFileSync(path.join(iconsDir, icon + ".svg"), "utf8"));
+    sizes.forEach(function (size) {
+        var file = path.join(__dirname, icon + "-" + size + ".png");
+        fs.writeFileSync(file, png(size, render(image, size)));
+        console.log(file);
+    });
+});
@@ -0,0 +1,47 @@
+/* Task tray button - unit tests.
+ * A minimal test harness for the platform-neutral core.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_TEST_H
+#define TRAY_BUTTON_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int testFailures = 0;
+static int testAssertions = 0;
+
+#define assertTrue(MSG, COND) do { \
+	testAssertions++; \
+	if (!(COND)) { \
+		testFailures++; \
+		printf("FAIL %s:%d: %s (%s)\n", __FILE__, __LINE__, MSG, #COND); \
+	} \
+} while (0)
+
+#define assertEquals(MSG, EXPECTED, ACTUAL) do { \
+	long long e_ = (long long)(EXPECTED), a_ = (long long)(ACTUAL); \
+	testAssertions++; \
+	if (e_ != a_) { \
+		testFailures++; \
+		printf("FAIL %s:%d: %s (expected %lld, got %lld)\n", __FILE__, __LINE__, MSG, e_, a_); \
+	} \
+} while (0)
+
+#define runTest(FN) do { \
+	printf("%s\n", #FN); \
+	FN(); \
+} while (0)
+
+/** Call at the end of main() */
+#define testResult() (printf("%d assertions, %d failures\n", testAssertions, testFailures), testFailures ? 1 : 0)
+
+#endif /* TRAY_BUTTON_TEST_H */
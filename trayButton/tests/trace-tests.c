@@ -0,0 +1,148 @@
+/* Task tray button - unit tests.
+ * Parsing and formatting of traces.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/trace.h"
+
+/** Every type of event survives formatting and parsing. */
+static void testRoundTrip()
+{
+	for (uint32_t type = TRACE_SHELL; type <= TRACE_EXPECT; type++) {
+		traceEvent event = { 0 };
+		event.time = 1234567890123ull + type;
+		event.type = type;
+		if (type == TRACE_GEOMETRY) {
+			event.geometry.trayRect = (coreRect) { -1920, 1040, 0, 1080 };
+			event.geometry.trayClient = (coreRect) { 0, 0, 1920, 40 };
+			event.geometry.tasksRect = (coreRect) { -1820, 1040, -150, 1080 };
+			event.geometry.notifyRect = (coreRect) { -150, 1040, 0, 1080 };
+			event.geometry.screenHeight = 1017;
+		} else if (type == TRACE_DPI) {
+			event.value = 144;
+		} else if (type == TRACE_CONTRAST) {
+			event.value = 1;
+		} else if (type == TRACE_EXPECT) {
+			strcpy(event.name, "setWindowPos");
+			event.value = 42;
+		}
+
+		char line[TRACE_LINE_LENGTH];
+		size_t length = traceFormat(&event, line, sizeof(line));
+		assertTrue("formatted", length > 0);
+		assertEquals("length", strlen(line), length);
+		assertTrue("starts with the time", strncmp(line, "1234567890", 10) == 0);
+		assertTrue("has the type name", strstr(line, traceTypeName(type)) != null);
+
+		traceEvent parsed;
+		assertEquals("parsed", TRACE_LINE_EVENT, traceParse(line, &parsed));
+		assertEquals("time", event.time, parsed.time);
+		assertEquals("type", event.type, parsed.type);
+		assertEquals("value", event.value, parsed.value);
+		assertTrue("name", strcmp(event.name, parsed.name) == 0);
+		assertTrue("geometry", memcmp(&event.geometry, &parsed.geometry, sizeof(event.geometry)) == 0);
+	}
+}
+
+/** Lines from the log, blank lines, and comments. */
+static void testLines()
+{
+	traceEvent event;
+
+	assertEquals("blank", TRACE_LINE_NONE, traceParse("", &event));
+	assertEquals("white space", TRACE_LINE_NONE, traceParse("  \t\r\n", &event));
+	assertEquals("comment", TRACE_LINE_NONE, traceParse("# a comment", &event));
+	assertEquals("indented comment", TRACE_LINE_NONE, traceParse("   # 100 shell", &event));
+
+	assertEquals("new-line", TRACE_LINE_EVENT, traceParse("100 shell\r\n", &event));
+	assertEquals("type", TRACE_SHELL, event.type);
+	assertEquals("time", 100, event.time);
+
+	assertEquals("log line", TRACE_LINE_EVENT, traceParse("12:00:01 trace: 250 dpi 120", &event));
+	assertEquals("log type", TRACE_DPI, event.type);
+	assertEquals("log value", 120, event.value);
+	assertEquals("log time", 250, event.time);
+
+	assertEquals("extra spaces", TRACE_LINE_EVENT, traceParse("  5   contrast   0  ", &event));
+	assertEquals("contrast", 0, event.value);
+}
+
+/** Bad lines are rejected. */
+static void testErrors()
+{
+	static const char *bad[] = {
+		"shell",
+		"-1 shell",
+		"10",
+		"10 unknown",
+		"10 shell extra",
+		"10x shell",
+		"10 dpi",
+		"10 dpi 0",
+		"10 dpi -96",
+		"10 dpi 96x",
+		"10 dpi 4294967296",
+		"10 contrast 2",
+		"10 expect redraws",
+		"10 expect redraws -1",
+		"10 expect a-name-which-is-far-too-long-to-fit 1",
+		"10 geometry 1 2 3 4",
+		"10 geometry 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0",
+		"10 geometry 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0",
+		"10 geometry 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 2147483648",
+		"99999999999999999999 shell"
+	};
+
+	for (size_t n = 0; n < sizeof(bad) / sizeof(bad[0]); n++) {
+		traceEvent event;
+		int result = traceParse(bad[n], &event);
+		if (result != TRACE_LINE_ERROR) {
+			printf("  accepted: %s\n", bad[n]);
+		}
+		assertEquals("rejected", TRACE_LINE_ERROR, result);
+	}
+
+	traceEvent event;
+	assertEquals("negative coordinates", TRACE_LINE_EVENT,
+		traceParse("10 geometry 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 -2147483648", &event));
+	assertEquals("screenHeight", INT32_MIN, event.geometry.screenHeight);
+}
+
+/** Formatting doesn't overflow the buffer. */
+static void testFormatLimits()
+{
+	traceEvent event = { 0 };
+	char line[8];
+
+	event.type = TRACE_SHELL;
+	event.time = 1000000;
+	assertEquals("too small", 0, traceFormat(&event, line, sizeof(line)));
+	assertEquals("terminated", 0, line[0]);
+
+	event.time = 1;
+	assertEquals("just fits", 7, traceFormat(&event, line, sizeof(line)));
+	assertTrue("formatted", strcmp(line, "1 shell") == 0);
+
+	event.type = 0;
+	assertEquals("unknown type", 0, traceFormat(&event, line, sizeof(line)));
+	event.type = TRACE_EXPECT + 1;
+	assertEquals("unknown type", 0, traceFormat(&event, line, sizeof(line)));
+	assertTrue("no name", traceTypeName(TRACE_EXPECT + 1) == null);
+}
+
+int main()
+{
+	runTest(testRoundTrip);
+	runTest(testLines);
+	runTest(testErrors);
+	runTest(testFormatLimits);
+	return testResult();
+}
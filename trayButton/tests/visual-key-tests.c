@@ -0,0 +1,93 @@
+/* Task tray button - unit tests.
+ * Tests for the visual key, which decides if a redraw is needed.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/visual-key.h"
+
+#define FOREGROUND 0x00ffffff
+#define BACKGROUND 0x00000000
+
+/** Only the states that are drawn in each mode matter. */
+static void testVisualState()
+{
+	assertEquals("normal", 0, visualState(STATE_NORMAL, false));
+	assertEquals("hover", STATE_HOVER, visualState(STATE_NORMAL | STATE_HOVER, false));
+	assertEquals("pressed wins", STATE_PRESSED, visualState(STATE_HOVER | STATE_PRESSED, false));
+	assertEquals("checked isn't drawn", 0, visualState(STATE_NORMAL | STATE_CHECKED, false));
+
+	assertEquals("hc checked", STATE_CHECKED, visualState(STATE_NORMAL | STATE_CHECKED, true));
+	assertEquals("hc hover", STATE_HOVER | STATE_CHECKED, visualState(STATE_HOVER | STATE_CHECKED, true));
+	assertEquals("hc pressed isn't drawn", 0, visualState(STATE_NORMAL | STATE_PRESSED, true));
+}
+
+/** The same appearance skips the redraw; anything that changes it doesn't. */
+static void testRedrawNeeded()
+{
+	visualTracker tracker = { 0 };
+	visualKey key, other;
+
+	visualKeyInit(&key, STATE_NORMAL, false, 1234, 16, 24, 40, FOREGROUND, BACKGROUND);
+	assertTrue("first frame", visualRedrawNeeded(&tracker, &key));
+	assertTrue("same frame", !visualRedrawNeeded(&tracker, &key));
+
+	// Changes that aren't visible
+	visualKeyInit(&other, STATE_NORMAL | STATE_CHECKED, false, 1234, 16, 24, 40, 0x123456, 0x654321);
+	assertTrue("checked and colours not drawn", !visualRedrawNeeded(&tracker, &other));
+	visualKeyInit(&other, STATE_NORMAL, false, 0, 16, 24, 40, 0, 0);
+	visualKeyInit(&key, STATE_NORMAL, false, 0, 20, 24, 40, 0, 0);
+	assertTrue("no icon", visualRedrawNeeded(&tracker, &other));
+	assertTrue("no icon, any size", !visualRedrawNeeded(&tracker, &key));
+
+	// Changes that are
+	visualKeyInit(&key, STATE_NORMAL, false, 1234, 16, 24, 40, 0, 0);
+	assertTrue("icon", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_NORMAL, false, 1234, 20, 24, 40, 0, 0);
+	assertTrue("icon size", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_NORMAL, false, 1234, 20, 30, 40, 0, 0);
+	assertTrue("width", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_NORMAL, false, 1234, 20, 30, 48, 0, 0);
+	assertTrue("height", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_HOVER, false, 1234, 20, 30, 48, 0, 0);
+	assertTrue("hover", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_HOVER, true, 1234, 20, 30, 48, FOREGROUND, BACKGROUND);
+	assertTrue("high-contrast", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_HOVER, true, 1234, 20, 30, 48, FOREGROUND, 0x0000ff);
+	assertTrue("colour", visualRedrawNeeded(&tracker, &key));
+	visualKeyInit(&key, STATE_HOVER | STATE_CHECKED, true, 1234, 20, 30, 48, FOREGROUND, 0x0000ff);
+	assertTrue("hc checked", visualRedrawNeeded(&tracker, &key));
+
+	assertEquals("performed counted", 10, tracker.performed);
+	assertEquals("skipped counted", 3, tracker.skipped);
+}
+
+/** Painting records the frame; invalidating forgets it. */
+static void testPaintedInvalidate()
+{
+	visualTracker tracker = { 0 };
+	visualKey key;
+	visualKeyInit(&key, STATE_NORMAL, false, 1, 16, 24, 40, 0, 0);
+
+	visualPainted(&tracker, &key);
+	assertTrue("already painted", !visualRedrawNeeded(&tracker, &key));
+
+	visualInvalidate(&tracker);
+	assertTrue("invalidated", visualRedrawNeeded(&tracker, &key));
+	assertTrue("then skipped", !visualRedrawNeeded(&tracker, &key));
+}
+
+int main()
+{
+	runTest(testVisualState);
+	runTest(testRedrawNeeded);
+	runTest(testPaintedInvalidate);
+	return testResult();
+}
@@ -0,0 +1,171 @@
+/* Task tray button - unit tests.
+ * The taskbar window cache, with a stand-in window system.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#include "test.h"
+#include "../core/window-cache.h"
+
+#define MAX_WINDOWS 16
+
+/** A window system, where a handle is an index into the window table (plus one). */
+typedef struct {
+	struct {
+		bool alive;
+		uint32_t which;
+		uintptr_t parent;
+	} windows[MAX_WINDOWS];
+	uint32_t count;
+	uint32_t finds, isWindows;
+} fakeSystem;
+
+static windowHandle fakeFind(void *context, windowHandle parent, uint32_t which)
+{
+	fakeSystem *fake = (fakeSystem*)context;
+	fake->finds++;
+	for (uint32_t n = 0; n < fake->count; n++) {
+		if (fake->windows[n].alive && fake->windows[n].which == which
+			&& fake->windows[n].parent == (uintptr_t)parent) {
+			return (windowHandle)(uintptr_t)(n + 1);
+		}
+	}
+	return null;
+}
+
+static bool fakeIsWindow(void *context, windowHandle window)
+{
+	fakeSystem *fake = (fakeSystem*)context;
+	uintptr_t n = (uintptr_t)window;
+	fake->isWindows++;
+	return n > 0 && n <= fake->count && fake->windows[n - 1].alive;
+}
+
+/** Creates a window. */
+static windowHandle fakeCreate(fakeSystem *fake, uint32_t which, windowHandle parent)
+{
+	uint32_t n = fake->count++;
+	fake->windows[n].alive = true;
+	fake->windows[n].which = which;
+	fake->windows[n].parent = (uintptr_t)parent;
+	return (windowHandle)(uintptr_t)(n + 1);
+}
+
+static void fakeDestroy(fakeSystem *fake, windowHandle window)
+{
+	fake->windows[(uintptr_t)window - 1].alive = false;
+}
+
+/** Starts explorer. */
+static windowHandle fakeTaskbar(fakeSystem *fake)
+{
+	windowHandle tray = fakeCreate(fake, WINDOW_TRAY, null);
+	fakeCreate(fake, WINDOW_TASKS, tray);
+	fakeCreate(fake, WINDOW_NOTIFY, tray);
+	return tray;
+}
+
+static void initCache(windowCache *cache, fakeSystem *fake)
+{
+	windowSystem system = { fakeFind, fakeIsWindow, fake };
+	memset(fake, 0, sizeof(*fake));
+	windowCacheInit(cache, &system);
+}
+
+/** The windows are searched for once, then validated. */
+static void testCached()
+{
+	fakeSystem fake;
+	windowCache cache;
+	initCache(&cache, &fake);
+	windowHandle tray = fakeTaskbar(&fake);
+
+	assertTrue("tray", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+	assertEquals("all searched for", 3, fake.finds);
+	assertEquals("one lookup", 1, cache.lookups);
+
+	for (int n = 0; n < 1000; n++) {
+		assertTrue("tray", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+		assertTrue("tasks", fakeIsWindow(&fake, windowCacheGet(&cache, WINDOW_TASKS)));
+		assertTrue("notify", fakeIsWindow(&fake, windowCacheGet(&cache, WINDOW_NOTIFY)));
+	}
+	assertEquals("no more searches", 3, fake.finds);
+	assertEquals("still one lookup", 1, cache.lookups);
+	assertEquals("hits", 3000, cache.hits);
+
+	assertTrue("unknown window", windowCacheGet(&cache, WINDOW_COUNT) == null);
+}
+
+/** A window which is destroyed is found again. */
+static void testDestroyed()
+{
+	fakeSystem fake;
+	windowCache cache;
+	initCache(&cache, &fake);
+	windowHandle tray = fakeTaskbar(&fake);
+
+	windowHandle tasks = windowCacheGet(&cache, WINDOW_TASKS);
+	fakeDestroy(&fake, tasks);
+	windowHandle newTasks = fakeCreate(&fake, WINDOW_TASKS, tray);
+
+	assertTrue("new task list", windowCacheGet(&cache, WINDOW_TASKS) == newTasks);
+	assertEquals("searched again", 2, cache.lookups);
+	assertTrue("same tray", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+	assertEquals("no more lookups", 2, cache.lookups);
+}
+
+/** Explorer restarts; the old handle is re-used by something else, which IsWindow can't tell. */
+static void testRecreated()
+{
+	fakeSystem fake;
+	windowCache cache;
+	initCache(&cache, &fake);
+	fakeTaskbar(&fake);
+
+	windowHandle tray = windowCacheGet(&cache, WINDOW_TRAY);
+	windowHandle notify = windowCacheGet(&cache, WINDOW_NOTIFY);
+	// Make the old windows look like something else.
+	fake.windows[(uintptr_t)tray - 1].which = WINDOW_COUNT;
+	fake.windows[(uintptr_t)notify - 1].which = WINDOW_COUNT;
+	windowHandle newTray = fakeTaskbar(&fake);
+
+	assertTrue("stale without invalidation", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+
+	windowCacheInvalidate(&cache);
+	assertTrue("new tray", windowCacheGet(&cache, WINDOW_TRAY) == newTray);
+	assertTrue("new notification icons", windowCacheGet(&cache, WINDOW_NOTIFY) != notify);
+	assertEquals("invalidated", 1, cache.invalidations);
+	assertEquals("two lookups", 2, cache.lookups);
+}
+
+/** Without a taskbar, it's searched for each time, until there is one. */
+static void testNoTaskbar()
+{
+	fakeSystem fake;
+	windowCache cache;
+	initCache(&cache, &fake);
+
+	assertTrue("no tray", windowCacheGet(&cache, WINDOW_TRAY) == null);
+	assertTrue("no tasks", windowCacheGet(&cache, WINDOW_TASKS) == null);
+	assertEquals("only the tray is searched for", 2, fake.finds);
+
+	windowHandle tray = fakeTaskbar(&fake);
+	assertTrue("tray", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+	assertTrue("cached", windowCacheGet(&cache, WINDOW_TRAY) == tray);
+	assertEquals("found", 5, fake.finds);
+}
+
+int main()
+{
+	runTest(testCached);
+	runTest(testDestroyed);
+	runTest(testRecreated);
+	runTest(testNoTaskbar);
+	return testResult();
+}
@@ -22,9 +22,38 @@
 #include <Windows.h>
 #include <uxtheme.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <WinBase.h>
 #include <shlwapi.h>
 
+#include "core/common.h"
+#include "core/animation.h"
+#include "core/atlas.h"
+#include "core/atomics.h"
+#include "core/batch.h"
+#include "core/button.h"
+#include "core/button-set.h"
+#include "core/frame.h"
+#include "core/frame-cache.h"
+#include "core/host.h"
+#include "core/icon-cache.h"
+#include "core/icon-loader.h"
+#include "core/layout.h"
+#include "core/log-ring.h"
+#include "core/metrics.h"
+#include "core/pixels.h"
+#include "core/recolor.h"
+#include "core/render-set.h"
+#include "core/solid-pool.h"
+#include "core/span.h"
+#include "core/startup.h"
+#include "core/state-snapshot.h"
+#include "core/svg.h"
+#include "core/trace.h"
+#include "core/visual-key.h"
+#include "core/window-cache.h"
+#include "tray-button.h"
+
 #pragma comment (lib, "User32.lib")
 #pragma comment (lib, "Kernel32.lib")
 #pragma comment (lib, "gdi32.lib")
@@ -33,130 +62,656 @@
 #pragma comment (lib, "Shlwapi.lib")
 
 #define BUTTON_CLASS L"GPII-TrayButton"
+#define WATCHER_CLASS L"GPII-TrayButton-Watcher"
 #define GPII_CLASS L"gpii-message-window"
 #define BUTTON_MESSAGE L"GPII-TrayButton-Message"
 #define BUTTON_POSITION_MESSAGE L"GPII-TrayButtonPos-Message"
+/** Names the pipe to gpii, if it has one (otherwise, window messages are used) */
+#define PIPE_VARIABLE L"GPII_TRAY_BUTTON_PIPE"
+/** Posted to the watcher window by the pipe reader; lParam is a pipeFrame, or null when the pipe has closed. */
+#define WM_PIPE_FRAME (WM_APP + 1)
+/** Posted by the icon decoder, when an icon has been decoded */
+#define WM_ICON_READY (WM_APP + 2)
 
-// Commands sent from GPII
-#define GPII_COMMAND_ICON    1
-#define GPII_COMMAND_ICON_HC 2
-#define GPII_COMMAND_TOOLTIP  3
-#define GPII_COMMAND_DESTROY  4
-#define GPII_COMMAND_STATE    5
-
-// Notifications sent to GPII
-#define GPII_MSG_UPDATE     0
-#define GPII_MSG_CLICK      1
-#define GPII_MSG_SHOWMENU   2
-#define GPII_MSG_MOUSEENTER 3
-#define GPII_MSG_MOUSELEAVE 4
-
-#define true TRUE
-#define false FALSE
-#define null NULL
+// The commands sent from gpii, and the notifications sent to it, are HOST_COMMAND_* and HOST_EVENT_* (core/host.h).
 
 #define ICON_SIZE 16
 #define BUTTON_WIDTH 24
 
-// Button states
-#define STATE_NORMAL  1
-#define STATE_HOVER   2
-#define STATE_PRESSED 4
-#define STATE_CHECKED 8
-
-/** Current state of the button */
+/** A button, on one of the taskbars. */
+typedef struct {
+	/** The button logic's view of this button's taskbar (first, so the platform functions can get the instance) */
+	buttonPlatform platform;
+	/** The button's logic, and state */
+	trayButton button;
+	/** The taskbar it's on, and that taskbar's windows */
+	HWND taskbar;
+	windowCache windows;
+	/** It's on the primary taskbar: the one that's traced, and whose position gpii is told about */
+	BOOL primary;
+	HWND window;
+	HWND tooltipWindow;
+	/** Hover and pressed states of this button (STATE_CHECKED is in buttonState, for all of them) */
+	int state;
+	/** What the button looked like last time it was painted */
+	visualTracker visuals;
+	/** The icon and frames for the size of this button, shared with the buttons of the same size */
+	renderIcon *icon;
+	renderAtlas *atlas;
+	int iconSize;
+	/** Identifies the version of the icon file, for finding its saved frames */
+	uint32_t iconSource;
+	/** The icon hasn't been decoded yet, because its frames were saved by an earlier run */
+	BOOL iconDeferred;
+	/** The icon being decoded, to be shown instead of the current one when it's ready (null if there's none) */
+	renderIcon *loading;
+	uint32_t loadingSource;
+} win32Button;
+
+/** Gets the button of a platform (the platform is the first member). */
+#define getInstance(P) ((win32Button*)(P))
+/** Gets the button of the button logic. */
+#define getButton(B) getInstance((B)->platform)
+
+/** The buttons, one on each taskbar */
+buttonSet buttons = { 0 };
+/** The atlases and icons, for each size of button */
+renderSet render = { 0 };
+/** The button gpii was last told the position of (null for the primary one) */
+win32Button *activeButton = null;
+/** true while the buttons are being removed; destroying the primary one doesn't end the message loop. */
+BOOL clearingButtons = false;
+/** Error from the last button window that couldn't be created */
+DWORD createError = 0;
+
+/** STATE_CHECKED, if the button is checked */
 int buttonState = STATE_NORMAL;
-/** last known window sizes */
-RECT taskRect = { 0 }, notifyRect = { 0 }, trayClient = { 0 }, windowRect = { 0 };
 
-HWND buttonWindow = null;
-HWND tooltipWindow = null;
-
-BOOL highContrast = false;
-UINT currentDpi = 0;
-int iconSize = ICON_SIZE;
-
-/** The icon of the button */
-HICON hIcon = null;
 WCHAR *iconFile = null;
-/** The icon used for high-contrast */
-WCHAR *iconFileHC = null;
+/** The icon files that have been read */
+iconCache iconFiles = { 0 };
+/** The SVG rendition of the icon that has been read (if vectorFile is set), and the sizes it's been drawn at */
+svgIcon vectorIcon = { 0 };
+WCHAR *vectorFile = null;
+BOOL vectorLoaded = false;
+
+/**
+ * The icons being decoded by the decoder thread (see core/icon-loader.h). While it's running, the thread is the only
+ * user of iconFiles and vectorIcon.
+ */
+iconLoader iconLoading = { 0 };
+/** Signalled when there are icons to decode */
+HANDLE iconEvent = null;
+HANDLE iconThread = null;
+/** Set (atomically) to stop the decoder thread */
+volatile uint32_t iconStopping = 0;
+
+/** The frames rendered by earlier runs (see core/frame-cache.h), from the file mapped read-only */
+frameCache savedFrames = { 0 };
+void *savedFramesView = null;
+/** The next version of the file: the frames in the mapped file, and those rendered since */
+frameCacheWriter newFrames = { 0 };
+BOOL newFramesAdded = false;
+
+/** The snapshot of the state (see core/state-snapshot.h), in the file mapped read-write; null if there's no file */
+void *stateView = null;
+/** The state last restored or saved */
+stateSnapshot lastState = { 0 };
+BOOL haveLastState = false;
+
+/** The atlas surface */
+typedef struct {
+	HDC dc;
+	HBITMAP bitmap;
+	HBITMAP original;
+	uint32_t *pixels;
+} atlasSurface;
+/** Blend table for the most recent high-contrast colours */
+recolorTable hcColors = { 0 };
+
+/** The animation being played (see core/animation.h), and its ID (0 if there's none) */
+animationSpec animation = { 0 };
+uint32_t animationId = 0;
+/** Which frame of the animation is shown; the same for every button, so one timer drives them all */
+frameScheduler animationFrames = { 0 };
+/** The animation's frames, rendered for each size of button */
+animationStrip animationStrips[RENDER_SLOTS] = { 0 };
+/** The strip to re-use next, when they're all for the current animation */
+uint32_t nextStrip = 0;
+/** Where a frame of the animation is composed, before it's painted */
+atlasSurface *frameSurface = null;
+int frameSurfaceWidth = 0, frameSurfaceHeight = 0;
+
+/** An animation frame is shown instead of the icon */
+#define isAnimating() (animationId && animationFrames.frame >= 0)
+/** A button shows the animation frame, once the frames for its icon size have been decoded (until then, its icon) */
+#define isAnimatingButton(I) (isAnimating() && findAnimationStrip((I)->iconSize))
+
+animationStrip *findAnimationStrip(int size);
 
 /** WM_SHELLHOOKMESSAGE */
 UINT shellMessage = 0;
 UINT gpiiMessage = 0;
 UINT gpiiPositionMessage = 0;
 HANDLE gpiiWindow = null;
+/** The pipe to gpii, when it's connected */
+HANDLE gpiiPipe = null;
 
 /** true if the button destruction is intentional */
 BOOL die = false;
 
-#define log(FMT, ...) {wprintf(L ## FMT L"\n", __VA_ARGS__); fflush(stdout);}
-#define fail(FMT, ...) {wprintf(L"fail: " L ## FMT, __VA_ARGS__); wprintf(L"(win32:%u)\n", GetLastError()); fflush(stdout);}
-#ifdef _DEBUG
-# define debug(FMT, ...) log(FMT, __VA_ARGS__)
+/** The icon, tool-tip and state (from gpii, or the in-process host), and where the button's events go */
+trayHost *host = null;
+/** The button is in the host's process (TRAY_BUTTON_LIBRARY), rather than its own; there's no gpii window to watch. */
+BOOL hosted = false;
+
+/** Log messages waiting to be written to stdout */
+logRing logMessages = { 0 };
+/** Signalled when there are log messages to write */
+HANDLE logEvent = null;
+HANDLE logThread = null;
+/** Set (atomically) to stop the writer thread, once it has written what's left */
+volatile uint32_t logStopping = 0;
+
+void logWrite(int level, DWORD error, const WCHAR *format, ...);
+
+// Logging only queues the message; the writer thread does the (possibly blocking) writing.
+#define log(FMT, ...) logWrite(LOG_INFO, 0, L ## FMT, __VA_ARGS__)
+#define fail(FMT, ...) logWrite(LOG_FAIL, GetLastError(), L"fail: " L ## FMT, __VA_ARGS__)
+#if LOG_LEVEL <= LOG_DEBUG
+# define debug(FMT, ...) logWrite(LOG_DEBUG, 0, L ## FMT, __VA_ARGS__)
 #else
 # define debug(FMT, ...)
 #endif
 
+// Timed calls
+#define METRIC_POSITION  0
+#define METRIC_PAINT     1
+#define METRIC_SET_IMAGE 2
+#define METRIC_SEND      3
+#define METRIC_RECEIVE   4
+#define METRIC_ANIMATION 5
+#define METRIC_ANIMATION_STRIP 6
+metricTimer timers[] = {
+	{ "positionTrayWindows" },
+	{ "paint" },
+	{ "setImage" },
+	{ "sendToGpii" },
+	{ "gotGpiiMessage" },
+	{ "animationFrame" },
+	{ "animationStrip" }
+};
+
+// Counted calls
+#define COUNT_SET_WINDOW_POS 0
+#define COUNT_REDRAW_WINDOW  1
+#define COUNT_SHELL_MESSAGE  2
+#define COUNT_TIMER_WAKEUP   3
+#define COUNT_ICON_FILE_READ 4
+#define COUNT_REDRAW_SKIPPED 5
+#define COUNT_WINDOW_LOOKUP  6
+#define COUNT_SAVED_FRAME    7
+#define COUNT_RENDERED_FRAME 8
+#define COUNT_ICON_DECODED   9
+metricCounter counters[] = {
+	{ "SetWindowPos" },
+	{ "RedrawWindow" },
+	{ "shellMessages" },
+	{ "timerWakeups" },
+	{ "iconFileReads" },
+	{ "redrawsSkipped" },
+	{ "windowLookups" },
+	{ "savedFrames" },
+	{ "renderedFrames" },
+	{ "iconsDecoded" }
+};
+
+#define countMetric(C) (counters[C].count++)
+
+/** The time taken by the clicks (see recordSpan) */
+spanRecorder spans = { 0 };
+
+/** How often the metrics are written to stdout */
+#define METRICS_INTERVAL (10 * 60 * 1000)
+
+/**
+ * Gets the start time of a timed call.
+ * @return The performance counter.
+ */
+LONGLONG timerStart()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+/**
+ * Records a duration that was measured elsewhere (like on the decoder thread, which doesn't touch the metrics).
+ * @param timer The timer (METRIC_*).
+ * @param ticks The duration, in performance counter ticks.
+ */
+void timerAdd(int timer, LONGLONG ticks)
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	metricTimerAdd(&timers[timer], (uint64_t)(ticks * 1000000000.0 / frequency.QuadPart));
+}
+
+/**
+ * Records the duration of a timed call.
+ * @param timer The timer (METRIC_*).
+ * @param start The value returned by timerStart.
+ */
+void timerEnd(int timer, LONGLONG start)
+{
+	timerAdd(timer, timerStart() - start);
+}
+
+/**
+ * Writes a snapshot of the metrics to stdout, as "metrics: {json}".
+ */
+void dumpMetrics();
+
+/**
+ * Queues a log message, to be written to stdout by the log writer thread. Never waits; if the queue is full then the
+ * message is dropped.
+ *
+ * Only call this from the main thread.
+ *
+ * @param level The log level (LOG_*).
+ * @param error The win32 error code, for failures.
+ * @param format The message format.
+ */
+void logWrite(int level, DWORD error, const WCHAR *format, ...)
+{
+	WCHAR failFormat[256];
+	if (level == LOG_FAIL) {
+		_snwprintf_s(failFormat, ARRAYSIZE(failFormat), _TRUNCATE, L"%s(win32:%u)", format, error);
+		format = failFormat;
+	}
+
+	va_list args;
+	va_start(args, format);
+	logRingWrite(&logMessages, level, format, args);
+	va_end(args);
+
+	if (logEvent) {
+		SetEvent(logEvent);
+	}
+}
+
+/**
+ * Writes a log message to stdout.
+ */
+void writeLogRecord(void *context, const logRecord *record)
+{
+	wprintf(L"%s\n", record->text);
+}
+
+/**
+ * The log writer thread. Writes the queued log messages to stdout, whenever there are some.
+ */
+DWORD WINAPI logWriter(LPVOID param)
+{
+	BOOL stopping;
+	do {
+		WaitForSingleObject(logEvent, INFINITE);
+		stopping = atomicLoad(&logStopping) != 0;
+
+		uint32_t dropped = logRingTakeDropped(&logMessages);
+		if (dropped) {
+			wprintf(L"log: %u messages dropped\n", dropped);
+		}
+		if (logRingRead(&logMessages, writeLogRecord, null) || dropped) {
+			fflush(stdout);
+		}
+	} while (!stopping);
+
+	return 0;
+}
+
+/**
+ * Starts the log writer thread.
+ */
+void startLogging()
+{
+	atomicStore(&logStopping, 0);
+	logEvent = CreateEvent(null, false, false, null);
+	logThread = CreateThread(null, 0, logWriter, null, 0, null);
+	if (logThread) {
+		// Pick up anything logged before the thread started.
+		SetEvent(logEvent);
+	}
+}
+
+/**
+ * Writes the remaining log messages, and stops the log writer thread.
+ */
+void stopLogging()
+{
+	if (logThread) {
+		atomicStore(&logStopping, 1);
+		SetEvent(logEvent);
+		WaitForSingleObject(logThread, 5000);
+		CloseHandle(logThread);
+		logThread = null;
+	}
+}
+
+/** When things happened on the way to the button being visible */
+startupMilestones startup = { 0 };
+
+/**
+ * Logs a startup milestone, the first time it's reached, as "startup: <milestone> +<ms>ms".
+ * @param which The milestone (MILESTONE_*).
+ */
+void milestone(uint32_t which)
+{
+	if (milestoneReach(&startup, which, GetTickCount64())) {
+		log("startup: %hs +%ums", milestoneName(which), startup.times[which]);
+	}
+}
+
+// Set the environment variable to log a trace of what the button receives, as "trace: <event>" (see core/trace.h).
+#define TRACE_VARIABLE L"GPII_TRAY_BUTTON_TRACE"
+BOOL tracing = false;
+ULONGLONG traceStart = 0;
+
+/**
+ * Adds an event to the trace.
+ * @param event The event (the time is set here).
+ */
+void traceWrite(traceEvent *event)
+{
+	char line[TRACE_LINE_LENGTH];
+	event->time = GetTickCount64() - traceStart;
+	if (traceFormat(event, line, sizeof(line))) {
+		log("trace: %hs", line);
+	}
+}
+
+/**
+ * Adds a message to the trace.
+ * @param type The message (TRACE_*).
+ */
+void traceMessage(uint32_t type)
+{
+	if (tracing) {
+		traceEvent event = { 0 };
+		event.type = type;
+		traceWrite(&event);
+	}
+}
+
+/**
+ * Adds a snapshot of a value to the trace, if it's changed.
+ * @param type TRACE_DPI or TRACE_CONTRAST.
+ * @param value The value.
+ */
+void traceValue(uint32_t type, uint32_t value)
+{
+	static uint32_t last[TRACE_EXPECT];
+	if (tracing && last[type] != value) {
+		traceEvent event = { 0 };
+		event.type = type;
+		event.value = last[type] = value;
+		traceWrite(&event);
+	}
+}
+
+/**
+ * Gets the colours used to draw the button in high-contrast mode, for a state.
+ * @param state The state of the button (STATE_*).
+ * @param foreground Receives the colour of the icon.
+ * @param background Receives the colour of the background.
+ */
+void getHighContrastColors(int state, COLORREF *foreground, COLORREF *background)
+{
+	UINT backcolor = COLOR_WINDOW;
+	UINT forecolor = COLOR_WINDOWTEXT;
+
+	if (state & STATE_CHECKED) {
+		forecolor = COLOR_HIGHLIGHT;
+	}
+
+	if (state & STATE_HOVER) {
+		backcolor = COLOR_HOTLIGHT;
+		forecolor = COLOR_HIGHLIGHTTEXT;
+	}
+
+	// Get the real colour
+	*background = GetSysColor(backcolor);
+	*foreground = GetSysColor(forecolor);
+}
+
+/** The state of a button: its own, plus the checked state shared by all of them. */
+#define getState(I) (buttonState | (I)->state)
+
+/**
+ * Gets the ID of a button's icon, if it's been loaded (or its frames have been saved).
+ * @param instance The button.
+ * @return The icon ID, or 0.
+ */
+uint32_t getIconId(win32Button *instance)
+{
+	return instance->icon && (instance->icon->icon || instance->iconDeferred) ? instance->icon->iconId : 0;
+}
+
+/**
+ * Gets the key of what a button currently looks like.
+ * @param instance The button.
+ * @param key Receives the key.
+ */
+void getVisualKey(win32Button *instance, visualKey *key)
+{
+	RECT rc;
+	COLORREF foreground = 0, background = 0;
+
+	GetClientRect(instance->window, &rc);
+	if (instance->button.highContrast) {
+		getHighContrastColors(getState(instance), &foreground, &background);
+	}
+
+	uint32_t iconId = getIconId(instance);
+	if (isAnimatingButton(instance)) {
+		// Each frame looks different.
+		uint32_t frame[2] = { animationId, (uint32_t)animationFrames.frame };
+		iconId = hashBytes(frame, sizeof(frame));
+	}
+	visualKeyInit(key, getState(instance), instance->button.highContrast, iconId, instance->iconSize,
+		rc.right, rc.bottom, foreground, background);
+}
+
 /**
- * Convert the value based on 96dpi to the current dpi.
+ * Cause a button to be redrawn, if it would look different to how it was last painted.
+ * @param instance The button.
  */
-#define fixDpi(size) MulDiv(size, currentDpi, 96)
+void redraw(win32Button *instance)
+{
+	visualKey key;
+	getVisualKey(instance, &key);
+	if (visualRedrawNeeded(&instance->visuals, &key)) {
+		countMetric(COUNT_REDRAW_WINDOW);
+		RedrawWindow(instance->window, null, null, RDW_ERASE | RDW_INVALIDATE | RDW_FRAME | RDW_ALLCHILDREN);
+	}
+}
+
+/**
+ * Cause every button to be redrawn, if it would look different.
+ */
+void redrawAll()
+{
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		redraw(getButton(buttons.entries[n].button));
+	}
+}
+
+/** Class names of the taskbar's windows (WINDOW_*) */
+const WCHAR *taskbarClasses[WINDOW_COUNT] = {
+	L"Shell_TrayWnd",
+	// Container of the window list (and toolbars)
+	L"ReBarWindow32",
+	// The notification icons
+	L"TrayNotifyWnd"
+};
+
+/** Class names of the windows of the taskbars on the other monitors (WINDOW_*) */
+const WCHAR *secondaryClasses[WINDOW_COUNT] = {
+	L"Shell_SecondaryTrayWnd",
+	// Container of the window list
+	L"WorkerW",
+	// There are no notification icons, just the clock (which isn't always there)
+	L"ClockButton"
+};
 
 /**
- * Cause the button to be redrawn.
+ * Finds one of the taskbar's windows.
+ * @param context The button whose taskbar it is, or null for the primary taskbar.
  */
-void redraw()
+windowHandle win32FindWindow(void *context, windowHandle parent, uint32_t which)
+{
+	win32Button *instance = context;
+	if (!parent) {
+		// A button stays on the taskbar it was created on.
+		return instance ? (windowHandle)instance->taskbar : FindWindow(taskbarClasses[which], null);
+	}
+	const WCHAR **classes = instance && !instance->primary ? secondaryClasses : taskbarClasses;
+	return FindWindowEx((HWND)parent, null, classes[which], null);
+}
+
+bool win32IsWindow(void *context, windowHandle window)
 {
-	RedrawWindow(buttonWindow, null, null, RDW_ERASE | RDW_INVALIDATE | RDW_FRAME | RDW_ALLCHILDREN);
+	return IsWindow((HWND)window) != 0;
 }
 
+/** How the taskbar's windows are found */
+windowSystem win32Windows = { win32FindWindow, win32IsWindow, null };
+/** The primary taskbar's windows, before there's a button on it */
+windowCache taskbarWindows = { 0 };
+
+/**
+ * Get one of the windows of a button's taskbar, without searching for it each time.
+ * @param instance The button.
+ * @param which The window (WINDOW_*).
+ * @return The window handle.
+ */
+#define getTaskbarChild(I, which) ((HWND)windowCacheGet(&(I)->windows, which))
+
 /**
- * Get the taskbar window handle.
+ * Get the primary taskbar window handle.
  * @return The taskbar's window handle.
  */
 HWND getTaskbarWindow()
 {
-	return FindWindow(L"Shell_TrayWnd", null);
+	return (HWND)windowCacheGet(&taskbarWindows, WINDOW_TRAY);
 }
 
-#define TIMER_RESIZE 1
-#define TIMER_CHECK 2
-#define TIMER_CHECK_DELAY 5000
+// TIMER_RESIZE and TIMER_CHECK are in core/button.h
+#define TIMER_METRICS 3
+#define TIMER_RESIZE_DELAY 100
+#define TIMER_CHECK_MIN_DELAY 1000
+#define TIMER_CHECK_MAX_DELAY 60000
+
+UINT_PTR(WINAPI *my_SetCoalescableTimer)(HWND, UINT_PTR, UINT, TIMERPROC, ULONG) = null;
+BOOL noSetCoalescableTimer = false;
+
+/**
+ * Starts (or restarts) one of a button's timers. If possible, the timer is allowed to be coalesced with other timers
+ * on the system, so the CPU doesn't need to wake up just for the button.
+ * @param instance The button.
+ * @param id The timer ID (TIMER_*).
+ * @param delay The delay, in milliseconds.
+ */
+void startTimer(win32Button *instance, UINT_PTR id, UINT delay)
+{
+	if (!noSetCoalescableTimer && !my_SetCoalescableTimer) {
+		// SetCoalescableTimer is only available on Windows 8+.
+		HINSTANCE user32 = LoadLibrary(L"user32.dll");
+		if (user32) {
+			*(void**)&my_SetCoalescableTimer = GetProcAddress(user32, "SetCoalescableTimer");
+		}
+		noSetCoalescableTimer = !my_SetCoalescableTimer;
+	}
+
+	if (my_SetCoalescableTimer) {
+		my_SetCoalescableTimer(instance->window, id, delay, null, schedulerTolerance(delay));
+	} else {
+		SetTimer(instance->window, id, delay, null);
+	}
+}
 
 void setImage(WCHAR *file);
+void loadButtonIcon(win32Button *instance);
+void scheduleSaveFrames();
+void saveState();
+void freeButton(win32Button *instance);
+void removeButtons();
+BOOL syncButtons();
+void scheduleSync();
+void gotGpiiBatch(const void *data, size_t size);
+BOOL sendToGpii(UINT msg, WPARAM wParam, LPARAM lParam);
+BOOL pipePosition(const coreRect *rect);
+void setAnimation();
+void updateAnimationVisibility();
+
+/**
+ * Make a taskbar adjust the sizes of its windows, after a button has gone from it.
+ * @param taskbar The taskbar.
+ */
+void relayoutTaskbar(HWND taskbar)
+{
+	if (taskbar && IsWindow(taskbar)) {
+		SendMessage(taskbar, WM_ENTERSIZEMOVE, 0, 0);
+		SendMessage(taskbar, WM_EXITSIZEMOVE, 0, 0);
+	}
+}
 
 /**
- * Hide the button
+ * Hide the buttons
  */
 void hideButton()
 {
+	traceMessage(TRACE_HIDE);
 	if (!IsWindow(gpiiWindow)) {
 		gpiiWindow = null;
 	}
 
 	iconFile = null;
-	if (hIcon) {
-		DestroyIcon(hIcon);
-		hIcon = null;
-	}
-
-	if (IsWindow(buttonWindow)) {
-		ShowWindow(buttonWindow, SW_HIDE);
+	if (host) {
+		// gpii says it all again when it's back.
+		trayHostReset(host);
+		setAnimation();
 	}
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		win32Button *instance = getButton(buttons.entries[n].button);
+		renderIconRelease(&render, instance->icon);
+		renderIconRelease(&render, instance->loading);
+		instance->icon = instance->loading = null;
+
+		if (IsWindow(instance->window)) {
+			ShowWindow(instance->window, SW_HIDE);
+		}
+		instance->button.hasIcon = false;
+		// It will need to be put back when it's shown again.
+		buttonHidden(&instance->button);
+		visualInvalidate(&instance->visuals);
 
-	HANDLE taskbar = getTaskbarWindow();
-	if (taskbar) {
-		// Make the taskbar adjust the sizes
-		SendMessage(taskbar, WM_ENTERSIZEMOVE, 0, 0);
-		SendMessage(taskbar, WM_EXITSIZEMOVE, 0, 0);
+		relayoutTaskbar(instance->taskbar);
 	}
+	updateAnimationVisibility();
 }
 
 UINT(WINAPI *my_GetDpiForWindow)(HWND) = null;
 BOOL noGetDpiForWindow = false;
-UINT getDpi(HWND window)
+
+/**
+ * Gets the DPI of a window.
+ * @param window The window.
+ * @param fallback Returned if the DPI can't be found (96 if this is 0).
+ */
+UINT getDpi(HWND window, UINT fallback)
 {
 	UINT result = 0;
 
@@ -176,177 +731,209 @@ UINT getDpi(HWND window)
 	}
 
 	if (!result) {
-		result = currentDpi ? currentDpi : 96;
+		result = fallback ? fallback : 96;
 	}
 
 	return result;
 }
 
 /**
- * Move the button in between the task list and notification icons by shrinking the task list.
- *
- * @param force true to always resize, even if not required.
- * @return true if resize was required.
+ * Gets the geometry of the taskbar.
  */
-BOOL positionTrayWindows(BOOL force)
+bool win32GetTaskbar(buttonPlatform *platform, layoutInput *input)
 {
-	debug("positionTrayWindows");
+	win32Button *instance = getInstance(platform);
+	HWND tray = getTaskbarChild(instance, WINDOW_TRAY);
+	HWND tasks = getTaskbarChild(instance, WINDOW_TASKS);
+	HWND notify = getTaskbarChild(instance, WINDOW_NOTIFY);
 
-	if (!buttonWindow) {
+	debug("tray:%u tasks:%u notify:%u", tray, tasks, notify);
+	if (!instance->window || !tray || !tasks) {
 		return false;
 	}
-	if (!IsWindow(gpiiWindow)) {
+	if (!trayHostReachable(hosted, gpiiPipe != null, IsWindow(gpiiWindow))) {
+		// gpii has gone away, without saying goodbye.
 		hideButton();
-	}
-	if (!hIcon) {
 		return false;
 	}
 
-	// Task bar
-	HWND tray = getTaskbarWindow();
-	// Container of the window list (and toolbars)
-	HWND tasks = FindWindowEx(tray, null, L"ReBarWindow32", null);
-	// The notification icons
-	HWND notify = FindWindowEx(tray, null, L"TrayNotifyWnd", null);
-
-	debug("tray:%u tasks:%u notify:%u", tray, tasks, notify);
-
-	// Current DPI
-	UINT dpi = getDpi(tray);
-	if (dpi != currentDpi) {
-		currentDpi = dpi;
-		setImage(iconFile);
-		return true;
-	}
-
-	// Get the dimensions of both windows.
-	RECT newTaskRect, newNotifyRect, newTrayClient;
-	RECT buttonRect = { 0 };
-	GetWindowRect(tasks, &newTaskRect);
-	GetWindowRect(notify, &newNotifyRect);
-	GetClientRect(tray, &newTrayClient);
-	// Have they changed since last time?
-	BOOL changed = !EqualRect(&taskRect, &newTaskRect)
-		|| !EqualRect(&notifyRect, &newNotifyRect)
-		|| !EqualRect(&trayClient, &newTrayClient);
-
-	CopyRect(&taskRect, &newTaskRect);
-	CopyRect(&notifyRect, &newNotifyRect);
-	CopyRect(&trayClient, &newTrayClient);
-
-	// Check the orientation
-	RECT trayRect;
-	GetWindowRect(tray, &trayRect);
-	BOOL vert = trayRect.top == 0 && trayRect.bottom > GetSystemMetrics(SM_CYFULLSCREEN) - 10;
-
-	if (vert) {
-		// Shrink the tasks window
-		taskRect.bottom = notifyRect.top - fixDpi(BUTTON_WIDTH);
-		// Put the button between
-		buttonRect.top = taskRect.bottom;
-		buttonRect.bottom = notifyRect.top;
-		buttonRect.left = highContrast ? 1 : 0;
-		buttonRect.right = trayClient.right;
+	GetWindowRect(tray, (RECT*)&input->trayRect);
+	GetClientRect(tray, (RECT*)&input->trayClient);
+	GetWindowRect(tasks, (RECT*)&input->tasksRect);
+	if (notify) {
+		GetWindowRect(notify, (RECT*)&input->notifyRect);
 	} else {
-		// Check the reading direction - if the notification icons are left of the task list, then assume right-to-left.
-		BOOL rtl = notifyRect.left < taskRect.left;
-
-		if (rtl) {
-			// notification area is on the left
-			// Shrink the tasks window
-			taskRect.left = notifyRect.right + fixDpi(BUTTON_WIDTH);
-			// Put the button between
-			buttonRect.left = trayClient.right - taskRect.left;
-			buttonRect.right = trayClient.right - notifyRect.right;
+		// Nothing at the end of a secondary taskbar: the button goes right up to the end.
+		coreRect end = input->trayRect;
+		if (rectHeight(end) > rectWidth(end)) {
+			end.top = end.bottom;
 		} else {
-			// notification area is on the right (the common way)
-			// Shrink the tasks window
-			taskRect.right = notifyRect.left - fixDpi(BUTTON_WIDTH);
-			// Put the button between
-			buttonRect.left = taskRect.right;
-			buttonRect.right = notifyRect.left;
+			end.left = end.right;
 		}
-
-		buttonRect.top = highContrast ? 1 : 0;
-		buttonRect.bottom = trayClient.bottom;
+		input->notifyRect = end;
+	}
+	input->screenHeight = GetSystemMetrics(SM_CYFULLSCREEN);
+
+	// The replay is of a single button, so only the primary one is traced.
+	static layoutInput traced = { 0 };
+	if (tracing && instance->primary && memcmp(&traced, input, sizeof(traced)) != 0) {
+		traceEvent event = { 0 };
+		event.type = TRACE_GEOMETRY;
+		event.geometry = traced = *input;
+		traceWrite(&event);
 	}
+	return true;
+}
 
-	if (!force || !changed) {
-		// See if the button needs to be moved
-		RECT currentRect;
-		GetWindowRect(buttonWindow, &currentRect);
-		MapWindowPoints(HWND_DESKTOP, tray, (POINT*)&currentRect, 2);
-		changed = changed || !EqualRect(&buttonRect, &currentRect);
+uint32_t win32GetDpi(buttonPlatform *platform)
+{
+	win32Button *instance = getInstance(platform);
+	uint32_t dpi = getDpi(instance->taskbar, instance->button.dpi);
+	if (instance->primary) {
+		traceValue(TRACE_DPI, dpi);
 	}
+	return dpi;
+}
+
+bool win32IsHighContrast(buttonPlatform *platform)
+{
+	HIGHCONTRAST hc = { 0 };
+	hc.cbSize = sizeof(hc);
+	SystemParametersInfo(SPI_GETHIGHCONTRAST, hc.cbSize, &hc, 0);
+	bool on = (hc.dwFlags & HCF_HIGHCONTRASTON) != 0;
+	traceValue(TRACE_CONTRAST, on);
+	return on;
+}
 
-	if (force || changed) {
-		// shrink the task list
-		SetWindowPos(tasks, HWND_BOTTOM,
-			0, 0,
-			taskRect.right - taskRect.left,
-			taskRect.bottom - taskRect.top,
-			SWP_NOACTIVATE | SWP_NOMOVE);
+void win32ResizeTasks(buttonPlatform *platform, int32_t width, int32_t height)
+{
+	HWND tasks = getTaskbarChild(getInstance(platform), WINDOW_TASKS);
+	countMetric(COUNT_SET_WINDOW_POS);
+	SetWindowPos(tasks, HWND_BOTTOM, 0, 0, width, height, SWP_NOACTIVATE | SWP_NOMOVE);
+}
 
-		// Move the button between the tasks and notification area
-		SetWindowPos(buttonWindow, HWND_TOP,
-			buttonRect.left, buttonRect.top,
-			buttonRect.right - buttonRect.left,
-			buttonRect.bottom - buttonRect.top,
-			SWP_NOACTIVATE | SWP_SHOWWINDOW);
+void win32MoveButton(buttonPlatform *platform, const coreRect *rect)
+{
+	win32Button *instance = getInstance(platform);
+	countMetric(COUNT_SET_WINDOW_POS);
+	SetWindowPos(instance->window, HWND_TOP, rect->left, rect->top, rectWidth(*rect), rectHeight(*rect),
+		SWP_NOACTIVATE | SWP_SHOWWINDOW);
+	if (instance->primary) {
+		milestone(MILESTONE_VISIBLE);
+	}
+	updateAnimationVisibility();
+}
 
-		redraw();
+void win32Redraw(buttonPlatform *platform, bool force)
+{
+	win32Button *instance = getInstance(platform);
+	if (force) {
+		visualInvalidate(&instance->visuals);
 	}
+	redraw(instance);
+}
 
-	if (force || changed) {
-		SetTimer(buttonWindow, TIMER_RESIZE, 100, NULL);
-		SetTimer(buttonWindow, TIMER_CHECK, 1000, null);
-	} else {
-		KillTimer(buttonWindow, TIMER_RESIZE);
+/**
+ * Tells gpii where the button is, when it's in its own process.
+ * @param rect The button's screen co-ordinates.
+ */
+void notifyPosition(const coreRect *rect)
+{
+	// The pipe has room for the whole rectangle; the message only has room for 16 bits of each.
+	if (!pipePosition(rect)) {
+		sendToGpii(gpiiPositionMessage, MAKELONG(rect->left, rect->top), MAKELONG(rectWidth(*rect), rectHeight(*rect)));
 	}
+}
 
-	if (changed) {
-		// Inform gpii about the new position.
-		RECT currentRect;
-		GetWindowRect(buttonWindow, &currentRect);
-		if (!EqualRect(&windowRect, &currentRect)) {
-			windowRect = currentRect;
-			sendToGpii(gpiiPositionMessage,
-				MAKELONG(windowRect.left, windowRect.top),
-				MAKELONG(windowRect.right - windowRect.left, windowRect.bottom - windowRect.top));
-		}
+void win32NotifyPosition(buttonPlatform *platform, const coreRect *rect)
+{
+	// gpii shows its window next to one button: the primary one, unless another was clicked.
+	win32Button *instance = getInstance(platform);
+	if (activeButton ? instance == activeButton : instance->primary) {
+		trayHostPosition(host, rect);
+	}
+	if (instance->primary) {
+		saveState();
 	}
+}
+
+void win32ReloadIcon(buttonPlatform *platform)
+{
+	loadButtonIcon(getInstance(platform));
+}
+
+void win32StartTimer(buttonPlatform *platform, uint32_t id, uint32_t delay)
+{
+	startTimer(getInstance(platform), id, delay);
+}
+
+void win32StopTimer(buttonPlatform *platform, uint32_t id)
+{
+	KillTimer(getInstance(platform)->window, id);
+}
+
+uint64_t win32Now(buttonPlatform *platform)
+{
+	return GetTickCount64();
+}
+
+/** The button logic's view of Windows; each button has a copy */
+buttonPlatform win32Platform = {
+	win32GetTaskbar,
+	win32GetDpi,
+	win32IsHighContrast,
+	win32ResizeTasks,
+	win32MoveButton,
+	win32Redraw,
+	win32NotifyPosition,
+	win32ReloadIcon,
+	win32StartTimer,
+	win32StopTimer,
+	win32Now
+};
 
+/**
+ * Move a button in between the task list and notification icons by shrinking the task list.
+ *
+ * @param instance The button.
+ * @param force true to always resize, even if not required.
+ * @return true if resize was required.
+ */
+BOOL positionTrayWindows(win32Button *instance, BOOL force)
+{
+	debug("positionTrayWindows");
+
+	LONGLONG start = timerStart();
+	BOOL changed = buttonPosition(&instance->button, force);
+	timerEnd(METRIC_POSITION, start);
 	return changed;
 }
 
 /**
- * Update the state of the button, and cause a redraw. The state is a bitmask of STATE_*
+ * Update the state of a button, and cause a redraw. The state is a bitmask of STATE_HOVER and STATE_PRESSED.
+ * @param instance The button.
  * @param newState
  */
-void updateState(int newState)
+void updateState(win32Button *instance, int newState)
 {
-	buttonState = newState;
-	redraw();
+	instance->state = newState;
+	redraw(instance);
 }
 /** Set a state */
-#define setState(F) updateState(buttonState | (F))
+#define setState(I, F) updateState(I, (I)->state | (F))
 /** Un-set a state */
-#define unsetState(F) updateState(buttonState & ~(F))
+#define unsetState(I, F) updateState(I, (I)->state & ~(F))
 /** Check a state */
-#define hasState(F) (buttonState & (F))
+#define hasState(I, F) (getState(I) & (F))
 
 /**
- * Determine if high-contrast is currently applied.
- * @return TRUE if the setting has changed.
+ * Checks or un-checks all the buttons.
+ * @param checked true to check.
  */
-BOOL checkHighContrast()
+void setChecked(BOOL checked)
 {
-	HIGHCONTRAST hc = { 0 };
-	hc.cbSize = sizeof(hc);
-	SystemParametersInfo(SPI_GETHIGHCONTRAST, hc.cbSize, &hc, 0);
-	BOOL last = highContrast;
-	highContrast = (hc.dwFlags & HCF_HIGHCONTRASTON) != 0;
-	return highContrast != last;
+	buttonState = checked ? STATE_CHECKED : STATE_NORMAL;
+	redrawAll();
 }
 
 /**
@@ -362,446 +949,2439 @@ HANDLE findGpiiWindow()
 	return gpiiWindow;
 }
 
+/** Reads from the pipe */
+HANDLE pipeThread = null;
+/** Signalled when a write has completed */
+HANDLE pipeWriteEvent = null;
+/** Sequence number of the next frame sent */
+uint32_t pipeSequence = 0;
+
+/** A frame received from the pipe, passed from the reader thread to the main thread. */
+typedef struct {
+	uint32_t type;
+	uint32_t length;
+	uint8_t *payload;
+} pipeFrame;
+
 /**
- * Send a message to the main GPII process.
- * @return TRUE if the window exists.
+ * Gets the time, for the frame timestamps.
+ * @return The performance counter, in microseconds.
  */
-BOOL sendToGpii(UINT msg, WPARAM wParam, LPARAM lParam)
+uint64_t pipeNow()
 {
-	log("sendToGpii(%u,%u,%u)", msg, wParam, lParam);
-
-	if (!IsWindow(gpiiWindow)) {
-		findGpiiWindow();
-	}
-
-	if (gpiiWindow) {
-		SendNotifyMessage(gpiiWindow, msg, wParam, lParam);
+	static LARGE_INTEGER frequency = { 0 };
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
 	}
-
-	return gpiiWindow != NULL;
+	LONGLONG now = timerStart();
+	return (uint64_t)(now / frequency.QuadPart * 1000000 + now % frequency.QuadPart * 1000000 / frequency.QuadPart);
 }
 
 /**
- * Draws a translucent rectangle.
- * @param dc The device context to draw on.
- * @param rc The rectangle
- * @param color Rectangle colour
- * @param alpha Alpha amount, 0 (transparent) - 0xff (opaque)
+ * Reads frames from the pipe, and posts them to the main thread. Runs on its own thread, so it mustn't log.
+ * @param param The window to post the frames to.
  */
-void AlphaRect(HDC dc, RECT rc, COLORREF color, BYTE alpha)
+DWORD WINAPI pipeReader(LPVOID param)
 {
-	// GDI doesn't have a concept of semi-transparent pixels - the only function that honours them is AlphaBlend.
-	// Create a bitmap containing a single pixel, and use AlphaBlend to stretch it to the size of the rect.
+	HWND target = param;
+	static frameReader reader;
+	uint8_t buffer[4096];
+	OVERLAPPED overlapped = { 0 };
+	BOOL ok = true;
+
+	overlapped.hEvent = CreateEvent(null, TRUE, FALSE, null);
+	frameReaderInit(&reader);
+
+	while (ok && overlapped.hEvent) {
+		DWORD length = 0;
+		// Overlapped, so writes from the main thread aren't held up by the read.
+		if (!ReadFile(gpiiPipe, buffer, sizeof(buffer), null, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+			break;
+		}
+		if (!GetOverlappedResult(gpiiPipe, &overlapped, &length, TRUE)) {
+			break;
+		}
+
+		DWORD offset = 0;
+		while (ok && offset < length) {
+			offset += (DWORD)frameReaderAppend(&reader, buffer + offset, length - offset);
+
+			frame f;
+			int result;
+			while ((result = frameReaderNext(&reader, &f)) == FRAME_READ) {
+				// The payload is only valid until the next read, so it's copied.
+				pipeFrame *copy = LocalAlloc(LMEM_FIXED, sizeof(pipeFrame) + f.payloadLength);
+				if (copy) {
+					copy->type = f.type;
+					copy->length = f.payloadLength;
+					copy->payload = (uint8_t*)(copy + 1);
+					memcpy(copy->payload, f.payload, f.payloadLength);
+					if (!PostMessage(target, WM_PIPE_FRAME, 0, (LPARAM)copy)) {
+						LocalFree(copy);
+					}
+				}
+			}
+			ok = result != FRAME_ERROR;
+		}
+	}
+
+	if (overlapped.hEvent) {
+		CloseHandle(overlapped.hEvent);
+	}
+	PostMessage(target, WM_PIPE_FRAME, 0, 0);
+	return 0;
+}
+
+/**
+ * Connects to gpii's pipe, if it has given one.
+ * @param target The window which receives the frames (WM_PIPE_FRAME).
+ */
+void pipeConnect(HWND target)
+{
+	WCHAR name[MAX_PATH];
+	if (!target || !GetEnvironmentVariable(PIPE_VARIABLE, name, ARRAYSIZE(name))) {
+		return;
+	}
+
+	HANDLE pipe = CreateFile(name, GENERIC_READ | GENERIC_WRITE, 0, null, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, null);
+	if (pipe == INVALID_HANDLE_VALUE) {
+		fail("CreateFile (pipe %s)", name);
+		return;
+	}
+
+	gpiiPipe = pipe;
+	pipeWriteEvent = CreateEvent(null, TRUE, FALSE, null);
+	pipeThread = CreateThread(null, 0, pipeReader, target, 0, null);
+	if (!pipeWriteEvent || !pipeThread) {
+		fail("Unable to start the pipe");
+		CloseHandle(gpiiPipe);
+		gpiiPipe = null;
+		return;
+	}
+
+	log("Connected to %s", name);
+}
+
+/**
+ * Closes the pipe, and waits for the reader to finish.
+ */
+void pipeClose()
+{
+	if (pipeThread) {
+		CancelIoEx(gpiiPipe, null);
+		WaitForSingleObject(pipeThread, 1000);
+		CloseHandle(pipeThread);
+		pipeThread = null;
+	}
+	if (gpiiPipe) {
+		CloseHandle(gpiiPipe);
+		gpiiPipe = null;
+	}
+	if (pipeWriteEvent) {
+		CloseHandle(pipeWriteEvent);
+		pipeWriteEvent = null;
+	}
+}
+
+/**
+ * Writes a frame to the pipe.
+ * @param data The frame.
+ * @param length Length of the frame.
+ * @return true if it was written.
+ */
+BOOL pipeWrite(const uint8_t *data, size_t length)
+{
+	if (!gpiiPipe || !length) {
+		return false;
+	}
+
+	OVERLAPPED overlapped = { 0 };
+	overlapped.hEvent = pipeWriteEvent;
+	DWORD written = 0;
+	BOOL ok = WriteFile(gpiiPipe, data, (DWORD)length, null, &overlapped) || GetLastError() == ERROR_IO_PENDING;
+	// Only waits if the pipe's buffer is full.
+	ok = ok && GetOverlappedResult(gpiiPipe, &overlapped, &written, TRUE) && written == length;
+	if (!ok) {
+		fail("WriteFile (pipe)");
+	}
+	return ok;
+}
+
+/**
+ * Sends a notification (HOST_EVENT_*) over the pipe.
+ * @param notification The notification.
+ * @param event The event's sequence number (hostEvent.sequence).
+ * @return true if it was sent.
+ */
+BOOL pipeNotify(uint32_t notification, uint32_t event)
+{
+	uint8_t buffer[FRAME_HEADER_SIZE + 8];
+	return gpiiPipe && pipeWrite(buffer,
+		frameEncodeNotify(buffer, sizeof(buffer), pipeSequence++, pipeNow(), notification, event));
+}
+
+/**
+ * Sends the button's position over the pipe.
+ * @return true if it was sent.
+ */
+BOOL pipePosition(const coreRect *rect)
+{
+	uint8_t buffer[FRAME_HEADER_SIZE + 16];
+	if (!gpiiPipe) {
+		return false;
+	}
+	log("pipePosition(%d,%d,%d,%d)", rect->left, rect->top, rectWidth(*rect), rectHeight(*rect));
+	return pipeWrite(buffer, frameEncodePosition(buffer, sizeof(buffer), pipeSequence++, pipeNow(), rect));
+}
+
+/**
+ * Handles a frame from the pipe, on the main thread.
+ * @param f The frame, from pipeReader; null if the pipe has closed.
+ */
+void pipeReceived(pipeFrame *f)
+{
+	if (!f) {
+		log("Pipe closed");
+		pipeClose();
+		return;
+	}
+
+	switch (f->type) {
+	case FRAME_COMMAND:
+		// Every command is a batch, over the pipe.
+		gotGpiiBatch(f->payload, f->length);
+		break;
+
+	case FRAME_PING:
+	{
+		static uint8_t pong[FRAME_MAX_SIZE];
+		pipeWrite(pong, frameEncode(pong, sizeof(pong), FRAME_PONG, pipeSequence++, pipeNow(), f->payload, f->length));
+		break;
+	}
+	default:
+		break;
+	}
+
+	LocalFree(f);
+}
+
+/**
+ * Send a message to the main GPII process. For a notification, lParam is the event's sequence number.
+ * @return TRUE if the window exists.
+ */
+BOOL sendToGpii(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	LONGLONG start = timerStart();
+	log("sendToGpii(%u,%u,%u)", msg, wParam, lParam);
+
+	if (msg == gpiiMessage && pipeNotify((uint32_t)wParam, (uint32_t)lParam)) {
+		timerEnd(METRIC_SEND, start);
+		return true;
+	}
+
+	if (!IsWindow(gpiiWindow)) {
+		findGpiiWindow();
+	}
+
+	if (gpiiWindow) {
+		SendNotifyMessage(gpiiWindow, msg, wParam, lParam);
+	}
+
+	timerEnd(METRIC_SEND, start);
+	return gpiiWindow != NULL;
+}
+
+/**
+ * Sends the button's events to gpii, when it's in its own process (the host's callback).
+ */
+void gpiiEvent(void *context, const hostEvent *event)
+{
+	if (event->type == HOST_EVENT_POSITION) {
+		notifyPosition(&event->rect);
+	} else {
+		// The sequence number identifies the notification on the timeline (see recordSpan).
+		sendToGpii(gpiiMessage, event->type, event->sequence);
+	}
+}
+
+/** A 1x1 bitmap, selected into a DC, used by AlphaRect. */
+typedef struct {
+	HDC dc;
+	HBITMAP bitmap;
+	HBITMAP original;
+} SolidSurface;
+
+/** The surfaces used by AlphaRect, kept between paints. */
+solidPool solidSurfaces = { 0 };
+
+/**
+ * Frees a surface created by getSolidSurface.
+ * @param surface The surface.
+ */
+void freeSolidSurface(void *surface)
+{
+	SolidSurface *s = surface;
+	if (s) {
+		SelectObject(s->dc, s->original);
+		DeleteObject(s->bitmap);
+		DeleteDC(s->dc);
+		LocalFree(s);
+	}
+}
+
+/**
+ * Gets a 1x1 surface of the given pixel from the pool, creating it if required.
+ * @param pixel The premultiplied pixel.
+ * @return The surface.
+ */
+SolidSurface *getSolidSurface(UINT pixel)
+{
+	SolidSurface *s = solidPoolFind(&solidSurfaces, pixel);
+	if (s) {
+		return s;
+	}
 
 	// The bitmap
-	int pixel;
 	BITMAPINFO bmi = { 0 };
 	bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
 	bmi.bmiHeader.biWidth = bmi.bmiHeader.biHeight = 1;
 	bmi.bmiHeader.biPlanes = 1;
 	bmi.bmiHeader.biBitCount = 32;
 
-	// The pixel
-	pixel = (
-		((alpha * GetRValue(color) / 0xff) << 16) |
-		((alpha * GetGValue(color) / 0xff) << 8) |
-		(alpha * GetBValue(color) / 0xff)
-			);
-	pixel = pixel | (alpha << 24);
-
 	// Make the bitmap DC.
-	int *bits;
-	HDC dcPixel = CreateCompatibleDC(dc);
-	HBITMAP bmpPixel = CreateDIBSection(dcPixel, &bmi, DIB_RGB_COLORS, &bits, null, 0);
-	HBITMAP bmpOrig = SelectObject(dcPixel, bmpPixel);
+	UINT *bits;
+	s = LocalAlloc(LPTR, sizeof(SolidSurface));
+	if (!s) {
+		return null;
+	}
+	s->dc = CreateCompatibleDC(null);
+	s->bitmap = CreateDIBSection(s->dc, &bmi, DIB_RGB_COLORS, (void **) &bits, null, 0);
+	if (!s->bitmap) {
+		fail("CreateDIBSection");
+		DeleteDC(s->dc);
+		LocalFree(s);
+		return null;
+	}
+	s->original = SelectObject(s->dc, s->bitmap);
 	*bits = pixel;
 
-	// Draw the "rectangle"
-	BLENDFUNCTION bf = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
-	AlphaBlend(dc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, dcPixel, 0, 0, 1, 1, bf);
+	freeSolidSurface(solidPoolAdd(&solidSurfaces, pixel, s));
+	return s;
+}
 
-	SelectObject(dcPixel, bmpOrig);
-	DeleteObject(bmpPixel);
-	DeleteDC(dcPixel);
+/**
+ * Draws a translucent rectangle.
+ * @param dc The device context to draw on.
+ * @param rc The rectangle
+ * @param color Rectangle colour
+ * @param alpha Alpha amount, 0 (transparent) - 0xff (opaque)
+ */
+void AlphaRect(HDC dc, RECT rc, COLORREF color, BYTE alpha)
+{
+	// GDI doesn't have a concept of semi-transparent pixels - the only function that honours them is AlphaBlend.
+	// Use a bitmap containing a single pixel, and use AlphaBlend to stretch it to the size of the rect.
+	SolidSurface *s = getSolidSurface(premultiplyColor(color, alpha));
+	if (s) {
+		// Draw the "rectangle"
+		BLENDFUNCTION bf = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+		AlphaBlend(dc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, s->dc, 0, 0, 1, 1, bf);
+	}
 }
 
 /**
- * Called from WM_PAINT to perform the drawing of the button.
+ * Frees an atlas surface (renderHooks.freeSurface).
  */
-void paint()
+void freeAtlasSurface(void *context, void *surface)
 {
-	RECT rc;
-	HDC dc, dcPaint;
-	PAINTSTRUCT ps;
+	atlasSurface *s = surface;
+	SelectObject(s->dc, s->original);
+	DeleteObject(s->bitmap);
+	DeleteDC(s->dc);
+	LocalFree(s);
+}
+
+/**
+ * Frees a decoded icon (renderHooks.freeIcon).
+ */
+void freeButtonIcon(void *context, void *icon)
+{
+	DestroyIcon((HICON)icon);
+}
+
+/** How the atlases and icons are freed */
+renderHooks win32Render = { freeAtlasSurface, freeButtonIcon, null };
+
+/**
+ * Creates a surface for the button's pixels: a top-down 32-bit DIB section, selected into a memory DC.
+ * @param width Width of the surface.
+ * @param height Height of the surface.
+ * @return The surface (free with freeAtlasSurface), or null on failure.
+ */
+atlasSurface *createSurface(int width, int height)
+{
+	// Top-down, so it can be addressed like the rest of the core's pixels.
+	BITMAPINFO bmi = { 0 };
+	bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+	bmi.bmiHeader.biWidth = width;
+	bmi.bmiHeader.biHeight = -height;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
 
-	GetClientRect(buttonWindow, &rc);
+	atlasSurface *s = LocalAlloc(LPTR, sizeof(atlasSurface));
+	if (!s) {
+		fail("LocalAlloc");
+		return null;
+	}
+	s->dc = CreateCompatibleDC(null);
+	s->bitmap = CreateDIBSection(s->dc, &bmi, DIB_RGB_COLORS, (void**)&s->pixels, null, 0);
+	if (!s->bitmap) {
+		fail("CreateDIBSection");
+		DeleteDC(s->dc);
+		LocalFree(s);
+		return null;
+	}
+	s->original = SelectObject(s->dc, s->bitmap);
+	return s;
+}
 
-	// Start the buffer
-	dcPaint = BeginPaint(buttonWindow, &ps);
-	HPAINTBUFFER paintBuffer = BeginBufferedPaint(dcPaint, &rc, BPBF_TOPDOWNDIB, null, &dc);
-	BufferedPaintClear(paintBuffer, null);
+/**
+ * Makes a button's atlas ready for its icon, size, and colours; (re)creating the surface if required. Buttons of the
+ * same size share an atlas.
+ * @param instance The button.
+ * @param width Width of the button.
+ * @param height Height of the button.
+ * @return true if the atlas can be used.
+ */
+BOOL prepareAtlas(win32Button *instance, int width, int height)
+{
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
 
-	int x = (rc.right - iconSize) / 2;
-	int y = (rc.bottom - iconSize) / 2;
+	renderAtlas *shared = instance->atlas = renderAtlasAcquire(&render, instance->atlas, width, height,
+		instance->iconSize);
+	if (!shared) {
+		return false;
+	}
 
-	if (highContrast) {
-		UINT backcolor = COLOR_WINDOW;
-		UINT forecolor = COLOR_WINDOWTEXT;
+	atlasKey key = shared->atlas.key;
+	// While animating, the cells are the background which the frames are drawn over.
+	key.iconId = isAnimatingButton(instance) ? 0 : getIconId(instance);
+	key.colors = 0;
+	if (instance->button.highContrast) {
+		COLORREF colors[] = {
+			GetSysColor(COLOR_WINDOW), GetSysColor(COLOR_WINDOWTEXT), GetSysColor(COLOR_HIGHLIGHT),
+			GetSysColor(COLOR_HOTLIGHT), GetSysColor(COLOR_HIGHLIGHTTEXT)
+		};
+		key.colors = hashBytes(colors, sizeof(colors));
+	}
 
-		if (hasState(STATE_CHECKED)) {
-			forecolor = COLOR_HIGHLIGHT;
+	if (atlasUpdate(&shared->atlas, &key) || !shared->surface) {
+		if (shared->surface) {
+			freeAtlasSurface(null, shared->surface);
+			shared->surface = null;
 		}
 
-		if (hasState(STATE_HOVER)) {
-			backcolor = COLOR_HOTLIGHT;
-			forecolor = COLOR_HIGHLIGHTTEXT;
+		shared->surface = createSurface(width * ATLAS_COLUMNS, height * ATLAS_ROWS);
+	}
+
+	return shared->surface != null;
+}
+
+/**
+ * Renders a frame of a button into its cell of the atlas.
+ * @param instance The button.
+ * @param cell The cell.
+ * @param visual What the frame looks like.
+ */
+void renderCell(win32Button *instance, int cell, const visualKey *visual)
+{
+	spriteAtlas *atlas = &instance->atlas->atlas;
+	atlasSurface *s = instance->atlas->surface;
+	// (No icon for the background of the animation frames, or while it's still being decoded)
+	HICON hIcon = atlas->key.iconId && instance->icon ? instance->icon->icon : null;
+	int iconSize = instance->iconSize;
+
+	coreRect rc;
+	atlasCellRect(atlas, cell, &rc);
+	int stride = atlas->key.width * ATLAS_COLUMNS;
+	int x = rc.left + (rectWidth(rc) - iconSize) / 2;
+	int y = rc.top + (rectHeight(rc) - iconSize) / 2;
+
+	// Finish any drawing before touching the pixels.
+	GdiFlush();
+
+	if (visual->highContrast) {
+		// Opaque black needs no blending
+		fillPixels(s->pixels, stride, rc.left, rc.top, rc.right, rc.bottom, premultiplyColor(0, 255));
+		if (hIcon) {
+			DrawIconEx(s->dc, x, y, hIcon, iconSize, iconSize, 0, null, DI_NORMAL);
+			GdiFlush();
 		}
 
-		// Get the real colour
-		backcolor = GetSysColor(backcolor);
-		forecolor = GetSysColor(forecolor);
+		// Make the colours of the icon what they need to be
+		recolorTableInit(&hcColors, visual->foreground, visual->background);
+		for (int row = rc.top; row < rc.bottom; row++) {
+			recolorPixels(&hcColors, s->pixels + (size_t)row * stride + rc.left, rectWidth(rc));
+		}
+	} else {
+		fillPixels(s->pixels, stride, rc.left, rc.top, rc.right, rc.bottom, 0);
 
-		// Create an off-screen copy of the icon
-		HDC dcBuf = CreateCompatibleDC(dc);
+		// Values come from what looks right.
+		BYTE alpha = 0;
+		if (visual->state & STATE_PRESSED) {
+			alpha = 10;
+		} else if (visual->state & STATE_HOVER) {
+			alpha = 25;
+		}
 
-		// Make the colours of the icon what they need to be by manually changing each pixel
-		// TODO: Pre-generate
+		if (alpha) {
+			AlphaRect(s->dc, *(RECT*)&rc, RGB(255, 255, 255), alpha);
+		}
 
-		// Create a buffer bitmap
-		BITMAPINFO bmi = { 0 };
-		bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
-		bmi.bmiHeader.biWidth = rc.right;
-		bmi.bmiHeader.biHeight = rc.bottom;
-		bmi.bmiHeader.biPlanes = 1;
-		bmi.bmiHeader.biBitCount = 32;
+		if (hIcon) {
+			DrawIconEx(s->dc, x, y, hIcon, iconSize, iconSize, 0, null, DI_NORMAL);
+		}
+	}
+}
 
-		UINT *pixels;
-		HBITMAP bmpBuf = CreateDIBSection(dcBuf, &bmi, DIB_RGB_COLORS, (void **) &pixels, null, 0);
-		HBITMAP origBmp = SelectObject(dcBuf, bmpBuf);
+/**
+ * Gets the cell of an atlas for a frame of a button: copied from the frames saved by an earlier run if it's there, or
+ * rendered (and added to the frames to be saved).
+ * @param instance The button.
+ * @param cell The cell.
+ * @param visual What the frame looks like.
+ * @return false if the frame was rendered without the icon (or with the previous DPI's), because it's still being
+ *  decoded.
+ */
+BOOL fillCell(win32Button *instance, int cell, const visualKey *visual)
+{
+	spriteAtlas *atlas = &instance->atlas->atlas;
+	atlasSurface *s = instance->atlas->surface;
+	if (atlas->key.iconId && instance->iconSize != scaleDpi(ICON_SIZE, instance->button.dpi)) {
+		// Still the previous DPI's icon, until this one's arrives; it's not what the frame at this DPI looks like.
+		renderCell(instance, cell, visual);
+		return false;
+	}
 
-		// Clear the buffer
-		AlphaRect(dcBuf, rc, 0, 255);
-		// Draw the icon
-		DrawIconEx(dcBuf, x, y, hIcon, iconSize, iconSize, 0, null, DI_NORMAL);
+	if (!atlas->key.iconId || !instance->iconSource) {
+		// The animation's background (or the icon file's version is unknown).
+		renderCell(instance, cell, visual);
+		return true;
+	}
 
-		// Change the pixels to the foreground colour, while taking the image's anti-aliasing into consideration.
-		int len = rc.right * rc.bottom;
-		UINT *p = pixels;
+	coreRect rc;
+	atlasCellRect(atlas, cell, &rc);
+	int stride = atlas->key.width * ATLAS_COLUMNS;
+	uint32_t *pixels = s->pixels + (size_t)rc.top * stride + rc.left;
+	frameCacheKey key = {
+		atlas->key.iconId, instance->iconSource, instance->button.dpi, atlas->key.colors,
+		visual->state | (visual->highContrast ? FRAME_CACHE_HIGH_CONTRAST : 0), rectWidth(rc), rectHeight(rc)
+	};
+
+	const uint32_t *saved = frameCacheFind(&savedFrames, &key);
+	GdiFlush();
+	if (saved) {
+		copyPixels(pixels, stride, saved, key.width, key.width, key.height);
+	} else if (instance->iconDeferred) {
+		// This frame wasn't saved, and the icon is on its way; it's rendered again when it arrives.
+		renderCell(instance, cell, visual);
+		return false;
+	} else {
+		renderCell(instance, cell, visual);
+		GdiFlush();
+		if (frameCacheWriterAdd(&newFrames, &key, pixels, stride) && !newFramesAdded) {
+			newFramesAdded = true;
+			scheduleSaveFrames();
+		}
+	}
+	return true;
+}
 
-#define TO_RGB(C) ((C << 16) & 0xff0000) | (C & 0xff00) | ((C >> 16) & 0xff)
-#define BLACK 0xff000000
-#define WHITE 0xffffffff
-		UINT bg = TO_RGB(backcolor), fg = TO_RGB(forecolor);
-		BYTE r1 = GetRValue(fg), g1 = GetGValue(fg), b1 = GetBValue(fg);
-		BYTE r2 = GetRValue(bg), g2 = GetGValue(bg), b2 = GetBValue(bg);
+/**
+ * Composes the current frame of the animation over a button's background, in the frame surface.
+ * @param instance The button.
+ * @param background The button's background cell, in its atlas.
+ * @param visual What the button looks like.
+ * @return true if the frame is in the frame surface; false to paint the atlas cell (like when the frames for this
+ *  size are still being decoded).
+ */
+BOOL composeAnimationFrame(win32Button *instance, const coreRect *background, const visualKey *visual)
+{
+	animationStrip *strip = findAnimationStrip(instance->iconSize);
+	int width = rectWidth(*background), height = rectHeight(*background);
+	if (!strip) {
+		return false;
+	}
 
-		for (int n = 0; n < len; n++, p++) {
-			// Don't calculate full black or white
-			if (*p == BLACK) {
-				*p = bg;
-			} else if (*p == WHITE) {
-				*p = fg;
-			} else {
-				// Make a colour the same distance between the background and foreground as the original's distance
-				// between black and white (assumes the original image is white on black).
-				double a = (*p & 0xff) / 255.0;
-				*p = RGB(
-					r1 * a + r2 * (1.0 - a),
-					g1 * a + g2 * (1.0 - a),
-					b1 * a + b2 * (1.0 - a)
-				);
-			}
+	if (width > frameSurfaceWidth || height > frameSurfaceHeight) {
+		// Big enough for the largest button, so buttons of different sizes don't keep re-creating it.
+		if (frameSurface) {
+			freeAtlasSurface(null, frameSurface);
 		}
+		frameSurfaceWidth = max(width, frameSurfaceWidth);
+		frameSurfaceHeight = max(height, frameSurfaceHeight);
+		frameSurface = createSurface(frameSurfaceWidth, frameSurfaceHeight);
+		if (!frameSurface) {
+			frameSurfaceWidth = frameSurfaceHeight = 0;
+			return false;
+		}
+	}
 
-		// buffer -> screen (buffer)
-		AlphaRect(dc, rc, 0, 255);
-		BitBlt(dc, 0, 0, rc.right, rc.bottom, dcBuf, 0, 0, SRCINVERT);
+	const recolorTable *hc = null;
+	if (visual->highContrast) {
+		recolorTableInit(&hcColors, visual->foreground, visual->background);
+		hc = &hcColors;
+	}
 
-		SelectObject(dcBuf, origBmp);
-		DeleteObject(bmpBuf);
-		DeleteObject(dcBuf);
+	renderAtlas *shared = instance->atlas;
+	int stride = shared->atlas.key.width * ATLAS_COLUMNS;
+	const uint32_t *cell = ((atlasSurface*)shared->surface)->pixels + (size_t)background->top * stride
+		+ background->left;
 
-	} else {
-		// Draw the not-high-contrast icon
-		// Values come from what looks right.
-		BYTE alpha = 0;
-		if (hasState(STATE_PRESSED)) {
-			alpha = 10;
-		} else if (hasState(STATE_HOVER)) {
-			alpha = 25;
+	GdiFlush();
+	animationCompose(frameSurface->pixels, frameSurfaceWidth, cell, stride, width, height,
+		animationStripFrame(strip, (uint32_t)animationFrames.frame), strip->size, hc);
+	return true;
+}
+
+/**
+ * Called from WM_PAINT to perform the drawing of a button. The frame is copied from the atlas, rendering it first if
+ * this is the first time it's been needed by any button of the same size (or copying it from the saved frames, if an
+ * earlier run rendered it). While animating, the animation's frame is drawn over the atlas cell (which has no icon).
+ * @param instance The button.
+ */
+void paint(win32Button *instance)
+{
+	RECT rc;
+	PAINTSTRUCT ps;
+	LONGLONG start = timerStart();
+
+	GetClientRect(instance->window, &rc);
+
+	visualKey visual;
+	getVisualKey(instance, &visual);
+	visualPainted(&instance->visuals, &visual);
+
+	HDC dc = BeginPaint(instance->window, &ps);
+
+	if (prepareAtlas(instance, rc.right, rc.bottom)) {
+		spriteAtlas *atlas = &instance->atlas->atlas;
+		atlasSurface *s = instance->atlas->surface;
+		int cell = atlasCell(getState(instance), instance->button.highContrast);
+		if (atlasNeedsRender(atlas, cell) && fillCell(instance, cell, &visual)) {
+			atlasRendered(atlas, cell);
 		}
 
-		if (alpha) {
-			AlphaRect(dc, rc, RGB(255, 255, 255), alpha);
+		coreRect cellRect;
+		atlasCellRect(atlas, cell, &cellRect);
+		if (isAnimating() && composeAnimationFrame(instance, &cellRect, &visual)) {
+			BitBlt(dc, 0, 0, rc.right, rc.bottom, frameSurface->dc, 0, 0, SRCCOPY);
+		} else {
+			BitBlt(dc, 0, 0, rc.right, rc.bottom, s->dc, cellRect.left, cellRect.top, SRCCOPY);
 		}
+	}
+
+	EndPaint(instance->window, &ps);
+	timerEnd(METRIC_PAINT, start);
+}
+
+/**
+ * Reads an icon file (.ico or .svg).
+ * @param file The file.
+ * @param size Receives the number of bytes read.
+ * @return The contents (free with LocalFree), or null if it can't be read.
+ */
+BYTE *readFileData(const WCHAR *file, DWORD *size)
+{
+	HANDLE handle = CreateFile(file, GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, null);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return null;
+	}
+
+	LARGE_INTEGER fileSize;
+	BYTE *data = null;
+	*size = 0;
+	// Icon files are small.
+	if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart < 0x100000) {
+		data = LocalAlloc(LMEM_FIXED, fileSize.LowPart);
+	}
+	if (data && !ReadFile(handle, data, fileSize.LowPart, size, null)) {
+		LocalFree(data);
+		data = null;
+	}
+	CloseHandle(handle);
+	return data;
+}
+
+/**
+ * Reads the images from an icon file.
+ * @param file The icon file.
+ * @param ico Receives the images. Free with icoFree, even on failure.
+ * @return true if the file has usable images.
+ */
+BOOL readIco(const WCHAR *file, icoFile *ico)
+{
+	DWORD size;
+	BYTE *data = readFileData(file, &size);
+	if (data) {
+		icoParse(data, size, ico);
+		LocalFree(data);
+	}
+	return ico->count > 0;
+}
+
+/**
+ * Reads the images from an icon file, or gets them from the cache if the file has already been read.
+ * @param file The icon file.
+ * @return The images, or null if the file couldn't be read or has no usable images.
+ */
+const icoFile *readIconFile(const WCHAR *file)
+{
+	size_t keySize = wcslen(file) * sizeof(WCHAR);
+	const icoFile *cached = iconCacheFind(&iconFiles, file, keySize);
+	if (cached) {
+		return cached;
+	}
+
+	icoFile ico = { 0 };
+	if (!readIco(file, &ico)) {
+		icoFree(&ico);
+		return null;
+	}
+	return iconCacheAdd(&iconFiles, file, keySize, &ico);
+}
+
+/**
+ * Creates an icon from 32-bit pixels.
+ * @param size The width and height.
+ * @param image The image to scale to the size (or null).
+ * @param pixels The pixels, if there's no image: BGRA, not premultiplied, top-down.
+ * @return The icon, or null on failure.
+ */
+HICON createIcon(int size, const icoImage *image, const uint32_t *pixels)
+{
+	BITMAPINFO bmi = { 0 };
+	bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+	bmi.bmiHeader.biWidth = size;
+	bmi.bmiHeader.biHeight = -size;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	void *bits;
+	HBITMAP color = CreateDIBSection(null, &bmi, DIB_RGB_COLORS, &bits, null, 0);
+	if (!color) {
+		return null;
+	}
+	if (image) {
+		icoScale(image, size, (uint32_t*)bits);
+	} else {
+		memcpy(bits, pixels, (size_t)size * size * sizeof(uint32_t));
+	}
+
+	// The alpha channel is used, so the mask is all zeros (rows are 16-bit aligned).
+	void *maskBits = LocalAlloc(LPTR, ((size + 15) / 16) * 2 * size);
+	HBITMAP mask = CreateBitmap(size, size, 1, 1, maskBits);
+
+	ICONINFO info = { 0 };
+	info.fIcon = true;
+	info.hbmColor = color;
+	info.hbmMask = mask;
+	HICON icon = mask ? CreateIconIndirect(&info) : null;
+
+	DeleteObject(color);
+	if (mask) {
+		DeleteObject(mask);
+	}
+	if (maskBits) {
+		LocalFree(maskBits);
+	}
+	return icon;
+}
+
+/**
+ * Creates an icon of the given size, from the images of an icon file (picking the nearest size, and scaling it).
+ * @param file The icon file.
+ * @param size The size.
+ * @return The icon, or null if the file couldn't be read.
+ */
+HICON loadIcon(const WCHAR *file, int size)
+{
+	const icoFile *ico = readIconFile(file);
+	const icoImage *image = ico ? icoSelect(ico, size) : null;
+	return image ? createIcon(size, image, null) : null;
+}
+
+/**
+ * Reads an SVG icon, or gets the one that's already been read. Only the current one is kept.
+ * @param file The SVG file.
+ * @return The icon, or null if it couldn't be read.
+ */
+svgIcon *getVectorIcon(const WCHAR *file)
+{
+	if (vectorFile && !wcscmp(vectorFile, file)) {
+		// Read before (or tried to be).
+		return vectorLoaded ? &vectorIcon : null;
+	}
+
+	if (vectorFile) {
+		LocalFree(vectorFile);
+	}
+	svgIconFree(&vectorIcon);
+	vectorFile = StrDup(file);
+
+	DWORD size;
+	BYTE *data = readFileData(file, &size);
+	vectorLoaded = data && svgParse(data, size, &vectorIcon.image);
+	if (data) {
+		LocalFree(data);
+	}
+	if (!vectorLoaded) {
+		// (Logged by the caller)
+		svgIconFree(&vectorIcon);
+	}
+	return vectorLoaded ? &vectorIcon : null;
+}
+
+/**
+ * Creates an icon of the given size from an SVG file, drawn at that size (each size is only drawn once).
+ * @param file The SVG file.
+ * @param size The size.
+ * @return The icon, or null if the file couldn't be read.
+ */
+HICON loadVectorIcon(const WCHAR *file, int size)
+{
+	svgIcon *icon = getVectorIcon(file);
+	const uint32_t *pixels = icon ? svgIconGet(icon, size) : null;
+	return pixels ? createIcon(size, null, pixels) : null;
+}
+
+/** Forgets the SVG icon. */
+void freeVectorIcon()
+{
+	svgIconFree(&vectorIcon);
+	if (vectorFile) {
+		LocalFree(vectorFile);
+		vectorFile = null;
+	}
+	vectorLoaded = false;
+}
+
+/**
+ * Sets the icon, of every button.
+ * @param file The icon file.
+ */
+void setImage(WCHAR *file)
+{
+	// If the passed file points to the current one, then don't free+dup it
+	if (iconFile != file) {
+		if (iconFile) {
+			LocalFree(iconFile);
+		}
+		iconFile = file ? StrDup(file) : null;
+	}
+
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		loadButtonIcon(getButton(buttons.entries[n].button));
+	}
+}
+
+/**
+ * Gets the files a button's icon comes from, for its high-contrast mode.
+ * @param instance The button.
+ * @param file Receives the icon file (null if there's no icon).
+ * @param vector Receives the SVG rendition of it, if there is one and it's used (otherwise null).
+ */
+void getIconFiles(win32Button *instance, WCHAR **file, WCHAR **vector)
+{
+	WCHAR *iconFileHC = (WCHAR*)host->iconFileHC;
+	BOOL useHC = instance->button.highContrast && iconFileHC;
+	*file = useHC ? iconFileHC : iconFile;
+	// The SVG is a rendition of the normal icon, drawn at the exact size rather than scaled.
+	*vector = (*file && !useHC) ? (WCHAR*)host->iconSvg : null;
+}
+
+/**
+ * Gets the version of an icon file, without reading it: a hash of its size and modification time.
+ * @param file The file.
+ * @return The version, or 0 if the file isn't there.
+ */
+uint32_t getIconSource(const WCHAR *file)
+{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesEx(file, GetFileExInfoStandard, &info)) {
+		return 0;
+	}
+	DWORD stamp[4] = {
+		info.nFileSizeLow, info.nFileSizeHigh, info.ftLastWriteTime.dwLowDateTime, info.ftLastWriteTime.dwHighDateTime
+	};
+	return hashBytes(stamp, sizeof(stamp));
+}
+
+/** What the decoder thread needs to decode an icon, or the frames of an animation (iconJob.request). */
+typedef struct {
+	/** The icon file, and its SVG rendition (or null) */
+	WCHAR *file;
+	WCHAR *vector;
+	/** Set by the decoder thread: the SVG rendition couldn't be read; the error, if the icon couldn't be decoded */
+	BOOL vectorFailed;
+	DWORD error;
+	/** For an animation (iconJob.iconId is its animationId), instead of an icon: the frame files, null-separated */
+	WCHAR *frames;
+	uint32_t frameCount;
+	/** Set by the decoder thread: the frames that couldn't be read (a bit each), and how long it took (ticks) */
+	uint32_t failedFrames;
+	LONGLONG decodeTime;
+} iconRequest;
+
+/**
+ * Frees an icon request.
+ * @param request The request.
+ */
+void freeIconRequest(iconRequest *request)
+{
+	if (request->file) {
+		LocalFree(request->file);
+	}
+	if (request->vector) {
+		LocalFree(request->vector);
+	}
+	if (request->frames) {
+		LocalFree(request->frames);
+	}
+	LocalFree(request);
+}
+
+/**
+ * Frees what the decoder thread made for a request, if it's not wanted.
+ * @param job The job; an icon, or an animation's frames.
+ */
+void freeIconResult(const iconJob *job)
+{
+	if (job->result) {
+		if (((iconRequest*)job->request)->frames) {
+			free(job->result);
+		} else {
+			DestroyIcon(job->result);
+		}
+	}
+}
+
+/**
+ * Decodes an icon: drawn from the SVG rendition, or scaled from the icon file. Uses iconFiles and vectorIcon, so
+ * only the decoder thread calls it while it's running. It mustn't log.
+ * @param request The files. The failures are recorded in it.
+ * @param size The size.
+ * @return The icon, or null if it couldn't be decoded.
+ */
+HICON decodeIcon(iconRequest *request, int size)
+{
+	HICON hIcon = null;
+	if (request->vector) {
+		hIcon = loadVectorIcon(request->vector, size);
+		request->vectorFailed = !hIcon;
+	}
+	if (!hIcon) {
+		hIcon = loadIcon(request->file, size);
+	}
+	if (!hIcon) {
+		// Not something the parser understands; let Windows try.
+		hIcon = LoadImage(null, request->file, IMAGE_ICON, size, size, LR_LOADFROMFILE);
+	}
+	if (!hIcon) {
+		request->error = GetLastError();
+	}
+	return hIcon;
+}
+
+/**
+ * Decodes the frames of an animation: each frame's file is read, scaled and premultiplied. Like decodeIcon, only the
+ * decoder thread calls it while it's running, and it mustn't log.
+ * @param request The frames. The ones that couldn't be read are recorded in it (and left blank).
+ * @param size The icon size.
+ * @return The pixels of the frames, one after the other (see animationStrip), or null if there's no memory.
+ */
+uint32_t *decodeAnimation(iconRequest *request, int size)
+{
+	LONGLONG start = timerStart();
+	size_t frameSize = (size_t)size * size;
+	uint32_t *pixels = calloc(frameSize * request->frameCount, sizeof(uint32_t));
+	const WCHAR *file = request->frames;
+	for (uint32_t n = 0; pixels && n < request->frameCount; n++, file += wcslen(file) + 1) {
+		// Not cached like the icons: the frames would push them out.
+		icoFile ico = { 0 };
+		const icoImage *image = readIco(file, &ico) ? icoSelect(&ico, size) : null;
+		if (image) {
+			icoScale(image, size, pixels + frameSize * n);
+			premultiplyPixels(pixels + frameSize * n, frameSize);
+		} else {
+			request->failedFrames |= 1u << n;
+		}
+		icoFree(&ico);
+	}
+	request->decodeTime = timerStart() - start;
+	return pixels;
+}
+
+/**
+ * Logs the failures of an icon request, once its icon has been decoded (or not).
+ * @param request The request.
+ * @param hIcon The icon.
+ */
+void logIconFailures(const iconRequest *request, HICON hIcon)
+{
+	if (request->vectorFailed) {
+		log("fail: SVG icon %s", request->vector);
+	}
+	if (!hIcon) {
+		logWrite(LOG_FAIL, request->error, L"fail: LoadImage %s", request->file);
+	}
+}
+
+/**
+ * The icon decoder thread. Decodes the requested icons (and animation frames), whenever there are some, and posts
+ * WM_ICON_READY after each one. Runs on its own thread, so it mustn't log.
+ * @param param The window to post the message to.
+ */
+DWORD WINAPI iconDecoder(LPVOID param)
+{
+	HWND target = param;
+	while (!atomicLoad(&iconStopping)) {
+		WaitForSingleObject(iconEvent, INFINITE);
+
+		iconJob job;
+		while (!atomicLoad(&iconStopping) && iconLoaderNext(&iconLoading, &job)) {
+			iconRequest *request = job.request;
+			job.result = request->frames ? (void*)decodeAnimation(request, job.size) : decodeIcon(request, job.size);
+			iconLoaderDone(&iconLoading, &job);
+			PostMessage(target, WM_ICON_READY, 0, 0);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Starts the icon decoder thread. If it can't be started, icons are decoded on the UI thread.
+ * @param target The window which is told when an icon is ready (WM_ICON_READY).
+ */
+void startIconDecoder(HWND target)
+{
+	if (!target) {
+		return;
+	}
+
+	atomicStore(&iconStopping, 0);
+	iconEvent = CreateEvent(null, false, false, null);
+	iconThread = iconEvent ? CreateThread(null, 0, iconDecoder, target, 0, null) : null;
+	if (!iconThread) {
+		fail("Unable to start the icon decoder");
+	}
+}
+
+/**
+ * Stops the icon decoder thread, and discards the icons that were on their way.
+ */
+void stopIconDecoder()
+{
+	if (iconThread) {
+		atomicStore(&iconStopping, 1);
+		SetEvent(iconEvent);
+		WaitForSingleObject(iconThread, INFINITE);
+		CloseHandle(iconThread);
+		iconThread = null;
+	}
+	if (iconEvent) {
+		CloseHandle(iconEvent);
+		iconEvent = null;
+	}
+
+	// The thread has gone, so the requests it didn't get to can be taken from its end of the queue.
+	iconJob job;
+	while (iconQueuePop(&iconLoading.requests, &job)) {
+		freeIconRequest(job.request);
+	}
+	while (iconLoaderTake(&iconLoading, &job)) {
+		freeIconResult(&job);
+		freeIconRequest(job.request);
+	}
+	memset(&iconLoading, 0, sizeof(iconLoading));
+}
+
+/**
+ * Decodes a button's icon: on the decoder thread, or here if the thread isn't running. Nothing is requested if the
+ * icon is already on its way, or if too many are (it's asked for again when one arrives).
+ * @param instance The button.
+ * @param icon The icon it's waiting for.
+ * @return true if the icon has been decoded (or failed to be) here; false if it's on its way.
+ */
+BOOL decodeButtonIcon(win32Button *instance, renderIcon *icon)
+{
+	WCHAR *f, *vector;
+	getIconFiles(instance, &f, &vector);
+
+	iconRequest *request = LocalAlloc(LPTR, sizeof(iconRequest));
+	if (!request || !(request->file = StrDup(f))) {
+		fail("LocalAlloc");
+		if (request) {
+			LocalFree(request);
+		}
+		return true;
+	}
+	request->vector = vector ? StrDup(vector) : null;
+
+	if (!iconThread) {
+		icon->icon = decodeIcon(request, icon->size);
+		logIconFailures(request, icon->icon);
+		freeIconRequest(request);
+		return true;
+	}
+
+	iconJob job = { icon->iconId, icon->size, request, null };
+	if (iconLoaderRequest(&iconLoading, &job) == ICON_REQUEST_QUEUED) {
+		SetEvent(iconEvent);
+	} else {
+		freeIconRequest(request);
+	}
+	return false;
+}
+
+void animationDecoded(uint32_t id, int size, iconRequest *request, uint32_t *pixels);
+void requestAnimationStrip(int size);
+
+/**
+ * Shows an icon on a button, instead of the one it had.
+ * @param instance The button.
+ * @param icon The icon, which the button now holds (null for none).
+ * @param source Identifies the version of the icon file.
+ * @param deferred The icon hasn't been decoded, but its frames were saved.
+ */
+void showIcon(win32Button *instance, renderIcon *icon, uint32_t source, BOOL deferred)
+{
+	trayButton *b = &instance->button;
+	renderIconRelease(&render, instance->icon);
+	instance->icon = icon;
+	instance->iconSource = source;
+	instance->iconDeferred = deferred;
+	// The button is drawn at the size of the icon it has, rather than the one that's on its way.
+	instance->iconSize = icon ? icon->size : scaleDpi(ICON_SIZE, b->dpi);
+
+	b->hasIcon = icon && (icon->icon || deferred);
+	if (b->hasIcon) {
+		milestone(MILESTONE_ICON);
+	}
+	// A new size needs its own animation frames; the icon is shown until they're decoded.
+	requestAnimationStrip(instance->iconSize);
+	positionTrayWindows(instance, true);
+}
+
+/**
+ * Takes the icons the decoder thread has decoded (WM_ICON_READY), and shows them on the buttons which are waiting for
+ * them. Buttons keep showing their previous icon until then. Also takes the animation frames it's decoded.
+ */
+void iconsReady()
+{
+	iconJob job;
+	while (iconLoaderTake(&iconLoading, &job)) {
+		if (((iconRequest*)job.request)->frames) {
+			animationDecoded(job.iconId, job.size, job.request, job.result);
+			freeIconRequest(job.request);
+			continue;
+		}
+
+		renderIcon *icon = null;
+		for (uint32_t n = 0; n < RENDER_SLOTS && !icon; n++) {
+			renderIcon *r = &render.icons[n];
+			if (r->iconId == job.iconId && r->size == job.size && !r->icon) {
+				icon = r;
+			}
+		}
+
+		logIconFailures(job.request, job.result);
+		freeIconRequest(job.request);
+		if (icon) {
+			icon->icon = job.result;
+		} else if (job.result) {
+			// Changed again before it arrived.
+			DestroyIcon(job.result);
+			continue;
+		}
+
+		for (uint32_t n = 0; icon && n < buttons.count; n++) {
+			win32Button *instance = getButton(buttons.entries[n].button);
+			if (instance->loading == icon) {
+				instance->loading = null;
+				// The cells drawn while it was on its way have the previous icon.
+				if (instance->atlas) {
+					atlasInvalidate(&instance->atlas->atlas);
+				}
+				visualInvalidate(&instance->visuals);
+				showIcon(instance, icon, instance->loadingSource, false);
+				redraw(instance);
+			} else if (instance->icon == icon && instance->iconDeferred) {
+				// The frames that weren't saved can now be rendered.
+				instance->iconDeferred = false;
+				visualInvalidate(&instance->visuals);
+				redraw(instance);
+			}
+		}
+	}
+
+	// Ask again for the icons that couldn't be requested.
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		win32Button *instance = getButton(buttons.entries[n].button);
+		renderIcon *waiting[] = { instance->iconDeferred ? instance->icon : null, instance->loading };
+		for (size_t w = 0; w < ARRAYSIZE(waiting); w++) {
+			renderIcon *icon = waiting[w];
+			if (icon && !icon->icon && !iconLoaderPending(&iconLoading, icon->iconId, icon->size)) {
+				decodeButtonIcon(instance, icon);
+			}
+		}
+		requestAnimationStrip(instance->iconSize);
+	}
+}
+
+/**
+ * Loads the icon of a button, for its size and high-contrast mode. Buttons of the same size share the icon, so it's
+ * only decoded for the first one. Does nothing if the button already has it.
+ *
+ * The icon is decoded on the decoder thread, so a slow disk doesn't hold up the taskbar; the button keeps its current
+ * icon until the new one arrives (see iconsReady). If an earlier run saved the icon's frames at this DPI, it's shown
+ * straight away, so the first paint only needs to copy them.
+ * @param instance The button.
+ */
+void loadButtonIcon(win32Button *instance)
+{
+	trayButton *b = &instance->button;
+	// (instance->iconSize stays as the current icon's until the new one is shown)
+	int iconSize = scaleDpi(ICON_SIZE, b->dpi);
+	WCHAR *f, *vector;
+	getIconFiles(instance, &f, &vector);
+	WCHAR *source = vector ? vector : f;
+	uint32_t id = f ? hashBytes(source, wcslen(source) * sizeof(WCHAR)) : 0;
+
+	renderIcon *current = instance->icon;
+	if (f && current && current->iconId == id && current->size == iconSize
+		&& (current->icon || instance->iconDeferred)) {
+		// Already loaded; the one it was waiting for is no longer wanted.
+		renderIconRelease(&render, instance->loading);
+		instance->loading = null;
+		return;
+	}
+
+	LONGLONG start = timerStart();
+	renderIcon *icon = null;
+	if (f && iconSize) {
+		icon = renderIconAcquire(&render, instance->loading, id, iconSize);
+	} else {
+		renderIconRelease(&render, instance->loading);
+	}
+	instance->loading = null;
+	uint32_t iconSource = icon ? getIconSource(source) : 0;
+
+	if (!icon || icon->icon) {
+		// No icon, or it's already been decoded for another button.
+		showIcon(instance, icon, iconSource, false);
+	} else if (iconThread && iconSource && frameCacheHasIcon(&savedFrames, id, iconSource, b->dpi)) {
+		// Decoded in the background, for the frames that weren't saved.
+		showIcon(instance, icon, iconSource, true);
+		decodeButtonIcon(instance, icon);
+	} else {
+		instance->loading = icon;
+		instance->loadingSource = iconSource;
+		if (decodeButtonIcon(instance, icon)) {
+			instance->loading = null;
+			showIcon(instance, icon, iconSource, false);
+		}
+	}
+	timerEnd(METRIC_SET_IMAGE, start);
+}
+
+/**
+ * Sets the tooltip of a button.
+ * @param instance The button.
+ * @param tooltip
+ */
+void setButtonToolTip(win32Button *instance, WCHAR *tooltip)
+{
+    if (!instance->tooltipWindow) {
+        instance->tooltipWindow = CreateWindowEx(0,
+                                       TOOLTIPS_CLASS, NULL,
+                                       WS_POPUP | TTS_ALWAYSTIP | TTS_NOPREFIX | TTS_BALLOON,
+                                       0, 0,
+                                       0, 0,
+                                       instance->window,
+                                       NULL, NULL, NULL);
+    }
+
+    TOOLINFO ti = { 0 };
+    ti.cbSize = sizeof(ti);
+    ti.hwnd = instance->window;
+    ti.uFlags = TTF_SUBCLASS;
+    ti.lpszText = tooltip;
+    GetClientRect(instance->window, &ti.rect);
+
+    SendMessage(instance->tooltipWindow, TTM_ADDTOOL, 0, (LPARAM)&ti);
+}
+
+/**
+ * Sets the host's tooltip, on every button.
+ */
+void setToolTip()
+{
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		setButtonToolTip(getButton(buttons.entries[n].button), (WCHAR*)host->toolTip);
+	}
+}
+
+/**
+ * Called when a message from gpii has been received.
+ * @param id The command (HOST_COMMAND_*)
+ * @param data The data
+ */
+void gotGpiiMessage(DWORD id, WCHAR* data)
+{
+	LONGLONG start = timerStart();
+	log("gotGpiiMessage(%u,%s)", id, data);
+
+	if (!gpiiWindow || !IsWindow(gpiiWindow)) {
+		findGpiiWindow();
+	}
+
+	if (id != HOST_COMMAND_BATCH) {
+		// Batches are handled by gotGpiiBatch.
+		trayHostCommand(host, id, (hostChar*)data, data ? wcslen(data) : 0);
+	}
+
+	timerEnd(METRIC_RECEIVE, start);
+}
+
+/**
+ * Called when a batch of messages from gpii has been received. The commands are applied in order, then the icon is
+ * loaded and the button redrawn (once), if required.
+ * @param data The batch (see core/batch.h).
+ * @param size The size of the batch, in bytes.
+ */
+void gotGpiiBatch(const void *data, size_t size)
+{
+	LONGLONG start = timerStart();
+	log("gotGpiiBatch(%u)", (UINT)size);
+
+	if (!gpiiWindow || !IsWindow(gpiiWindow)) {
+		findGpiiWindow();
+	}
+
+	if (!trayHostBatch(host, data, size)) {
+		log("Malformed batch");
+	}
+
+	timerEnd(METRIC_RECEIVE, start);
+}
+
+/**
+ * Applies the host's settings to the buttons (hostBackend.apply). A batch of commands only gets here once.
+ * @param h The host.
+ * @param changes What has changed (HOST_CHANGED_*).
+ */
+void win32Apply(trayHost *h, uint32_t changes)
+{
+	if (changes & HOST_CHANGED_STATE) {
+		setChecked(h->checked);
+	}
+	if (changes & HOST_CHANGED_TOOLTIP) {
+		setToolTip();
+	}
+	if (changes & HOST_CHANGED_ICON) {
+		// Also performs the layout and redraw.
+		traceMessage(TRACE_ICON);
+		setImage((WCHAR*)h->iconFile);
+	}
+	if (changes & HOST_CHANGED_ANIMATION) {
+		setAnimation();
+	}
+	saveState();
+}
+
+void win32Metrics(trayHost *h)
+{
+#ifdef TRAY_BUTTON_LIBRARY
+	// The caller gets them with trayButtonMetrics.
+	trayHostEvent(h, HOST_EVENT_METRICS);
+#else
+	dumpMetrics();
+#endif
+}
+
+void win32Destroy(trayHost *h)
+{
+	die = true;
+	removeButtons();
+	if (!hosted) {
+		PostQuitMessage(0);
+	}
+}
+
+/**
+ * Gets the time of an event: the same clock as the pipe's timestamps, and node's process.hrtime.
+ */
+uint64_t win32HostNow(trayHost *h)
+{
+	return pipeNow();
+}
+
+/** What's done with the host's settings */
+hostBackend win32Backend = {
+	win32Apply,
+	win32Metrics,
+	win32Destroy,
+	win32HostNow,
+	null
+};
+
+/**
+ * Gets a snapshot of the metrics, as JSON.
+ * @param json Receives the JSON.
+ * @param size Size of the buffer.
+ * @return The length of the JSON, or 0 if it didn't fit.
+ */
+size_t formatMetrics(char *json, size_t size)
+{
+	// Totals of the buttons that are there now.
+	uint32_t wakeups = 0, skipped = 0, lookups = taskbarWindows.lookups;
+	for (uint32_t n = 0; n < buttons.count; n++) {
+		win32Button *instance = getButton(buttons.entries[n].button);
+		wakeups += instance->button.scheduler.wakeups;
+		skipped += instance->visuals.skipped;
+		lookups += instance->windows.lookups;
+	}
+	counters[COUNT_TIMER_WAKEUP].count = wakeups;
+	counters[COUNT_ICON_FILE_READ].count = iconFiles.misses;
+	counters[COUNT_REDRAW_SKIPPED].count = skipped;
+	counters[COUNT_WINDOW_LOOKUP].count = lookups;
+	counters[COUNT_SAVED_FRAME].count = savedFrames.hits;
+	counters[COUNT_RENDERED_FRAME].count = savedFrames.misses;
+	counters[COUNT_ICON_DECODED].count = iconLoading.completed;
+	return metricsFormat(json, size, counters, ARRAYSIZE(counters), timers, ARRAYSIZE(timers));
+}
+
+/**
+ * Writes a snapshot of the metrics to stdout, as "metrics: {json}".
+ */
+void dumpMetrics()
+{
+	char json[METRICS_JSON_LENGTH];
+	if (formatMetrics(json, sizeof(json))) {
+		log("metrics: %hs", json);
+	}
+}
+
+/**
+ * Makes a button the one gpii shows its window next to, when it's clicked.
+ * @param instance The button.
+ */
+void activateButton(win32Button *instance)
+{
+	win32Button *active = instance->primary ? null : instance;
+	if (active != activeButton) {
+		activeButton = active;
+		coreRect *rect = &instance->button.layout.notifiedRect;
+		if (rectWidth(*rect) > 0) {
+			trayHostPosition(host, rect);
+		}
+	}
+}
+
+/**
+ * Records a span of the button's time, and logs it as "span: <trace event>" (see core/span.h).
+ * @param name What it was.
+ * @param sequence The event it belongs to.
+ * @param flags SPAN_FLOW_*.
+ * @param start When it started (pipeNow).
+ * @param end When it ended.
+ */
+void recordSpan(const char *name, uint32_t sequence, uint32_t flags, uint64_t start, uint64_t end)
+{
+	char json[SPAN_EVENT_LENGTH];
+	const span *s = spanRecord(&spans, name, sequence, flags, start, end);
+	if (spanFormatEvent(s, GetCurrentProcessId(), GetCurrentThreadId(), json, sizeof(json))) {
+		log("span: %hs", json);
+	}
+}
+
+/**
+ * Handles a click of a button: gpii's window is activated so its popup or menu can take focus, and gpii is told. Each
+ * step is recorded as a span, so the time between the click and the popup can be followed into gpii.
+ * @param instance The button.
+ * @param event HOST_EVENT_CLICK or HOST_EVENT_MENU.
+ */
+void buttonClicked(win32Button *instance, uint32_t event)
+{
+	uint64_t start = pipeNow();
+	SetForegroundWindow(gpiiWindow);
+	uint64_t activated = pipeNow();
+
+	activateButton(instance);
+	uint64_t notify = pipeNow();
+	uint32_t sequence = trayHostEvent(host, event);
+	uint64_t end = pipeNow();
+
+	recordSpan(event == HOST_EVENT_CLICK ? "click" : "menu", sequence, 0, start, end);
+	recordSpan("SetForegroundWindow", sequence, 0, start, activated);
+	recordSpan("notify", sequence, SPAN_FLOW_OUT, notify, end);
+}
+
+LRESULT CALLBACK buttonWndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
+{
+	COPYDATASTRUCT *copyData;
+	win32Button *instance = (win32Button*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+
+	if (msg == WM_NCCREATE) {
+		// The button is passed to CreateWindowEx.
+		instance = ((CREATESTRUCT*)lp)->lpCreateParams;
+		instance->window = hwnd;
+		SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)instance);
+	}
+	if (!instance) {
+		return DefWindowProc(hwnd, msg, wp, lp);
+	}
+
+	switch (msg) {
+	case WM_CREATE:
+		log("WM_CREATE");
+		if (instance->primary) {
+			// Ask gpii for an update.
+			trayHostEvent(host, HOST_EVENT_UPDATE);
+		}
+		break;
+
+	case WM_COPYDATA:
+		// A command from GPII.
+		copyData = (COPYDATASTRUCT*)lp;
+		if (copyData && copyData->dwData == HOST_COMMAND_BATCH) {
+			// Binary data, with its own length.
+			gotGpiiBatch(copyData->lpData, copyData->cbData);
+		} else if (copyData) {
+			if (copyData->lpData) {
+				// lpData should be a string - enforce the null at the end
+				memset((char*)copyData->lpData + copyData->cbData - 2, 0, 2);
+			}
+			gotGpiiMessage(copyData->dwData, copyData->lpData);
+		} else {
+			fail("Got WM_COPYDATA with no data");
+		}
+		break;
+
+	case WM_MOUSEMOVE:
+		// Draw the highlight
+		if (!hasState(instance, STATE_HOVER)) {
+			// Inform gpii
+			trayHostEvent(host, HOST_EVENT_ENTER);
+			// Detect when the mouse leaves.
+			TRACKMOUSEEVENT tme = { 0 };
+			tme.cbSize = sizeof(tme);
+			tme.dwFlags = TME_LEAVE;
+			tme.hwndTrack = hwnd;
+			TrackMouseEvent(&tme);
+
+			setState(instance, STATE_HOVER);
+		}
+	break;
+
+	case WM_MOUSELEAVE:
+		trayHostEvent(host, HOST_EVENT_LEAVE);
+		unsetState(instance, STATE_HOVER | STATE_PRESSED);
+		break;
+
+	case WM_LBUTTONDOWN:
+		setState(instance, STATE_PRESSED);
+		break;
+
+	case WM_LBUTTONUP:
+		buttonClicked(instance, HOST_EVENT_CLICK);
+		unsetState(instance, STATE_PRESSED);
+		break;
+
+	case WM_RBUTTONUP:
+		buttonClicked(instance, HOST_EVENT_MENU);
+		return 0;
+
+	case WM_TIMER:
+		debug("timer %u", wp);
+		switch (wp) {
+		case TIMER_CHECK:
+			// Periodic checks that GPII still exists.
+			if (!hosted && gpiiWindow && !IsWindow(gpiiWindow)) {
+				log("gpiiWindow no longer exists");
+				PostQuitMessage(0);
+				break;
+			}
+			if (instance->primary) {
+				// Pick up taskbars that appeared after the monitor was added (or "show on all displays" was set).
+				syncButtons();
+			}
+			buttonTimer(&instance->button, TIMER_CHECK);
+			break;
+		case TIMER_METRICS:
+			dumpMetrics();
+			break;
+		case TIMER_RESIZE:
+			buttonTimer(&instance->button, TIMER_RESIZE);
+			break;
+		default:
+			break;
+		}
+		break;
+
+	case WM_SIZE:
+	case WM_WINDOWPOSCHANGED:
+		if (instance->primary) {
+			traceMessage(TRACE_SIZE);
+		}
+		positionTrayWindows(instance, true);
+		break;
+
+	case WM_ERASEBKGND:
+		if (instance->primary) {
+			traceMessage(TRACE_ERASE);
+		}
+		positionTrayWindows(instance, false);
+		break;
+
+	case WM_PAINT:
+		paint(instance);
+		break;
+
+	case WM_DPICHANGED:
+		// Set the current one to the given one (for < win10); the icon for the new size is loaded.
+		instance->button.dpi = getDpi(hwnd, LOWORD(wp));
+		loadButtonIcon(instance);
+		break;
+
+	case WM_SETTINGCHANGE:
+		// The system colours may have changed. Every button gets this, but it only needs doing once.
+		if (instance->primary) {
+			renderSetInvalidate(&render);
+			traceMessage(TRACE_SETTING);
+		}
+		buttonSettingChange(&instance->button);
+		break;
+
+	case WM_DISPLAYCHANGE:
+		if (instance->primary) {
+			traceMessage(TRACE_DISPLAY);
+		}
+		positionTrayWindows(instance, true);
+		break;
+
+	case WM_DESTROY:
+		if (instance->primary && !clearingButtons) {
+			if (hosted) {
+				// The message loop is the host's; the buttons are put back when the taskbar is.
+				scheduleSync();
+			} else {
+				PostQuitMessage(die ? 0 : 1);
+			}
+		}
+		break;
+
+	case WM_NCDESTROY:
+		SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+		instance->window = null;
+		if (buttonSetRemove(&buttons, &instance->button)) {
+			// Not removed by detachButton, so its taskbar has gone by itself.
+			freeButton(instance);
+		}
+		break;
+
+	default:
+		if (msg == shellMessage) {
+			// Only the primary button gets these, but the taskbars on the other monitors change too.
+			countMetric(COUNT_SHELL_MESSAGE);
+			traceMessage(TRACE_SHELL);
+			LONGLONG start = timerStart();
+			buttonSetShellMessage(&buttons);
+			timerEnd(METRIC_POSITION, start);
+		}
+		break;
+	}
+
+	return DefWindowProc(hwnd, msg, wp, lp);
+}
+
+/**
+ * Creates a button on a taskbar (buttonSetHooks.attach).
+ * @return The button, or null if its window couldn't be created.
+ */
+trayButton *attachButton(void *context, windowHandle taskbar, bool primary)
+{
+	win32Button *instance = LocalAlloc(LPTR, sizeof(win32Button));
+	if (!instance) {
+		fail("LocalAlloc");
+		return null;
+	}
+
+	instance->platform = win32Platform;
+	instance->taskbar = (HWND)taskbar;
+	instance->primary = primary;
+	windowSystem system = win32Windows;
+	system.context = instance;
+	windowCacheInit(&instance->windows, &system);
+
+	trayButton *b = &instance->button;
+	buttonInit(b, &instance->platform, BUTTON_WIDTH, TIMER_RESIZE_DELAY, TIMER_CHECK_MIN_DELAY, TIMER_CHECK_MAX_DELAY);
+	b->dpi = getDpi(instance->taskbar, 0);
+	buttonCheckHighContrast(b);
+
+	// Where it was last time, if the taskbar hasn't changed: it's first painted there, rather than moved there.
+	coreRect rect = { 0, 0, BUTTON_WIDTH, 40 };
+	RECT taskbarRect;
+	if (primary && haveLastState && lastState.dpi == b->dpi && rectWidth(lastState.buttonRect) > 0
+		&& GetWindowRect(instance->taskbar, &taskbarRect)
+		&& rectEquals((coreRect*)&taskbarRect, &lastState.taskbarRect)) {
+		rect = lastState.buttonRect;
+		b->layout.buttonRect = rect;
+	}
+
+	// Create the button window
+	HWND window = CreateWindowEx(
+		WS_EX_TOOLWINDOW,
+		BUTTON_CLASS,
+		BUTTON_CLASS,
+		WS_VISIBLE | WS_CHILD | WS_CLIPSIBLINGS | WS_TABSTOP,
+		rect.left, rect.top, rectWidth(rect), rectHeight(rect),
+		instance->taskbar,
+		null,
+		0,
+		instance);
+
+	if (!window) {
+		// Sometimes CreateWindowEx fails with ERROR_ACCESS_DENIED (can be reproduced if the start menu is open)
+		// Also, creating without a parent but using SetParent returns ERROR_INVALID_PARAMETER, under the same
+		// conditions.
+		createError = GetLastError();
+		LocalFree(instance);
+		return null;
+	}
+
+	log("Button created on %s taskbar %p", primary ? L"the primary" : L"a secondary", taskbar);
+	startTimer(instance, TIMER_CHECK, schedulerActivity(&b->scheduler, GetTickCount64()));
+	if (primary) {
+		startTimer(instance, TIMER_METRICS, METRICS_INTERVAL);
+	}
+
+	if (host->toolTip) {
+		setButtonToolTip(instance, (WCHAR*)host->toolTip);
+	}
+	if (iconFile) {
+		// gpii has already said what it looks like.
+		loadButtonIcon(instance);
+	}
+
+	return b;
+}
+
+/**
+ * Frees a button, after its window has gone.
+ * @param instance The button.
+ */
+void freeButton(win32Button *instance)
+{
+	if (activeButton == instance) {
+		activeButton = null;
+	}
+	if (instance->tooltipWindow) {
+		// Its owner is the taskbar (the button is a child window), so it isn't destroyed with the button.
+		DestroyWindow(instance->tooltipWindow);
+	}
+	renderIconRelease(&render, instance->icon);
+	renderIconRelease(&render, instance->loading);
+	renderAtlasRelease(&render, instance->atlas);
+	LocalFree(instance);
+}
+
+/**
+ * Removes a button from its taskbar (buttonSetHooks.detach).
+ */
+void detachButton(void *context, trayButton *button)
+{
+	win32Button *instance = getButton(button);
+	HWND taskbar = instance->taskbar;
+	if (instance->window) {
+		// It's already out of the set, so WM_NCDESTROY leaves the freeing to here.
+		DestroyWindow(instance->window);
+	}
+	freeButton(instance);
+	relayoutTaskbar(taskbar);
+}
+
+/** How the buttons are created and removed */
+buttonSetHooks win32Buttons = { attachButton, detachButton, null };
+
+/**
+ * Puts a button on each taskbar, and removes the ones whose taskbar has gone.
+ * @return true if there's a button on the primary taskbar.
+ */
+BOOL syncButtons()
+{
+	windowHandle taskbars[BUTTON_SET_MAX + 1];
+	uint32_t count = 0;
+
+	// The primary button stays until its window is destroyed (when explorer restarts, that ends the message loop).
+	trayButton *primary = buttonSetPrimary(&buttons);
+	taskbars[count++] = primary ? (windowHandle)getButton(primary)->taskbar : (windowHandle)getTaskbarWindow();
+
+	HWND secondary = null;
+	while (count < ARRAYSIZE(taskbars)
+		&& (secondary = FindWindowEx(null, secondary, secondaryClasses[WINDOW_TRAY], null))) {
+		taskbars[count++] = secondary;
+	}
+
+	if (buttonSetSync(&buttons, taskbars, count)) {
+		log("Buttons: %u", buttons.count);
+	}
+	return buttonSetPrimary(&buttons) != null;
+}
+
+/**
+ * Removes all the buttons, without ending the message loop.
+ */
+void removeButtons()
+{
+	clearingButtons = true;
+	buttonSetClear(&buttons);
+	clearingButtons = false;
+	activeButton = null;
+	updateAnimationVisibility();
+}
+
+// How long to wait for the taskbar, if TaskbarCreated doesn't arrive first (ms)
+#define TASKBAR_WAIT_MIN 50
+#define TASKBAR_WAIT_MAX 2000
+// How long to wait before complaining about there being no taskbar (ms)
+#define TASKBAR_WAIT_WARN (100 * 1000)
+// Delays between attempts to create the button window (ms)
+#define CREATE_RETRY_MIN 10
+#define CREATE_RETRY_MAX 1000
+
+/** Receives the TaskbarCreated broadcast, which only goes to top-level windows */
+HWND watcherWindow = null;
+UINT taskbarCreatedMessage = 0;
+/** Signalled by the shell when it's ready (if it exists) */
+HANDLE shellReadyEvent = null;
+
+/** Watcher timer for creating the buttons, when hosted (there's no loop of its own to wait in) */
+#define TIMER_SYNC 1
+backoff syncRetry;
+/** Watcher timer for the animation frames, of every button */
+#define TIMER_ANIMATION 2
+/** Watcher timer for saving the frames rendered since the last save */
+#define TIMER_SAVE_FRAMES 3
+/** Delay before saving new frames (ms), so the frames for a change of state are saved together */
+#define SAVE_FRAMES_DELAY (30 * 1000)
+/** Where the frames are saved, between runs */
+#define FRAMES_FILE L"%LOCALAPPDATA%\\gpii-tray-button.frames"
+/** Where the snapshot of the state is kept, between runs */
+#define STATE_FILE L"%LOCALAPPDATA%\\gpii-tray-button.state"
+
+/**
+ * Gets the path of a file kept between runs.
+ * @param file The path, with environment variables (FRAMES_FILE or STATE_FILE).
+ * @param path Receives the path.
+ * @return false if there's nowhere to keep it.
+ */
+BOOL getDataFile(const WCHAR *file, WCHAR path[MAX_PATH])
+{
+	DWORD length = ExpandEnvironmentStrings(file, path, MAX_PATH);
+	// (Unexpanded if the variable isn't set)
+	return length && length <= MAX_PATH && !wcschr(path, L'%');
+}
+
+/**
+ * Gets the path of the file of saved frames.
+ * @param path Receives the path.
+ * @return false if there's nowhere to save them.
+ */
+BOOL getFramesFile(WCHAR path[MAX_PATH])
+{
+	return getDataFile(FRAMES_FILE, path);
+}
+
+/**
+ * Maps the file of frames saved by earlier runs, and starts the next version of it with those frames.
+ */
+void openSavedFrames()
+{
+	WCHAR path[MAX_PATH];
+	frameCacheWriterInit(&newFrames);
+	newFramesAdded = false;
+	if (!getFramesFile(path)) {
+		return;
+	}
+
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, null, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, null);
+	if (file == INVALID_HANDLE_VALUE) {
+		// The first run.
+		return;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = null;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < 0x1000000) {
+		mapping = CreateFileMapping(file, null, PAGE_READONLY, 0, 0, null);
+	}
+	CloseHandle(file);
+	if (mapping) {
+		// The view keeps the mapping open.
+		savedFramesView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+
+	if (savedFramesView && frameCacheOpen(&savedFrames, savedFramesView, size.LowPart)) {
+		frameCacheWriterKeep(&newFrames, &savedFrames);
+		log("Saved frames: %u", savedFrames.count);
+	} else if (savedFramesView) {
+		log("Saved frames ignored");
+	}
+}
+
+/**
+ * Unmaps the file of saved frames, and forgets the frames that weren't saved.
+ */
+void closeSavedFrames()
+{
+	KillTimer(watcherWindow, TIMER_SAVE_FRAMES);
+	frameCacheWriterFree(&newFrames);
+	newFramesAdded = false;
+	frameCacheClose(&savedFrames);
+	if (savedFramesView) {
+		UnmapViewOfFile(savedFramesView);
+		savedFramesView = null;
+	}
+}
+
+/**
+ * Saves the frames rendered since the file was mapped, by replacing it with a new version. Does nothing if there
+ * aren't any.
+ */
+void saveFrames()
+{
+	WCHAR path[MAX_PATH], temp[MAX_PATH + 4];
+	if (!newFramesAdded || !getFramesFile(path)) {
+		return;
+	}
+
+	size_t size;
+	uint8_t *data = frameCacheWriterFinish(&newFrames, &size);
+	// The frames that are kept are in the old file, which can't be replaced while it's mapped.
+	closeSavedFrames();
+
+	if (data) {
+		_snwprintf_s(temp, ARRAYSIZE(temp), _TRUNCATE, L"%s.new", path);
+		HANDLE file = CreateFile(temp, GENERIC_WRITE, 0, null, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, null);
+		DWORD written = 0;
+		BOOL ok = file != INVALID_HANDLE_VALUE && WriteFile(file, data, (DWORD)size, &written, null)
+			&& written == size;
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		// Replaced in one go, so another instance never maps half of it.
+		if (!ok || !MoveFileEx(temp, path, MOVEFILE_REPLACE_EXISTING)) {
+			fail("Saving frames");
+			DeleteFile(temp);
+		}
+		free(data);
+	}
+
+	openSavedFrames();
+}
+
+/**
+ * Saves the frames after a while, unless it's already going to.
+ */
+void scheduleSaveFrames()
+{
+	if (watcherWindow) {
+		SetTimer(watcherWindow, TIMER_SAVE_FRAMES, SAVE_FRAMES_DELAY, null);
+	}
+}
+
+/**
+ * Maps the file of the state snapshot, read-write. The view is shared memory backed by the file, so a write is only a
+ * copy into memory, and it's still there when the process dies.
+ */
+void openState()
+{
+	WCHAR path[MAX_PATH];
+	if (!getDataFile(STATE_FILE, path)) {
+		return;
+	}
+
+	HANDLE file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		null, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, null);
+	if (file == INVALID_HANDLE_VALUE) {
+		fail("Opening the state file");
+		return;
+	}
+	// Grows a new (or short) file to the size of the snapshot, with zeros.
+	HANDLE mapping = CreateFileMapping(file, null, PAGE_READWRITE, 0, SNAPSHOT_SIZE, null);
+	CloseHandle(file);
+	if (mapping) {
+		// The view keeps the mapping open.
+		stateView = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, SNAPSHOT_SIZE);
+		CloseHandle(mapping);
+	}
+	if (!stateView) {
+		fail("Mapping the state file");
+	}
+}
+
+/**
+ * Unmaps the file of the state snapshot.
+ */
+void closeState()
+{
+	if (stateView) {
+		UnmapViewOfFile(stateView);
+		stateView = null;
+	}
+}
+
+/**
+ * Puts the settings and position of the last run back, so the button can be shown before gpii says what it looks
+ * like. gpii still sends everything when the button asks for an update, but only what's different is applied.
+ */
+void restoreState()
+{
+	static const char *reasons[] = { "restored", "empty", "from another version", "busy", "damaged" };
+	if (!stateView) {
+		return;
+	}
+
+	int result = snapshotRead(stateView, &lastState);
+	haveLastState = result == SNAPSHOT_OK;
+	log("State %hs", reasons[result]);
+	if (haveLastState && lastState.batchLength) {
+		if (!hosted) {
+			// Otherwise, the first layout would take gpii for gone, and throw the settings away before it's connected.
+			findGpiiWindow();
+		}
+		// Applied like gpii's batch: in one go.
+		trayHostBatch(host, lastState.batch, lastState.batchLength * sizeof(uint16_t));
+	}
+}
+
+/**
+ * Saves the settings and the primary button's position in the snapshot, if they've changed. A button without an icon
+ * isn't saved: gpii hasn't said what it looks like yet, or it has gone.
+ */
+void saveState()
+{
+	static stateSnapshot state;
+	if (!stateView || !host || !host->iconFile) {
+		return;
+	}
 
-		DrawIconEx(dc, x, y, hIcon, iconSize, iconSize, 0, 0, DI_NORMAL);
+	state = lastState;
+	size_t length = trayHostSaveBatch(host, state.batch, SNAPSHOT_MAX_BATCH);
+	if (!length) {
+		// Too long to keep.
+		return;
+	}
+	state.batchLength = length;
+
+	trayButton *primary = buttonSetPrimary(&buttons);
+	if (primary && rectWidth(primary->layout.buttonRect) > 0) {
+		win32Button *instance = getButton(primary);
+		GetWindowRect(instance->taskbar, (RECT*)&state.taskbarRect);
+		state.buttonRect = primary->layout.buttonRect;
+		state.screenRect = primary->layout.notifiedRect;
+		state.dpi = primary->dpi;
 	}
 
-	// Commit the buffer.
-	EndBufferedPaint(paintBuffer, true);
-	EndPaint(buttonWindow, &ps);
+	// Most calls (a relayout that moved nothing, or gpii sending the same settings again) leave it as it was.
+	if (haveLastState && snapshotEquals(&state, &lastState)) {
+		return;
+	}
+	snapshotWrite(stateView, &state);
+	lastState = state;
+	haveLastState = true;
 }
 
 /**
- * Sets the icon.
- * @param file The icon file.
+ * Starts the animation timer, or stops it.
+ * @param delay The delay until the next frame (ms), or 0 to stop it.
  */
-void setImage(WCHAR *file)
+void setAnimationTimer(UINT delay)
 {
-	if (hIcon) {
-		DestroyIcon(hIcon);
-		hIcon = null;
+	if (!watcherWindow) {
+		return;
 	}
-
-	// If the passed file points to the current one, then don't free+dup it
-	if (iconFile != file) {
-		if (iconFile) {
-			LocalFree(iconFile);
-		}
-		iconFile = file ? StrDup(file) : null;
+	if (delay) {
+		// Not coalesced: frames need to be on time.
+		SetTimer(watcherWindow, TIMER_ANIMATION, delay, null);
+	} else {
+		KillTimer(watcherWindow, TIMER_ANIMATION);
 	}
+}
 
-	iconSize = fixDpi(ICON_SIZE);
-
-	WCHAR *f = (highContrast && iconFileHC) ? iconFileHC : iconFile;
-	if (iconSize && f) {
-		hIcon = LoadImage(null, f, IMAGE_ICON, iconSize, iconSize, LR_LOADFROMFILE);
-		if (!hIcon) {
-			fail("LoadImage %p", f);
+/**
+ * Plays the host's animation, or stops it if there's none.
+ */
+void setAnimation()
+{
+	const hostChar *data = host ? host->animation : null;
+	size_t length = hostStringLength(data);
+	UINT delay = 0;
+
+	frameSchedulerStop(&animationFrames);
+	animationId = 0;
+	if (data) {
+		if (animationParse(data, length, &animation)) {
+			animationId = hashBytes(data, length * sizeof(hostChar));
+			delay = frameSchedulerStart(&animationFrames, animation.frameCount, animation.interval, animation.loops,
+				GetTickCount64());
+			// Decoded away from the painting; the buttons show their icon until then.
+			for (uint32_t n = 0; n < buttons.count; n++) {
+				requestAnimationStrip(getButton(buttons.entries[n].button)->iconSize);
+			}
+		} else {
+			log("Malformed animation");
 		}
 	}
 
-	positionTrayWindows(true);
+	setAnimationTimer(delay);
+	redrawAll();
 }
 
 /**
- * Sets the current tooltip
- * @param tooltip
+ * The animation timer has fired: shows the frame for the current time.
  */
-void setToolTip(WCHAR *tooltip)
+void animationTimer()
 {
-    if (!tooltipWindow) {
-        tooltipWindow = CreateWindowEx(0,
-                                       TOOLTIPS_CLASS, NULL,
-                                       WS_POPUP | TTS_ALWAYSTIP | TTS_NOPREFIX | TTS_BALLOON,
-                                       0, 0,
-                                       0, 0,
-                                       buttonWindow,
-                                       NULL, NULL, NULL);
-    }
+	LONGLONG start = timerStart();
+	int32_t frame = animationFrames.frame;
 
-    TOOLINFO ti = { 0 };
-    ti.cbSize = sizeof(ti);
-    ti.hwnd = buttonWindow;
-    ti.uFlags = TTF_SUBCLASS;
-    ti.lpszText = tooltip;
-    GetClientRect(buttonWindow, &ti.rect);
+	setAnimationTimer(frameSchedulerTick(&animationFrames, GetTickCount64()));
+	if (animationFrames.frame != frame) {
+		// (When it's ended, this shows the icon again)
+		redrawAll();
+	}
 
-    SendMessage(tooltipWindow, TTM_ADDTOOL, 0, (LPARAM)&ti);
+	timerEnd(METRIC_ANIMATION, start);
 }
 
 /**
- * Called when a message from gpii has been received.
- * @param id The command
- * @param data The data
+ * Pauses the animation while none of the buttons are showing, and resumes it when one is.
  */
-void gotGpiiMessage(DWORD id, WCHAR* data)
+void updateAnimationVisibility()
 {
-	log("gotGpiiMessage(%u,%s)", id, data);
-
-	if (!gpiiWindow || !IsWindow(gpiiWindow)) {
-		findGpiiWindow();
+	bool hidden = true;
+	for (uint32_t n = 0; n < buttons.count && hidden; n++) {
+		win32Button *instance = getButton(buttons.entries[n].button);
+		hidden = !instance->button.hasIcon || !IsWindowVisible(instance->window);
 	}
 
-	switch (id) {
-	case GPII_COMMAND_ICON:
-		setImage(data);
-		break;
-	case GPII_COMMAND_ICON_HC:
-	    if (iconFileHC) {
-	        LocalFree(iconFileHC);
-	    }
-	    iconFileHC = StrDup(data);
+	if (hidden != animationFrames.hidden) {
+		setAnimationTimer(frameSchedulerSetHidden(&animationFrames, hidden, GetTickCount64()));
+	}
+}
 
-		setImage(iconFile);
-		break;
+/**
+ * Finds the frames of the current animation at an icon size.
+ * @param size The icon size.
+ * @return The frames, or null if they haven't been decoded (yet).
+ */
+animationStrip *findAnimationStrip(int size)
+{
+	for (uint32_t n = 0; n < RENDER_SLOTS; n++) {
+		animationStrip *s = &animationStrips[n];
+		if (s->pixels && s->animationId == animationId && s->size == size) {
+			return s;
+		}
+	}
+	return null;
+}
 
-	case GPII_COMMAND_TOOLTIP:
-	    setToolTip(data);
-		break;
+/**
+ * Asks for the frames of the current animation to be decoded at an icon size, if they haven't been. They're decoded on
+ * the decoder thread (or here, if it isn't running), rather than when painting; the buttons of that size show their
+ * icon until they arrive (see animationDecoded).
+ * @param size The icon size.
+ */
+void requestAnimationStrip(int size)
+{
+	if (!animationId || size <= 0 || !host || !host->animation || findAnimationStrip(size)
+		|| iconLoaderPending(&iconLoading, animationId, size)) {
+		return;
+	}
 
-	case GPII_COMMAND_STATE:
-	{
-		BOOL on = CompareStringOrdinal(data, -1, L"true", -1, true) == CSTR_EQUAL;
-		if (on) {
-			setState(STATE_CHECKED);
-		} else {
-			unsetState(STATE_CHECKED);
+	// The file names are copied, so the decoder thread doesn't look at the host's animation.
+	size_t length = 0;
+	for (uint32_t n = 0; n < animation.frameCount; n++) {
+		length += min(animation.frames[n].length, MAX_PATH - 1) + 1;
+	}
+	iconRequest *request = LocalAlloc(LPTR, sizeof(iconRequest));
+	if (!request || !(request->frames = LocalAlloc(LPTR, length * sizeof(WCHAR)))) {
+		fail("LocalAlloc");
+		if (request) {
+			LocalFree(request);
 		}
-		break;
+		return;
+	}
+	request->frameCount = animation.frameCount;
+	WCHAR *file = request->frames;
+	for (uint32_t n = 0; n < animation.frameCount; n++) {
+		uint32_t frameLength = min(animation.frames[n].length, MAX_PATH - 1);
+		memcpy(file, host->animation + animation.frames[n].offset, frameLength * sizeof(WCHAR));
+		file += frameLength + 1;
 	}
-	case GPII_COMMAND_DESTROY:
-		die = true;
-		DestroyWindow(buttonWindow);
-		PostQuitMessage(0);
-		break;
 
-	default:
-		break;
+	if (!iconThread) {
+		animationDecoded(animationId, size, request, decodeAnimation(request, size));
+		freeIconRequest(request);
+		return;
+	}
+
+	iconJob job = { animationId, size, request, null };
+	if (iconLoaderRequest(&iconLoading, &job) == ICON_REQUEST_QUEUED) {
+		SetEvent(iconEvent);
+	} else {
+		// Asked for again when an icon arrives.
+		freeIconRequest(request);
 	}
 }
 
-LRESULT CALLBACK buttonWndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
+/**
+ * Keeps the frames of an animation that have been decoded, and shows them on the buttons of that size.
+ * @param id The animation they're for.
+ * @param size The icon size.
+ * @param request The request, which says which frames couldn't be read.
+ * @param pixels The decoded frames (null if there was no memory); freed here.
+ */
+void animationDecoded(uint32_t id, int size, iconRequest *request, uint32_t *pixels)
 {
-	COPYDATASTRUCT *copyData;
+	timerAdd(METRIC_ANIMATION_STRIP, request->decodeTime);
+	if (id != animationId || !pixels) {
+		// Stopped (or changed) before it arrived.
+		free(pixels);
+		return;
+	}
 
-	switch (msg) {
-	case WM_CREATE:
-		log("WM_CREATE");
-		if (!buttonWindow) {
-			buttonWindow = hwnd;
+	const WCHAR *file = request->frames;
+	for (uint32_t n = 0; n < request->frameCount; n++, file += wcslen(file) + 1) {
+		if (request->failedFrames & (1u << n)) {
+			// Left blank.
+			log("fail: Animation frame %s", file);
 		}
+	}
 
-		// Ask gpii for an update.
-		sendToGpii(gpiiMessage, GPII_MSG_UPDATE, 0);
-		break;
-
-	case WM_COPYDATA:
-		// A command from GPII.
-		copyData = (COPYDATASTRUCT*)lp;
-		if (copyData) {
-			if (copyData->lpData) {
-				// lpData should be a string - enforce the null at the end
-				memset((char*)copyData->lpData + copyData->cbData - 2, 0, 2);
-			}
-			gotGpiiMessage(copyData->dwData, copyData->lpData);
-		} else {
-			fail("Got WM_COPYDATA with no data");
+	animationStrip *strip = null;
+	for (uint32_t n = 0; n < RENDER_SLOTS && !strip; n++) {
+		if (animationStrips[n].animationId != animationId) {
+			// For an old animation.
+			strip = &animationStrips[n];
 		}
-		break;
-
-	case WM_MOUSEMOVE:
-		// Draw the highlight
-		if (!hasState(STATE_HOVER)) {
-			// Inform gpii
-			sendToGpii(gpiiMessage, GPII_MSG_MOUSEENTER, 0);
-			// Detect when the mouse leaves.
-			TRACKMOUSEEVENT tme = { 0 };
-			tme.cbSize = sizeof(tme);
-			tme.dwFlags = TME_LEAVE;
-			tme.hwndTrack = hwnd;
-			TrackMouseEvent(&tme);
+	}
+	if (!strip) {
+		strip = &animationStrips[nextStrip];
+		nextStrip = (nextStrip + 1) % RENDER_SLOTS;
+	}
 
-			setState(STATE_HOVER);
-		}
-	break;
+	if (animationStripPrepare(strip, animationId, size, request->frameCount)) {
+		memcpy(strip->pixels, pixels, (size_t)size * size * request->frameCount * sizeof(uint32_t));
+	}
+	free(pixels);
 
-	case WM_MOUSELEAVE:
-		sendToGpii(gpiiMessage, GPII_MSG_MOUSELEAVE, 0);
-		unsetState(STATE_HOVER | STATE_PRESSED);
-		break;
+	// The buttons of this size go from their icon to the animation.
+	redrawAll();
+}
 
-	case WM_LBUTTONDOWN:
-		setState(STATE_PRESSED);
-		break;
+/**
+ * Called when the primary button has been created.
+ */
+void primaryCreated()
+{
+	milestone(MILESTONE_WINDOW);
 
-	case WM_LBUTTONUP:
-		// Activate the GPII window so the popup can take focus
-		SetForegroundWindow(gpiiWindow);
+	// The shell hook needs the window to exist. Only the primary button gets the messages.
+	if (RegisterShellHookWindow(getButton(buttonSetPrimary(&buttons))->window)) {
+		milestone(MILESTONE_SHELL_HOOK);
+	} else {
+		fail("RegisterShellHookWindow");
+	}
+}
 
-		sendToGpii(gpiiMessage, GPII_MSG_CLICK, 0);
-		unsetState(STATE_PRESSED);
-		break;
+/**
+ * Creates the buttons later, when hosted: the taskbar isn't there, or the primary button has gone with it.
+ */
+void scheduleSync()
+{
+	// The button closes with the taskbar; when explorer restarts, the new taskbar windows could have the old handles.
+	windowCacheInvalidate(&taskbarWindows);
+	backoffInit(&syncRetry, CREATE_RETRY_MIN, TASKBAR_WAIT_MAX);
+	SetTimer(watcherWindow, TIMER_SYNC, backoffNext(&syncRetry), null);
+}
 
-	case WM_RBUTTONUP:
-		// Activate the GPII window so the menu can take focus
-		SetForegroundWindow(gpiiWindow);
+/**
+ * Gets when the process started, so the startup milestones include the time taken to load.
+ * @return The start time, on the GetTickCount64 clock.
+ */
+ULONGLONG getProcessStartTime()
+{
+	ULONGLONG now = GetTickCount64();
+	FILETIME created, exited, kernel, user, current;
+	if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+		GetSystemTimeAsFileTime(&current);
+		ULARGE_INTEGER c = { created.dwLowDateTime, created.dwHighDateTime };
+		ULARGE_INTEGER n = { current.dwLowDateTime, current.dwHighDateTime };
+		// 100ns units
+		ULONGLONG age = n.QuadPart > c.QuadPart ? (n.QuadPart - c.QuadPart) / 10000 : 0;
+		if (age < now) {
+			return now - age;
+		}
+	}
+	return now;
+}
 
-		sendToGpii(gpiiMessage, GPII_MSG_SHOWMENU, 0);
+LRESULT CALLBACK watcherWndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
+{
+	if (msg == taskbarCreatedMessage && msg) {
+		// Explorer has (re-)started; its windows are new, even if the handles aren't.
+		log("TaskbarCreated");
+		windowCacheInvalidate(&taskbarWindows);
+		if (hosted && !buttonSetPrimary(&buttons)) {
+			scheduleSync();
+		}
 		return 0;
-
-	case WM_TIMER:
-		debug("timer %u", wp);
-		switch (wp) {
-		case TIMER_CHECK:
-			// Periodic checks that GPII still exists.
-			if (gpiiWindow && !IsWindow(gpiiWindow)) {
-				log("gpiiWindow no longer exists");
-				PostQuitMessage(0);
-				break;
-			}
-			SetTimer(buttonWindow, TIMER_CHECK, TIMER_CHECK_DELAY, null);
-			redraw();
-			// fall through
-		case TIMER_RESIZE:
-			positionTrayWindows(false);
-			break;
-		default:
-			break;
+	} else if (msg == WM_DISPLAYCHANGE) {
+		// A monitor may have been added or removed; its taskbar follows shortly after.
+		if (buttonSetPrimary(&buttons)) {
+			syncButtons();
 		}
-		break;
+	} else if (msg == WM_PIPE_FRAME) {
+		pipeReceived((pipeFrame*)lp);
+		return 0;
+	} else if (msg == WM_ICON_READY) {
+		iconsReady();
+		return 0;
+	} else if (msg == WM_TIMER && wp == TIMER_ANIMATION) {
+		animationTimer();
+		return 0;
+	} else if (msg == WM_TIMER && wp == TIMER_SAVE_FRAMES) {
+		KillTimer(hwnd, TIMER_SAVE_FRAMES);
+		saveFrames();
+		return 0;
+	} else if (msg == WM_TIMER && wp == TIMER_SYNC) {
+		if (syncButtons()) {
+			KillTimer(hwnd, TIMER_SYNC);
+			milestone(MILESTONE_TASKBAR);
+			primaryCreated();
+		} else {
+			SetTimer(hwnd, TIMER_SYNC, backoffNext(&syncRetry), null);
+		}
+		return 0;
+	}
+	return DefWindowProc(hwnd, msg, wp, lp);
+}
 
-	case WM_SIZE:
-	case WM_WINDOWPOSCHANGED:
-		positionTrayWindows(true);
-		break;
+/**
+ * Creates the hidden window which is told when the taskbar is created.
+ */
+void createWatcher()
+{
+	taskbarCreatedMessage = RegisterWindowMessage(L"TaskbarCreated");
 
-	case WM_ERASEBKGND:
-		positionTrayWindows(false);
-		break;
+	WNDCLASS cls = { 0 };
+	cls.lpfnWndProc = watcherWndProc;
+	cls.lpszClassName = WATCHER_CLASS;
+	if (!RegisterClass(&cls)) {
+		fail("RegisterClass (watcher)");
+	}
 
-	case WM_PAINT:
-		paint();
-		break;
+	// Not a message-only window (HWND_MESSAGE), because they don't receive broadcasts.
+	watcherWindow = CreateWindowEx(WS_EX_TOOLWINDOW, WATCHER_CLASS, WATCHER_CLASS, WS_POPUP, 0, 0, 0, 0,
+		null, null, 0, null);
+	if (!watcherWindow) {
+		fail("CreateWindowEx (watcher)");
+	}
 
-	case WM_DPICHANGED:
-		// Set the current one to the given one (for < win10), then call getDpi to make the real check
-		currentDpi = LOWORD(wp);
-		getDpi(buttonWindow);
-		setImage(iconFile);
-		break;
+	// Set when the shell has started (Windows 8+).
+	shellReadyEvent = OpenEvent(SYNCHRONIZE, FALSE, L"ShellDesktopSwitchEvent");
+}
 
-	case WM_SETTINGCHANGE:
-		if (checkHighContrast()) {
-			// If high-contrast has changed, the icon will need to be reloaded.
-			setImage(iconFile);
-		}
-		// fall through
-	case WM_DISPLAYCHANGE:
-		positionTrayWindows(true);
-		break;
+/**
+ * Waits until something happens: a message (like TaskbarCreated), the shell becoming ready, or the timeout.
+ * Messages are dispatched.
+ * @param timeout The longest time to wait (ms).
+ */
+void waitForEvent(DWORD timeout)
+{
+	DWORD count = shellReadyEvent ? 1 : 0;
+	DWORD result = MsgWaitForMultipleObjects(count, &shellReadyEvent, FALSE, timeout, QS_ALLINPUT);
+	if (count && result == WAIT_OBJECT_0) {
+		// It stays signalled, so it's only useful once.
+		log("Shell ready");
+		CloseHandle(shellReadyEvent);
+		shellReadyEvent = null;
+	}
 
-	case WM_NCDESTROY:
-	case WM_DESTROY:
-		PostQuitMessage(die ? 0 : 1);
-		break;
+	MSG msg;
+	while (PeekMessage(&msg, null, 0, 0, PM_REMOVE)) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
 
-	default:
-		if (msg == shellMessage) {
-			// The taskbar reacts to shell messages, so there's a good chance something will need to be redrawn.
-			if (!positionTrayWindows(false)) {
-				redraw();
-			}
+/**
+ * Waits for the taskbar to exist.
+ * @return The taskbar window.
+ */
+HWND waitForTaskbar()
+{
+	HWND taskbar;
+	backoff wait;
+	backoffInit(&wait, TASKBAR_WAIT_MIN, TASKBAR_WAIT_MAX);
+	ULONGLONG start = GetTickCount64();
+	BOOL warned = false;
+
+	while (!(taskbar = getTaskbarWindow())) {
+		ULONGLONG waited = GetTickCount64() - start;
+		if (!warned && waited > TASKBAR_WAIT_WARN) {
+			fail("No taskbar after %u seconds", (UINT)(waited / 1000));
+			warned = true;
 		}
-		break;
+		// TaskbarCreated ends the wait; the timeout is in case it was missed.
+		waitForEvent(backoffNext(&wait));
 	}
 
-	return DefWindowProc(hwnd, msg, wp, lp);
+	milestone(MILESTONE_TASKBAR);
+	return taskbar;
 }
 
-#ifdef _DEBUG
-int main(int argc, char **argv)
-#else
-int CALLBACK WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmd, int show)
-#endif
+/**
+ * Sets up everything except the buttons: the watcher, the window class, and the host.
+ * @param callback Where the button's events go.
+ * @param context Passed to the callback.
+ * @return false if the host couldn't be created.
+ */
+BOOL startButton(hostCallback callback, void *context)
 {
-	log("Started");
+	windowCacheInit(&taskbarWindows, &win32Windows);
+	createWatcher();
+	startIconDecoder(watcherWindow);
 
 	// Used to communicate with GPII
 	gpiiMessage = RegisterWindowMessage(BUTTON_MESSAGE);
 	gpiiPositionMessage = RegisterWindowMessage(BUTTON_POSITION_MESSAGE);
 
+	host = trayHostCreate(&win32Backend, callback, context);
+	if (!host) {
+		fail("trayHostCreate");
+		return false;
+	}
+
 	// See if there's already an instance
 	HANDLE existing = FindWindowEx(getTaskbarWindow(), null, BUTTON_CLASS, null);
 	if (existing) {
@@ -809,7 +3389,7 @@ int CALLBACK WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmd, int show)
 
 		// Tell it to die
 		COPYDATASTRUCT copyData = { 0 };
-		copyData.dwData = GPII_COMMAND_DESTROY;
+		copyData.dwData = HOST_COMMAND_DESTROY;
 		SendMessage(existing, WM_COPYDATA, 0, (LPARAM)&copyData);
 	}
 
@@ -822,61 +3402,155 @@ int CALLBACK WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmd, int show)
 		fail("RegisterClass");
 	}
 
-	if (BufferedPaintInit() != S_OK) {
-		fail("BufferedPaintInit");
+	shellMessage = RegisterWindowMessage(L"SHELLHOOK");
+
+	buttonSetInit(&buttons, &win32Buttons);
+	renderSetInit(&render, &win32Render);
+	openSavedFrames();
+	openState();
+	restoreState();
+	frameSchedulerInit(&animationFrames);
+	// There are no buttons to show it yet.
+	frameSchedulerSetHidden(&animationFrames, true, GetTickCount64());
+	return true;
+}
+
+/**
+ * Removes the buttons, and frees everything startButton made.
+ */
+void stopButton()
+{
+	removeButtons();
+	hideButton();
+	stopIconDecoder();
+	renderSetClear(&render);
+	for (uint32_t n = 0; n < RENDER_SLOTS; n++) {
+		animationStripFree(&animationStrips[n]);
+	}
+	if (frameSurface) {
+		freeAtlasSurface(null, frameSurface);
+		frameSurface = null;
+		frameSurfaceWidth = frameSurfaceHeight = 0;
+	}
+	iconCacheClear(&iconFiles);
+	freeVectorIcon();
+	solidPoolClear(&solidSurfaces, freeSolidSurface);
+	saveFrames();
+	closeSavedFrames();
+	closeState();
+	if (watcherWindow) {
+		DestroyWindow(watcherWindow);
+		watcherWindow = null;
+	}
+	if (shellReadyEvent) {
+		CloseHandle(shellReadyEvent);
+		shellReadyEvent = null;
+	}
+	UnregisterClass(BUTTON_CLASS, null);
+	UnregisterClass(WATCHER_CLASS, null);
+	trayHostDestroy(host);
+	host = null;
+}
+
+#ifdef TRAY_BUTTON_LIBRARY
+
+trayHost *trayButtonStart(hostCallback callback, void *context)
+{
+	if (host) {
+		// The windows and their state belong to the process.
+		return null;
+	}
+
+	hosted = true;
+	die = false;
+	milestonesStart(&startup, GetTickCount64());
+	startLogging();
+	milestone(MILESTONE_STARTED);
+
+	if (!startButton(callback, context)) {
+		stopLogging();
+		hosted = false;
+		return null;
 	}
+	log("Initialised (in-process)");
 
-	RegisterShellHookWindow(buttonWindow);
-	shellMessage = RegisterWindowMessage(L"SHELLHOOK");
+	// Created by the watcher's timer, which keeps trying until the taskbar is there.
+	scheduleSync();
+	return host;
+}
+
+void trayButtonStop()
+{
+	if (!host) {
+		return;
+	}
+
+	die = true;
+	KillTimer(watcherWindow, TIMER_SYNC);
+	stopButton();
+	hosted = false;
+
+	dumpMetrics();
+	log("Stopped");
+	stopLogging();
+}
+
+size_t trayButtonTrace(char *buffer, size_t size)
+{
+	return spanFormatTrace(&spans, "tray-button", GetCurrentProcessId(), GetCurrentThreadId(), buffer, size);
+}
+
+size_t trayButtonMetrics(char *buffer, size_t size)
+{
+	return formatMetrics(buffer, size);
+}
+
+#else
+
+#ifdef _DEBUG
+int main(int argc, char **argv)
+#else
+int CALLBACK WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmd, int show)
+#endif
+{
+	milestonesStart(&startup, getProcessStartTime());
+	startLogging();
+	milestone(MILESTONE_STARTED);
+
+	tracing = GetEnvironmentVariable(TRACE_VARIABLE, null, 0) > 0;
+	traceStart = GetTickCount64();
+
+	if (!startButton(gpiiEvent, null)) {
+		stopLogging();
+		return 1;
+	}
+	// Or a pipe, if gpii made one.
+	pipeConnect(watcherWindow);
 
 	log("Initialised");
 
 	MSG msg = { 0 };
 	do {
 		// Wait for explorer to start
-		HWND taskbar;
-		int seconds = 0;
-		while (!(taskbar = getTaskbarWindow())) {
-			if (seconds++ == 100) {
-				fail("No taskbar after %u seconds", seconds);
-			}
-			Sleep(1000);
-		}
-
-		log("Found taskbar");
-
-		currentDpi = getDpi(taskbar);
-		checkHighContrast();
+		waitForTaskbar();
 
 		DWORD lastError = 0;
-		do {
-			// Create the button window
-			buttonWindow = CreateWindowEx(
-				WS_EX_TOOLWINDOW,
-				BUTTON_CLASS,
-				BUTTON_CLASS,
-				WS_VISIBLE | WS_CHILD | WS_CLIPSIBLINGS | WS_TABSTOP,
-				0, 0, BUTTON_WIDTH, 40,
-				taskbar,
-				null,
-				0,
-				null);
-
-			if (!buttonWindow) {
-				// Sometimes CreateWindowEx fails with ERROR_ACCESS_DENIED (can be reproduced if the start menu is open)
-				// Also, creating without a parent but using SetParent returns ERROR_INVALID_PARAMETER, under the same
-				// conditions.
-				DWORD thisError = GetLastError();
-				if (thisError != lastError) {
-					fail("CreateWindowEx (retrying)");
-					lastError = thisError;
-				}
-				Sleep(1000);
+		backoff retry;
+		backoffInit(&retry, CREATE_RETRY_MIN, CREATE_RETRY_MAX);
+		createError = 0;
+		// Create the buttons; continue trying until the one on the primary taskbar has been created.
+		while (!syncButtons()) {
+			if (createError != lastError) {
+				SetLastError(createError);
+				fail("CreateWindowEx (retrying)");
+				lastError = createError;
 			}
-			// Continue trying to create the window if it didn't succeed.
-		} while (!buttonWindow);
+			waitForEvent(backoffNext(&retry));
+			// The taskbar may have gone in the meantime.
+			waitForTaskbar();
+		}
 
-		SetTimer(buttonWindow, TIMER_CHECK, TIMER_CHECK_DELAY, null);
+		primaryCreated();
 
 		while (GetMessage(&msg, null, 0, 0))
 		{
@@ -885,13 +3559,26 @@ int CALLBACK WinMain(HINSTANCE hInst, HINSTANCE hPrevInst, LPSTR cmd, int show)
 		}
 
 		log("Window closed");
+		// The buttons on the other taskbars go too; they're put back with the primary one.
+		removeButtons();
+		// The button closes with the taskbar; when explorer restarts, the new taskbar windows could have the old handles.
+		// (TaskbarCreated is only broadcast to top-level windows, which the button isn't.)
+		windowCacheInvalidate(&taskbarWindows);
+		if (!die) {
+			// Time how long it takes to get back.
+			milestonesRestart(&startup, GetTickCount64());
+		}
 		// Re-create the window if it closes unexpectedly.
 	} while (!die);
 
-	hideButton();
-	BufferedPaintUnInit();
+	stopButton();
+	pipeClose();
 
-	log("Stopped")
+	dumpMetrics();
+	log("Stopped");
+	stopLogging();
 
 	return msg.wParam;
 }
+
+#endif /* TRAY_BUTTON_LIBRARY */
@@ -0,0 +1,56 @@
+/* Task tray button.
+ * The button as a library, for putting it on the taskbar from the host application's own process.
+ *
+ * Copyright 2018 Raising the Floor - International
+ *
+ * Licensed under the New BSD license. You may not use this file except in
+ * compliance with this License.
+ *
+ * You may obtain a copy of the License at
+ * https://github.com/GPII/universal/blob/master/LICENSE.txt
+ */
+
+#ifndef TRAY_BUTTON_H
+#define TRAY_BUTTON_H
+
+#include "core/host.h"
+#include "core/metrics.h"
+#include "core/span.h"
+
+/*
+ * Built into tray-button.c when TRAY_BUTTON_LIBRARY is defined (instead of WinMain). The button's windows belong to
+ * the calling thread, so that thread needs to be running a message loop (as Electron's main thread does). The
+ * settings are given to the host with the trayHost* functions, and the events arrive at the callback, on that thread.
+ */
+
+/**
+ * Starts the button. It appears once there's an icon, and the taskbar is there.
+ * @param callback Receives the button's events.
+ * @param context Passed to the callback.
+ * @return The host, or null if there's already one (there's only one button per process), or it couldn't start.
+ */
+trayHost *trayButtonStart(hostCallback callback, void *context);
+
+/**
+ * Removes the button, and frees the host.
+ */
+void trayButtonStop();
+
+/**
+ * Gets the spans of the most recent clicks, as a Chrome trace (see core/span.h).
+ * @param buffer Receives the JSON (always null-terminated).
+ * @param size Size of the buffer; SPAN_CAPACITY * SPAN_EVENT_LENGTH is enough.
+ * @return The length of the JSON, or 0 if the buffer is too small.
+ */
+size_t trayButtonTrace(char *buffer, size_t size);
+
+/**
+ * Gets a snapshot of the metrics (see core/metrics.h), for HOST_EVENT_METRICS. In-process, there's no stdout for them
+ * to be written to.
+ * @param buffer Receives the JSON (always null-terminated).
+ * @param size Size of the buffer; METRICS_JSON_LENGTH is enough.
+ * @return The length of the JSON, or 0 if the buffer is too small.
+ */
+size_t trayButtonMetrics(char *buffer, size_t size);
+
+#endif /* TRAY_BUTTON_H */